@@ -11,6 +11,22 @@
 #include "logger.h"
 #include "ble_peripheral_manager.h"
 #include "ble_client_manager.h"
+#include "bike_driver.h"
+#include "bike_link.h"
+#include "telemetry.h"
+#include "ftms_forwarder.h"
+#include "ftms_control_point.h"
+#include "app_sessions.h"
+#include "sensor_links.h"
+#include "link_manager.h"
+#include "erg_controller.h"
+#include "stepper_motion.h"
+#include "resistance_calibration.h"
+#include "bike_capture.h"
+#include "display_manager.h"
+#include "system_tasks.h"
+#include "heap_monitor.h"
+#include "metrics.h"
 
 // --- Global Device Name ---
 std::string globalDeviceName; 
@@ -29,6 +45,8 @@ NimBLECharacteristic* pSupportedResistanceRangeCharacteristic_Peripheral = NULL;
 NimBLECharacteristic* pSupportedPowerRangeCharacteristic_Peripheral = NULL;
 NimBLECharacteristic* pSupportedHeartRateRangeCharacteristic_Peripheral = NULL;
 NimBLECharacteristic* pServiceChangedCharacteristic_Peripheral = NULL;
+NimBLECharacteristic* pCyclingPowerMeasurementCharacteristic_Peripheral = NULL;
+NimBLECharacteristic* pCscMeasurementCharacteristic_Peripheral = NULL;
 volatile bool mywhooshConnected = false;
 TaskHandle_t blePeripheralTaskHandle = NULL;
 
@@ -43,18 +61,45 @@ NimBLERemoteCharacteristic* pBikeFTMSFeatureCharacteristic = NULL;
 NimBLERemoteCharacteristic* pBikeCustomDataCharacteristic = NULL;
 bool ftmsDataNotificationsEnabled = false; 
 bool customDataNotificationsEnabled = false; 
-TaskHandle_t bleScanTaskHandle = NULL;
-TaskHandle_t bleConnectTaskHandle = NULL;
+
+// --- Global Bike Connect Task (the button's scans and connects) ---
+TaskHandle_t bikeConnectTaskHandle = NULL;
+
+// --- Global Bike Control Task (resistance writes to bikes that take them over BLE) ---
+TaskHandle_t bikeControlTaskHandle = NULL;
+
+// --- Global Bike Link Task (reconnects the known bike by address) ---
+TaskHandle_t bikeLinkTaskHandle = NULL;
+
+// --- Global Forwarder Task (bike -> app data path) ---
+TaskHandle_t forwarderTaskHandle = NULL;
+
+// --- Global Control Point Task (sends queued 0x2AD9 responses and status notifications) ---
+TaskHandle_t controlPointTaskHandle = NULL;
+
+// --- Global Sensor Task (heart-rate strap / power meter links) ---
+TaskHandle_t sensorTaskHandle = NULL;
+
+// --- Global Link Manager Task (connection parameters of the bike and app links) ---
+TaskHandle_t linkManagerTaskHandle = NULL;
+
+// --- Global ERG Task (Set Target Power -> resistance level) ---
+TaskHandle_t ergTaskHandle = NULL;
+
+// --- Global Motion Task (target level -> knob stepper) ---
+TaskHandle_t motionTaskHandle = NULL;
+
+// --- Global Calibration Task (knob sweep, started from the console) ---
+TaskHandle_t calibrationTaskHandle = NULL;
+
+// --- Global Log Drain Task (writes queued log lines to Serial) ---
+TaskHandle_t logDrainTaskHandle = NULL;
 
 // --- Global Sensor Data Variables ---
-uint16_t currentCadence = 0;
-uint16_t currentPower = 0;   
-uint16_t currentSpeed = 0;   
-uint32_t totalDistance = 0;  
+// Live speed/cadence/power/calories/resistance live in the telemetry snapshot (telemetry.h), the
+// ride totals (distance, energy, time) in its session totals (ride_session.h).
 uint32_t bikeMachineFeatures = 0;     
 uint32_t bikeTargetSettingFeatures = 0; 
-uint16_t bikeRawCaloriesX10 = 0; 
-volatile uint8_t currentBikeResistanceLevel_Apparent = 0; 
 
 // --- Global Variables for Target Data from App ---
 int16_t  targetInclinationPercentX100 = 0; 
@@ -74,149 +119,6 @@ bool displayInitialized = false;
 // --- Button State ---
 bool buttonPressedLastState = false;
 
-// --- Display Functions ---
-void initDisplay() {
-    tft.init();
-    tft.setRotation(0); 
-    spr.createSprite(tft.width(), tft.height());
-    spr.fillSprite(TFT_BLACK); 
-    spr.setTextColor(TFT_WHITE, TFT_BLACK); 
-    spr.setTextSize(2); 
-    spr.setCursor(10, 80);
-    spr.println("SMARTUP BIKE");
-    spr.pushSprite(0, 0); 
-    ts_log_printf("TFT Display Initialized. Sprite created (%dx%d).", spr.width(), spr.height());
-    displayInitialized = true;
-}
-
-void updateDisplay() {
-    if (!displayInitialized) return;
-
-    spr.fillSprite(TFT_BLACK); 
-    spr.setTextWrap(false);    
-
-    // Define positions and sizes
-    int16_t yPos = 0;
-    int16_t xPosLabel = 5; 
-    int16_t xPosValue = tft.width() * 2 / 3 -15; // Shift values further right
-    int16_t labelHeight = 15; 
-    int16_t valueHeight = 17;  
-    int16_t lineSpacing = 3;   
-
-    // Header
-    spr.setTextSize(2);
-    spr.setTextColor(TFT_CYAN, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos); // Use xPosLabel for header too
-    spr.println("SMARTUP BIKE");
-    yPos += valueHeight + 4; 
-
-    // Bike Connection Status
-    spr.setTextSize(1); 
-    spr.setCursor(xPosLabel, yPos);
-    if (!pTargetBikeDevice && !bikeSensorConnected && !bikeAttemptingConnection) {
-        spr.setTextColor(TFT_ORANGE, TFT_BLACK);
-        spr.print("Bike: SCAN (BTN)");
-    } else if (pTargetBikeDevice && !bikeSensorConnected && !bikeAttemptingConnection) {
-        spr.setTextColor(TFT_YELLOW, TFT_BLACK);
-        spr.print("Bike: PAIR (BTN)");
-    } else if (bikeAttemptingConnection) {
-        spr.setTextColor(TFT_BLUE, TFT_BLACK);
-        spr.print("Bike: CONNECTING...");
-    } else if (bikeSensorConnected) {
-        spr.setTextColor(TFT_GREEN, TFT_BLACK);
-        spr.print("Bike: CONNECTED");
-    } else { 
-        spr.setTextColor(TFT_RED, TFT_BLACK);
-        spr.print("Bike: OFFLINE");
-    }
-    yPos += labelHeight + 1;
-
-    // MyWhoosh App Connection Status
-    spr.setCursor(xPosLabel, yPos);
-    bool currentMyWhooshStatus = mywhooshConnected; 
-    spr.setTextColor(currentMyWhooshStatus ? TFT_GREEN : TFT_RED, TFT_BLACK);
-    spr.printf("App:  %s", currentMyWhooshStatus ? "CONNECTED" : "OFFLINE");
-    yPos += labelHeight + lineSpacing + 2; 
-
-    // Resistance (Bike's current)
-    spr.setTextColor(TFT_WHITE, TFT_BLACK); 
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Bike Res:");
-    spr.setTextSize(2); spr.setCursor(xPosValue, yPos); spr.printf("%u", currentBikeResistanceLevel_Apparent);
-    yPos += valueHeight + lineSpacing;
-
-    // Target Resistance (from App)
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Tgt Res:"); // Shortened label
-    spr.setTextColor(TFT_GOLD, TFT_BLACK); 
-    spr.setTextSize(2); spr.setCursor(xPosValue, yPos); spr.printf("%u", targetResistanceLevel_App);
-    yPos += valueHeight + lineSpacing;
-
-    // Target Inclination (from App)
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Tgt Inc:"); // Shortened label
-    spr.setTextColor(TFT_VIOLET, TFT_BLACK); 
-    spr.setTextSize(2); spr.setCursor(xPosValue, yPos);
-    char inclBuffer[10];
-    sprintf(inclBuffer, "%.1f%%", (float)targetInclinationPercentX100 / 100.0f); // Display with 1 decimal for space
-    spr.print(inclBuffer);
-    yPos += valueHeight + lineSpacing;
-
-    // Resistance Match Status
-    if (mywhooshConnected && bikeSensorConnected && targetResistanceLevel_App > 0) { 
-        targetResistanceMatchesBike = (currentBikeResistanceLevel_Apparent == targetResistanceLevel_App);
-    } else {
-        targetResistanceMatchesBike = false; 
-    }
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Match:"); // Shortened label
-    spr.setTextSize(2); spr.setCursor(xPosValue, yPos);
-    if (mywhooshConnected && bikeSensorConnected && targetResistanceLevel_App > 0) {
-        spr.setTextColor(targetResistanceMatchesBike ? TFT_GREEN : TFT_RED, TFT_BLACK);
-        spr.print(targetResistanceMatchesBike ? "YES" : "NO");
-    } else {
-        spr.setTextColor(TFT_DARKGREY, TFT_BLACK);
-        spr.print("N/A");
-    }
-    yPos += valueHeight + lineSpacing;
-
-    // Speed
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Speed:");
-    spr.setTextSize(2); spr.setTextColor(TFT_GREENYELLOW, TFT_BLACK); spr.setCursor(xPosValue, yPos);
-    char speedBuffer[12]; sprintf(speedBuffer, "%.1f", (float)currentSpeed / 100.0); spr.print(speedBuffer);
-    yPos += valueHeight + lineSpacing;
-
-    // Cadence
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Cadence:");
-    spr.setTextSize(2); spr.setTextColor(TFT_ORANGE, TFT_BLACK); spr.setCursor(xPosValue, yPos);
-    spr.printf("%.0f", (float)currentCadence); // Display currentCadence directly
-    yPos += valueHeight + lineSpacing;
-
-    // Power
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Power:");
-    spr.setTextSize(2); spr.setTextColor(TFT_MAGENTA, TFT_BLACK); spr.setCursor(xPosValue, yPos);
-    spr.printf("%u", currentPower);
-    yPos += valueHeight + lineSpacing;
-
-    // Calories
-    spr.setTextColor(TFT_WHITE, TFT_BLACK);
-    spr.setCursor(xPosLabel, yPos);
-    spr.setTextSize(1); spr.print("Calories:");
-    spr.setTextSize(2); spr.setTextColor(TFT_SKYBLUE, TFT_BLACK); spr.setCursor(xPosValue, yPos);
-    spr.printf("%.1f", (float)bikeRawCaloriesX10 / 10.0); 
-    
-    spr.pushSprite(0, 0); 
-}
-
 // --- Handle Button Press ---
 void handleButtonPress() {
     ts_log_printf("[handleButtonPress] Button Pressed!");
@@ -224,6 +126,7 @@ void handleButtonPress() {
         ts_log_printf("[handleButtonPress] Already connected or attempting connection to bike.");
         if(bikeSensorConnected && pBikeClient != nullptr) {
             ts_log_printf("[handleButtonPress] Disconnecting from bike due to button press while connected.");
+            bikeLinkPause(); // The rider asked for it: no automatic reconnect
             pBikeClient->disconnect(); 
         }
         targetInclinationPercentX100 = 0;
@@ -232,37 +135,99 @@ void handleButtonPress() {
         return;
     }
 
-    if (pTargetBikeDevice == nullptr) { 
+    if (pTargetBikeDevice == nullptr && bikeLinkKnown()) {
+        ts_log_printf("[handleButtonPress] Reconnecting to the known bike (console '%c' forgets it)...", SERIAL_CMD_BIKE_FORGET);
+        bikeLinkKick();
+    }
+    else if (pTargetBikeDevice == nullptr) { 
         ts_log_printf("[handleButtonPress] No target bike known. Starting scan...");
-        if (bleScanTaskHandle != NULL) { 
-             eTaskState taskState = eTaskGetState(bleScanTaskHandle);
-             if (taskState != eDeleted && taskState != eInvalid) {
-                vTaskDelete(bleScanTaskHandle);
-             }
-             bleScanTaskHandle = NULL; 
-        }
-        xTaskCreatePinnedToCore(startBikeScanTask_func, "BikeScanBtn", 8192, NULL, 1, &bleScanTaskHandle, 0);
+        bikeCommandPost(BIKE_COMMAND_SCAN);
     }
     else if (pTargetBikeDevice != nullptr && !bikeSensorConnected && !bikeAttemptingConnection) { 
         ts_log_printf("[handleButtonPress] Target bike known. Attempting to connect...");
-        if (pBikeClient == nullptr) { 
-            pBikeClient = NimBLEDevice::createClient();
-            if (pBikeClient == nullptr) {
-                ts_log_printf("[handleButtonPress] FATAL: Failed to create new pBikeClient!");
-                return; 
-            }
-            pBikeClient->setClientCallbacks(&myBikeClientCallbacks_global); 
-        }
+        if (bikeClientGet() == nullptr) return;
         bikeAttemptingConnection = true; 
         updateDisplay(); 
-        if (bleConnectTaskHandle != NULL) { 
-             eTaskState taskState = eTaskGetState(bleConnectTaskHandle);
-             if (taskState != eDeleted && taskState != eInvalid) {
-                vTaskDelete(bleConnectTaskHandle);
-             }
-             bleConnectTaskHandle = NULL; 
+        if (!bikeCommandPost(BIKE_COMMAND_CONNECT)) bikeAttemptingConnection = false;
+    }
+}
+
+// --- UI Events (link and control changes from the BLE callbacks) ---
+void handleUiEvent(const UiEvent& event) {
+    switch (event.type) {
+        case UI_EVENT_APP_LINK:
+            ts_log_printf("App connections (UI): %u", event.value);
+            break;
+        case UI_EVENT_CONTROL:
+            // Targets belong to the app holding control: ftmsClearControlTargets() already dropped them
+            // where it left, not when any app does.
+            ts_log_printf("App control (UI): %s", event.value != APP_SESSION_NONE ? "TAKEN" : "RELEASED");
+            if (event.value == APP_SESSION_NONE) {
+                targetResistanceMatchesBike = false;
+            }
+            break;
+        case UI_EVENT_BIKE_LINK:
+            ts_log_printf("Bike connection (UI): %s", event.value ? "CONNECTED" : "DOWN");
+            break;
+        default:
+            break;
+    }
+}
+
+// --- Serial Console Commands ---
+void handleSerialCommands() {
+    while (Serial.available() > 0) {
+        int command = Serial.read();
+        switch (command) {
+            case SERIAL_CMD_CAPTURE_DUMP:
+                captureDumpToSerial();
+                break;
+            case SERIAL_CMD_CAPTURE_CLEAR:
+                captureClear();
+                ts_log_printf("[Console] Capture buffer cleared.");
+                break;
+            case SERIAL_CMD_LOG_VERBOSE: {
+                uint8_t level = ts_log_get_level(LOG_MOD_MAIN) >= LOG_LEVEL_DEBUG ? LOG_DEFAULT_LEVEL : LOG_LEVEL_DEBUG;
+                ts_log_set_all_levels(level);
+                ts_log_printf("[Console] Log level set to %s for all modules.", level >= LOG_LEVEL_DEBUG ? "DEBUG" : "default");
+                break;
+            }
+            case SERIAL_CMD_LOG_TOKENIZED:
+                ts_log_set_tokenized(!ts_log_tokenized());
+                ts_log_printf("[Console] Tokenized logging %s.", ts_log_tokenized() ? "ON (decode with tools/log_decode.py)" : "OFF");
+                break;
+            case SERIAL_CMD_CALIBRATE:
+                calibrationStart();
+                break;
+            case SERIAL_CMD_BIKE_LINK:
+                bikeLinkLogStats();
+                break;
+            case SERIAL_CMD_BIKE_FORGET:
+                bikeLinkForget();
+                break;
+            case SERIAL_CMD_LINKS:
+                linkManagerLogStats();
+                break;
+            case SERIAL_CMD_TASKS:
+                systemTasksLogStats();
+                break;
+            case SERIAL_CMD_HEAP:
+                heapMonitorLogStats();
+                break;
+            case SERIAL_CMD_METRICS:
+                metricsLogStats();
+                break;
+            case SERIAL_CMD_LOG_PANIC: {
+                static bool panicLogging = LOG_PANIC_FLUSH;
+                panicLogging = !panicLogging;
+                ts_log_set_panic_mode(panicLogging);
+                ts_log_printf("[Console] Panic (synchronous) logging %s. Dropped lines so far: %lu",
+                              panicLogging ? "ON" : "OFF", (unsigned long)ts_log_dropped());
+                break;
+            }
+            default:
+                break; // Ignore line endings and unknown keys
         }
-        xTaskCreatePinnedToCore(connectToBikeDeviceTask_func, "ConnectBikeBtn", 8192, NULL, 2, &bleConnectTaskHandle, 0);
     }
 }
 
@@ -273,24 +238,58 @@ void setup() {
   while (!Serial && (millis() - setupStartTime < 3000));
   ts_log_printf("\n[%08.3fs] Starting ESP32 FTMS BLE Bridge...", millis()/1000.0);
 
+  // Logging goes through the drain task from here on; nothing else may block on the UART.
+  ts_log_begin();
+  systemTaskCreate(SYSTEM_TASK_LOG_DRAIN);
+
   initDisplay(); 
+#if CAPTURE_ENABLED
+  captureBegin(CAPTURE_BUFFER_BYTES);
+#endif
   pinMode(PAIR_BUTTON_PIN, INPUT_PULLUP); 
   globalDeviceName = "DIY FTMS Bike"; 
   NimBLEDevice::init("");
   NimBLEDevice::setMTU(247); 
   delay(500); 
   
-  BaseType_t peripheralTaskStatus = xTaskCreatePinnedToCore(
-                                      blePeripheralSetupTask_func, "BLEPeripheralSetup", 
-                                      20480, NULL, 1, &blePeripheralTaskHandle, 0);                         
-  if (peripheralTaskStatus != pdPASS) {
-    ts_log_printf("Failed to create BLE Peripheral Setup Task. Error: %d", peripheralTaskStatus);
+  // Task layout (cores, priorities, stacks): system_tasks.cpp.
+  systemTasksBegin();
+  calibrationBegin();
+  controlPointBegin();
+  bikeClientBegin();
+  bikeLinkBegin();
+  systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP); // One-shot
+  systemTaskCreate(SYSTEM_TASK_FORWARDER);
+  systemTaskCreate(SYSTEM_TASK_CONTROL_POINT);
+  systemTaskCreate(SYSTEM_TASK_BIKE_CONTROL);
+  systemTaskCreate(SYSTEM_TASK_BIKE_CONNECT);
+#if BIKE_LINK_AUTO_RECONNECT
+  systemTaskCreate(SYSTEM_TASK_BIKE_LINK);
+#endif
+  systemTaskCreate(SYSTEM_TASK_ERG);
+#if LINK_MANAGER_ENABLED
+  systemTaskCreate(SYSTEM_TASK_LINK_MANAGER);
+#endif
+
+#if SENSOR_HR_ENABLED || SENSOR_POWER_ENABLED
+  sensorBegin();
+  systemTaskCreate(SYSTEM_TASK_SENSORS);
+#endif
+
+#if STEPPER_ENABLED
+  // setup() runs on core 1: the step timer interrupt stays off the NimBLE host's core.
+  if (motionBegin()) {
+    systemTaskCreate(SYSTEM_TASK_MOTION);
   }
+#endif
   updateDisplay(); 
 }
 
 // --- MAIN LOOP ---
 void loop() {
+  handleSerialCommands();
+  calibrationSaveIfDirty();
+
   static unsigned long lastButtonCheck = 0;
   if (millis() - lastButtonCheck > 50) { 
     bool currentButtonState = (digitalRead(PAIR_BUTTON_PIN) == LOW); 
@@ -301,32 +300,40 @@ void loop() {
     lastButtonCheck = millis();
   }
 
-  static bool oldMywhooshConnected_loop = false;
-  bool currentMyWhooshStatus = mywhooshConnected; 
-  if (currentMyWhooshStatus != oldMywhooshConnected_loop) {
-    ts_log_printf("MyWhoosh app connection status (loop): %s", currentMyWhooshStatus ? "CONNECTED" : "DISCONNECTED");
-    oldMywhooshConnected_loop = currentMyWhooshStatus;
-    if (!currentMyWhooshStatus) {
-        targetInclinationPercentX100 = 0;
-        targetResistanceLevel_App = 0;
-        targetResistanceMatchesBike = false;
-    }
-    updateDisplay(); 
-  }
-
-  static unsigned long lastDataSendToMyWhooshTime = 0;
-  if (mywhooshConnected && bikeSensorConnected) {
-    if (millis() - lastDataSendToMyWhooshTime > 250) { 
-        sendDataToMyWhoosh(); 
-        lastDataSendToMyWhooshTime = millis();
-    }
-  }
+  // Bike -> app data is forwarded by forwarderTask_func as soon as each bike sample arrives.
 
   static unsigned long lastDisplayUpdateTime = 0;
   if (millis() - lastDisplayUpdateTime > 500) { 
       updateDisplay(); 
       lastDisplayUpdateTime = millis();
   }
-  vTaskDelay(pdMS_TO_TICKS(10)); 
+
+#if SYSTEM_TASKS_STATS_INTERVAL_MS > 0
+  static unsigned long lastTaskStatsTime = 0;
+  if (millis() - lastTaskStatsTime >= SYSTEM_TASKS_STATS_INTERVAL_MS) {
+      systemTasksLogStats();
+      lastTaskStatsTime = millis();
+  }
+#endif
+
+#if METRICS_LOG_INTERVAL_MS > 0
+  static unsigned long lastMetricsTime = 0;
+  if (millis() - lastMetricsTime >= METRICS_LOG_INTERVAL_MS) {
+      metricsLogStats();
+      lastMetricsTime = millis();
+  }
+#endif
+
+  // Steady state: nothing left to allocate once the bike and an app are connected.
+  heapMonitorPoll(bikeSensorConnected && appSessionCount() > 0);
+
+  // The BLE callbacks post link and control changes; waiting on the queue also paces loop().
+  UiEvent event;
+  if (uiWaitEvent(event, pdMS_TO_TICKS(10))) {
+    do {
+      handleUiEvent(event);
+    } while (uiWaitEvent(event, 0));
+    updateDisplay(); 
+  }
 }
 
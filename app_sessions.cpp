@@ -0,0 +1,150 @@
+#define LOG_MODULE LOG_MOD_APP
+#include "app_sessions.h"
+#include "system_tasks.h"
+
+static portMUX_TYPE appSessionsMux = portMUX_INITIALIZER_UNLOCKED;
+static AppSession appSessions[APP_SESSION_MAX];
+static uint8_t appSessionsOpen = 0;
+static uint16_t controlOwner = APP_SESSION_NONE;
+static bool appSessionsInitialized = false;
+
+// Called with appSessionsMux held.
+static void initSessionsLocked() {
+    if (appSessionsInitialized) return;
+    for (uint8_t i = 0; i < APP_SESSION_MAX; i++) {
+        appSessions[i].connHandle = APP_SESSION_NONE;
+    }
+    appSessionsInitialized = true;
+}
+
+// Called with appSessionsMux held.
+static AppSession* findSessionLocked(uint16_t connHandle) {
+    initSessionsLocked();
+    for (uint8_t i = 0; i < APP_SESSION_MAX; i++) {
+        if (appSessions[i].connHandle == connHandle) return &appSessions[i];
+    }
+    return NULL;
+}
+
+bool appSessionOpen(uint16_t connHandle, uint16_t mtu, const uint8_t* peerAddress) {
+    portENTER_CRITICAL(&appSessionsMux);
+    AppSession* session = findSessionLocked(connHandle);
+    if (session == NULL) session = findSessionLocked(APP_SESSION_NONE);
+    if (session != NULL) {
+        if (session->connHandle == APP_SESSION_NONE) appSessionsOpen++;
+        session->connHandle = connHandle;
+        session->mtu = mtu >= 23 ? mtu : 23;
+        memcpy(session->peerAddress, peerAddress, sizeof(session->peerAddress));
+        session->subscriptions = 0;
+        session->connectedMs = millis();
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+    return session != NULL;
+}
+
+bool appSessionClose(uint16_t connHandle) {
+    bool heldControl = false;
+    portENTER_CRITICAL(&appSessionsMux);
+    AppSession* session = connHandle != APP_SESSION_NONE ? findSessionLocked(connHandle) : NULL;
+    if (session != NULL) {
+        session->connHandle = APP_SESSION_NONE;
+        appSessionsOpen--;
+        if (controlOwner == connHandle) {
+            controlOwner = APP_SESSION_NONE;
+            heldControl = true;
+        }
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+    if (heldControl) uiPostEvent(UI_EVENT_CONTROL, APP_SESSION_NONE);
+    return heldControl;
+}
+
+void appSessionSetMtu(uint16_t connHandle, uint16_t mtu) {
+    portENTER_CRITICAL(&appSessionsMux);
+    AppSession* session = connHandle != APP_SESSION_NONE ? findSessionLocked(connHandle) : NULL;
+    if (session != NULL) session->mtu = mtu >= 23 ? mtu : 23;
+    portEXIT_CRITICAL(&appSessionsMux);
+}
+
+void appSessionSetSubscribed(uint16_t connHandle, uint8_t subscription, bool enabled) {
+    portENTER_CRITICAL(&appSessionsMux);
+    AppSession* session = connHandle != APP_SESSION_NONE ? findSessionLocked(connHandle) : NULL;
+    if (session != NULL) {
+        if (enabled) session->subscriptions |= subscription;
+        else session->subscriptions &= ~subscription;
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+}
+
+uint8_t appSessionCount() {
+    return appSessionsOpen;
+}
+
+bool appSessionHasFreeSlot() {
+    return appSessionsOpen < APP_SESSION_MAX;
+}
+
+uint8_t appSessionSubscribers(uint8_t subscription, uint16_t* handles, uint16_t& minMtu) {
+    uint8_t count = 0;
+    minMtu = 0xFFFF;
+    portENTER_CRITICAL(&appSessionsMux);
+    initSessionsLocked();
+    for (uint8_t i = 0; i < APP_SESSION_MAX; i++) {
+        const AppSession& session = appSessions[i];
+        if (session.connHandle == APP_SESSION_NONE || !(session.subscriptions & subscription)) continue;
+        handles[count++] = session.connHandle;
+        if (session.mtu < minMtu) minMtu = session.mtu;
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+    return count;
+}
+
+uint8_t appSessionGetAll(AppSession* out) {
+    uint8_t count = 0;
+    portENTER_CRITICAL(&appSessionsMux);
+    initSessionsLocked();
+    for (uint8_t i = 0; i < APP_SESSION_MAX; i++) {
+        if (appSessions[i].connHandle != APP_SESSION_NONE) out[count++] = appSessions[i];
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+    return count;
+}
+
+// --- Control Ownership ---
+bool appSessionRequestControl(uint16_t connHandle) {
+    portENTER_CRITICAL(&appSessionsMux);
+    bool granted = findSessionLocked(connHandle) != NULL &&
+                   (controlOwner == APP_SESSION_NONE || controlOwner == connHandle);
+    bool taken = granted && controlOwner != connHandle;
+    if (granted) controlOwner = connHandle;
+    portEXIT_CRITICAL(&appSessionsMux);
+    if (taken) uiPostEvent(UI_EVENT_CONTROL, connHandle);
+    return granted;
+}
+
+bool appSessionCheckControl(uint16_t connHandle) {
+    portENTER_CRITICAL(&appSessionsMux);
+    bool allowed = controlOwner == connHandle && connHandle != APP_SESSION_NONE;
+    bool taken = false;
+    if (!allowed && APP_SESSION_IMPLICIT_CONTROL && controlOwner == APP_SESSION_NONE &&
+        findSessionLocked(connHandle) != NULL) {
+        controlOwner = connHandle;
+        allowed = true;
+        taken = true;
+    }
+    portEXIT_CRITICAL(&appSessionsMux);
+    if (taken) uiPostEvent(UI_EVENT_CONTROL, connHandle);
+    return allowed;
+}
+
+void appSessionReleaseControl(uint16_t connHandle) {
+    portENTER_CRITICAL(&appSessionsMux);
+    bool released = controlOwner == connHandle && connHandle != APP_SESSION_NONE;
+    if (released) controlOwner = APP_SESSION_NONE;
+    portEXIT_CRITICAL(&appSessionsMux);
+    if (released) uiPostEvent(UI_EVENT_CONTROL, APP_SESSION_NONE);
+}
+
+uint16_t appSessionControlOwner() {
+    return controlOwner;
+}
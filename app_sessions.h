@@ -0,0 +1,51 @@
+#ifndef APP_SESSIONS_H
+#define APP_SESSIONS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- App Sessions (one per connected central) ---
+// Written from the NimBLE host task (connect, disconnect, MTU, subscribe, Control Point writes) and
+// read by the forwarder and Control Point tasks; all access goes through the functions below.
+#define APP_SESSION_NONE 0xFFFF // Same value as BLE_HS_CONN_HANDLE_NONE
+
+// Subscription bits (CCCDs the central has enabled)
+#define APP_SUB_INDOOR_BIKE_DATA 0x01 // 0x2ACC
+#define APP_SUB_TRAINING_STATUS  0x02 // 0x2AD3
+#define APP_SUB_MACHINE_STATUS   0x04 // 0x2ADA
+#define APP_SUB_FEATURE          0x08 // 0x2AD2
+#define APP_SUB_SERVICE_CHANGED  0x10 // 0x2A05
+#define APP_SUB_CYCLING_POWER    0x20 // 0x2A63
+#define APP_SUB_CSC              0x40 // 0x2A5B
+
+struct AppSession {
+    uint16_t connHandle;    // APP_SESSION_NONE = free slot
+    uint16_t mtu;           // Negotiated ATT MTU (23 until exchanged)
+    uint8_t  peerAddress[6];
+    uint8_t  subscriptions; // APP_SUB_*
+    uint32_t connectedMs;
+};
+
+// Connection events (peripheral server callbacks). Open returns false when every slot is taken.
+bool appSessionOpen(uint16_t connHandle, uint16_t mtu, const uint8_t* peerAddress);
+bool appSessionClose(uint16_t connHandle); // True if the session held control
+void appSessionSetMtu(uint16_t connHandle, uint16_t mtu);
+void appSessionSetSubscribed(uint16_t connHandle, uint8_t subscription, bool enabled);
+
+uint8_t appSessionCount();
+bool appSessionHasFreeSlot(); // Advertising continues while this is true
+// Copies the handles of sessions subscribed to 'subscription' (up to APP_SESSION_MAX) and the smallest
+// MTU among them, so one encoded frame fits every subscriber. Returns the count.
+uint8_t appSessionSubscribers(uint8_t subscription, uint16_t* handles, uint16_t& minMtu);
+uint8_t appSessionGetAll(AppSession* out); // Open sessions, up to APP_SESSION_MAX
+
+// --- Control Ownership (FTMS Request Control) ---
+// One session at a time may change targets. With APP_SESSION_IMPLICIT_CONTROL, the first session to
+// write a target while nobody holds control gets it, for apps that never send Request Control.
+bool appSessionRequestControl(uint16_t connHandle);  // False if another session holds control
+bool appSessionCheckControl(uint16_t connHandle);    // May this session change targets now?
+void appSessionReleaseControl(uint16_t connHandle);  // Reset (0x01) from the owner
+uint16_t appSessionControlOwner();                   // APP_SESSION_NONE if free
+
+#endif // APP_SESSIONS_H
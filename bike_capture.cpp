@@ -0,0 +1,332 @@
+#define LOG_MODULE LOG_MOD_CAPTURE
+#include "bike_capture.h"
+#include "ble_client_manager.h"
+#include "ftms_forwarder.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static uint8_t* captureRing = nullptr;
+static size_t captureCapacity = 0;
+static size_t captureHead = 0;          // Next write offset
+static size_t captureTail = 0;          // Offset of the oldest record
+static size_t captureUsed = 0;
+static uint32_t captureRecordCount = 0;
+static uint32_t captureOverwritten = 0;
+static uint32_t captureDroppedWhilePaused = 0;
+static int64_t captureOldestUs = 0;     // Absolute time of the oldest record
+static int64_t captureNewestUs = 0;     // Absolute time of the newest record
+static bool captureInPsram = false;
+static bool capturePaused = false;      // Set while the ring is being read out
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Ring helpers (caller holds captureMux or has paused the recorder) ---
+static void ringWrite(size_t offset, const uint8_t* src, size_t length) {
+    size_t first = captureCapacity - offset;
+    if (first >= length) {
+        memcpy(captureRing + offset, src, length);
+    } else {
+        memcpy(captureRing + offset, src, first);
+        memcpy(captureRing, src + first, length - first);
+    }
+}
+
+static void ringRead(size_t offset, uint8_t* dst, size_t length) {
+    size_t first = captureCapacity - offset;
+    if (first >= length) {
+        memcpy(dst, captureRing + offset, length);
+    } else {
+        memcpy(dst, captureRing + offset, first);
+        memcpy(dst + first, captureRing, length - first);
+    }
+}
+
+static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeLe32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value; p[1] = (uint8_t)(value >> 8); p[2] = (uint8_t)(value >> 16); p[3] = (uint8_t)(value >> 24);
+}
+
+static void evictOldestRecord() {
+    uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+    ringRead(captureTail, header, sizeof(header));
+    size_t recordSize = CAPTURE_RECORD_HEADER_SIZE + header[1];
+    captureTail = (captureTail + recordSize) % captureCapacity;
+    captureUsed -= recordSize;
+    captureRecordCount--;
+    captureOverwritten++;
+    if (captureRecordCount > 0) {
+        // The next record's delta was relative to the one just dropped.
+        ringRead(captureTail, header, sizeof(header));
+        captureOldestUs += readLe32(header + 2);
+    }
+}
+
+// --- Recorder ---
+bool captureBegin(size_t bufferBytes) {
+    captureEnd();
+    captureRing = (uint8_t*)heap_caps_malloc(bufferBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    captureInPsram = captureRing != nullptr;
+    if (!captureRing) {
+        captureRing = (uint8_t*)heap_caps_malloc(bufferBytes, MALLOC_CAP_8BIT);
+    }
+    if (!captureRing) {
+        ts_log_error("[Capture] FAILED to allocate %u byte capture buffer.", (unsigned)bufferBytes);
+        return false;
+    }
+    captureCapacity = bufferBytes;
+    captureClear();
+    ts_log_printf("[Capture] Recording raw bike notifications into %u bytes of %s.",
+                  (unsigned)bufferBytes, captureInPsram ? "PSRAM" : "internal RAM");
+    return true;
+}
+
+void captureEnd() {
+    portENTER_CRITICAL(&captureMux);
+    uint8_t* ring = captureRing;
+    captureRing = nullptr;
+    captureCapacity = 0;
+    portEXIT_CRITICAL(&captureMux);
+    if (ring) heap_caps_free(ring);
+}
+
+void captureClear() {
+    portENTER_CRITICAL(&captureMux);
+    captureHead = 0;
+    captureTail = 0;
+    captureUsed = 0;
+    captureRecordCount = 0;
+    captureOverwritten = 0;
+    captureDroppedWhilePaused = 0;
+    captureOldestUs = 0;
+    captureNewestUs = 0;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+void captureRecord(uint8_t source, const uint8_t* data, size_t length) {
+    captureRecordAt(source, data, length, esp_timer_get_time());
+}
+
+void captureRecordAt(uint8_t source, const uint8_t* data, size_t length, int64_t timestampUs) {
+    if (captureRing == nullptr || length > CAPTURE_MAX_PAYLOAD) {
+        return;
+    }
+    size_t recordSize = CAPTURE_RECORD_HEADER_SIZE + length;
+
+    portENTER_CRITICAL(&captureMux);
+    if (captureRing == nullptr || recordSize > captureCapacity) {
+        portEXIT_CRITICAL(&captureMux);
+        return;
+    }
+    if (capturePaused) {
+        captureDroppedWhilePaused++;
+        portEXIT_CRITICAL(&captureMux);
+        return;
+    }
+    while (captureCapacity - captureUsed < recordSize) {
+        evictOldestRecord();
+    }
+
+    uint32_t deltaUs = 0;
+    if (captureRecordCount == 0) {
+        captureOldestUs = timestampUs;
+    } else {
+        int64_t delta = timestampUs - captureNewestUs;
+        deltaUs = delta < 0 ? 0 : (delta > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)delta);
+    }
+    captureNewestUs = timestampUs;
+
+    uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+    header[0] = source;
+    header[1] = (uint8_t)length;
+    writeLe32(header + 2, deltaUs);
+    ringWrite(captureHead, header, sizeof(header));
+    ringWrite((captureHead + sizeof(header)) % captureCapacity, data, length);
+    captureHead = (captureHead + recordSize) % captureCapacity;
+    captureUsed += recordSize;
+    captureRecordCount++;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+void captureGetStats(CaptureStats& out) {
+    portENTER_CRITICAL(&captureMux);
+    out.capacityBytes = captureCapacity;
+    out.usedBytes = captureUsed;
+    out.records = captureRecordCount;
+    out.overwritten = captureOverwritten;
+    out.droppedWhilePaused = captureDroppedWhilePaused;
+    out.inPsram = captureInPsram;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+size_t captureExportSize() {
+    portENTER_CRITICAL(&captureMux);
+    size_t size = CAPTURE_HEADER_SIZE + captureUsed;
+    portEXIT_CRITICAL(&captureMux);
+    return size;
+}
+
+static void setPaused(bool paused) {
+    portENTER_CRITICAL(&captureMux);
+    capturePaused = paused;
+    portEXIT_CRITICAL(&captureMux);
+}
+
+static void buildHeader(uint8_t* header) {
+    memcpy(header, CAPTURE_MAGIC, 4);
+    header[4] = CAPTURE_FORMAT_VERSION;
+    header[5] = 0;
+    writeLe32(header + 6, captureRecordCount);
+    writeLe32(header + 10, (uint32_t)((uint64_t)captureOldestUs & 0xFFFFFFFFu));
+    writeLe32(header + 14, (uint32_t)((uint64_t)captureOldestUs >> 32));
+}
+
+size_t captureExport(uint8_t* out, size_t maxLength) {
+    // Pausing under the lock guarantees no record is half-written while the ring is read out.
+    setPaused(true);
+    size_t total = CAPTURE_HEADER_SIZE + captureUsed;
+    if (captureRing == nullptr || maxLength < total) {
+        setPaused(false);
+        return 0;
+    }
+    buildHeader(out);
+    ringRead(captureTail, out + CAPTURE_HEADER_SIZE, captureUsed);
+    // The oldest record's delta is meaningless once it is the first record; export it as 0.
+    if (captureRecordCount > 0) writeLe32(out + CAPTURE_HEADER_SIZE + 2, 0);
+    setPaused(false);
+    return total;
+}
+
+static void dumpHexLine(const uint8_t* data, size_t length) {
+    static const char hexDigits[] = "0123456789ABCDEF";
+    char line[4 + 2 * 32 + 1];
+    memcpy(line, "CAP:", 4);
+    for (size_t i = 0; i < length; i++) {
+        line[4 + 2 * i] = hexDigits[data[i] >> 4];
+        line[4 + 2 * i + 1] = hexDigits[data[i] & 0x0F];
+    }
+    line[4 + 2 * length] = '\0';
+    Serial.println(line);
+}
+
+void captureDumpToSerial() {
+    if (captureRing == nullptr) {
+        ts_log_printf("[Capture] No capture buffer allocated.");
+        return;
+    }
+    setPaused(true);
+    size_t total = CAPTURE_HEADER_SIZE + captureUsed;
+    ts_log_printf("[Capture] Dumping %lu records (%u bytes). Recording paused during dump.",
+                  (unsigned long)captureRecordCount, (unsigned)total);
+    ts_log_flush();
+    ts_log_lock_output(); // Keep log lines out of the middle of the dump
+    Serial.printf("CAP-BEGIN %u\n", (unsigned)total);
+
+    uint8_t chunk[32];
+    buildHeader(chunk);
+    size_t chunkFill = CAPTURE_HEADER_SIZE;
+    size_t offset = captureTail;
+    size_t remaining = captureUsed;
+    bool firstRecordHeader = captureRecordCount > 0;
+    while (remaining > 0 || chunkFill > 0) {
+        size_t take = sizeof(chunk) - chunkFill;
+        if (take > remaining) take = remaining;
+        ringRead(offset, chunk + chunkFill, take);
+        if (firstRecordHeader && chunkFill == CAPTURE_HEADER_SIZE && take >= CAPTURE_RECORD_HEADER_SIZE) {
+            writeLe32(chunk + CAPTURE_HEADER_SIZE + 2, 0);
+            firstRecordHeader = false;
+        }
+        offset = (offset + take) % captureCapacity;
+        remaining -= take;
+        chunkFill += take;
+        dumpHexLine(chunk, chunkFill);
+        chunkFill = 0;
+    }
+    Serial.println("CAP-END");
+    ts_log_unlock_output();
+    setPaused(false);
+}
+
+// --- Replay ---
+bool captureForEachRecord(const uint8_t* image, size_t length, CaptureRecordHandler handler, void* context) {
+    if (length < CAPTURE_HEADER_SIZE || memcmp(image, CAPTURE_MAGIC, 4) != 0 || image[4] != CAPTURE_FORMAT_VERSION) {
+        return false;
+    }
+    uint32_t recordCount = readLe32(image + 6);
+    int64_t timestampUs = (int64_t)((uint64_t)readLe32(image + 10) | ((uint64_t)readLe32(image + 14) << 32));
+
+    size_t offset = CAPTURE_HEADER_SIZE;
+    for (uint32_t i = 0; i < recordCount; i++) {
+        if (offset + CAPTURE_RECORD_HEADER_SIZE > length) return false;
+        CaptureRecord record;
+        record.source = image[offset];
+        record.length = image[offset + 1];
+        timestampUs += readLe32(image + offset + 2);
+        record.timestampUs = timestampUs;
+        record.data = image + offset + CAPTURE_RECORD_HEADER_SIZE;
+        if (offset + CAPTURE_RECORD_HEADER_SIZE + record.length > length) return false;
+        handler(record, context);
+        offset += CAPTURE_RECORD_HEADER_SIZE + record.length;
+    }
+    return true;
+}
+
+struct ReplayContext {
+    bool realTime;
+    int64_t replayStartUs;
+    int64_t firstRecordUs;
+    bool started;
+    CaptureReplayStats stats;
+};
+
+static void replayRecord(const CaptureRecord& record, void* context) {
+    ReplayContext* ctx = (ReplayContext*)context;
+    if (!ctx->started) {
+        ctx->started = true;
+        ctx->firstRecordUs = record.timestampUs;
+        ctx->replayStartUs = esp_timer_get_time();
+    }
+    if (ctx->realTime) {
+        int64_t dueUs = ctx->replayStartUs + (record.timestampUs - ctx->firstRecordUs);
+        int64_t waitUs = dueUs - esp_timer_get_time();
+        if (waitUs > 1000) vTaskDelay(pdMS_TO_TICKS(waitUs / 1000));
+    }
+
+    ctx->stats.records++;
+    ctx->stats.capturedSpanUs = record.timestampUs - ctx->firstRecordUs;
+    if (record.source == CAPTURE_SOURCE_CUSTOM_DATA) ctx->stats.customDataRecords++;
+    else if (record.source == CAPTURE_SOURCE_FTMS_FEATURE) ctx->stats.featureRecords++;
+    if (!captureReplayRecord(record)) ctx->stats.malformed++;
+}
+
+bool captureReplayRecord(const CaptureRecord& record) {
+    // The parsers take a mutable pointer (NimBLE callback signature); replay from a copy.
+    uint8_t payload[CAPTURE_MAX_PAYLOAD];
+    memcpy(payload, record.data, record.length);
+
+    if (record.source == CAPTURE_SOURCE_CUSTOM_DATA) {
+        parseCustomBikeData(payload, record.length);
+        forwarderSignalNewSample();
+        return true;
+    }
+    if (record.source == CAPTURE_SOURCE_FTMS_FEATURE) {
+        parseBikeResistanceData(payload, record.length);
+        return true;
+    }
+    if (record.source == CAPTURE_SOURCE_INDOOR_BIKE_DATA) {
+        parseIndoorBikeData(payload, record.length);
+        forwarderSignalNewSample();
+        return true;
+    }
+    return false;
+}
+
+bool captureReplay(const uint8_t* image, size_t length, bool realTime, CaptureReplayStats* stats) {
+    ReplayContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.realTime = realTime;
+    bool ok = captureForEachRecord(image, length, replayRecord, &ctx);
+    if (stats) *stats = ctx.stats;
+    return ok;
+}
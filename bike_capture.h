@@ -0,0 +1,72 @@
+#ifndef BIKE_CAPTURE_H
+#define BIKE_CAPTURE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Capture Sources (one byte per record) ---
+#define CAPTURE_SOURCE_CUSTOM_DATA   0x01 // Bike's 0xFFF1 proprietary data
+#define CAPTURE_SOURCE_FTMS_FEATURE  0x02 // Bike's 0x2AD2 notifications (resistance)
+#define CAPTURE_SOURCE_INDOOR_BIKE_DATA 0x03 // Standard FTMS bike's Indoor Bike Data (bike_driver_ftms.cpp)
+
+// --- Capture Image Format ---
+// Exported captures are a header followed by records, all little-endian:
+//   Header: "SUBC" | version u8 | reserved u8 | record count u32 | first record time (us) i64
+//   Record: source u8 | length u8 | delta since previous record (us) u32 | payload[length]
+// The in-memory ring uses the same record layout; the oldest records are overwritten when full.
+#define CAPTURE_MAGIC            "SUBC"
+#define CAPTURE_FORMAT_VERSION   1
+#define CAPTURE_HEADER_SIZE      18
+#define CAPTURE_RECORD_HEADER_SIZE 6
+#define CAPTURE_MAX_PAYLOAD      255
+
+struct CaptureRecord {
+    uint8_t source;
+    uint8_t length;
+    int64_t timestampUs;   // Absolute, rebuilt from the header start time and the deltas
+    const uint8_t* data;
+};
+
+struct CaptureStats {
+    size_t capacityBytes;
+    size_t usedBytes;
+    uint32_t records;         // Records currently held
+    uint32_t overwritten;     // Oldest records dropped to make room
+    uint32_t droppedWhilePaused;
+    bool inPsram;
+};
+
+struct CaptureReplayStats {
+    uint32_t records;
+    uint32_t customDataRecords;
+    uint32_t featureRecords;
+    uint32_t malformed;
+    int64_t  capturedSpanUs;  // Time between first and last record in the capture
+};
+
+// --- Recorder (defined in bike_capture.cpp) ---
+bool captureBegin(size_t bufferBytes);  // Allocates the ring (PSRAM when available)
+void captureEnd();
+// Called from the bike notification callbacks before parsing. Never blocks.
+void captureRecord(uint8_t source, const uint8_t* data, size_t length);
+void captureRecordAt(uint8_t source, const uint8_t* data, size_t length, int64_t timestampUs);
+void captureClear();
+void captureGetStats(CaptureStats& out);
+size_t captureExportSize();
+// Linearizes the ring into 'out' as a capture image. Returns bytes written (0 if 'out' is too small).
+size_t captureExport(uint8_t* out, size_t maxLength);
+// Writes the capture image to Serial as "CAP:" hex lines between CAP-BEGIN / CAP-END markers.
+void captureDumpToSerial();
+
+// --- Replay (defined in bike_capture.cpp) ---
+typedef void (*CaptureRecordHandler)(const CaptureRecord& record, void* context);
+// Walks a capture image; returns false if the header is invalid or a record is truncated.
+bool captureForEachRecord(const uint8_t* image, size_t length, CaptureRecordHandler handler, void* context);
+// Dispatches one record to its parser, exactly as the notification callback would. False for unknown sources.
+bool captureReplayRecord(const CaptureRecord& record);
+// Feeds a capture image back through the bike drivers' parsers (bike_driver.h).
+// realTime = true sleeps between records to reproduce the original timing.
+bool captureReplay(const uint8_t* image, size_t length, bool realTime, CaptureReplayStats* stats);
+
+#endif // BIKE_CAPTURE_H
@@ -0,0 +1,97 @@
+#define LOG_MODULE LOG_MOD_BIKE
+#include "bike_driver.h"
+#include <string.h>
+
+// Merach first: it also carries an FTMS service, but its data only comes over 0xFFF1.
+static const BikeDriver* const bikeDrivers[] = {
+    &merachBikeDriver,
+    &ftmsBikeDriver,
+};
+
+// Written by the scan callback / connect task, read by any task.
+static const BikeDriver* volatile selectedBikeDriver = NULL;
+static const BikeDriver* volatile activeBikeDriver = NULL;
+
+// Latest level for the bike control task; older requests are superseded, not queued.
+static portMUX_TYPE bikeControlMux = portMUX_INITIALIZER_UNLOCKED;
+static float pendingBikeLevel = 0.0f;
+
+bool bikeDriverMatches(const BikeDriver& driver, NimBLEAdvertisedDevice* device) {
+    if (driver.namePrefix != NULL && device->haveName()) {
+        std::string name = device->getName();
+        if (strncmp(name.c_str(), driver.namePrefix, strlen(driver.namePrefix)) == 0) return true;
+    }
+    if (driver.serviceUuid16 != 0 && device->isAdvertisingService(NimBLEUUID(driver.serviceUuid16))) return true;
+    if (driver.manufacturerId != BIKE_DRIVER_NO_MANUFACTURER && device->haveManufacturerData()) {
+        std::string data = device->getManufacturerData();
+        if (data.length() >= 2 && (uint16_t)((uint8_t)data[0] | ((uint8_t)data[1] << 8)) == driver.manufacturerId) return true;
+    }
+    return false;
+}
+
+const BikeDriver* bikeDriverMatch(NimBLEAdvertisedDevice* device) {
+    for (size_t i = 0; i < sizeof(bikeDrivers) / sizeof(bikeDrivers[0]); i++) {
+        if (bikeDriverMatches(*bikeDrivers[i], device)) return bikeDrivers[i];
+    }
+    return NULL;
+}
+
+const BikeDriver* bikeDriverByName(const char* name) {
+    for (size_t i = 0; i < sizeof(bikeDrivers) / sizeof(bikeDrivers[0]); i++) {
+        if (strcasecmp(bikeDrivers[i]->name, name) == 0) return bikeDrivers[i];
+    }
+    return NULL;
+}
+
+void bikeDriverSelect(const BikeDriver* driver) {
+    selectedBikeDriver = driver;
+}
+
+const BikeDriver* bikeDriverSelected() {
+    return selectedBikeDriver;
+}
+
+bool bikeDriverBind(NimBLEClient* pClient) {
+    const BikeDriver* driver = selectedBikeDriver;
+    if (driver == NULL) driver = &merachBikeDriver;
+    ts_log_printf("[BikeDriver] Using the %s driver.", driver->name);
+    if (!driver->discover(pClient)) return false;
+    activeBikeDriver = driver;
+    if (driver->start != NULL) driver->start(pClient);
+    return true;
+}
+
+void bikeDriverUnbind() {
+    activeBikeDriver = NULL;
+}
+
+const BikeDriver* bikeDriverActive() {
+    return activeBikeDriver;
+}
+
+// --- Resistance Control ---
+bool bikeDriverRequestLevel(float level) {
+    const BikeDriver* driver = activeBikeDriver;
+    if (driver == NULL || driver->setResistanceLevel == NULL) return false;
+    portENTER_CRITICAL(&bikeControlMux);
+    pendingBikeLevel = level;
+    portEXIT_CRITICAL(&bikeControlMux);
+    if (bikeControlTaskHandle != NULL) xTaskNotifyGive(bikeControlTaskHandle);
+    return true;
+}
+
+// Control Point writes arrive on the NimBLE host task, which must not wait for a write response from
+// the bike; the write is made here instead.
+void bikeControlTask_func(void *pvParameters) {
+    ts_log_printf("[BikeControl] Task started.");
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&bikeControlMux);
+        float level = pendingBikeLevel;
+        portEXIT_CRITICAL(&bikeControlMux);
+        const BikeDriver* driver = activeBikeDriver;
+        if (driver != NULL && driver->setResistanceLevel != NULL && !driver->setResistanceLevel(level)) {
+            ts_log_warn("[BikeControl] %s: level %.1f not accepted by the bike.", driver->name, level);
+        }
+    }
+}
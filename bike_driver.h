@@ -0,0 +1,80 @@
+#ifndef BIKE_DRIVER_H
+#define BIKE_DRIVER_H
+
+#include <NimBLEDevice.h>
+#include "config.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "ftms_encoder.h"
+
+// --- Bike Protocol Drivers ---
+// One driver per bike protocol. The registry picks the driver from the bike's advertisement when the
+// scan finds it; at connect time the driver's discovery subscribes its own notification callbacks, so
+// a bike packet goes straight into that driver's decoder without any lookup.
+#define BIKE_DRIVER_NO_MANUFACTURER 0xFFFF // Reserved company ID: match on name / service only
+
+struct BikeDriver {
+    const char* name;
+    // Advertisement match; any one criterion is enough (NULL / 0 / BIKE_DRIVER_NO_MANUFACTURER = unused).
+    const char* namePrefix;
+    uint16_t serviceUuid16;
+    uint16_t manufacturerId; // First two bytes of the manufacturer data (little-endian)
+    // Finds the characteristics and subscribes the data path; false = unusable bike. Connect task.
+    bool (*discover)(NimBLEClient* pClient);
+    // Control handshake after discovery (may be NULL). Connect task.
+    void (*start)(NimBLEClient* pClient);
+    // One data packet -> telemetry. The notification callbacks, capture replay and the host tools use it.
+    void (*decode)(uint8_t* pData, size_t length);
+    // Writes a resistance level (ERG_LEVEL_MIN..ERG_LEVEL_MAX) to the bike. Bike control task.
+    // NULL = the bike has no resistance control over BLE; the knob motor (stepper_motion.h) turns it.
+    bool (*setResistanceLevel)(float level);
+};
+
+// --- Global Variables related to Bike Control (defined in .ino) ---
+extern TaskHandle_t bikeControlTaskHandle;
+
+extern const BikeDriver merachBikeDriver;
+extern const BikeDriver ftmsBikeDriver;
+
+// --- Registry ---
+// Drivers in match order: the first whose criteria the advertisement meets is used.
+bool bikeDriverMatches(const BikeDriver& driver, NimBLEAdvertisedDevice* device);
+const BikeDriver* bikeDriverMatch(NimBLEAdvertisedDevice* device); // First driver that matches, NULL if none
+const BikeDriver* bikeDriverByName(const char* name);
+
+// The scan callback selects the driver of the stored target; connecting binds it.
+void bikeDriverSelect(const BikeDriver* driver);
+const BikeDriver* bikeDriverSelected();
+bool bikeDriverBind(NimBLEClient* pClient); // discover + start; the driver stays active until unbound
+void bikeDriverUnbind();
+const BikeDriver* bikeDriverActive(); // NULL while no bike is connected
+
+// Hands a level to the active driver's setResistanceLevel (through the bike control task, so no
+// caller blocks on a GATT write). Returns false if the bike has no BLE resistance control.
+bool bikeDriverRequestLevel(float level);
+void bikeControlTask_func(void *pvParameters);
+
+// --- Merach S26 (bike_driver_merach.cpp) ---
+// Proprietary 0xFFF0/0xFFF1 data; apparent resistance in the bike's 0x2AD2 notifications.
+void parseCustomBikeData(uint8_t* pData, size_t length);
+void parseBikeResistanceData(uint8_t* pData, size_t length); // Apparent resistance from the bike's 0x2AD2 packets
+void customDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+void ftmsFeatureNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+
+// --- Standard FTMS bike (bike_driver_ftms.cpp) ---
+// Indoor Bike Data (0x2ACC) in, Set Target Resistance (0x2AD9) out.
+struct FtmsResistanceRange {
+    int16_t minimum; // Supported Resistance Level Range (0x2AD6), 0.1 units
+    int16_t maximum;
+};
+
+void parseIndoorBikeData(uint8_t* pData, size_t length);
+void bikeIndoorDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+// Level mapping between our 1-8 scale and the bike's range.
+uint8_t ftmsBikeLevelFromResistance(int16_t resistance, const FtmsResistanceRange& range);
+int16_t ftmsBikeResistanceFromLevel(float level, const FtmsResistanceRange& range);
+// Builds a Set Target Resistance (0x04) request; returns its length.
+size_t ftmsBikeEncodeSetResistance(int16_t resistance, uint8_t* out);
+void ftmsBikeSetResistanceRange(const FtmsResistanceRange& range);
+
+#endif // BIKE_DRIVER_H
@@ -0,0 +1,190 @@
+#define LOG_MODULE LOG_MOD_BIKE
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "ftms_control_point.h"
+#include "ftms_forwarder.h"
+#include "bike_capture.h"
+#include "bike_link.h"
+#include "sensor_links.h"
+#include "link_manager.h"
+#include "metrics.h"
+#include <esp_timer.h>
+#include <math.h>
+
+// Set at discovery (connect task) before the data path is subscribed; read by the host and control tasks.
+static FtmsResistanceRange ftmsBikeRange = {BIKE_FTMS_DEFAULT_RESISTANCE_MIN, BIKE_FTMS_DEFAULT_RESISTANCE_MAX};
+static int16_t ftmsBikeLastResistance = INT16_MIN; // Last Set Target Resistance accepted (bike control task)
+
+// More Data fragments accumulate here until the last one (NimBLE host task only).
+static FtmsIndoorBikeData ftmsBikeRecord;
+static uint16_t ftmsBikeRecordFields = 0;
+
+// --- Level Mapping ---
+// The bike's range maps linearly onto ERG_LEVEL_MIN..ERG_LEVEL_MAX.
+uint8_t ftmsBikeLevelFromResistance(int16_t resistance, const FtmsResistanceRange& range) {
+    int32_t span = (int32_t)range.maximum - range.minimum;
+    if (span <= 0) return (uint8_t)ERG_LEVEL_MIN;
+    float level = ERG_LEVEL_MIN + (float)((int32_t)resistance - range.minimum) * (ERG_LEVEL_MAX - ERG_LEVEL_MIN) / span;
+    if (level < ERG_LEVEL_MIN) level = ERG_LEVEL_MIN;
+    if (level > ERG_LEVEL_MAX) level = ERG_LEVEL_MAX;
+    return (uint8_t)lroundf(level);
+}
+
+int16_t ftmsBikeResistanceFromLevel(float level, const FtmsResistanceRange& range) {
+    if (level < ERG_LEVEL_MIN) level = ERG_LEVEL_MIN;
+    if (level > ERG_LEVEL_MAX) level = ERG_LEVEL_MAX;
+    float span = (float)range.maximum - range.minimum;
+    return (int16_t)lroundf(range.minimum + (level - ERG_LEVEL_MIN) * span / (ERG_LEVEL_MAX - ERG_LEVEL_MIN));
+}
+
+size_t ftmsBikeEncodeSetResistance(int16_t resistance, uint8_t* out) {
+    out[0] = FTMS_CP_SET_TARGET_RESISTANCE;
+    if (resistance >= 0 && resistance <= 0xFF) { // FTMS 1.0: uint8, 0.1 resolution
+        out[1] = (uint8_t)resistance;
+        return 2;
+    }
+    out[1] = (uint8_t)resistance; // Wider ranges: sint16, as later revisions define it
+    out[2] = (uint8_t)((uint16_t)resistance >> 8);
+    return 3;
+}
+
+void ftmsBikeSetResistanceRange(const FtmsResistanceRange& range) {
+    ftmsBikeRange = range;
+}
+
+// --- parseIndoorBikeData Implementation (bike's Indoor Bike Data, also used by capture replay) ---
+// A record is published once, from its last fragment, like a Merach 0x42 packet.
+void parseIndoorBikeData(uint8_t* pData, size_t length) {
+    metricsCount(METRIC_BIKE_PACKETS);
+    uint16_t fields = ftmsDecodeIndoorBikeData(pData, length, ftmsBikeRecord);
+    if (fields == 0) {
+        metricsCount(METRIC_BIKE_PARSE_REJECTS);
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    Bike's Indoor Bike Data - malformed packet (len %d).", length);
+        return;
+    }
+    ftmsBikeRecordFields |= fields;
+    if (!(fields & FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED))) return; // More Data follows
+
+    fields = ftmsBikeRecordFields;
+    ftmsBikeRecordFields = 0;
+    const uint64_t* value = ftmsBikeRecord.value;
+    TelemetryFrame& frame = telemetryBeginUpdate();
+    frame.speed = (uint16_t)value[FTMS_IBD_INST_SPEED];
+    if (fields & FTMS_IBD_FIELD(FTMS_IBD_INST_CADENCE)) frame.cadence = (uint16_t)value[FTMS_IBD_INST_CADENCE];
+    if (fields & FTMS_IBD_FIELD(FTMS_IBD_RESISTANCE)) {
+        frame.resistanceLevel = ftmsBikeLevelFromResistance((int16_t)value[FTMS_IBD_RESISTANCE], ftmsBikeRange);
+    }
+    if (fields & FTMS_IBD_FIELD(FTMS_IBD_INST_POWER)) {
+        int16_t power = (int16_t)value[FTMS_IBD_INST_POWER];
+        frame.bikePower = power > 0 ? (uint16_t)power : 0;
+    }
+    if (fields & FTMS_IBD_FIELD(FTMS_IBD_EXPENDED_ENERGY)) {
+        uint16_t totalKcal = (uint16_t)value[FTMS_IBD_EXPENDED_ENERGY];
+        if (totalKcal != 0xFFFF) frame.caloriesX10 = totalKcal >= 6553 ? 0xFFFF : (uint16_t)(totalKcal * 10);
+    }
+    sensorMergeAndPublish(frame); // Power source and heart rate from the external sensors
+}
+
+// --- bikeIndoorDataNotificationCallback Implementation (bike's Indoor Bike Data 0x2AD2) ---
+void bikeIndoorDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    captureRecord(CAPTURE_SOURCE_INDOOR_BIKE_DATA, pData, length);
+    int64_t parseStartUs = esp_timer_get_time();
+    parseIndoorBikeData(pData, length);
+    metricsObserve(METRIC_HIST_PARSE_US, (uint32_t)(esp_timer_get_time() - parseStartUs));
+    if (length >= 1 && !(pData[0] & FTMS_IBD_MORE_DATA)) {
+        forwarderSignalNewSample();
+        bikeLinkOnSample();
+        linkManagerOnBikeSample();
+    }
+}
+
+static void controlPointIndicationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    if (length >= 3 && pData[0] == FTMS_CP_RESPONSE_CODE) {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    Bike's 0x2AD9 response: op 0x%02X result 0x%02X", pData[1], pData[2]);
+    }
+}
+
+// --- Discovery (connect task) ---
+static bool ftmsBikeDiscover(NimBLEClient* pClient_local) {
+    if (!pClient_local || !pClient_local->isConnected()) {
+        ts_log_printf("[FTMSBike] Client not connected.");
+        return false;
+    }
+    NimBLERemoteService* pService = pClient_local->getService(BIKE_FTMS_SERVICE_UUID_STR);
+    if (pService == nullptr) {
+        ts_log_error("[FTMSBike] FTMS Service (0x1826) NOT found.");
+        return false;
+    }
+
+    NimBLERemoteCharacteristic* pFeature = pService->getCharacteristic(NimBLEUUID((uint16_t)BIKE_MACHINE_FEATURE_UUID_SHORT));
+    if (pFeature != nullptr && pFeature->canRead()) {
+        std::string value = pFeature->readValue();
+        if (value.length() >= 4) memcpy(&bikeMachineFeatures, value.data(), 4);
+        if (value.length() >= 8) memcpy(&bikeTargetSettingFeatures, value.data() + 4, 4);
+        ts_log_printf("    Bike Machine Features: 0x%08X, Target Setting Features: 0x%08X", bikeMachineFeatures, bikeTargetSettingFeatures);
+    }
+
+    FtmsResistanceRange range = {BIKE_FTMS_DEFAULT_RESISTANCE_MIN, BIKE_FTMS_DEFAULT_RESISTANCE_MAX};
+    NimBLERemoteCharacteristic* pRange = pService->getCharacteristic(BIKE_FTMS_RESISTANCE_RANGE_CHAR_UUID_STR);
+    if (pRange != nullptr && pRange->canRead()) {
+        std::string value = pRange->readValue();
+        if (value.length() >= 4) {
+            FtmsResistanceRange read;
+            memcpy(&read.minimum, value.data(), 2);
+            memcpy(&read.maximum, value.data() + 2, 2);
+            if (read.maximum > read.minimum) range = read;
+        }
+    }
+    ftmsBikeSetResistanceRange(range);
+    ts_log_printf("    Resistance range: %d..%d (0.1 units) -> levels %.0f..%.0f", range.minimum, range.maximum,
+                  ERG_LEVEL_MIN, ERG_LEVEL_MAX);
+
+    pBikeFTMSControlPointCharacteristic = pService->getCharacteristic(BIKE_FTMS_CONTROL_POINT_CHAR_UUID_STR);
+    if (pBikeFTMSControlPointCharacteristic != nullptr && pBikeFTMSControlPointCharacteristic->canIndicate()) {
+        // Most bikes refuse Control Point writes until the response indications are enabled.
+        pBikeFTMSControlPointCharacteristic->subscribe(false, controlPointIndicationCallback, true);
+    }
+
+    ftmsBikeRecordFields = 0;
+    pBikeFTMSDataCharacteristic = pService->getCharacteristic(NimBLEUUID((uint16_t)BIKE_INDOOR_BIKE_DATA_UUID_SHORT));
+    if (pBikeFTMSDataCharacteristic == nullptr || !pBikeFTMSDataCharacteristic->canNotify()) {
+        ts_log_error("    CRITICAL: Indoor Bike Data (0x2AD2) NOT found or cannot notify.");
+        return false;
+    }
+    if (!pBikeFTMSDataCharacteristic->subscribe(true, bikeIndoorDataNotificationCallback, false)) {
+        ts_log_error("    CRITICAL: FAILED to subscribe to Indoor Bike Data (0x2AD2).");
+        return false;
+    }
+    ftmsDataNotificationsEnabled = true;
+    ts_log_printf("      Subscribed to BIKE's Indoor Bike Data notifications (0x2AD2 - Primary Data Path).");
+    return true;
+}
+
+// --- Control (connect task / bike control task) ---
+static void ftmsBikeStart(NimBLEClient* pClient_local) {
+    ftmsBikeLastResistance = INT16_MIN;
+    sendFTMSControlCommandToBike(FTMS_CP_REQUEST_CONTROL);
+    delay(250);
+    sendFTMSControlCommandToBike(FTMS_CP_START_OR_RESUME);
+}
+
+static bool ftmsBikeSetResistanceLevel(float level) {
+    int16_t resistance = ftmsBikeResistanceFromLevel(level, ftmsBikeRange);
+    if (resistance == ftmsBikeLastResistance) return true;
+    uint8_t request[3];
+    size_t length = ftmsBikeEncodeSetResistance(resistance, request);
+    if (!sendFTMSControlRequestToBike(request, length)) return false;
+    ftmsBikeLastResistance = resistance;
+    return true;
+}
+
+const BikeDriver ftmsBikeDriver = {
+    "FTMS",
+    NULL,
+    FTMS_SERVICE_UUID_SHORT,
+    BIKE_DRIVER_NO_MANUFACTURER,
+    ftmsBikeDiscover,
+    ftmsBikeStart,
+    parseIndoorBikeData,
+    ftmsBikeSetResistanceLevel,
+};
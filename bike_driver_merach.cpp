@@ -0,0 +1,214 @@
+#define LOG_MODULE LOG_MOD_BIKE
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "ftms_forwarder.h"
+#include "bike_capture.h"
+#include "bike_link.h"
+#include "sensor_links.h"
+#include "link_manager.h"
+#include "metrics.h"
+#include <esp_timer.h>
+
+// --- parseBikeResistanceData Implementation (bike's 0x2AD2 notifications, also used by capture replay) ---
+void parseBikeResistanceData(uint8_t* pData, size_t length) {
+    // Resistance parsing from specific notified FTMS Feature packet from Merach S26
+    if (length == 11 && pData[0] == 0x75) { 
+        uint8_t potentialResistance = pData[7]; 
+        if (potentialResistance >= 1 && potentialResistance <= 8) { 
+            telemetryBeginUpdate().resistanceLevel = potentialResistance;
+            telemetryPublish();
+            TS_LOG_TOKEN(LOG_LEVEL_INFO, "    >> Updated Apparent Resistance: %u (from Bike's 0x2AD2 NOTIFY, type 0x75, byte 7)", potentialResistance);
+        } else {
+            TS_LOG_TOKEN(LOG_LEVEL_INFO, "    >> Potential Resistance from Bike's 0x2AD2 (type 0x75, byte 7) out of range (1-8): %u", potentialResistance);
+        }
+    } else if (length == 12 && pData[0] == 0x00 && pData[1] == 0x0B) {
+        uint8_t potentialResistance = pData[7]; 
+        if (potentialResistance >= 1 && potentialResistance <= 8) {
+             telemetryBeginUpdate().resistanceLevel = potentialResistance;
+             telemetryPublish();
+             TS_LOG_TOKEN(LOG_LEVEL_INFO, "    >> Updated Apparent Resistance: %u (from Bike's 0x2AD2 NOTIFY, type 0x000B, byte 7)", potentialResistance);
+        } else {
+             TS_LOG_TOKEN(LOG_LEVEL_INFO, "    >> Potential Resistance from Bike's 0x2AD2 (type 0x000B, byte 7) out of range (1-8): %u", potentialResistance);
+        }
+    } else {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    Bike's 0x2AD2 NOTIFY - Unhandled packet format for resistance parsing (len %d, first byte 0x%02X).", length, pData[0]);
+    }
+}
+
+// --- ftmsFeatureNotificationCallback Implementation (for bike's FTMS Feature 0x2AD2) ---
+void ftmsFeatureNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    captureRecord(CAPTURE_SOURCE_FTMS_FEATURE, pData, length);
+    TS_LOG_TOKEN(LOG_LEVEL_DEBUG, "--- BIKE's FTMS Feature-like Notif (Bike's 0x2AD2), Len: %d ---", length);
+    TS_LOG_TOKEN_HEX(LOG_LEVEL_DEBUG, "    Raw Data from Bike's 0x2AD2: %s", pData, length);
+
+    parseBikeResistanceData(pData, length);
+    
+    // FORWARD THIS RAW DATA TO THE APP's FTMS FEATURE (0x2AD2) on the ESP32 peripheral side.
+    sendRawFTMSFeatureDataToApp(pData, length); 
+}
+
+// --- parseCustomBikeData Implementation (for bike's proprietary service 0xFFF1) ---
+// Fields of one packet are staged and published together, so readers never see
+// a speed from one packet next to a power from another.
+void parseCustomBikeData(uint8_t* pData, size_t length) {
+    metricsCount(METRIC_BIKE_PACKETS);
+    if (length > 0 && pData[0] == 0x02) { 
+        if (pData[1] == 0x42 && length >= 11) { 
+            TelemetryFrame& frame = telemetryBeginUpdate();
+
+            uint16_t rawSpeed = (pData[4] << 8) | pData[3]; 
+            frame.speed = rawSpeed; 
+
+            uint16_t actualRPM_x2_from_bike = (pData[7] << 8) | pData[6]; 
+            frame.cadence = actualRPM_x2_from_bike; 
+
+            uint16_t rawPowerTimes10 = (pData[10] << 8) | pData[9];
+            frame.bikePower = (uint16_t)((rawPowerTimes10 + 5) / 10); // 0.1 W -> W, rounded
+
+            sensorMergeAndPublish(frame); // Power source and heart rate from the external sensors
+        } else if (pData[1] == 0x43 && length >= 8) { 
+            telemetryBeginUpdate().caloriesX10 = (pData[6] << 8) | pData[7]; 
+            telemetryPublish();
+        } else {
+            metricsCount(METRIC_BIKE_PARSE_REJECTS);
+        }
+    } else {
+        metricsCount(METRIC_BIKE_PARSE_REJECTS);
+    }
+}
+
+// --- customDataNotificationCallback Implementation (for bike's proprietary service 0xFFF1) ---
+void customDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    captureRecord(CAPTURE_SOURCE_CUSTOM_DATA, pData, length);
+    int64_t parseStartUs = esp_timer_get_time();
+    parseCustomBikeData(pData, length);
+    metricsObserve(METRIC_HIST_PARSE_US, (uint32_t)(esp_timer_get_time() - parseStartUs));
+    forwarderSignalNewSample(); // Wake the forwarder task; 0x2ACC goes out without waiting for loop()
+    bikeLinkOnSample();
+    linkManagerOnBikeSample();
+}
+
+// --- Discovery (connect task) ---
+static bool merachDiscover(NimBLEClient* pClient_local) {
+    if (!pClient_local || !pClient_local->isConnected()) {
+        ts_log_printf("[Merach] Client not connected.");
+        return false;
+    }
+
+    ts_log_printf("[Merach] Discovering services for BIKE...");
+    bool dataPathEstablished = false; 
+
+    NimBLERemoteService* pRemoteFTMSService = nullptr;
+    try {
+        pRemoteFTMSService = pClient_local->getService(BIKE_FTMS_SERVICE_UUID_STR);
+    } catch (const std::exception& e) {
+        ts_log_error("[Merach] Exception getting FTMS service: %s", e.what());
+    }
+
+    if (pRemoteFTMSService) {
+        ts_log_printf("  Found BIKE's FTMS Service (0x1826).");
+
+        pBikeFTMSFeatureCharacteristic = pRemoteFTMSService->getCharacteristic(BIKE_FTMS_FEATURE_CHAR_UUID_STR); 
+        if (pBikeFTMSFeatureCharacteristic) {
+            ts_log_printf("    Found BIKE's FTMS Feature-like Char (Bike's 0x2AD2)."); 
+            if (pBikeFTMSFeatureCharacteristic->canNotify()) {
+                if (pBikeFTMSFeatureCharacteristic->subscribe(true, ftmsFeatureNotificationCallback, false)) { 
+                     ts_log_printf("      Subscribed to BIKE's FTMS Feature-like (Bike's 0x2AD2) notifications.");
+                } else {
+                     ts_log_error("      FAILED to subscribe to BIKE's FTMS Feature-like (Bike's 0x2AD2) notifications.");
+                     pBikeFTMSFeatureCharacteristic->unsubscribe(); 
+                }
+            }
+        } else {
+            ts_log_printf("    BIKE's FTMS Feature-like Char (Bike's 0x2AD2) NOT found.");
+        }
+
+        pBikeFTMSControlPointCharacteristic = pRemoteFTMSService->getCharacteristic(BIKE_FTMS_CONTROL_POINT_CHAR_UUID_STR);
+        if (pBikeFTMSControlPointCharacteristic) {
+            ts_log_printf("    Found BIKE's FTMS Control Point Char (0x2AD9). Writable: %s, Indicable: %s",
+                          pBikeFTMSControlPointCharacteristic->canWrite() ? "Yes" : "No",
+                          pBikeFTMSControlPointCharacteristic->canIndicate() ? "Yes" : "No");
+        } else {
+            ts_log_printf("    BIKE's FTMS Control Point Char (0x2AD9) NOT found.");
+        }
+
+        pBikeFTMSDataCharacteristic = pRemoteFTMSService->getCharacteristic(BIKE_FTMS_INDOOR_BIKE_DATA_CHAR_UUID_STR); 
+        if (pBikeFTMSDataCharacteristic) {
+            ts_log_printf("    Found BIKE's FTMS Indoor Bike Data / Feature Char (Bike's 0x2ACC)."); 
+            if (pBikeFTMSDataCharacteristic->canRead()) {
+                std::string value = pBikeFTMSDataCharacteristic->readValue();
+                if (!value.empty()) {
+                    ts_log_printf("      Value of Bike's 0x2ACC (FTMS Feature on Merach):");
+                    TS_LOG_TOKEN_HEX(LOG_LEVEL_INFO, "        Raw: %s", value.data(), value.length());
+                    if (value.length() >= 4) memcpy(&bikeMachineFeatures, value.data(), 4);
+                    if (value.length() >= 8) memcpy(&bikeTargetSettingFeatures, (uint8_t*)value.data() + 4, 4);
+                    ts_log_printf("        Parsed Bike Machine Features: 0x%08X, Target Setting Features: 0x%08X", bikeMachineFeatures, bikeTargetSettingFeatures);
+                }
+            }
+        } else {
+            ts_log_printf("    BIKE's FTMS Indoor Bike Data / Feature Char (Bike's 0x2ACC) NOT found.");
+        }
+
+    } else {
+        ts_log_printf("  BIKE's FTMS Service (0x1826) NOT found.");
+    }
+
+    NimBLERemoteService* pCustomService = nullptr;
+    try {
+        pCustomService = pClient_local->getService(CUSTOM_SERVICE_UUID_STR);
+    } catch (const std::exception& e) {
+        ts_log_error("[Merach] Exception getting Custom service: %s", e.what());
+    }
+    
+    if (pCustomService) {
+        ts_log_printf("  Found BIKE's Custom Service (0xFFF0).");
+        pBikeCustomDataCharacteristic = pCustomService->getCharacteristic(CUSTOM_DATA_CHAR_UUID_STR); 
+        if (pBikeCustomDataCharacteristic) {
+            ts_log_printf("    Found BIKE's Custom Data Char (0xFFF1)."); 
+            if (pBikeCustomDataCharacteristic->canNotify()) {
+                if (pBikeCustomDataCharacteristic->subscribe(true, customDataNotificationCallback, false)) {
+                    customDataNotificationsEnabled = true;
+                    dataPathEstablished = true; 
+                    ts_log_printf("      Subscribed to BIKE's Custom Data notifications (0xFFF1 - Primary Data Path).");
+                } else {
+                    ts_log_error("      FAILED to subscribe to BIKE's Custom Data notifications (0xFFF1).");
+                    pBikeCustomDataCharacteristic->unsubscribe(); 
+                }
+            } else {
+                ts_log_printf("      BIKE's Custom Data Char (0xFFF1) cannot notify.");
+            }
+        } else {
+            ts_log_printf("    BIKE's Custom Data Char (0xFFF1) NOT found.");
+        }
+    } else {
+        ts_log_printf("  BIKE's Custom Service (0xFFF0) NOT found. This is critical for data from Merach S26.");
+    }
+
+    if (!dataPathEstablished) {
+        ts_log_error("    CRITICAL: FAILED to establish primary data path (Custom Service 0xFFF1 notifications)!");
+    }
+    return dataPathEstablished; 
+}
+
+// --- Control handshake (connect task) ---
+static void merachStart(NimBLEClient* pClient_local) {
+    if (pBikeFTMSControlPointCharacteristic != nullptr) {
+        ts_log_printf("[Merach] Sending FTMS control commands to bike (if applicable)...");
+        sendFTMSControlCommandToBike(0x00);
+        delay(250);
+        sendFTMSControlCommandToBike(0x07);
+    }
+}
+
+// Resistance is set by turning the knob (stepper_motion.h): no setResistanceLevel.
+const BikeDriver merachBikeDriver = {
+    "Merach",
+    MERACH_NAME_PREFIX,
+    CUSTOM_SERVICE_UUID_SHORT,
+    BIKE_DRIVER_NO_MANUFACTURER,
+    merachDiscover,
+    merachStart,
+    parseCustomBikeData,
+    NULL,
+};
@@ -0,0 +1,346 @@
+#define LOG_MODULE LOG_MOD_BIKE
+#include "bike_link.h"
+#include "ble_client_manager.h"
+#include "bike_driver.h"
+#include "link_manager.h"
+#include <esp_timer.h>
+#include <string.h>
+
+extern MyNimBLEAdvertisedDeviceCallbacks myAdvertisedDeviceCallbacks_global; // Defined in .ino
+
+// The bike link task, the NimBLE host task (disconnects, first samples), the connect task (onConnect)
+// and loop() (button, console) all touch this state.
+static portMUX_TYPE bikeLinkMux = portMUX_INITIALIZER_UNLOCKED;
+static BikeLinkPolicy bikeLinkPolicy = {BIKE_LINK_IDLE, 0, 0};
+static BikeLinkStats bikeLinkStats = {0, 0, 0, 0, 0, 0, 0, 0};
+static int64_t bikeLinkAttemptUs = 0;
+static int64_t bikeLinkLostUs = 0;        // 0 = no outage in progress
+static bool bikeLinkAttemptAutomatic = false;
+static bool bikeLinkAttemptKeeps = false; // The attempt kept the attributes of the last connection
+static bool bikeLinkCacheHit = false;
+static bool bikeLinkForceDiscovery = false;
+// Read in onConnect (connect task), stored by bikeLinkOnReady in the same task.
+static uint8_t bikeLinkPeerHash[BIKE_REGISTRY_HASH_SIZE];
+static bool bikeLinkPeerHashValid = false;
+static volatile bool bikeLinkScanning = false; // The background scan is ours (bike link task)
+
+volatile bool bikeLinkAwaitingSample = false;
+
+// --- Reconnect Policy ---
+uint32_t bikeLinkBackoffMs(uint8_t failures) {
+    if (failures == 0) return 0;
+    uint8_t shift = failures - 1;
+    if (shift >= 16) return BIKE_LINK_RETRY_MAX_MS;
+    uint32_t backoff = (uint32_t)BIKE_LINK_RETRY_MIN_MS << shift;
+    return backoff > BIKE_LINK_RETRY_MAX_MS ? BIKE_LINK_RETRY_MAX_MS : backoff;
+}
+
+void bikeLinkPolicyInit(BikeLinkPolicy& policy, bool known, uint32_t nowMs) {
+    policy.state = known ? BIKE_LINK_BACKOFF : BIKE_LINK_IDLE;
+    policy.failures = 0;
+    policy.nextAttemptMs = nowMs;
+}
+
+uint8_t bikeLinkPolicyNext(BikeLinkPolicy& policy, uint32_t nowMs) {
+    if (policy.state != BIKE_LINK_BACKOFF) return BIKE_LINK_ACTION_NONE;
+    if ((int32_t)(nowMs - policy.nextAttemptMs) < 0) return BIKE_LINK_ACTION_NONE; // Wrap-safe
+    return BIKE_LINK_ACTION_CONNECT;
+}
+
+void bikeLinkPolicyAttempt(BikeLinkPolicy& policy) {
+    policy.state = BIKE_LINK_CONNECTING;
+}
+
+void bikeLinkPolicyConnected(BikeLinkPolicy& policy) {
+    policy.state = BIKE_LINK_CONNECTED;
+    policy.failures = 0;
+}
+
+void bikeLinkPolicyFailed(BikeLinkPolicy& policy, uint32_t nowMs) {
+    if (policy.state == BIKE_LINK_IDLE) return; // Paused by the rider
+    if (policy.failures < 255) policy.failures++;
+    policy.state = BIKE_LINK_BACKOFF;
+    policy.nextAttemptMs = nowMs + bikeLinkBackoffMs(policy.failures);
+}
+
+void bikeLinkPolicyDropped(BikeLinkPolicy& policy, uint32_t nowMs) {
+    if (policy.state == BIKE_LINK_IDLE) return;
+    policy.failures = 0;
+    policy.state = BIKE_LINK_BACKOFF;
+    policy.nextAttemptMs = nowMs; // The bike usually re-advertises at once after a blip
+}
+
+void bikeLinkPolicyPause(BikeLinkPolicy& policy) {
+    policy.state = BIKE_LINK_IDLE;
+}
+
+void bikeLinkPolicySighted(BikeLinkPolicy& policy, uint32_t nowMs) {
+    if (policy.state != BIKE_LINK_BACKOFF) return;
+    if ((int32_t)(policy.nextAttemptMs - nowMs) > 0) policy.nextAttemptMs = nowMs;
+}
+
+// --- Known Bikes ---
+static void selectRecordDriver(const BikeRecord& record) {
+    const BikeDriver* driver = bikeDriverByName(record.driver);
+    bikeDriverSelect(driver != NULL ? driver : &merachBikeDriver);
+}
+
+void bikeLinkBegin() {
+    bikeRegistryBegin();
+    BikeRecord last;
+    bool found = bikeRegistryGet(0, last);
+
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkPolicyInit(bikeLinkPolicy, found && BIKE_LINK_AUTO_RECONNECT, millis());
+    portEXIT_CRITICAL(&bikeLinkMux);
+
+    if (!found) {
+        ts_log_printf("[BikeLink] No known bike: press the button to scan.");
+        return;
+    }
+    selectRecordDriver(last);
+    ts_log_printf("[BikeLink] Last bike %s (%s driver, %s).", bikeRecordAddress(last).toString().c_str(), last.driver,
+                  last.hashValid ? "database hash stored" : "no database hash");
+}
+
+bool bikeLinkKnown() {
+    return bikeRegistryCount() > 0;
+}
+
+bool bikeLinkReconnecting() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bool reconnecting = bikeRegistryCount() > 0 &&
+                        (bikeLinkPolicy.state == BIKE_LINK_BACKOFF || bikeLinkPolicy.state == BIKE_LINK_CONNECTING);
+    portEXIT_CRITICAL(&bikeLinkMux);
+    return reconnecting;
+}
+
+void bikeLinkForget() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkForceDiscovery = true;
+    if (bikeLinkPolicy.state != BIKE_LINK_CONNECTED) bikeLinkPolicyPause(bikeLinkPolicy);
+    portEXIT_CRITICAL(&bikeLinkMux);
+    if (bikeLinkScanning) { // The controller refuses white list changes while a scan uses it
+        NimBLEDevice::getScan()->stop();
+        bikeLinkScanning = false;
+    }
+    bikeRegistryForget();
+}
+
+void bikeLinkPause() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkPolicyPause(bikeLinkPolicy);
+    bikeLinkLostUs = 0;
+    portEXIT_CRITICAL(&bikeLinkMux);
+}
+
+void bikeLinkKick() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    if (bikeRegistryCount() > 0 && bikeLinkPolicy.state != BIKE_LINK_CONNECTING && bikeLinkPolicy.state != BIKE_LINK_CONNECTED) {
+        bikeLinkPolicy.state = BIKE_LINK_BACKOFF;
+        bikeLinkPolicy.nextAttemptMs = millis();
+    }
+    portEXIT_CRITICAL(&bikeLinkMux);
+    if (bikeLinkTaskHandle != NULL) xTaskNotifyGive(bikeLinkTaskHandle);
+}
+
+void bikeLinkGetStats(BikeLinkStats& out) {
+    portENTER_CRITICAL(&bikeLinkMux);
+    out = bikeLinkStats;
+    portEXIT_CRITICAL(&bikeLinkMux);
+}
+
+void bikeLinkLogStats() {
+    BikeLinkStats stats;
+    bikeLinkGetStats(stats);
+    ts_log_printf("[BikeLink] %lu connects (%lu automatic, %lu from cache), %lu failures. Last: link up %lu ms, "
+                  "first sample %lu ms, outage %lu ms (worst %lu ms).",
+                  (unsigned long)stats.connects, (unsigned long)stats.autoConnects, (unsigned long)stats.cacheHits,
+                  (unsigned long)stats.failures, (unsigned long)stats.lastConnectMs, (unsigned long)stats.lastFirstSampleMs,
+                  (unsigned long)stats.lastOutageMs, (unsigned long)stats.maxOutageMs);
+    bikeRegistryLog();
+}
+
+// --- Hooks from ble_client_manager.cpp ---
+void bikeLinkOnAttempt(bool automatic, bool keepAttributes) {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkPolicyAttempt(bikeLinkPolicy);
+    bikeLinkAttemptUs = esp_timer_get_time();
+    bikeLinkAttemptAutomatic = automatic;
+    bikeLinkAttemptKeeps = keepAttributes;
+    portEXIT_CRITICAL(&bikeLinkMux);
+}
+
+void bikeLinkOnConnectFailed() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkStats.failures++;
+    bikeLinkPolicyFailed(bikeLinkPolicy, millis());
+    uint32_t retryMs = bikeLinkPolicy.state == BIKE_LINK_BACKOFF ? bikeLinkBackoffMs(bikeLinkPolicy.failures) : 0;
+    bool retrying = bikeRegistryCount() > 0 && bikeLinkPolicy.state == BIKE_LINK_BACKOFF;
+    portEXIT_CRITICAL(&bikeLinkMux);
+    if (retrying) ts_log_printf("[BikeLink] Connect failed; retrying in %lu ms.", (unsigned long)retryMs);
+}
+
+static bool readDatabaseHash(NimBLEClient* pClient, uint8_t* hash) {
+    NimBLERemoteService* pGattService = pClient->getService(NimBLEUUID((uint16_t)GENERIC_ATTRIBUTE_UUID_SHORT));
+    if (pGattService == nullptr) return false;
+    NimBLERemoteCharacteristic* pHash = pGattService->getCharacteristic(NimBLEUUID((uint16_t)DATABASE_HASH_UUID_SHORT));
+    if (pHash == nullptr || !pHash->canRead()) return false;
+    std::string value = pHash->readValue();
+    if (value.length() != BIKE_REGISTRY_HASH_SIZE) return false;
+    memcpy(hash, value.data(), BIKE_REGISTRY_HASH_SIZE);
+    return true;
+}
+
+bool bikeLinkPrepareAttributes(NimBLEClient* pClient) {
+    bikeLinkPeerHashValid = readDatabaseHash(pClient, bikeLinkPeerHash);
+    BikeRecord known;
+    int index = bikeRegistryFind(pClient->getPeerAddress());
+    bool sameLayout = index >= 0 && bikeRegistryGet((uint8_t)index, known) &&
+                      known.hashValid == (uint8_t)bikeLinkPeerHashValid &&
+                      (!bikeLinkPeerHashValid || memcmp(known.databaseHash, bikeLinkPeerHash, BIKE_REGISTRY_HASH_SIZE) == 0);
+
+    portENTER_CRITICAL(&bikeLinkMux);
+    bool keeps = bikeLinkAttemptKeeps && !bikeLinkForceDiscovery;
+    bikeLinkForceDiscovery = false;
+    bikeLinkCacheHit = keeps && sameLayout;
+    portEXIT_CRITICAL(&bikeLinkMux);
+
+    if (bikeLinkCacheHit) {
+        ts_log_printf("[BikeLink] Same bike, same GATT database: reusing the discovered attributes.");
+    } else if (bikeLinkAttemptKeeps) {
+        ts_log_printf("[BikeLink] Bike's GATT database changed: rediscovering.");
+        pClient->deleteServices();
+    }
+    return bikeLinkCacheHit;
+}
+
+void bikeLinkOnReady(NimBLEClient* pClient) {
+    const BikeDriver* driver = bikeDriverActive();
+    BikeRecord record;
+    memset(&record, 0, sizeof(record)); // Unused driver bytes included: records are compared as bytes
+    NimBLEAddress address = pClient->getPeerAddress();
+    record.addressType = address.getType();
+    memcpy(record.address, address.getNative(), sizeof(record.address));
+    strncpy(record.driver, driver != NULL ? driver->name : "", sizeof(record.driver) - 1);
+    record.hashValid = bikeLinkPeerHashValid;
+    if (bikeLinkPeerHashValid) memcpy(record.databaseHash, bikeLinkPeerHash, BIKE_REGISTRY_HASH_SIZE);
+
+    int64_t nowUs = esp_timer_get_time();
+    bikeRegistryRemember(record);
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkPolicyConnected(bikeLinkPolicy);
+    bikeLinkStats.connects++;
+    if (bikeLinkAttemptAutomatic) bikeLinkStats.autoConnects++;
+    if (bikeLinkCacheHit) bikeLinkStats.cacheHits++;
+    bikeLinkStats.lastConnectMs = (uint32_t)((nowUs - bikeLinkAttemptUs) / 1000);
+    portEXIT_CRITICAL(&bikeLinkMux);
+    bikeLinkAwaitingSample = true;
+}
+
+void bikeLinkOnDiscoveryFailed() {
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkForceDiscovery = true; // The kept attributes may be what failed
+    portEXIT_CRITICAL(&bikeLinkMux);
+}
+
+void bikeLinkOnDisconnected() {
+    bikeLinkAwaitingSample = false;
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&bikeLinkMux);
+    if (bikeLinkPolicy.state == BIKE_LINK_CONNECTED) {
+        bikeLinkPolicyDropped(bikeLinkPolicy, nowMs);
+        bikeLinkLostUs = esp_timer_get_time();
+    } else if (bikeLinkPolicy.state == BIKE_LINK_CONNECTING) { // Dropped during discovery
+        bikeLinkStats.failures++;
+        bikeLinkPolicyFailed(bikeLinkPolicy, nowMs);
+    }
+    portEXIT_CRITICAL(&bikeLinkMux);
+    if (bikeLinkTaskHandle != NULL) xTaskNotifyGive(bikeLinkTaskHandle);
+}
+
+// Any scan's results (NimBLE host task): a known bike heard during the background scan ends the wait.
+void bikeLinkOnAdvertisement(NimBLEAdvertisedDevice* device) {
+    if (!bikeRegistryOnAdvertisement(device) || !bikeLinkScanning) return;
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkPolicySighted(bikeLinkPolicy, millis());
+    portEXIT_CRITICAL(&bikeLinkMux);
+    if (bikeLinkTaskHandle != NULL) xTaskNotifyGive(bikeLinkTaskHandle);
+}
+
+// --- First Sample (NimBLE host task) ---
+void bikeLinkFirstSample() {
+    bikeLinkAwaitingSample = false;
+    int64_t nowUs = esp_timer_get_time();
+    portENTER_CRITICAL(&bikeLinkMux);
+    bikeLinkStats.lastFirstSampleMs = (uint32_t)((nowUs - bikeLinkAttemptUs) / 1000);
+    bikeLinkStats.lastOutageMs = bikeLinkLostUs != 0 ? (uint32_t)((nowUs - bikeLinkLostUs) / 1000) : 0;
+    if (bikeLinkStats.lastOutageMs > bikeLinkStats.maxOutageMs) bikeLinkStats.maxOutageMs = bikeLinkStats.lastOutageMs;
+    bikeLinkLostUs = 0;
+    uint32_t firstSampleMs = bikeLinkStats.lastFirstSampleMs;
+    uint32_t outageMs = bikeLinkStats.lastOutageMs;
+    portEXIT_CRITICAL(&bikeLinkMux);
+    ts_log_printf("[BikeLink] First bike sample %lu ms after connecting (data outage %lu ms).",
+                  (unsigned long)firstSampleMs, (unsigned long)outageMs);
+}
+
+// --- Task ---
+static void reconnectKnownBike() {
+    BikeRecord record;
+    if (!bikeRegistryPickTarget(millis(), record)) return;
+    NimBLEClient* pClient = bikeClientGet();
+    if (pClient == nullptr) return;
+    NimBLEAddress address = bikeRecordAddress(record);
+    // NimBLE keeps the discovered attributes when told to; they belong to the last peer.
+    bool keepAttributes = pClient->getPeerAddress().equals(address);
+    selectRecordDriver(record);
+    bikeAttemptingConnection = true;
+    bikeLinkOnAttempt(true, keepAttributes);
+    linkManagerBikeConnectParams(pClient);
+    pClient->setConnectTimeout(BIKE_LINK_CONNECT_TIMEOUT_S);
+    ts_log_printf("[BikeLink] Reconnecting to %s (%s)...", address.toString().c_str(), record.driver);
+    if (!pClient->connect(address, !keepAttributes)) {
+        bikeAttemptingConnection = false;
+        bikeLinkOnConnectFailed();
+    }
+}
+
+// Passive, white-listed and low duty: only known bikes get through, and the radio stays free for the apps.
+static void startBackgroundScan(uint32_t waitMs) {
+    NimBLEScan* pScan = NimBLEDevice::getScan();
+    pScan->setAdvertisedDeviceCallbacks(&myAdvertisedDeviceCallbacks_global, true); // Duplicates refresh RSSI / last seen
+    pScan->setActiveScan(false);
+    pScan->setInterval(BIKE_SCAN_IDLE_INTERVAL_MS);
+    pScan->setWindow(BIKE_SCAN_IDLE_WINDOW_MS);
+    pScan->setFilterPolicy(BLE_HCI_SCAN_FILT_USE_WL);
+    bikeLinkScanning = pScan->start(waitMs / 1000, nullptr, false);
+}
+
+void bikeLinkTask_func(void *pvParameters) {
+    ts_log_printf("[BikeLink] Task started.");
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BIKE_LINK_POLL_MS));
+        NimBLEScan* pScan = NimBLEDevice::getScan();
+        if (bikeLinkScanning && !pScan->isScanning()) bikeLinkScanning = false; // Burst over
+        if (bikeSensorConnected || bikeAttemptingConnection) continue;
+
+        uint32_t nowMs = millis();
+        bool known = bikeRegistryCount() > 0;
+        portENTER_CRITICAL(&bikeLinkMux);
+        uint8_t action = known ? bikeLinkPolicyNext(bikeLinkPolicy, nowMs) : BIKE_LINK_ACTION_NONE;
+        bool waiting = known && bikeLinkPolicy.state == BIKE_LINK_BACKOFF;
+        int32_t waitMs = (int32_t)(bikeLinkPolicy.nextAttemptMs - nowMs);
+        portEXIT_CRITICAL(&bikeLinkMux);
+
+        if (bikeLinkScanning && (action == BIKE_LINK_ACTION_CONNECT || !waiting)) {
+            pScan->stop(); // Connect now, or paused / forgotten
+            bikeLinkScanning = false;
+        }
+        if (action == BIKE_LINK_ACTION_CONNECT) {
+            if (pScan->isScanning()) continue; // Pairing or sensor scan: the controller refuses to connect mid-scan
+            reconnectKnownBike();
+        } else if (waiting && waitMs >= BIKE_SCAN_IDLE_MIN_WAIT_MS && !pScan->isScanning() && !bikeClientBusy()) {
+            startBackgroundScan((uint32_t)waitMs);
+        }
+    }
+}
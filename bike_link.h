@@ -0,0 +1,81 @@
+#ifndef BIKE_LINK_H
+#define BIKE_LINK_H
+
+#include <NimBLEDevice.h>
+#include "config.h"
+#include "logger.h"
+#include "bike_registry.h"
+
+// --- Global Variables related to the Bike Link (defined in .ino) ---
+extern TaskHandle_t bikeLinkTaskHandle;
+
+// --- Reconnect Policy (pure; the bike link task drives it) ---
+// A known bike is connected by address, without scanning: on boot, right after a link loss, and
+// then with a doubling backoff while it stays away. Longer waits run a low-duty background scan
+// filtered by the white list; hearing a known bike ends the wait. Pressing the button while
+// connected pauses it.
+#define BIKE_LINK_IDLE       0 // No known bike, or paused by the rider
+#define BIKE_LINK_BACKOFF    1 // Waiting for nextAttemptMs
+#define BIKE_LINK_CONNECTING 2
+#define BIKE_LINK_CONNECTED  3
+
+#define BIKE_LINK_ACTION_NONE    0
+#define BIKE_LINK_ACTION_CONNECT 1
+
+struct BikeLinkPolicy {
+    uint8_t  state;         // BIKE_LINK_*
+    uint8_t  failures;      // Failed attempts since the link was last up
+    uint32_t nextAttemptMs; // millis() of the next attempt while in BACKOFF
+};
+
+void bikeLinkPolicyInit(BikeLinkPolicy& policy, bool known, uint32_t nowMs);
+uint8_t bikeLinkPolicyNext(BikeLinkPolicy& policy, uint32_t nowMs); // BIKE_LINK_ACTION_*
+void bikeLinkPolicyAttempt(BikeLinkPolicy& policy);                 // Any connect attempt (also the button's)
+void bikeLinkPolicyConnected(BikeLinkPolicy& policy);
+void bikeLinkPolicyFailed(BikeLinkPolicy& policy, uint32_t nowMs);
+void bikeLinkPolicyDropped(BikeLinkPolicy& policy, uint32_t nowMs); // First retry is immediate
+void bikeLinkPolicyPause(BikeLinkPolicy& policy);
+void bikeLinkPolicySighted(BikeLinkPolicy& policy, uint32_t nowMs); // A known bike advertised: retry now
+uint32_t bikeLinkBackoffMs(uint8_t failures);
+
+// --- Stats ---
+struct BikeLinkStats {
+    uint32_t connects;           // Links that reached the data path
+    uint32_t autoConnects;       // ... of which reconnected without the button
+    uint32_t failures;           // Attempts that failed to connect or discover
+    uint32_t cacheHits;          // Connections that reused the discovered attributes
+    uint32_t lastConnectMs;      // Attempt start -> link up
+    uint32_t lastFirstSampleMs;  // Attempt start -> first bike sample (time to first sample)
+    uint32_t lastOutageMs;       // Link lost -> first bike sample (0 if not a reconnect)
+    uint32_t maxOutageMs;
+};
+
+// --- API ---
+void bikeLinkBegin();                  // Loads the known bikes and selects the last one's driver. setup()
+bool bikeLinkKnown();                  // At least one bike in the registry
+bool bikeLinkReconnecting();           // Known bike, not connected, not paused
+void bikeLinkForget();                 // Clears the registry (console)
+void bikeLinkPause();                  // Rider disconnected with the button
+void bikeLinkKick();                   // Reconnect now (button while reconnecting)
+void bikeLinkGetStats(BikeLinkStats& out);
+void bikeLinkLogStats();
+
+// Hooks from ble_client_manager.cpp
+void bikeLinkOnAttempt(bool automatic, bool keepAttributes); // Before NimBLEClient::connect
+void bikeLinkOnConnectFailed();                              // connect() returned false
+bool bikeLinkPrepareAttributes(NimBLEClient* pClient);       // onConnect, before discovery; true = cache reused
+void bikeLinkOnReady(NimBLEClient* pClient);                 // Discovery succeeded
+void bikeLinkOnDiscoveryFailed();
+void bikeLinkOnDisconnected();
+void bikeLinkOnAdvertisement(NimBLEAdvertisedDevice* device); // Scan callback, any scan
+
+// Bike notification callbacks: the first sample after a connect stamps the stats.
+extern volatile bool bikeLinkAwaitingSample;
+void bikeLinkFirstSample();
+inline void bikeLinkOnSample() {
+    if (bikeLinkAwaitingSample) bikeLinkFirstSample();
+}
+
+void bikeLinkTask_func(void *pvParameters);
+
+#endif // BIKE_LINK_H
@@ -0,0 +1,227 @@
+#define LOG_MODULE LOG_MOD_BIKE
+#include "bike_registry.h"
+#include <Preferences.h>
+#include <string.h>
+
+#define BIKE_REGISTRY_NVS_KEY    "bikes"
+#define BIKE_REGISTRY_NVS_KEY_V1 "known" // Single bike, before the registry
+
+struct BikeRegistryBlob {
+    uint8_t version;     // BIKE_REGISTRY_VERSION
+    uint8_t count;
+    BikeRecord bikes[BIKE_REGISTRY_MAX];
+};
+
+struct BikeRecordV1 {
+    uint8_t version;
+    BikeRecord record;   // Same layout after the version byte
+};
+
+// Written by the connect task (remember), loop() (forget); read by the scan callback and the bike link task.
+static portMUX_TYPE bikeRegistryMux = portMUX_INITIALIZER_UNLOCKED;
+static BikeRegistryBlob bikeRegistry;
+static BikeSighting bikeSightings[BIKE_REGISTRY_MAX];
+
+static bool sameAddress(const BikeRecord& record, const NimBLEAddress& address) {
+    return record.addressType == address.getType() && memcmp(record.address, address.getNative(), 6) == 0;
+}
+
+static int findLocked(const NimBLEAddress& address) {
+    for (uint8_t i = 0; i < bikeRegistry.count; i++) {
+        if (sameAddress(bikeRegistry.bikes[i], address)) return i;
+    }
+    return -1;
+}
+
+static bool saveRegistry(const BikeRegistryBlob& blob) {
+    Preferences prefs;
+    if (!prefs.begin(BIKE_REGISTRY_NVS_NAMESPACE, false)) {
+        ts_log_error("[BikeRegistry] FAILED to open NVS namespace '%s'.", BIKE_REGISTRY_NVS_NAMESPACE);
+        return false;
+    }
+    size_t written = prefs.putBytes(BIKE_REGISTRY_NVS_KEY, &blob, sizeof(blob));
+    prefs.remove(BIKE_REGISTRY_NVS_KEY_V1);
+    prefs.end();
+    if (written != sizeof(blob)) {
+        ts_log_error("[BikeRegistry] FAILED to write the known bikes to NVS.");
+        return false;
+    }
+    return true;
+}
+
+// The controller matches the white list on address and type.
+static void whiteListAdd(const BikeRecord& record) {
+    if (!NimBLEDevice::whiteListAdd(bikeRecordAddress(record))) {
+        ts_log_warn("[BikeRegistry] White list full or busy; background scans will miss %s.",
+                    bikeRecordAddress(record).toString().c_str());
+    }
+}
+
+void bikeRegistryBegin() {
+    BikeRegistryBlob stored;
+    memset(&stored, 0, sizeof(stored));
+    Preferences prefs;
+    if (prefs.begin(BIKE_REGISTRY_NVS_NAMESPACE, true)) {
+        BikeRecordV1 v1;
+        if (prefs.getBytesLength(BIKE_REGISTRY_NVS_KEY) == sizeof(stored) &&
+            prefs.getBytes(BIKE_REGISTRY_NVS_KEY, &stored, sizeof(stored)) == sizeof(stored) &&
+            stored.version == BIKE_REGISTRY_VERSION && stored.count <= BIKE_REGISTRY_MAX) {
+            // Current layout
+        } else if (prefs.getBytesLength(BIKE_REGISTRY_NVS_KEY_V1) == sizeof(v1) &&
+                   prefs.getBytes(BIKE_REGISTRY_NVS_KEY_V1, &v1, sizeof(v1)) == sizeof(v1) && v1.version == 1) {
+            memset(&stored, 0, sizeof(stored));
+            stored.count = 1;
+            stored.bikes[0] = v1.record;
+        } else {
+            memset(&stored, 0, sizeof(stored));
+        }
+        prefs.end();
+    }
+    stored.version = BIKE_REGISTRY_VERSION;
+    for (uint8_t i = 0; i < stored.count; i++) stored.bikes[i].driver[sizeof(stored.bikes[i].driver) - 1] = '\0';
+
+    portENTER_CRITICAL(&bikeRegistryMux);
+    bikeRegistry = stored;
+    memset(bikeSightings, 0, sizeof(bikeSightings));
+    portEXIT_CRITICAL(&bikeRegistryMux);
+
+    for (uint8_t i = 0; i < stored.count; i++) whiteListAdd(stored.bikes[i]);
+    // Pinned bike: the pairing scan filters in the controller too. The controller matches address and
+    // type, and the MAC alone doesn't say which the bike uses, so both entries go in.
+    if (BIKE_MAC_ADDRESS[0] != '\0') {
+        NimBLEDevice::whiteListAdd(NimBLEAddress(std::string(BIKE_MAC_ADDRESS), BLE_ADDR_PUBLIC));
+        NimBLEDevice::whiteListAdd(NimBLEAddress(std::string(BIKE_MAC_ADDRESS), BLE_ADDR_RANDOM));
+    }
+    ts_log_printf("[BikeRegistry] %u known bike(s).", stored.count);
+}
+
+uint8_t bikeRegistryCount() {
+    return bikeRegistry.count;
+}
+
+bool bikeRegistryGet(uint8_t index, BikeRecord& record, BikeSighting* sighting) {
+    portENTER_CRITICAL(&bikeRegistryMux);
+    bool found = index < bikeRegistry.count;
+    if (found) {
+        record = bikeRegistry.bikes[index];
+        if (sighting != NULL) *sighting = bikeSightings[index];
+    }
+    portEXIT_CRITICAL(&bikeRegistryMux);
+    return found;
+}
+
+int bikeRegistryFind(const NimBLEAddress& address) {
+    portENTER_CRITICAL(&bikeRegistryMux);
+    int index = findLocked(address);
+    portEXIT_CRITICAL(&bikeRegistryMux);
+    return index;
+}
+
+void bikeRegistryRemember(const BikeRecord& record) {
+    BikeRecord evicted;
+    bool didEvict = false;
+    BikeRegistryBlob snapshot;
+    portENTER_CRITICAL(&bikeRegistryMux);
+    int index = findLocked(bikeRecordAddress(record));
+    bool changed = index != 0 || memcmp(&bikeRegistry.bikes[0], &record, sizeof(record)) != 0;
+    if (changed) {
+        BikeSighting sighting = {false, 0, 0};
+        int from = index;
+        if (from < 0) { // New bike: the oldest drops out when full
+            if (bikeRegistry.count == BIKE_REGISTRY_MAX) {
+                evicted = bikeRegistry.bikes[BIKE_REGISTRY_MAX - 1];
+                didEvict = true;
+                from = BIKE_REGISTRY_MAX - 1;
+            } else {
+                from = bikeRegistry.count++;
+            }
+        } else {
+            sighting = bikeSightings[from];
+        }
+        for (int i = from; i > 0; i--) {
+            bikeRegistry.bikes[i] = bikeRegistry.bikes[i - 1];
+            bikeSightings[i] = bikeSightings[i - 1];
+        }
+        bikeRegistry.bikes[0] = record;
+        bikeSightings[0] = sighting;
+    }
+    snapshot = bikeRegistry;
+    portEXIT_CRITICAL(&bikeRegistryMux);
+    if (!changed) return;
+
+    if (didEvict) {
+        NimBLEDevice::whiteListRemove(bikeRecordAddress(evicted));
+        ts_log_printf("[BikeRegistry] Registry full: forgot %s.", bikeRecordAddress(evicted).toString().c_str());
+    }
+    if (index < 0) whiteListAdd(snapshot.bikes[0]);
+    if (saveRegistry(snapshot) && index < 0) {
+        ts_log_printf("[BikeRegistry] Remembered %s (%s driver) for automatic reconnects.",
+                      bikeRecordAddress(snapshot.bikes[0]).toString().c_str(), snapshot.bikes[0].driver);
+    }
+}
+
+void bikeRegistryForget() {
+    BikeRegistryBlob old;
+    portENTER_CRITICAL(&bikeRegistryMux);
+    old = bikeRegistry;
+    bikeRegistry.count = 0;
+    memset(bikeRegistry.bikes, 0, sizeof(bikeRegistry.bikes));
+    memset(bikeSightings, 0, sizeof(bikeSightings));
+    portEXIT_CRITICAL(&bikeRegistryMux);
+
+    for (uint8_t i = 0; i < old.count; i++) NimBLEDevice::whiteListRemove(bikeRecordAddress(old.bikes[i]));
+    Preferences prefs;
+    if (prefs.begin(BIKE_REGISTRY_NVS_NAMESPACE, false)) {
+        prefs.remove(BIKE_REGISTRY_NVS_KEY);
+        prefs.remove(BIKE_REGISTRY_NVS_KEY_V1);
+        prefs.end();
+    }
+    ts_log_printf("[BikeRegistry] %u known bike(s) forgotten.", old.count);
+}
+
+bool bikeRegistryOnAdvertisement(NimBLEAdvertisedDevice* device) {
+    if (bikeRegistry.count == 0) return false;
+    NimBLEAddress address = device->getAddress();
+    uint32_t nowMs = millis();
+    int8_t rssi = (int8_t)device->getRSSI();
+    portENTER_CRITICAL(&bikeRegistryMux);
+    int index = findLocked(address);
+    if (index >= 0) {
+        bikeSightings[index].seen = true;
+        bikeSightings[index].rssi = rssi;
+        bikeSightings[index].lastSeenMs = nowMs;
+    }
+    portEXIT_CRITICAL(&bikeRegistryMux);
+    return index >= 0;
+}
+
+bool bikeRegistryPickTarget(uint32_t nowMs, BikeRecord& record) {
+    portENTER_CRITICAL(&bikeRegistryMux);
+    int pick = bikeRegistry.count > 0 ? 0 : -1;
+    uint32_t freshestAgeMs = BIKE_REGISTRY_FRESH_MS;
+    for (uint8_t i = 0; i < bikeRegistry.count; i++) {
+        uint32_t ageMs = nowMs - bikeSightings[i].lastSeenMs;
+        if (bikeSightings[i].seen && ageMs < freshestAgeMs) {
+            freshestAgeMs = ageMs;
+            pick = i;
+        }
+    }
+    if (pick >= 0) record = bikeRegistry.bikes[pick];
+    portEXIT_CRITICAL(&bikeRegistryMux);
+    return pick >= 0;
+}
+
+void bikeRegistryLog() {
+    uint32_t nowMs = millis();
+    for (uint8_t i = 0; i < BIKE_REGISTRY_MAX; i++) {
+        BikeRecord record;
+        BikeSighting sighting;
+        if (!bikeRegistryGet(i, record, &sighting)) break;
+        if (sighting.seen) {
+            ts_log_printf("[BikeRegistry] %u: %s (%s) RSSI %d dBm, seen %lu ms ago.", i, bikeRecordAddress(record).toString().c_str(),
+                          record.driver, sighting.rssi, (unsigned long)(nowMs - sighting.lastSeenMs));
+        } else {
+            ts_log_printf("[BikeRegistry] %u: %s (%s) not seen since boot.", i, bikeRecordAddress(record).toString().c_str(), record.driver);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef BIKE_REGISTRY_H
+#define BIKE_REGISTRY_H
+
+#include <NimBLEDevice.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Known Bikes (one NVS blob, most recently connected first) ---
+// Every registered bike is also on the controller's white list, so background scans hear only them.
+// The attribute handles themselves stay in NimBLE's client: they are kept across reconnects to the
+// same bike and dropped when its GATT Database Hash (0x2B2A) changes (bike_link.cpp).
+#define BIKE_REGISTRY_VERSION   2
+#define BIKE_REGISTRY_HASH_SIZE 16
+
+struct BikeRecord {
+    uint8_t addressType;
+    uint8_t address[6];
+    char    driver[12];                              // BikeDriver::name
+    uint8_t hashValid;                               // The bike exposes a Database Hash
+    uint8_t databaseHash[BIKE_REGISTRY_HASH_SIZE];
+};
+
+// Runtime only: filled from advertisements of any scan.
+struct BikeSighting {
+    bool     seen;       // Since boot
+    int8_t   rssi;
+    uint32_t lastSeenMs; // millis()
+};
+
+void bikeRegistryBegin();                 // Loads NVS and programs the white list. setup()
+uint8_t bikeRegistryCount();
+bool bikeRegistryGet(uint8_t index, BikeRecord& record, BikeSighting* sighting = NULL); // 0 = most recent
+int bikeRegistryFind(const NimBLEAddress& address);                                      // -1 = not registered
+// Moves the bike to the front (adding it, evicting the oldest when full). Writes NVS only on a change.
+void bikeRegistryRemember(const BikeRecord& record);
+void bikeRegistryForget();                // Every bike, and their white list entries
+// Scan callback (NimBLE host task): records RSSI / last seen. True for a registered bike.
+bool bikeRegistryOnAdvertisement(NimBLEAdvertisedDevice* device);
+// The bike to reconnect: the most recently heard within BIKE_REGISTRY_FRESH_MS, else the most
+// recently connected. False with no bikes.
+bool bikeRegistryPickTarget(uint32_t nowMs, BikeRecord& record);
+void bikeRegistryLog();
+
+// record.address is little-endian, as getNative() returns it. NimBLEAddress(uint8_t[6], type) would
+// reverse it, so the address is rebuilt from a ble_addr_t, which is taken as is.
+inline NimBLEAddress bikeRecordAddress(const BikeRecord& record) {
+    ble_addr_t address;
+    address.type = record.addressType;
+    memcpy(address.val, record.address, sizeof(address.val));
+    return NimBLEAddress(address);
+}
+
+#endif // BIKE_REGISTRY_H
@@ -5,16 +5,14 @@
 #include "config.h"
 #include "logger.h"
 #include "ble_peripheral_manager.h" // Added back for sendRawFTMSFeatureDataToApp
+#include "telemetry.h"
+#include "bike_driver.h"
+#include "bike_link.h"
 
 // --- External Global Data Variables (defined in .ino or other .cpp files) ---
-extern uint16_t currentCadence;
-extern uint16_t currentPower;
-extern uint16_t currentSpeed;
-extern uint32_t totalDistance; 
+// Live speed/cadence/power/calories/resistance are published through telemetry.h.
 extern uint32_t bikeMachineFeatures;
 extern uint32_t bikeTargetSettingFeatures;
-extern uint16_t bikeRawCaloriesX10;
-extern volatile uint8_t currentBikeResistanceLevel_Apparent;
 
 // --- Global Variables related to Client (defined in .ino) ---
 extern NimBLEClient* pBikeClient;
@@ -30,8 +28,15 @@ extern NimBLERemoteCharacteristic* pBikeCustomDataCharacteristic;
 extern bool ftmsDataNotificationsEnabled; 
 extern bool customDataNotificationsEnabled; 
 
-extern TaskHandle_t bleScanTaskHandle;
-extern TaskHandle_t bleConnectTaskHandle;
+extern TaskHandle_t bikeConnectTaskHandle;
+
+// --- Bike Commands (button -> bike connect task) ---
+#define BIKE_COMMAND_SCAN    0 // Pairing scan for a new bike (BIKE_SCAN_PAIRING_SECONDS)
+#define BIKE_COMMAND_CONNECT 1 // Connect to the bike the scan found (pTargetBikeDevice)
+
+struct BikeCommand {
+    uint8_t type; // BIKE_COMMAND_*
+};
 
 // --- Callback Class Declarations (Instances will be global in .ino) ---
 class BikeClientCallbacks : public NimBLEClientCallbacks {
@@ -49,16 +54,14 @@ public:
 };
 
 // --- Function Declarations (defined in ble_client_manager.cpp) ---
-bool discoverBikeServicesAndCharacteristics(NimBLEClient* pClient);
+NimBLEClient* bikeClientGet(); // Creates pBikeClient on first use
 void sendFTMSControlCommandToBike(uint8_t command);
-void startBikeScanTask_func(void *pvParameters);    
-void connectToBikeDeviceTask_func(void *pvParameters); 
+bool sendFTMSControlRequestToBike(const uint8_t* request, size_t length); // Op code + parameters, with response
+void bikeClientBegin();                // Command queue. setup()
+bool bikeCommandPost(uint8_t type);    // Never blocks; false (and logged) when the queue is full
+bool bikeClientBusy();                 // A command queued or running, or the pairing scan on
+void bikeConnectTask_func(void *pvParameters);
 
-// Notification Callbacks & Data Parsing (defined in ble_client_manager.cpp)
-void ftmsFeatureNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
-void bikeIndoorDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
-void customDataNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
-void bikeFTMSDataParse(uint8_t* pData, size_t length, const char* source); 
-void parseCustomBikeData(uint8_t* pData, size_t length); 
+// Notification callbacks and data parsing live in the bike drivers (bike_driver.h).
 
 #endif // BLE_CLIENT_MANAGER_H
@@ -1,7 +1,18 @@
+#define LOG_MODULE LOG_MOD_APP
 #include "ble_peripheral_manager.h"
 #include "config.h"
 #include "logger.h"
-#include <math.h> // For roundf
+#include "ble_client_manager.h"
+#include "ftms_encoder.h"
+#include "cycling_encoder.h"
+#include "ftms_control_point.h"
+#include "app_sessions.h"
+#include "link_manager.h"
+#include "system_tasks.h"
+#include "metrics.h"
+#include "ride_filter.h"
+#include "ride_session.h"
+#include <esp_timer.h>
 #include <stdio.h> // For sprintf
 
 // Instances of callback classes (defined in .ino if global, or local if only used here)
@@ -14,11 +25,12 @@ static TrainingStatusCallbacks myTrainingStatusCallbacks_instance_local;
 static FitnessMachineStatusCallbacks myFitnessMachineStatusCallbacks_instance_local;
 static FTMSFeatureCallbacks myFTMSFeatureCallbacks_instance_local;
 static ServiceChangedCallbacks myServiceChangedCallbacks_instance_local;
+static CyclingMeasurementCallbacks myCyclingPowerCallbacks_instance_local(APP_SUB_CYCLING_POWER, "Cycling Power Measurement (0x2A63)");
+static CyclingMeasurementCallbacks myCscCallbacks_instance_local(APP_SUB_CSC, "CSC Measurement (0x2A5B)");
+static MetricsCallbacks myMetricsCountersCallbacks_instance_local(metricsEncodeCounters);
+static MetricsCallbacks myMetricsHistogramsCallbacks_instance_local(metricsEncodeHistograms);
 
-// Global sensor data variables (defined in .ino, read by this module for sending to app)
-extern uint16_t currentSpeed;
-extern uint16_t currentCadence; // Assumed to be ACTUAL RPM from bike (x2 for 0.5 RPM resolution)
-extern uint16_t currentPower;
+// Live sensor data is read from the telemetry snapshot (telemetry.h)
 extern std::string globalDeviceName; // From .ino, used for advertising
 
 // --- Global Variables for Target Data from App (defined in .ino, written by this module) ---
@@ -27,316 +39,248 @@ extern uint8_t  targetResistanceLevel_App;
 
 
 // --- MyWhooshNimBLEServerCallbacks Implementation (Peripheral Role) ---
+// Every central gets its own session (app_sessions.h). NimBLE stops advertising when a central
+// connects, so advertising is restarted here while a slot is still free.
+static void restartAdvertisingIfFree(const char* reason) {
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+    if (!pAdvertising || pAdvertising->isAdvertising() || !appSessionHasFreeSlot()) return;
+    if (pAdvertising->start()) {
+        ts_log_printf("[PeripheralCallbacks] Advertising restarted %s (%u of %u app slots used).",
+                      reason, appSessionCount(), APP_SESSION_MAX);
+    } else {
+        ts_log_error("[PeripheralCallbacks] FAILED to restart peripheral advertising.");
+    }
+}
+
 void MyWhooshNimBLEServerCallbacks::onConnect(NimBLEServer* pSrv, ble_gap_conn_desc* desc) {
+    if (!appSessionOpen(desc->conn_handle, pSrv->getPeerMTU(desc->conn_handle), desc->peer_ota_addr.val)) {
+        ts_log_error("App connection %d refused: all %u app slots are in use.", desc->conn_handle, APP_SESSION_MAX);
+        pSrv->disconnect(desc->conn_handle);
+        return;
+    }
     mywhooshConnected = true;
-    ts_log_printf("App Connected to ESP32. Conn Handle: %d, Peer Address: %s. 'mywhooshConnected' flag SET TO TRUE.",
-                  desc->conn_handle, NimBLEAddress(desc->peer_ota_addr).toString().c_str());
+    ts_log_printf("App Connected to ESP32. Conn Handle: %d, Peer Address: %s. %u app(s) connected.",
+                  desc->conn_handle, NimBLEAddress(desc->peer_ota_addr).toString().c_str(), appSessionCount());
+    uiPostEvent(UI_EVENT_APP_LINK, appSessionCount());
+    restartAdvertisingIfFree("for another app");
 }
 
-void MyWhooshNimBLEServerCallbacks::onDisconnect(NimBLEServer* pSrv, ble_gap_conn_desc* desc) {
-    mywhooshConnected = false;
-    ts_log_printf("App Disconnected from ESP32. Conn Handle: %d. 'mywhooshConnected' flag SET TO FALSE.", desc->conn_handle);
+void MyWhooshNimBLEServerCallbacks::onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) {
+    appSessionSetMtu(desc->conn_handle, MTU);
+    ts_log_printf("App MTU updated to %u (Conn Handle: %d). Indoor Bike Data payload limit: %u bytes.", MTU, desc->conn_handle, MTU - 3);
+}
 
-    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
-    if(pAdvertising && !pAdvertising->isAdvertising()) {
-        ts_log_printf("[PeripheralCallbacks] Attempting to restart advertising after app disconnect...");
-        if (pAdvertising->start()) {
-             ts_log_printf("[PeripheralCallbacks] Peripheral advertising restarted successfully.");
-        } else {
-             ts_log_printf("[PeripheralCallbacks] FAILED to restart peripheral advertising.");
-        }
-    }
+void MyWhooshNimBLEServerCallbacks::onDisconnect(NimBLEServer* pSrv, ble_gap_conn_desc* desc) {
+    bool heldControl = appSessionClose(desc->conn_handle);
+    if (heldControl) ftmsClearControlTargets(); // Its ERG / simulation targets leave with it
+    mywhooshConnected = appSessionCount() > 0;
+    ts_log_printf("App Disconnected from ESP32. Conn Handle: %d.%s %u app(s) still connected.",
+                  desc->conn_handle, heldControl ? " It held control." : "", appSessionCount());
+    uiPostEvent(UI_EVENT_APP_LINK, appSessionCount());
+    restartAdvertisingIfFree("after app disconnect");
 }
 
 // --- MyWhooshNimBLEControlPointCallbacks Implementation (Peripheral Role - FTMS Control Point) ---
+// Op codes are handled by the table-driven dispatcher in ftms_control_point.cpp; the written bytes are
+// copied into a fixed buffer (no std::string) and responses are sent later by the Control Point task.
+struct ControlPointWriteBuffer {
+    uint8_t bytes[FTMS_CP_MAX_WRITE];
+};
+
 void MyWhooshNimBLEControlPointCallbacks::onWrite(NimBLECharacteristic* pChar, ble_gap_conn_desc* desc) {
-    NimBLEAttValue value_att = pChar->getValue();
-    std::string value_str = (std::string)value_att;
-    const uint8_t* pData = (const uint8_t*)value_str.data();
-    size_t length = value_str.length();
-
-    ts_log_printf(">>> App -> Wrote to ESP32's Control Point (0x2AD9), Length: %d <<<", length);
-
-    std::string hexStr;
-    for(size_t i = 0; i < length; ++i) {
-        char buf[4];
-        sprintf(buf, "%02X ", pData[i]);
-        hexStr += buf;
-    }
-    ts_log_printf("    Raw CP Data from App: %s", hexStr.c_str());
-
-    if (length > 0) {
-        uint8_t opCode = pData[0];
-        ts_log_printf("    Received OpCode: 0x%02X", opCode);
-
-        uint8_t response[3]; 
-        response[0] = 0x80; 
-        response[1] = opCode; 
-
-        switch (opCode) {
-            case 0x00: // Request Control
-                ts_log_printf("    CP Handler: Request Control (0x00)");
-                response[2] = 0x01; // Success
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                ts_log_printf("    CP Response to App: Sent Success (0x01) for Request Control.");
-                sendTrainingStatusUpdate(0x0D, true); 
-                sendFitnessMachineStatusUpdate(0x02, true); 
-                break;
-
-            case 0x01: // Reset
-                ts_log_printf("    CP Handler: Reset (0x01)");
-                response[2] = 0x01; // Success
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                ts_log_printf("    CP Response to App: Sent Success for Reset.");
-                targetInclinationPercentX100 = 0; 
-                targetResistanceLevel_App = 0;
-                sendTrainingStatusUpdate(0x01, true); 
-                sendFitnessMachineStatusUpdate(0x01, true); 
-                break;
-
-            case 0x03: // Set Target Inclination
-                ts_log_printf("    CP Handler: Set Target Inclination (0x03)");
-                if (length >= 3) { 
-                    int16_t rawInclination;
-                    memcpy(&rawInclination, &pData[1], sizeof(rawInclination));
-                    targetInclinationPercentX100 = rawInclination;
-                    ts_log_printf("      Raw Inclination Bytes: %02X %02X", pData[1], pData[2]);
-                    ts_log_printf("      Parsed targetInclinationPercentX100: %d (%.2f%%)",
-                                  targetInclinationPercentX100, (float)targetInclinationPercentX100 / 100.0f);
-                    response[2] = 0x01; // Success
-                } else {
-                    ts_log_printf("      ERROR: Insufficient data length (%d). Expected 3 for Set Target Inclination.", length);
-                    response[2] = 0x04; // Invalid Parameter
-                }
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                break;
-
-            case 0x04: // Set Target Resistance Level
-                ts_log_printf("    CP Handler: Set Target Resistance Level (0x04)");
-                if (length >= 2) { 
-                    uint8_t rawResistanceValueFromApp = pData[1]; 
-                    ts_log_printf("      Raw Resistance Byte from App: %02X (Value: %u)", pData[1], rawResistanceValueFromApp);
-                    
-                    uint8_t processedLevel = 0;
-                    if (rawResistanceValueFromApp == 0) {
-                        processedLevel = 0;
-                    } else {
-                        processedLevel = (uint8_t)roundf((float)rawResistanceValueFromApp / 10.0f);
-                    }
-
-                    if (processedLevel == 0 && rawResistanceValueFromApp == 0) { 
-                        targetResistanceLevel_App = 0; 
-                    } else if (processedLevel < 1) {
-                        targetResistanceLevel_App = 1; 
-                    } else if (processedLevel > 8) { 
-                        targetResistanceLevel_App = 8; 
-                    } else {
-                        targetResistanceLevel_App = processedLevel;
-                    }
-                                        
-                    ts_log_printf("      Processed targetResistanceLevel_App (1-8 scale): %u", targetResistanceLevel_App);
-                    response[2] = 0x01; // Success
-                } else {
-                    ts_log_printf("      ERROR: Insufficient data length (%d). Expected 2 for Set Target Resistance.", length);
-                    response[2] = 0x04; // Invalid Parameter
-                }
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                break;
-            
-            case 0x05: // Set Target Power
-                ts_log_printf("    CP Handler: Set Target Power (0x05)");
-                if (length >= 3) { 
-                    int16_t rawPower;
-                    memcpy(&rawPower, &pData[1], sizeof(rawPower));
-                    ts_log_printf("      Received Target Power command: %d W. (Currently not acted upon)", rawPower);
-                    response[2] = 0x01; 
-                } else {
-                    ts_log_printf("      ERROR: Insufficient data length (%d). Expected 3 for Set Target Power.", length);
-                    response[2] = 0x04; 
-                }
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                break;
-            
-            case 0x07: // Start or Resume
-                ts_log_printf("    CP Handler: Start/Resume (0x07)");
-                response[2] = 0x01; // Success
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                ts_log_printf("    CP Response to App: Sent Success for Start/Resume.");
-                sendFitnessMachineStatusUpdate(0x04, true); 
-                break;
-
-            case 0x08: // Stop or Pause
-                ts_log_printf("    CP Handler: Stop/Pause (0x08)");
-                if (length >= 2 && pData[1] == 0x01) { 
-                     ts_log_printf("      Parameter: Stop (0x01)");
-                     sendFitnessMachineStatusUpdate(0x02, true); 
-                } else if (length >=2 && pData[1] == 0x02) { 
-                     ts_log_printf("      Parameter: Pause (0x02)");
-                     sendFitnessMachineStatusUpdate(0x07, true); 
-                } else {
-                     ts_log_printf("      Parameter: Unknown/None for Stop/Pause");
-                     sendFitnessMachineStatusUpdate(0x02, true);
-                }
-                response[2] = 0x01; // Success
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                ts_log_printf("    CP Response to App: Sent Success for Stop/Pause.");
-                break;
-
-            default:
-                ts_log_printf("    CP Handler: Unrecognized Op Code: 0x%02X", opCode);
-                response[2] = 0x02; 
-                pChar->setValue(response, 3);
-                pChar->indicate();
-                ts_log_printf("    CP Response to App: Sent 'Op Code Not Supported'.");
-                break;
-        }
-    } else {
-        ts_log_printf("    Received empty Control Point write (length 0). Ignoring.");
-    }
+    // The NimBLE host task stores each write and then calls this, so the length and the bytes belong to
+    // the same write. Only the bytes the app sent reach the dispatcher's length checks; the copy into
+    // the fixed buffer takes no heap (a NimBLEAttValue snapshot would).
+    size_t length = pChar->getDataLength();
+    if (length > FTMS_CP_MAX_WRITE) length = FTMS_CP_MAX_WRITE;
+    ControlPointWriteBuffer buffer = pChar->getValue<ControlPointWriteBuffer>(nullptr, true);
+    ftmsControlPointOnWrite(desc->conn_handle, buffer.bytes, length);
 }
 
 // --- onSubscribe Callbacks ---
+// Unknown CCCD values are formatted into the caller's buffer.
+static const char* cccdDescription(uint16_t subValue, bool indications, char* buffer, size_t size) {
+    if (subValue == 0x0000) return indications ? "Indications DISABLED" : "Notifications DISABLED";
+    if (subValue == (indications ? 0x0002 : 0x0001)) return indications ? "INDICATIONS ENABLED" : "NOTIFICATIONS ENABLED";
+    snprintf(buffer, size, "UNKNOWN CCCD value: 0x%04X", subValue);
+    return buffer;
+}
+
+// NimBLE reports every notify() here, synchronously: SUCCESS_NOTIFY, or the reason it was not sent.
+void IndoorBikeDataCallbacks::onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) {
+  if (s != SUCCESS_NOTIFY) metricsCount(METRIC_APP_NOTIFY_FAILURES);
+}
+
 void IndoorBikeDataCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
-    std::string subValStr;
-    char cccdValHex[7]; 
-    if (subValue == 0x0001) subValStr = "NOTIFICATIONS ENABLED";
-    else if (subValue == 0x0000) subValStr = "Notifications DISABLED";
-    else {
-        sprintf(cccdValHex, "0x%04X", subValue);
-        subValStr = "UNKNOWN CCCD value: ";
-        subValStr += cccdValHex;
-    }
+    appSessionSetSubscribed(desc->conn_handle, APP_SUB_INDOOR_BIKE_DATA, subValue != 0);
+    char cccdText[32];
+    const char* subValStr = cccdDescription(subValue, false, cccdText, sizeof(cccdText));
     NimBLEAddress peerAddr(desc->peer_ota_addr);
     ts_log_printf("App (%s) %s for ESP32's Indoor Bike Data (0x2ACC). CCCD Raw Value: 0x%04X",
-                  peerAddr.toString().c_str(), subValStr.c_str(), subValue);
+                  peerAddr.toString().c_str(), subValStr, subValue);
 }
 
 void TrainingStatusCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
-    std::string subValStr;
-    char cccdValHex[7];
-    if (subValue == 0x0001) subValStr = "NOTIFICATIONS ENABLED";
-    else if (subValue == 0x0000) subValStr = "Notifications DISABLED";
-    else {
-        sprintf(cccdValHex, "0x%04X", subValue);
-        subValStr = "UNKNOWN CCCD value: ";
-        subValStr += cccdValHex;
-    }
+    appSessionSetSubscribed(desc->conn_handle, APP_SUB_TRAINING_STATUS, subValue != 0);
+    char cccdText[32];
+    const char* subValStr = cccdDescription(subValue, false, cccdText, sizeof(cccdText));
     NimBLEAddress peerAddr(desc->peer_ota_addr);
     ts_log_printf("App (%s) %s for ESP32's Training Status (0x2AD3). CCCD Raw Value: 0x%04X",
-                  peerAddr.toString().c_str(), subValStr.c_str(), subValue);
+                  peerAddr.toString().c_str(), subValStr, subValue);
     if (subValue == 0x0001) { 
         sendTrainingStatusUpdate(pCharacteristic->getValue<uint8_t>(), true); 
     }
 }
 
 void FitnessMachineStatusCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
-    std::string subValStr;
-    char cccdValHex[7];
-    if (subValue == 0x0001) subValStr = "NOTIFICATIONS ENABLED";
-    else if (subValue == 0x0000) subValStr = "Notifications DISABLED";
-    else {
-        sprintf(cccdValHex, "0x%04X", subValue);
-        subValStr = "UNKNOWN CCCD value: ";
-        subValStr += cccdValHex;
-    }
+    appSessionSetSubscribed(desc->conn_handle, APP_SUB_MACHINE_STATUS, subValue != 0);
+    char cccdText[32];
+    const char* subValStr = cccdDescription(subValue, false, cccdText, sizeof(cccdText));
     NimBLEAddress peerAddr(desc->peer_ota_addr);
     ts_log_printf("App (%s) %s for ESP32's Fitness Machine Status (0x2ADA). CCCD Raw Value: 0x%04X",
-                  peerAddr.toString().c_str(), subValStr.c_str(), subValue);
+                  peerAddr.toString().c_str(), subValStr, subValue);
     if (subValue == 0x0001) { 
         sendFitnessMachineStatusUpdate(pCharacteristic->getValue<uint8_t>(), true); 
     }
 }
 
 void FTMSFeatureCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
-    std::string subValStr;
-    char cccdValHex[7];
-    if (subValue == 0x0001) subValStr = "NOTIFICATIONS ENABLED"; 
-    else if (subValue == 0x0000) subValStr = "Notifications DISABLED";
-    else {
-        sprintf(cccdValHex, "0x%04X", subValue);
-        subValStr = "UNKNOWN CCCD value: ";
-        subValStr += cccdValHex;
-    }
+    appSessionSetSubscribed(desc->conn_handle, APP_SUB_FEATURE, subValue != 0);
+    char cccdText[32];
+    const char* subValStr = cccdDescription(subValue, false, cccdText, sizeof(cccdText));
     NimBLEAddress peerAddr(desc->peer_ota_addr);
     ts_log_printf("App (%s) %s for ESP32's FTMS Feature (0x2AD2). CCCD Raw Value: 0x%04X",
-                  peerAddr.toString().c_str(), subValStr.c_str(), subValue);
+                  peerAddr.toString().c_str(), subValStr, subValue);
 }
 
 void ServiceChangedCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
-    std::string subValStr;
-    char cccdValHex[7];
-    if (subValue == 0x0002) subValStr = "INDICATIONS ENABLED"; 
-    else if (subValue == 0x0000) subValStr = "Indications DISABLED";
-    else {
-        sprintf(cccdValHex, "0x%04X", subValue);
-        subValStr = "UNKNOWN CCCD value: ";
-        subValStr += cccdValHex;
-    }
+    appSessionSetSubscribed(desc->conn_handle, APP_SUB_SERVICE_CHANGED, subValue != 0);
+    char cccdText[32];
+    const char* subValStr = cccdDescription(subValue, true, cccdText, sizeof(cccdText));
     NimBLEAddress peerAddr(desc->peer_ota_addr);
     ts_log_printf("App (%s) %s for ESP32's Service Changed (0x2A05). CCCD Raw Value: 0x%04X",
-                  peerAddr.toString().c_str(), subValStr.c_str(), subValue);
+                  peerAddr.toString().c_str(), subValStr, subValue);
     if (subValue == 0x0002) { 
          ts_log_printf("  >>> App SUBSCRIBED to INDICATIONS for Service Changed! <<<");
          indicateServiceChanged();
     }
 }
 
-// --- sendDataToMyWhoosh Implementation (Corrected FTMS Flags) ---
-void sendDataToMyWhoosh() {
-  if (!mywhooshConnected || pIndoorBikeDataCharacteristic_Peripheral == nullptr) {
-    return;
-  }
-  if (pIndoorBikeDataCharacteristic_Peripheral->getSubscribedCount() == 0) {
-    return;
+void CyclingMeasurementCallbacks::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
+    appSessionSetSubscribed(desc->conn_handle, subscription, subValue != 0);
+    NimBLEAddress peerAddr(desc->peer_ota_addr);
+    ts_log_printf("App (%s) %s for ESP32's %s. CCCD Raw Value: 0x%04X", peerAddr.toString().c_str(),
+                  subValue != 0 ? "NOTIFICATIONS ENABLED" : "Notifications DISABLED", name, subValue);
+}
+
+// --- MetricsCallbacks Implementation (diagnostics service) ---
+// Reads arrive on the NimBLE host task one at a time, so one buffer serves both characteristics;
+// the value was presized at setup and is overwritten in place.
+void MetricsCallbacks::onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+    static uint8_t record[METRICS_HISTOGRAMS_LENGTH > METRICS_COUNTERS_LENGTH ? METRICS_HISTOGRAMS_LENGTH : METRICS_COUNTERS_LENGTH];
+    pCharacteristic->setValue(record, encode(record));
+}
+
+// --- sendDataToMyWhoosh Implementation (FTMS Indoor Bike Data, ftms_encoder.h) ---
+// The record is encoded once, sized for the smallest MTU among the subscribed apps, and each
+// fragment is notified to every subscriber.
+struct IndoorBikeDataFanOut {
+    uint16_t handles[APP_SESSION_MAX];
+    uint8_t count;
+    uint32_t notifyUs; // Time in setValue/notify, so the encode time can be told apart
+};
+
+static void notifyIndoorBikeDataFragment(const uint8_t* payload, size_t length, void* context) {
+  IndoorBikeDataFanOut* fanOut = (IndoorBikeDataFanOut*)context;
+  int64_t startUs = esp_timer_get_time();
+  pIndoorBikeDataCharacteristic_Peripheral->setValue(payload, length);
+  for (uint8_t i = 0; i < fanOut->count; i++) {
+    metricsCount(METRIC_APP_NOTIFIES); // Failures are counted from the notify() result (onStatus)
+    linkManagerOnNotify(fanOut->handles[i]);
+    pIndoorBikeDataCharacteristic_Peripheral->notify(true, fanOut->handles[i]);
   }
+  fanOut->notifyUs += (uint32_t)(esp_timer_get_time() - startUs);
+}
 
-  uint16_t ftms_flags = 0;
-  // FTMS Indoor Bike Data Packet Flags:
-  // Bit 0: More Data (0 for false)
-  // Bit 1: Average Speed Present (0 for false, means Instantaneous Speed field is present)
-  // Bit 2: Instantaneous Cadence Present (1 = true)
-  // Bit 3: Average Cadence Present (0 for false)
-  // Bit 4: Total Distance Present (0 for false)
-  // Bit 5: Resistance Level Present (0 for false - we are not sending it here)
-  // Bit 6: Instantaneous Power Present (1 = true)
-  // Bit 7: Average Power Present (0 for false)
-  // Other flags (HR, Metabolic, Elapsed Time, Remaining Time) are 0 for this basic implementation.
-
-  bool cadence_present = true; 
-  bool power_present = true;   
-
-  // Instantaneous Speed is always present after flags if Bit 1 is 0.
-  
-  if (cadence_present) {
-    ftms_flags |= (1 << 2); 
+bool sendDataToMyWhoosh(const TelemetryFrame& frame) {
+  if (!mywhooshConnected || pIndoorBikeDataCharacteristic_Peripheral == nullptr) {
+    return false;
   }
-  if (power_present) {
-    ftms_flags |= (1 << 6); 
+  IndoorBikeDataFanOut fanOut;
+  uint16_t minMtu;
+  fanOut.count = appSessionSubscribers(APP_SUB_INDOOR_BIKE_DATA, fanOut.handles, minMtu);
+  if (fanOut.count == 0) {
+    return false;
   }
-
-  uint8_t payload[8]; 
-  int offset = 0;
-
-  memcpy(payload + offset, &ftms_flags, 2); offset += 2;
-  memcpy(payload + offset, &currentSpeed, 2); offset += 2; 
-
-  if (cadence_present) {
-    memcpy(payload + offset, &currentCadence, 2); offset += 2;
+  fanOut.notifyUs = 0;
+  int64_t startUs = esp_timer_get_time();
+
+  // Fields outside FTMS_IBD_FIELD_MASK are filled in but never packed.
+  FtmsIndoorBikeData data;
+  memset(&data, 0, sizeof(data));
+  data.value[FTMS_IBD_INST_SPEED] = frame.speed;
+  data.value[FTMS_IBD_AVG_SPEED] = rideFilterValue(frame, FTMS_IBD_AVERAGE_FILTER, TELEMETRY_METRIC_SPEED);
+  data.value[FTMS_IBD_INST_CADENCE] = frame.cadence;
+  data.value[FTMS_IBD_AVG_CADENCE] = rideFilterValue(frame, FTMS_IBD_AVERAGE_FILTER, TELEMETRY_METRIC_CADENCE);
+  data.value[FTMS_IBD_TOTAL_DISTANCE] = frame.totals.distanceM > 0xFFFFFF ? 0xFFFFFF : frame.totals.distanceM;
+  data.value[FTMS_IBD_RESISTANCE] = (uint16_t)(int16_t)frame.resistanceLevel;
+  data.value[FTMS_IBD_INST_POWER] = (uint16_t)(int16_t)frame.power;
+  data.value[FTMS_IBD_AVG_POWER] = rideFilterValue(frame, FTMS_IBD_AVERAGE_FILTER, TELEMETRY_METRIC_POWER);
+  uint32_t kcal = rideSessionKcalX10(frame.totals.workJ) / 10;
+  uint32_t kcalPerHour = rideSessionKcalPerHour(frame.power);
+  uint32_t kcalPerMinute = (kcalPerHour + 30) / 60;
+  data.value[FTMS_IBD_EXPENDED_ENERGY] = ftmsExpendedEnergy(kcal > 0xFFFE ? 0xFFFE : (uint16_t)kcal, // All ones = not available
+                                                            kcalPerHour > 0xFFFE ? 0xFFFE : (uint16_t)kcalPerHour,
+                                                            kcalPerMinute > 0xFE ? 0xFE : (uint8_t)kcalPerMinute);
+  data.value[FTMS_IBD_ELAPSED_TIME] = frame.totals.elapsedS > 0xFFFF ? 0xFFFF : frame.totals.elapsedS;
+
+  data.value[FTMS_IBD_HEART_RATE] = frame.heartRate;
+
+  size_t maxPayload = minMtu - 3;
+  size_t fragments;
+  if (frame.heartRate > 0) { // Only while a strap is delivering, so apps don't show 0 BPM
+    fragments = ftmsSendIndoorBikeData<FTMS_IBD_FIELD_MASK | FTMS_IBD_FIELD(FTMS_IBD_HEART_RATE)>(
+        data, maxPayload, notifyIndoorBikeDataFragment, &fanOut);
+  } else {
+    fragments = ftmsSendIndoorBikeData<FTMS_IBD_FIELD_MASK>(data, maxPayload, notifyIndoorBikeDataFragment, &fanOut);
   }
-  if (power_present) { 
-    int16_t powerForFtms_val = (int16_t)currentPower; 
-    memcpy(payload + offset, &powerForFtms_val, 2); offset += 2;
+  uint32_t totalUs = (uint32_t)(esp_timer_get_time() - startUs);
+  metricsObserve(METRIC_HIST_NOTIFY_US, fanOut.notifyUs);
+  metricsObserve(METRIC_HIST_ENCODE_US, totalUs - fanOut.notifyUs);
+  return fragments > 0;
+}
+
+// --- sendCyclingMeasurements Implementation (Cycling Power 0x2A63, CSC 0x2A5B; cycling_encoder.h) ---
+// Both records come from one pass over the frame, so a watch on CPS and one on CSC count the same
+// revolutions. Called only from the forwarder task, which owns the revolution state.
+static CyclingMeasurementState cyclingState;
+
+static bool notifySubscribers(NimBLECharacteristic* pCharacteristic, uint8_t subscription, const uint8_t* payload, size_t length) {
+  uint16_t handles[APP_SESSION_MAX];
+  uint16_t minMtu;
+  uint8_t count = appSessionSubscribers(subscription, handles, minMtu);
+  if (pCharacteristic == nullptr || count == 0) return false;
+  pCharacteristic->setValue(payload, length);
+  for (uint8_t i = 0; i < count; i++) {
+    linkManagerOnNotify(handles[i]);
+    pCharacteristic->notify(true, handles[i]);
   }
+  return true;
+}
 
-  pIndoorBikeDataCharacteristic_Peripheral->setValue(payload, offset);
-  pIndoorBikeDataCharacteristic_Peripheral->notify();
+bool sendCyclingMeasurements(const TelemetryFrame& frame) {
+  if (!CYCLING_SERVICES_ENABLED || !mywhooshConnected) {
+    return false;
+  }
+  FtmsControlTargets targets;
+  ftmsGetControlTargets(targets);
+  CyclingMeasurements measurements;
+  cyclingEncodeMeasurements(cyclingState, frame, targets.wheelCircumference, measurements);
+  bool sentPower = notifySubscribers(pCyclingPowerMeasurementCharacteristic_Peripheral, APP_SUB_CYCLING_POWER,
+                                     measurements.cps, sizeof(measurements.cps));
+  bool sentCsc = notifySubscribers(pCscMeasurementCharacteristic_Peripheral, APP_SUB_CSC,
+                                   measurements.csc, sizeof(measurements.csc));
+  return sentPower || sentCsc;
 }
 
 // --- sendTrainingStatusUpdate, sendFitnessMachineStatusUpdate, sendRawFTMSFeatureDataToApp, indicateServiceChanged ---
@@ -364,18 +308,25 @@ void sendFitnessMachineStatusUpdate(uint8_t status_code, bool force_notify) {
     }
 }
 
+// Notifies a full Fitness Machine Status record (op code + parameters), e.g. queued Control Point results.
+void sendFitnessMachineStatus(const uint8_t* status, size_t length) {
+    if (mywhooshConnected && pFitnessMachineStatusCharacteristic_Peripheral != nullptr) {
+        pFitnessMachineStatusCharacteristic_Peripheral->setValue(status, length);
+        if (pFitnessMachineStatusCharacteristic_Peripheral->getSubscribedCount() > 0) {
+            pFitnessMachineStatusCharacteristic_Peripheral->notify();
+            ts_log_printf("[BLE Peripheral] Sent Fitness Machine Status (0x2ADA) Update to App: 0x%02X (%u parameter bytes)",
+                          status[0], (unsigned)(length - 1));
+        }
+    }
+}
+
 // This function will now be used to forward bike's 0x2AD2 data to app via ESP32's 0x2AD2
 void sendRawFTMSFeatureDataToApp(const uint8_t* data, size_t length) {
     if (mywhooshConnected && pFTMSFeatureCharacteristic_Peripheral != nullptr) {
         if (pFTMSFeatureCharacteristic_Peripheral->getSubscribedCount() > 0) {
             pFTMSFeatureCharacteristic_Peripheral->setValue(data, length);
             pFTMSFeatureCharacteristic_Peripheral->notify();
-            // char dataStr[length * 3 + 1];
-            // dataStr[length*3] = '\0';
-            // for (size_t i = 0; i < length; i++) {
-            //     sprintf(dataStr + i * 3, "%02X ", data[i]);
-            // }
-            // ts_log_printf("[BLE Peripheral] Forwarded data to App via 0x2AD2 (len %d): %s", length, dataStr);
+            TS_LOG_TOKEN_HEX(LOG_LEVEL_DEBUG, "[BLE Peripheral] Forwarded data to App via 0x2AD2: %s", data, length);
         }
     }
 }
@@ -398,8 +349,8 @@ void blePeripheralSetupTask_func(void *pvParameters) {
 
     pServer_Peripheral = NimBLEDevice::createServer();
     if (!pServer_Peripheral) { 
-        ts_log_printf("FATAL: Failed to create server in blePeripheralSetupTask_func");
-        vTaskDelete(NULL); return;
+        ts_log_error("FATAL: Failed to create server in blePeripheralSetupTask_func");
+        systemTaskExit(); return;
     }
     pServer_Peripheral->setCallbacks(&myServerCallbacks_global);
 
@@ -407,6 +358,16 @@ void blePeripheralSetupTask_func(void *pvParameters) {
     NimBLEService* pDISService = pServer_Peripheral->createService(NimBLEUUID((uint16_t)DEVICE_INFORMATION_SERVICE_UUID_SHORT));
     NimBLEService* pGenericAccessService = pServer_Peripheral->createService(NimBLEUUID((uint16_t)GENERIC_ACCESS_UUID_SHORT));
     NimBLEService* pGattService = pServer_Peripheral->createService(NimBLEUUID((uint16_t)GENERIC_ATTRIBUTE_UUID_SHORT));
+    NimBLEService* pCyclingPowerService = NULL;
+    NimBLEService* pCscService = NULL;
+    if (CYCLING_SERVICES_ENABLED) {
+        pCyclingPowerService = pServer_Peripheral->createService(NimBLEUUID((uint16_t)CPS_SERVICE_UUID_SHORT));
+        pCscService = pServer_Peripheral->createService(NimBLEUUID((uint16_t)CSC_SERVICE_UUID_SHORT));
+    }
+    NimBLEService* pMetricsService = NULL;
+    if (METRICS_GATT_ENABLED) {
+        pMetricsService = pServer_Peripheral->createService(NimBLEUUID(METRICS_SERVICE_UUID_STR));
+    }
 
 
     if (pFTMSService_Peripheral) {
@@ -420,15 +381,20 @@ void blePeripheralSetupTask_func(void *pvParameters) {
             // No static value set here, it will be updated by sendRawFTMSFeatureDataToApp
             pFTMSFeatureCharacteristic_Peripheral->setCallbacks(&myFTMSFeatureCallbacks_instance_local); 
             ts_log_printf("    FTMS Feature (0x2AD2) created. Properties: NOTIFY (Dynamically updated)");
-        } else {ts_log_printf("    FAILED to create FTMS Feature (0x2AD2).");}
+        } else {ts_log_error("    FAILED to create FTMS Feature (0x2AD2).");}
 
         pIndoorBikeDataCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
                                                     NimBLEUUID((uint16_t)FTMS_INDOOR_BIKE_DATA_UUID_SHORT), 
                                                     NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ ); // Properties NOTIFY, READ
         if(pIndoorBikeDataCharacteristic_Peripheral) {
             pIndoorBikeDataCharacteristic_Peripheral->setCallbacks(&myIndoorBikeDataCallbacks_instance_local);
+            // Grown once to the longest record, so no notify reallocates the value; then a valid empty
+            // record (flags 0: speed only, 0 km/h) until the first bike sample.
+            uint8_t emptyRecord[FTMS_IBD_MAX_LENGTH] = {0};
+            pIndoorBikeDataCharacteristic_Peripheral->setValue(emptyRecord, sizeof(emptyRecord));
+            pIndoorBikeDataCharacteristic_Peripheral->setValue(emptyRecord, 4);
             ts_log_printf("    Indoor Bike Data (0x2ACC) created. Properties: NOTIFY, READ");
-        } else {ts_log_printf("    FAILED to create Indoor Bike Data (0x2ACC).");}
+        } else {ts_log_error("    FAILED to create Indoor Bike Data (0x2ACC).");}
         
         pTrainingStatusCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
                                                     NimBLEUUID((uint16_t)FTMS_TRAINING_STATUS_UUID_SHORT), NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ );
@@ -437,7 +403,7 @@ void blePeripheralSetupTask_func(void *pvParameters) {
             uint8_t initialTrainingStatus = 0x0D; 
             pTrainingStatusCharacteristic_Peripheral->setValue(&initialTrainingStatus, 1);
             ts_log_printf("    Training Status (0x2AD3) created.");
-        } else {ts_log_printf("    FAILED to create Training Status (0x2AD3).");}
+        } else {ts_log_error("    FAILED to create Training Status (0x2AD3).");}
         
         uint8_t speedRangePayload[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00}; 
         pSupportedSpeedRangeCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
@@ -445,7 +411,7 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if (pSupportedSpeedRangeCharacteristic_Peripheral) {
             pSupportedSpeedRangeCharacteristic_Peripheral->setValue(speedRangePayload, sizeof(speedRangePayload));
             ts_log_printf("    Supported Speed Range (0x2AD4) set to all zeros.");
-        } else {ts_log_printf("    FAILED to create Supported Speed Range (0x2AD4).");}
+        } else {ts_log_error("    FAILED to create Supported Speed Range (0x2AD4).");}
 
         uint8_t inclinationRangePayload[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00}; 
         pSupportedInclinationRangeCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
@@ -453,7 +419,7 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if (pSupportedInclinationRangeCharacteristic_Peripheral) {
             pSupportedInclinationRangeCharacteristic_Peripheral->setValue(inclinationRangePayload, sizeof(inclinationRangePayload));
             ts_log_printf("    Supported Inclination Range (0x2AD5) set to all zeros.");
-        } else {ts_log_printf("    FAILED to create Supported Inclination Range (0x2AD5).");}
+        } else {ts_log_error("    FAILED to create Supported Inclination Range (0x2AD5).");}
 
         uint8_t resistanceRangePayload[6] = {0x0A, 0x00, 0x50, 0x00, 0x0A, 0x00};  
         pSupportedResistanceRangeCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
@@ -461,7 +427,7 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if (pSupportedResistanceRangeCharacteristic_Peripheral) {
             pSupportedResistanceRangeCharacteristic_Peripheral->setValue(resistanceRangePayload, sizeof(resistanceRangePayload));
              ts_log_printf("    Supported Resistance Level Range (0x2AD6) set: Min:1.0, Max:8.0, Inc:1.0 (0.1 resolution)");
-        } else { ts_log_printf("    FAILED to create Supported Resistance Level Range (0x2AD6)."); }
+        } else { ts_log_error("    FAILED to create Supported Resistance Level Range (0x2AD6)."); }
 
         int16_t min_power = 0; int16_t max_power = 1000; uint16_t inc_power = 1;   
         uint8_t powerRangePayload[6]; 
@@ -473,7 +439,7 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if (pSupportedPowerRangeCharacteristic_Peripheral) {
             pSupportedPowerRangeCharacteristic_Peripheral->setValue(powerRangePayload, sizeof(powerRangePayload));
              ts_log_printf("    Supported Power Range (0x2AD8) created.");
-        } else {ts_log_printf("    FAILED to create Supported Power Range (0x2AD8).");}
+        } else {ts_log_error("    FAILED to create Supported Power Range (0x2AD8).");}
         
         uint8_t hrRangePayload[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
         pSupportedHeartRateRangeCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(
@@ -481,13 +447,13 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if(pSupportedHeartRateRangeCharacteristic_Peripheral) {
             pSupportedHeartRateRangeCharacteristic_Peripheral->setValue(hrRangePayload, sizeof(hrRangePayload));
             ts_log_printf("    Supported Heart Rate Range (0x2AD7) set to all zeros.");
-        } else {ts_log_printf("    FAILED to create Supported Heart Rate Range (0x2AD7).");}
+        } else {ts_log_error("    FAILED to create Supported Heart Rate Range (0x2AD7).");}
 
         pControlPointCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::INDICATE);
         if(pControlPointCharacteristic_Peripheral) {
             pControlPointCharacteristic_Peripheral->setCallbacks(&myControlPointCallbacks_instance_local);
             ts_log_printf("    FTMS Control Point (0x2AD9) created.");
-        } else {ts_log_printf("    FAILED to create FTMS Control Point (0x2AD9).");}
+        } else {ts_log_error("    FAILED to create FTMS Control Point (0x2AD9).");}
 
         pFitnessMachineStatusCharacteristic_Peripheral = pFTMSService_Peripheral->createCharacteristic(NimBLEUUID((uint16_t)FTMS_STATUS_UUID_SHORT), NIMBLE_PROPERTY::NOTIFY);
         if (pFitnessMachineStatusCharacteristic_Peripheral) {
@@ -495,11 +461,11 @@ void blePeripheralSetupTask_func(void *pvParameters) {
             uint8_t initialFMStatus = 0x02; 
             pFitnessMachineStatusCharacteristic_Peripheral->setValue(&initialFMStatus, 1);
             ts_log_printf("    Fitness Machine Status (0x2ADA) created.");
-        } else {ts_log_printf("    FAILED to create Fitness Machine Status (0x2ADA).");}
+        } else {ts_log_error("    FAILED to create Fitness Machine Status (0x2ADA).");}
 
     } else { 
-        ts_log_printf("FATAL: Failed to create FTMS Service in blePeripheralSetupTask_func");
-        vTaskDelete(NULL); return;
+        ts_log_error("FATAL: Failed to create FTMS Service in blePeripheralSetupTask_func");
+        systemTaskExit(); return;
     }
 
     if (pDISService) {
@@ -518,9 +484,9 @@ void blePeripheralSetupTask_func(void *pvParameters) {
             uint8_t systemIdPayload[] = {0x49, 0xB6, 0xE2, 0x3C, 0x01, 0xAB, 0x00, 0x00}; 
             pSysId->setValue(systemIdPayload, sizeof(systemIdPayload));
             ts_log_printf("    System ID (0x2A23) created with Merach value.");
-        } else {ts_log_printf("    FAILED to create System ID (0x2A23).");}
+        } else {ts_log_error("    FAILED to create System ID (0x2A23).");}
 
-    } else {ts_log_printf("  FAILED to create Device Information Service (0x180A).");}
+    } else {ts_log_error("  FAILED to create Device Information Service (0x180A).");}
 
 
     if(pGenericAccessService){
@@ -533,9 +499,9 @@ void blePeripheralSetupTask_func(void *pvParameters) {
             uint16_t appearanceValue = 0x0741; // Indoor Bike (reverted from 0x0000)
             pAppearanceChar->setValue(appearanceValue);
             ts_log_printf("    Appearance (0x2A01) set to 0x%04X (Indoor Bike).", appearanceValue);
-        } else {ts_log_printf("    FAILED to create Appearance (0x2A01).");}
+        } else {ts_log_error("    FAILED to create Appearance (0x2A01).");}
 
-    } else {ts_log_printf("  FAILED to create Generic Access Service (0x1800).");}
+    } else {ts_log_error("  FAILED to create Generic Access Service (0x1800).");}
 
      if(pGattService){
         ts_log_printf("  Configuring Generic Attribute Service (0x1801)...");
@@ -543,25 +509,82 @@ void blePeripheralSetupTask_func(void *pvParameters) {
         if(pServiceChangedCharacteristic_Peripheral) {
             pServiceChangedCharacteristic_Peripheral->setCallbacks(&myServiceChangedCallbacks_instance_local);
             ts_log_printf("    Service Changed (0x2A05) created.");
-        } else {ts_log_printf("    FAILED to create Service Changed (0x2A05).");}
-     } else {ts_log_printf("  FAILED to create Generic Attribute Service (0x1801).");}
+        } else {ts_log_error("    FAILED to create Service Changed (0x2A05).");}
+     } else {ts_log_error("  FAILED to create Generic Attribute Service (0x1801).");}
+
+    if (pCyclingPowerService) {
+        ts_log_printf("  Configuring Cycling Power Service (0x1818)...");
+        pCyclingPowerMeasurementCharacteristic_Peripheral = pCyclingPowerService->createCharacteristic(
+                                                    NimBLEUUID((uint16_t)CPS_MEASUREMENT_UUID_SHORT), NIMBLE_PROPERTY::NOTIFY);
+        if (pCyclingPowerMeasurementCharacteristic_Peripheral) {
+            pCyclingPowerMeasurementCharacteristic_Peripheral->setCallbacks(&myCyclingPowerCallbacks_instance_local);
+            ts_log_printf("    Cycling Power Measurement (0x2A63) created.");
+        } else {ts_log_error("    FAILED to create Cycling Power Measurement (0x2A63).");}
+
+        NimBLECharacteristic* pCpsFeature = pCyclingPowerService->createCharacteristic(NimBLEUUID((uint16_t)CPS_FEATURE_UUID_SHORT), NIMBLE_PROPERTY::READ);
+        if (pCpsFeature) pCpsFeature->setValue((uint32_t)(CPS_FEATURE_WHEEL_REVOLUTIONS | CPS_FEATURE_CRANK_REVOLUTIONS));
+        NimBLECharacteristic* pCpsLocation = pCyclingPowerService->createCharacteristic(NimBLEUUID((uint16_t)SENSOR_LOCATION_UUID_SHORT), NIMBLE_PROPERTY::READ);
+        if (pCpsLocation) pCpsLocation->setValue((uint8_t)CYCLING_SENSOR_LOCATION);
+    }
+
+    if (pCscService) {
+        ts_log_printf("  Configuring Cycling Speed and Cadence Service (0x1816)...");
+        pCscMeasurementCharacteristic_Peripheral = pCscService->createCharacteristic(
+                                                    NimBLEUUID((uint16_t)CSC_MEASUREMENT_UUID_SHORT), NIMBLE_PROPERTY::NOTIFY);
+        if (pCscMeasurementCharacteristic_Peripheral) {
+            pCscMeasurementCharacteristic_Peripheral->setCallbacks(&myCscCallbacks_instance_local);
+            ts_log_printf("    CSC Measurement (0x2A5B) created.");
+        } else {ts_log_error("    FAILED to create CSC Measurement (0x2A5B).");}
+
+        NimBLECharacteristic* pCscFeature = pCscService->createCharacteristic(NimBLEUUID((uint16_t)CSC_FEATURE_UUID_SHORT), NIMBLE_PROPERTY::READ);
+        if (pCscFeature) pCscFeature->setValue((uint16_t)(CSC_FEATURE_WHEEL_REVOLUTIONS | CSC_FEATURE_CRANK_REVOLUTIONS));
+        NimBLECharacteristic* pCscLocation = pCscService->createCharacteristic(NimBLEUUID((uint16_t)SENSOR_LOCATION_UUID_SHORT), NIMBLE_PROPERTY::READ);
+        if (pCscLocation) pCscLocation->setValue((uint8_t)CYCLING_SENSOR_LOCATION);
+    }
+
+    if (pMetricsService) {
+        ts_log_printf("  Configuring Diagnostics Service (%s)...", METRICS_SERVICE_UUID_STR);
+        static uint8_t emptyRecord[METRICS_HISTOGRAMS_LENGTH]; // Sizes each value once, at its largest
+        NimBLECharacteristic* pCounters = pMetricsService->createCharacteristic(
+            NimBLEUUID(METRICS_COUNTERS_UUID_STR), NIMBLE_PROPERTY::READ, METRICS_COUNTERS_LENGTH);
+        if (pCounters) {
+            pCounters->setValue(emptyRecord, METRICS_COUNTERS_LENGTH);
+            pCounters->setCallbacks(&myMetricsCountersCallbacks_instance_local);
+        } else {ts_log_error("    FAILED to create Metrics Counters.");}
+        NimBLECharacteristic* pHistograms = pMetricsService->createCharacteristic(
+            NimBLEUUID(METRICS_HISTOGRAMS_UUID_STR), NIMBLE_PROPERTY::READ, METRICS_HISTOGRAMS_LENGTH);
+        if (pHistograms) {
+            pHistograms->setValue(emptyRecord, METRICS_HISTOGRAMS_LENGTH);
+            pHistograms->setCallbacks(&myMetricsHistogramsCallbacks_instance_local);
+        } else {ts_log_error("    FAILED to create Metrics Histograms.");}
+    }
 
     if (pFTMSService_Peripheral) pFTMSService_Peripheral->start();
     if (pDISService) pDISService->start();
     if (pGenericAccessService) pGenericAccessService->start();
     if (pGattService) pGattService->start();
+    if (pCyclingPowerService) pCyclingPowerService->start();
+    if (pCscService) pCscService->start();
+    if (pMetricsService) pMetricsService->start();
     vTaskDelay(pdMS_TO_TICKS(100)); 
 
     NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
     if (!pAdvertising) { 
-        ts_log_printf("FATAL: Failed to get advertising object in blePeripheralSetupTask_func");
-        vTaskDelete(NULL); return;
+        ts_log_error("FATAL: Failed to get advertising object in blePeripheralSetupTask_func");
+        systemTaskExit(); return;
      }
     if(pAdvertising->isAdvertising()) pAdvertising->stop(); 
 
     NimBLEAdvertisementData advertisementData;
     advertisementData.setFlags(0x06); 
-    advertisementData.setCompleteServices(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT)); 
+    // One 16-bit list: watches filter on 0x1818 / 0x1816 in the advertisement itself (31 bytes total with the name).
+    std::vector<NimBLEUUID> advertisedServices;
+    advertisedServices.push_back(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    if (CYCLING_SERVICES_ENABLED) {
+        advertisedServices.push_back(NimBLEUUID((uint16_t)CPS_SERVICE_UUID_SHORT));
+        advertisedServices.push_back(NimBLEUUID((uint16_t)CSC_SERVICE_UUID_SHORT));
+    }
+    advertisementData.setCompleteServices16(advertisedServices);
     
     uint16_t appearanceValueForAdv = 0x0741; // Indoor Bike
     advertisementData.setAppearance(appearanceValueForAdv);
@@ -573,15 +596,16 @@ void blePeripheralSetupTask_func(void *pvParameters) {
     NimBLEAdvertisementData scanResponseData; 
     pAdvertising->setScanResponseData(scanResponseData);
     
-    pAdvertising->setMinPreferred(0x06);  
-    pAdvertising->setMaxPreferred(0x12);
+    // Preferred parameters for a new app (riding profile); the link manager adjusts them once connected.
+    pAdvertising->setMinPreferred(LINK_RIDE_APP_INTERVAL);
+    pAdvertising->setMaxPreferred(LINK_RIDE_APP_INTERVAL_MAX);
 
     if (pAdvertising->start()) {
         ts_log_printf("[BLE Peripheral Task] BLE Advertising started as '%s'. Appearance: 0x%04X", globalDeviceName.c_str(), appearanceValueForAdv);
     } else {
-        ts_log_printf("[BLE Peripheral Task] FAILED to start BLE Advertising.");
+        ts_log_error("[BLE Peripheral Task] FAILED to start BLE Advertising.");
     }
 
-    ts_log_printf("[BLE Peripheral Task] Peripheral setup complete. Task idling.");
-    while(1) { vTaskDelay(pdMS_TO_TICKS(10000)); } 
+    ts_log_printf("[BLE Peripheral Task] Peripheral setup complete.");
+    systemTaskExit(); // One-shot: its stack goes back to the heap
 }
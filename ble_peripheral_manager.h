@@ -4,12 +4,10 @@
 #include <NimBLEDevice.h>
 #include "config.h"
 #include "logger.h"
+#include "telemetry.h"
 #include <string>
 
 // --- External Global Data Variables (defined in .ino, read by this module) ---
-extern uint16_t currentSpeed;
-extern uint16_t currentCadence;
-extern uint16_t currentPower;
 extern std::string globalDeviceName;
 
 // --- NEW: External Global Data Variables for Target Values (defined in .ino, written by this module) ---
@@ -35,8 +33,11 @@ extern NimBLECharacteristic* pSupportedHeartRateRangeCharacteristic_Peripheral;
 
 // GATT Service Characteristics
 extern NimBLECharacteristic* pServiceChangedCharacteristic_Peripheral;
+// Cycling Power (0x1818) and CSC (0x1816) Measurements (CYCLING_SERVICES_ENABLED)
+extern NimBLECharacteristic* pCyclingPowerMeasurementCharacteristic_Peripheral;
+extern NimBLECharacteristic* pCscMeasurementCharacteristic_Peripheral;
 
-extern volatile bool mywhooshConnected;
+extern volatile bool mywhooshConnected; // At least one app session is open (app_sessions.h)
 extern TaskHandle_t blePeripheralTaskHandle;
 
 // --- Callback Class Declarations ---
@@ -44,6 +45,7 @@ class MyWhooshNimBLEServerCallbacks : public NimBLEServerCallbacks {
 public:
     void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) override;
     void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) override;
+    void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) override;
 };
 
 class MyWhooshNimBLEControlPointCallbacks : public NimBLECharacteristicCallbacks {
@@ -54,6 +56,7 @@ public:
 class IndoorBikeDataCallbacks : public NimBLECharacteristicCallbacks {
 public:
     void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) override;
+    void onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) override; // Result of each notify()
 };
 
 class TrainingStatusCallbacks : public NimBLECharacteristicCallbacks {
@@ -77,12 +80,32 @@ public:
     void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) override;
 };
 
+// Cycling Power Measurement (0x2A63) and CSC Measurement (0x2A5B): one instance per characteristic.
+class CyclingMeasurementCallbacks : public NimBLECharacteristicCallbacks {
+public:
+    CyclingMeasurementCallbacks(uint8_t subscription, const char* name) : subscription(subscription), name(name) {}
+    void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) override;
+private:
+    uint8_t subscription; // APP_SUB_*
+    const char* name;
+};
+
+// Diagnostics service (metrics.h): each read encodes the registry's current record.
+class MetricsCallbacks : public NimBLECharacteristicCallbacks {
+public:
+    explicit MetricsCallbacks(size_t (*encode)(uint8_t* out)) : encode(encode) {}
+    void onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) override;
+private:
+    size_t (*encode)(uint8_t* out);
+};
 
 // --- Function Declarations ---
 void blePeripheralSetupTask_func(void *pvParameters);
-void sendDataToMyWhoosh();
+bool sendDataToMyWhoosh(const TelemetryFrame& frame); // Returns true if a 0x2ACC notify was issued
+bool sendCyclingMeasurements(const TelemetryFrame& frame); // 0x2A63 / 0x2A5B; true if any notify was issued
 void sendTrainingStatusUpdate(uint8_t status_code, bool force_notify = false);
 void sendFitnessMachineStatusUpdate(uint8_t status_code, bool force_notify = false);
+void sendFitnessMachineStatus(const uint8_t* status, size_t length);
 void indicateServiceChanged();
 
 // ADDED: Function to send raw FTMS Feature data
@@ -5,17 +5,250 @@
 const int PAIR_BUTTON_PIN = 14; // GPIO pin for the pairing button (ensure this is correct for your ESP32 board)
 
 // --- Bike Sensor (Central Role - ESP32 connects to Bike) ---
-#define BIKE_MAC_ADDRESS "24:00:0C:A0:4B:4B" // YOUR BIKE'S ACTUAL MAC ADDRESS
+#define BIKE_MAC_ADDRESS "24:00:0C:A0:4B:4B" // YOUR BIKE'S ACTUAL MAC ADDRESS ("" = first bike a driver recognizes)
 
 // Service and Characteristic UUIDs for the BIKE (if it uses standard FTMS or known custom ones)
 #define BIKE_FTMS_SERVICE_UUID_STR "00001826-0000-1000-8000-00805f9b34fb" // Standard FTMS
 #define BIKE_FTMS_INDOOR_BIKE_DATA_CHAR_UUID_STR "00002ACC-0000-1000-8000-00805f9b34fb"
 #define BIKE_FTMS_FEATURE_CHAR_UUID_STR "00002AD2-0000-1000-8000-00805f9b34fb"
 #define BIKE_FTMS_CONTROL_POINT_CHAR_UUID_STR "00002AD9-0000-1000-8000-00805f9b34fb"
+#define BIKE_FTMS_RESISTANCE_RANGE_CHAR_UUID_STR "00002AD6-0000-1000-8000-00805f9b34fb"
 
 // Custom service and characteristic for Merach bike data (primary data source)
 #define CUSTOM_SERVICE_UUID_STR "0000fff0-0000-1000-8000-00805f9b34fb"
 #define CUSTOM_DATA_CHAR_UUID_STR "0000fff1-0000-1000-8000-00805f9b34fb"
+#define CUSTOM_SERVICE_UUID_SHORT 0xFFF0
+
+// --- Bike Protocol Drivers (bike_driver.cpp) ---
+// The driver is picked from the bike's advertisement (name prefix, service, manufacturer ID).
+// A bike found by BIKE_MAC_ADDRESS that no driver recognizes uses the Merach driver.
+#define MERACH_NAME_PREFIX               "MRK-" // Merach bikes advertise as MRK-<model>-<serial>
+#define BIKE_INDOOR_BIKE_DATA_UUID_SHORT 0x2AD2 // Standard FTMS bikes, as the FTMS spec assigns them
+#define BIKE_MACHINE_FEATURE_UUID_SHORT  0x2ACC
+#define BIKE_FTMS_DEFAULT_RESISTANCE_MIN 10     // Until the bike's 0x2AD6 is read (0.1 units, as in our own 0x2AD6)
+#define BIKE_FTMS_DEFAULT_RESISTANCE_MAX 80
+
+// --- Bike Link (bike_link.cpp) ---
+// The last bike connected is kept in NVS and reconnected by address, without a scan.
+#define BIKE_LINK_AUTO_RECONNECT   1          // 0 = reconnect only with the button
+#define BIKE_LINK_RETRY_MIN_MS     250        // Backoff after the first failed attempt; doubles per failure
+#define BIKE_LINK_RETRY_MAX_MS     8000
+#define BIKE_LINK_CONNECT_TIMEOUT_S 3         // Per automatic attempt (the button's attempt waits 10 s)
+#define BIKE_LINK_POLL_MS          50         // Task wake-up period while waiting for a retry
+
+// --- Known Bikes and Bike Scans (bike_registry.cpp) ---
+// Registered bikes sit on the controller white list: background scans only report them.
+#define BIKE_REGISTRY_MAX            4          // Oldest is dropped when a new bike is connected
+#define BIKE_REGISTRY_FRESH_MS       10000      // A bike heard this recently is reconnected before the last one used
+#define BIKE_REGISTRY_NVS_NAMESPACE  "bikelink"
+#define BIKE_SCAN_IDLE_INTERVAL_MS   1280       // Background scan while reconnecting: 48 of every 1280 ms (~4%)
+#define BIKE_SCAN_IDLE_WINDOW_MS     48
+#define BIKE_SCAN_IDLE_MIN_WAIT_MS   1000       // Shorter backoff waits just retry, without a scan
+#define BIKE_SCAN_PAIRING_SECONDS    30         // Button scan for a new bike (full duty); 0 = until found
+
+
+// --- Bike -> App Forwarding (ftms_forwarder.cpp) ---
+#define FORWARDER_MIN_INTERVAL_MS   0     // Max-rate cap between 0x2ACC notifies (0 = forward every bike sample)
+#define FORWARDER_HEARTBEAT_MS      1000  // Re-send the last frame when the bike has been quiet this long
+#define FORWARDER_STATS_INTERVAL_MS 10000 // How often the bike->app latency summary is logged
+
+// --- Indoor Bike Data (0x2ACC) Field Set (ftms_encoder.h) ---
+// Records longer than the app's MTU - 3 are sent as "More Data" fragments, which not every app
+// reassembles. This set is 20 bytes and fits the default MTU of 23; adding FTMS_IBD_AVG_SPEED /
+// _AVG_CADENCE / _AVG_POWER (2 bytes each, FTMS_IBD_AVERAGE_FILTER) makes every record two fragments.
+#define FTMS_IBD_FIELD_MASK (FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED) | FTMS_IBD_FIELD(FTMS_IBD_INST_CADENCE) | \
+                             FTMS_IBD_FIELD(FTMS_IBD_TOTAL_DISTANCE) | FTMS_IBD_FIELD(FTMS_IBD_RESISTANCE) | \
+                             FTMS_IBD_FIELD(FTMS_IBD_INST_POWER) | FTMS_IBD_FIELD(FTMS_IBD_EXPENDED_ENERGY) | \
+                             FTMS_IBD_FIELD(FTMS_IBD_ELAPSED_TIME))
+
+// --- FTMS Control Point (ftms_control_point.cpp) ---
+#define CONTROL_POINT_QUEUE_DEPTH         8     // Responses waiting for the Control Point task; overflow is dropped and logged
+#define CONTROL_POINT_WHEEL_CIRCUMFERENCE 21050 // Until the app sets one (0.1 mm; 700x25c)
+
+// --- App Connections (app_sessions.cpp) ---
+// NimBLE-Arduino allows CONFIG_BT_NIMBLE_MAX_CONNECTIONS (3) links in total; the bike and the sensors below use the others.
+#define APP_SESSION_MAX              2 // Apps (or watches) connected at once; advertising continues while a slot is free
+#define APP_SESSION_IMPLICIT_CONTROL 1 // 1 = a target write without Request Control takes control if nobody holds it
+
+// --- Connection Parameters (link_manager.cpp) ---
+// Intervals in 1.25 ms units, all multiples of 15 ms so the links' connection events share one grid on
+// the radio. Short intervals while pedalling, shortest in ERG, long with latency when idle. App ranges
+// follow Apple's rules: min >= 15 ms, max >= min + 15 ms (or both 15 ms), max x (latency + 1) <= 2 s,
+// timeout 2-6 s.
+#define LINK_MANAGER_ENABLED     1
+#define LINK_MANAGER_PERIOD_MS   1000  // Activity check, stats refresh and parameter requests
+#define LINK_IDLE_AFTER_MS       30000 // No cadence or speed this long: idle profile
+#define LINK_UPDATE_MIN_MS       5000  // Between two requests on one link; a refused range is not asked again
+#define LINK_ERG_BIKE_INTERVAL   12    // 15 ms (up to 30 ms to match the apps)
+#define LINK_ERG_APP_INTERVAL    12    // 15 ms
+#define LINK_ERG_APP_INTERVAL_MAX 12
+#define LINK_RIDE_BIKE_INTERVAL  24    // 30 ms (up to 60 ms)
+#define LINK_RIDE_APP_INTERVAL   24    // 30-45 ms
+#define LINK_RIDE_APP_INTERVAL_MAX 36
+#define LINK_IDLE_BIKE_INTERVAL  48    // 60 ms (up to 120 ms)
+#define LINK_IDLE_APP_INTERVAL   48    // 60-75 ms
+#define LINK_IDLE_APP_INTERVAL_MAX 60
+#define LINK_IDLE_LATENCY        4     // Idle: the peripheral may skip this many events
+#define LINK_SENSOR_INTERVAL     48    // HR strap / power meter (1 Hz data): same grid, never renegotiated
+#define LINK_SUPERVISION_TIMEOUT 400   // 4 s (10 ms units)
+#define LINK_LATE_SAMPLE_FACTOR  2     // A bike sample this many usual gaps after the last counts as late
+
+// --- External Sensors (sensor_links.cpp) ---
+// Heart-rate strap (0x180D) and power meter (0x1818), each on its own NimBLE client with its own retry
+// backoff. Raise CONFIG_BT_NIMBLE_MAX_CONNECTIONS (nimconfig.h) to cover the bike, the apps and every sensor.
+#define SENSOR_HR_ENABLED         1
+#define SENSOR_POWER_ENABLED      0     // Optional power meter
+#define SENSOR_HR_ADDRESS         ""    // "" = first strap found advertising 0x180D; otherwise only this MAC
+#define SENSOR_POWER_ADDRESS      ""    // "" = first meter found advertising 0x1818
+#define SENSOR_PREFER_METER_POWER 1     // 1 = meter power over the bike's estimate; 0 = meter only while the bike reports 0 W
+#define SENSOR_MAX_AGE_MS         2500  // Sensor samples older than this (at the bike frame's time) are not merged
+#define SENSOR_SCAN_SECONDS       3     // Discovery scan, only while the bike is not scanning or connecting
+#define SENSOR_CONNECT_TIMEOUT_S  5
+#define SENSOR_RETRY_MIN_MS       2000  // Wait after a failed scan/connect or a drop; doubles per failure
+#define SENSOR_RETRY_MAX_MS       60000
+#define SENSOR_FORGET_AFTER       5     // Failed connects before a discovered sensor is forgotten and searched for again
+#define SENSOR_TASK_PERIOD_MS     500
+
+// --- Ride Filter (ride_filter.cpp) ---
+// Averages and an EMA of speed, cadence and power, computed once per published frame. Each consumer
+// picks one: TELEMETRY_FILTER_SHORT / _LONG / _SESSION / _EMA, or TELEMETRY_FILTER_RAW (telemetry.h).
+#define RIDE_FILTER_SHORT_MS      3000
+#define RIDE_FILTER_LONG_MS       10000
+#define RIDE_FILTER_EMA_TAU_MS    1000  // EMA time constant
+#define RIDE_FILTER_MAX_GAP_MS    2500  // A longer gap between frames is a pause: not averaged, EMA restarts
+#define RIDE_FILTER_RING          128   // Frames kept (power of 2); above 12.8 frames/s the long window gets shorter
+#define DISPLAY_FILTER            TELEMETRY_FILTER_SHORT   // Speed, cadence and power on screen
+#define ERG_POWER_FILTER          TELEMETRY_FILTER_EMA     // Power fed back to the ERG controller
+#define FTMS_IBD_AVERAGE_FILTER   TELEMETRY_FILTER_SESSION // 0x2ACC Average Speed / Cadence / Power, if in FTMS_IBD_FIELD_MASK
+
+// --- Ride Session (ride_session.cpp) ---
+// Distance, energy and elapsed / moving time for 0x2ACC and the display, kept across bike reconnects.
+#define RIDE_SESSION_MAX_GAP_MS     2500   // A longer gap between frames (link down) is not integrated
+#define RIDE_SESSION_TIMEOUT_MS     600000 // No movement for this long ends the session; the next ride starts a new one
+#define RIDE_SESSION_EFFICIENCY_PCT 24     // Gross efficiency: expended energy = mechanical work / efficiency
+
+// --- Cycling Power / CSC Services (cycling_encoder.cpp) ---
+// Served next to FTMS for watches and head units, from the same frames as Indoor Bike Data.
+#define CYCLING_SERVICES_ENABLED  1
+#define CYCLING_SENSOR_LOCATION   12    // Sensor Location (0x2A5D): 12 = rear hub
+#define CYCLING_MAX_GAP_MS        2000  // Longest frame gap integrated into the synthesized revolutions
+
+// --- ERG Mode (erg_controller.cpp) ---
+// Drives the resistance level toward the app's Set Target Power. Tune with host/sim_erg.
+#define ERG_CONTROL_PERIOD_MS   250   // Fixed control rate
+#define ERG_KP                  0.005f // Levels per W of power error
+#define ERG_KI                  0.005f // Levels per W·s of accumulated error
+#define ERG_FEED_FORWARD_GAIN   1.0f  // Weight of the bike-model level (reacts to cadence changes immediately)
+#define ERG_TORQUE_BASE_NM      2.3f  // Bike model: crank torque = base + per-level * level (estimated for the S26)
+#define ERG_TORQUE_PER_LEVEL_NM 4.0f
+#define ERG_LEVEL_MIN           1.0f
+#define ERG_LEVEL_MAX           8.0f
+#define ERG_LEVEL_STEP          1.0f  // Settable resolution (whole levels today; finer with a motor)
+#define ERG_LEVEL_HYSTERESIS    0.15f // Levels past a step boundary before the level changes
+#define ERG_DEADBAND_W          5.0f  // Power error not integrated
+#define ERG_MIN_CADENCE_RPM     20.0f // Below this the controller holds its level and integrator
+
+// --- SIM Mode (sim_physics.cpp) ---
+// Road load from Control Point 0x11 (or 0x03 inclination with the defaults below) -> resistance level.
+#define SIM_RIDER_MASS_KG         75
+#define SIM_BIKE_MASS_KG          10
+#define SIM_DEFAULT_CRR           40  // 0.0040, for 0x03 inclination mode (0.0001 units)
+#define SIM_DEFAULT_CW            51  // 0.51 kg/m, for 0x03 inclination mode (0.01 kg/m units)
+#define SIM_GRADE_SCALE_PERCENT   100 // "Trainer difficulty": share of the app's grade that is applied
+#define SIM_LEVEL_HYSTERESIS_X100 15  // Hundredths of a level past the rounding point before the level changes
+
+// --- Resistance Knob Motor (stepper_motion.cpp) ---
+// NEMA 17 + A4988/DRV8825 turning the resistance knob. Step pulses come from a hardware timer ISR.
+#define STEPPER_ENABLED            0       // 1 = driver fitted: home at boot and follow the target level
+#define STEPPER_STEP_PIN           43      // Grove header (free while USB CDC is the serial console)
+#define STEPPER_DIR_PIN            44
+#define STEPPER_ENABLE_PIN         -1      // Driver EN (active low); -1 = tied low on the board
+#define STEPPER_HOME_PIN           -1      // Switch at the minimum-resistance stop (active low); -1 = home against the stop
+#define STEPPER_TIMER              0       // Hardware timer used for step pulses
+#define STEPPER_PULSE_US           4       // STEP high time (A4988 >= 1 us, DRV8825 >= 1.9 us)
+#define STEPPER_MAX_SPEED_SPS      1600.0f // Steps/s (1/8 microstepping: one knob turn per second)
+#define STEPPER_ACCEL_SPS2         4000.0f // Steps/s^2
+#define STEPPER_HOMING_SPEED_SPS   400.0f  // Constant speed toward the stop; slow enough to stall safely
+#define STEPPER_TRAVEL_STEPS       11200   // Knob travel from home to the maximum-resistance stop
+#define STEPPER_HOMING_MAX_STEPS   12800   // Full knob travel plus margin
+#define STEPPER_HOME_ON_BOOT       1
+#define STEPPER_STEPS_AT_LEVEL_MIN 800     // Knob position of ERG_LEVEL_MIN, in steps from home (until calibrated)
+#define STEPPER_STEPS_PER_LEVEL    1200
+#define STEPPER_QUEUE_DEPTH        8       // Commands waiting for the motion task; overflow is dropped and counted
+
+// --- Resistance Calibration (resistance_calibration.cpp) ---
+// Knob position of each apparent bike level (from a sweep, 'k' on the console) and each level's power
+// vs cadence line (learned while riding). Stored in NVS; replaces the STEPPER_STEPS_* and ERG_TORQUE_* models.
+#define CALIBRATION_LEVEL_COUNT             8       // Apparent levels 1..N reported by the bike
+#define CALIBRATION_SWEEP_STEP              200     // Knob steps between sweep readings
+#define CALIBRATION_SETTLE_MS               1500    // Wait after a knob move / level change before trusting the bike's data
+#define CALIBRATION_MOVE_TIMEOUT_MS         20000   // A knob move that takes longer aborts the sweep
+#define CALIBRATION_LEARN_WINDOW            2000.0f // Samples: older power/cadence samples fade out over about this many
+#define CALIBRATION_MIN_SAMPLES             300.0f  // Samples of a level before its power curve is used
+#define CALIBRATION_MIN_CADENCE_RPM         30.0f   // Slower pedalling is not learned
+#define CALIBRATION_MIN_CADENCE_SPREAD_RPM  5.0f    // Less cadence variation fits the curve through the origin
+#define CALIBRATION_REFERENCE_RPM           80.0f   // Cadence at which learned curves become the ERG torque model
+#define CALIBRATION_SAVE_INTERVAL_MS        600000  // Learned curves are written to NVS at most this often
+#define CALIBRATION_NVS_NAMESPACE           "calib"
+
+// --- Raw Bike Notification Capture (bike_capture.cpp) ---
+#define CAPTURE_ENABLED      1            // Record every raw 0xFFF1 / 0x2AD2 notification from boot
+#define CAPTURE_BUFFER_BYTES (256 * 1024) // Ring size; allocated in PSRAM when available, oldest records overwritten
+
+// --- Display (display_manager.cpp) ---
+#define DISPLAY_STATS_INTERVAL_MS 60000 // How often frame time / SPI pixel counts are logged (0 = never)
+
+// --- Logging (logger.cpp) ---
+#define LOG_RING_SLOTS     64             // Lines queued for the drain task (power of two); overflow is dropped and counted
+#define LOG_LINE_MAX       192            // Message bytes kept per line; longer messages are truncated
+#define LOG_DRAIN_IDLE_MS  100            // Drain task wake-up period when nothing signals it
+#define LOG_DEFAULT_LEVEL  LOG_LEVEL_INFO // Boot level for every module (LOG_LEVEL_* in logger.h)
+#define LOG_PANIC_FLUSH    0              // 1 = write and flush every line synchronously, for crash debugging
+#define LOG_TOKENIZED      0              // 1 = TS_LOG_TOKEN lines are sent as binary frames (decode with tools/log_decode.py)
+
+// --- Metrics (metrics.cpp) ---
+// Always-on data-path counters and latency histograms, read with 'm' on the console or from the vendor
+// diagnostics service. Histogram bucket 0 counts zeros, bucket i values in [2^(i-1), 2^i); the last
+// bucket takes everything above.
+#define METRICS_GATT_ENABLED        1
+#define METRICS_SERVICE_UUID_STR    "7a1e0001-3c5f-4d8a-9b2e-5f0c6d1e8a40" // Vendor diagnostics service
+#define METRICS_COUNTERS_UUID_STR   "7a1e0002-3c5f-4d8a-9b2e-5f0c6d1e8a40" // READ: counters (metrics.h)
+#define METRICS_HISTOGRAMS_UUID_STR "7a1e0003-3c5f-4d8a-9b2e-5f0c6d1e8a40" // READ: histograms (metrics.h)
+#define METRICS_HISTOGRAM_BUCKETS   16
+#define METRICS_LOG_INTERVAL_MS     0  // How often the metrics are logged (0 = only on the console command)
+
+// --- Task Layout (system_tasks.cpp) ---
+// Core 0 runs the NimBLE host and the bike -> app data path next to it. Control, I/O and the UI
+// (loop(): display, button, console) run on core 1. Core, priority and stack of every task are in
+// the layout table in system_tasks.cpp.
+#define TASK_CORE_DATA            0   // CONFIG_BT_NIMBLE_PINNED_TO_CORE on the ESP32 Arduino core
+#define TASK_CORE_APP             1   // ARDUINO_RUNNING_CORE: setup() and loop()
+#define UI_EVENT_QUEUE_DEPTH      8   // Link / control changes waiting for loop(); overflow is dropped and counted
+#define BIKE_COMMAND_QUEUE_DEPTH  2   // Button requests waiting for the bike connect task
+#define SYSTEM_TASKS_STATS_MAX    32  // Tasks sampled for CPU and stack stats (NimBLE, IDLE, timers included)
+#define SYSTEM_TASKS_STATS_INTERVAL_MS 0 // How often the task table is logged (0 = only on the console command)
+
+// --- Heap Monitor (heap_monitor.cpp) ---
+// Once the bike and an app are connected (steady state), the data path should not touch the heap.
+// Internal heap free / minimum free / largest block and every operator new call site seen in steady
+// state are reported on the console; call sites are code addresses (xtensa-esp32s3-elf-addr2line -e <elf>).
+#define HEAP_MONITOR_TRACE_NEW       1   // 1 = count operator new / delete and record steady-state call sites
+#define HEAP_MONITOR_SITES           16  // Distinct call sites recorded; later ones are counted as "other"
+#define HEAP_MONITOR_LOG_INTERVAL_MS 0   // How often heap stats are logged (0 = only on the console command)
+
+// --- Serial Console Commands (one character, handled in loop()) ---
+#define SERIAL_CMD_CAPTURE_DUMP  'c' // Dump the capture ring as CAP: hex lines (replay with host/replay_capture)
+#define SERIAL_CMD_CAPTURE_CLEAR 'x' // Discard captured records
+#define SERIAL_CMD_LOG_VERBOSE   'v' // Toggle DEBUG logging for every module
+#define SERIAL_CMD_LOG_PANIC     'p' // Toggle synchronous (panic) logging
+#define SERIAL_CMD_LOG_TOKENIZED 't' // Toggle tokenized (binary) logging for TS_LOG_TOKEN lines
+#define SERIAL_CMD_CALIBRATE     'k' // Sweep the knob motor and store the level -> position map
+#define SERIAL_CMD_BIKE_LINK     'b' // Log reconnect / time-to-first-sample stats
+#define SERIAL_CMD_BIKE_FORGET   'f' // Forget the known bike (the button scans again)
+#define SERIAL_CMD_LINKS         'l' // Log connection parameters, RSSI, late events and notify buffers per link
+#define SERIAL_CMD_TASKS         'q' // Log per-task core, CPU share and stack high-water marks
+#define SERIAL_CMD_HEAP          'h' // Log heap free / min free / fragmentation and steady-state allocations
+#define SERIAL_CMD_METRICS       'm' // Log data-path counters and latency histograms
 
 
 // --- ESP32 Peripheral Role (Advertised Services & Characteristics to MyWhoosh) ---
@@ -27,6 +260,8 @@ const int PAIR_BUTTON_PIN = 14; // GPIO pin for the pairing button (ensure this
 #define GENERIC_ATTRIBUTE_UUID_SHORT         0x1801
 #define DEVICE_INFORMATION_SERVICE_UUID_SHORT 0x180A
 #define FTMS_SERVICE_UUID_SHORT              0x1826 // Fitness Machine Service
+#define CPS_SERVICE_UUID_SHORT               0x1818 // Cycling Power (watches, head units)
+#define CSC_SERVICE_UUID_SHORT               0x1816 // Cycling Speed and Cadence
 
 // Standard BLE Characteristic UUIDs (16-bit)
 // GAS Characteristics
@@ -34,6 +269,7 @@ const int PAIR_BUTTON_PIN = 14; // GPIO pin for the pairing button (ensure this
 #define APPEARANCE_UUID_SHORT                0x2A01
 // GATT Characteristics
 #define SERVICE_CHANGED_UUID_SHORT           0x2A05
+#define DATABASE_HASH_UUID_SHORT             0x2B2A // Read from the bike: its attributes changed when this did
 // DIS Characteristics
 #define MANUFACTURER_NAME_UUID_SHORT         0x2A29
 #define MODEL_NUMBER_UUID_SHORT              0x2A24
@@ -52,6 +288,12 @@ const int PAIR_BUTTON_PIN = 14; // GPIO pin for the pairing button (ensure this
 #define FTMS_SUPPORTED_POWER_RANGE_UUID_SHORT 0x2AD8
 #define FTMS_CONTROL_POINT_UUID_SHORT        0x2AD9
 #define FTMS_STATUS_UUID_SHORT               0x2ADA
+// Cycling Power / CSC Characteristics
+#define CPS_MEASUREMENT_UUID_SHORT           0x2A63
+#define CPS_FEATURE_UUID_SHORT               0x2A65
+#define CSC_MEASUREMENT_UUID_SHORT           0x2A5B
+#define CSC_FEATURE_UUID_SHORT               0x2A5C
+#define SENSOR_LOCATION_UUID_SHORT           0x2A5D
 
 
 // Descriptor UUIDs
@@ -0,0 +1,62 @@
+#include "cycling_encoder.h"
+#include <string.h>
+
+void cyclingStateReset(CyclingMeasurementState& state) {
+    memset(&state, 0, sizeof(state));
+}
+
+// rateQ16: revolutions per second in Q16.
+static void advanceCounter(RevolutionCounter& counter, uint64_t rateQ16, int64_t dtUs, int64_t nowUs) {
+    if (rateQ16 == 0) return; // Stopped: the count and the event time hold, as on a real sensor
+    uint64_t fraction = counter.fractionQ16 + rateQ16 * (uint64_t)dtUs / 1000000;
+    uint32_t whole = (uint32_t)(fraction >> 16);
+    counter.fractionQ16 = (uint32_t)(fraction & 0xFFFF);
+    if (whole == 0) return;
+    counter.revolutions += whole;
+    // Back-date the event to the moment the last revolution was completed.
+    counter.lastEventUs = nowUs - (int64_t)((uint64_t)counter.fractionQ16 * 1000000 / rateQ16);
+}
+
+static uint8_t* putU16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t* putU32(uint8_t* p, uint32_t value) {
+    return putU16(putU16(p, (uint16_t)value), (uint16_t)(value >> 16));
+}
+
+void cyclingEncodeMeasurements(CyclingMeasurementState& state, const TelemetryFrame& frame,
+                               uint16_t wheelCircumference, CyclingMeasurements& out) {
+    int64_t nowUs = frame.timestampUs;
+    if (state.lastFrameUs != 0 && nowUs > state.lastFrameUs) {
+        int64_t dtUs = nowUs - state.lastFrameUs;
+        if (dtUs > (int64_t)CYCLING_MAX_GAP_MS * 1000) dtUs = (int64_t)CYCLING_MAX_GAP_MS * 1000; // Bike went quiet
+        // Cadence is in 0.5 RPM: rev/s = cadence / 120. Speed is in 0.01 km/h and the circumference
+        // in 0.1 mm: rev/s = speed * 10000 / (360 * circumference).
+        advanceCounter(state.crank, ((uint64_t)frame.cadence << 16) / 120, dtUs, nowUs);
+        if (wheelCircumference > 0) {
+            advanceCounter(state.wheel, ((uint64_t)frame.speed * 10000 << 16) / (360ull * wheelCircumference), dtUs, nowUs);
+        }
+    }
+    if (nowUs > state.lastFrameUs) state.lastFrameUs = nowUs;
+
+    uint16_t crankRevolutions = (uint16_t)state.crank.revolutions;
+    uint16_t crankEventTime = cyclingEventTime(state.crank.lastEventUs, 1024);
+
+    // Cycling Power Measurement (0x2A63)
+    uint8_t* p = putU16(out.cps, CPS_FLAG_WHEEL_REVOLUTIONS | CPS_FLAG_CRANK_REVOLUTIONS);
+    p = putU16(p, (uint16_t)(int16_t)frame.power);
+    p = putU32(p, state.wheel.revolutions);
+    p = putU16(p, cyclingEventTime(state.wheel.lastEventUs, 2048));
+    p = putU16(p, crankRevolutions);
+    putU16(p, crankEventTime);
+
+    // CSC Measurement (0x2A5B)
+    out.csc[0] = CSC_FLAG_WHEEL_REVOLUTIONS | CSC_FLAG_CRANK_REVOLUTIONS;
+    p = putU32(out.csc + 1, state.wheel.revolutions);
+    p = putU16(p, cyclingEventTime(state.wheel.lastEventUs, 1024));
+    p = putU16(p, crankRevolutions);
+    putU16(p, crankEventTime);
+}
@@ -0,0 +1,54 @@
+#ifndef CYCLING_ENCODER_H
+#define CYCLING_ENCODER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "config.h"
+#include "telemetry.h"
+
+// --- Cycling Power (0x1818) and Cycling Speed and Cadence (0x1816) Measurements ---
+// The bike only reports instantaneous speed and cadence; watches and head units want cumulative
+// revolutions with the time of the last revolution. Both are synthesized here from the telemetry frames.
+#define CPS_FLAG_WHEEL_REVOLUTIONS 0x0010
+#define CPS_FLAG_CRANK_REVOLUTIONS 0x0020
+#define CPS_FEATURE_WHEEL_REVOLUTIONS 0x00000004
+#define CPS_FEATURE_CRANK_REVOLUTIONS 0x00000008
+#define CSC_FLAG_WHEEL_REVOLUTIONS 0x01
+#define CSC_FLAG_CRANK_REVOLUTIONS 0x02
+#define CSC_FEATURE_WHEEL_REVOLUTIONS 0x0001
+#define CSC_FEATURE_CRANK_REVOLUTIONS 0x0002
+
+#define CPS_MEASUREMENT_LENGTH 14 // Flags, power, wheel (uint32 + uint16), crank (uint16 + uint16)
+#define CSC_MEASUREMENT_LENGTH 11 // Flags, wheel (uint32 + uint16), crank (uint16 + uint16)
+
+// One synthesized revolution counter. Revolutions are integrated in Q16 so a slow cadence still
+// accumulates; the event time is when the last whole revolution was completed.
+struct RevolutionCounter {
+    uint32_t revolutions;
+    uint32_t fractionQ16;
+    int64_t  lastEventUs; // Monotonic time of the last whole revolution (0 = none yet)
+};
+
+struct CyclingMeasurementState {
+    int64_t lastFrameUs; // Timestamp of the last frame integrated (0 = none)
+    RevolutionCounter crank;
+    RevolutionCounter wheel;
+};
+
+struct CyclingMeasurements {
+    uint8_t cps[CPS_MEASUREMENT_LENGTH];
+    uint8_t csc[CSC_MEASUREMENT_LENGTH];
+};
+
+void cyclingStateReset(CyclingMeasurementState& state);
+// Advances the counters to frame.timestampUs (a frame already integrated adds nothing) and packs both
+// records from the same counters. wheelCircumference: 0.1 mm (FTMS Set Wheel Circumference).
+void cyclingEncodeMeasurements(CyclingMeasurementState& state, const TelemetryFrame& frame,
+                               uint16_t wheelCircumference, CyclingMeasurements& out);
+
+// Event times on the wire: 1/1024 s (crank, CSC wheel) or 1/2048 s (CPS wheel), wrapping at 16 bits.
+inline uint16_t cyclingEventTime(int64_t eventUs, uint32_t ticksPerSecond) {
+    return (uint16_t)((uint64_t)eventUs * ticksPerSecond / 1000000);
+}
+
+#endif // CYCLING_ENCODER_H
@@ -0,0 +1,239 @@
+#define LOG_MODULE LOG_MOD_DISPLAY
+#include "display_manager.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "ride_filter.h"
+#include "ride_session.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include <esp_timer.h>
+
+// --- Retained Field Model ---
+// Each row keeps the text and colour it was last rendered with; a row is redrawn only when either changes.
+enum DisplayCell {
+    CELL_BIKE_STATUS,
+    CELL_APP_STATUS,
+    CELL_BIKE_RES,
+    CELL_TARGET_RES,
+    CELL_TARGET_INC,
+    CELL_MATCH,
+    CELL_SPEED,
+    CELL_CADENCE,
+    CELL_POWER,
+    CELL_CALORIES,
+    CELL_COUNT
+};
+
+struct DisplayField {
+    const char* label;  // Static label drawn on full redraws (NULL: the value spans the whole row)
+    int16_t y;
+    int16_t x;          // Where the value starts
+    uint8_t textSize;
+    char text[24];      // Last rendered value
+    uint16_t color;
+    int16_t width;      // Pixel width of the last rendered value
+};
+
+static DisplayField displayFields[CELL_COUNT];
+static bool displayNeedsFullRedraw = true;
+static DisplayFrameStats displayStats = {0, 0, 0, 0, 0, 0, 0, 0};
+static unsigned long displayStatsLastLogMs = 0;
+
+static void setupLayout() {
+    // Same positions as the original full-frame layout.
+    int16_t xPosLabel = 5;
+    int16_t xPosValue = tft.width() * 2 / 3 - 15;
+    int16_t labelHeight = 15;
+    int16_t valueHeight = 17;
+    int16_t lineSpacing = 3;
+    static const char* const valueLabels[] = {
+        "Bike Res:", "Tgt Res:", "Tgt Inc:", "Match:", "Speed:", "Cadence:", "Power:", "Calories:"
+    };
+
+    int16_t yPos = valueHeight + 4; // Below the header
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        DisplayField& field = displayFields[cell];
+        memset(&field, 0, sizeof(field));
+        field.y = yPos;
+        if (cell == CELL_BIKE_STATUS || cell == CELL_APP_STATUS) {
+            field.label = NULL;
+            field.x = xPosLabel;
+            field.textSize = 1;
+            yPos += (cell == CELL_BIKE_STATUS) ? labelHeight + 1 : labelHeight + lineSpacing + 2;
+        } else {
+            field.label = valueLabels[cell - CELL_BIKE_RES];
+            field.x = xPosValue;
+            field.textSize = 2;
+            yPos += valueHeight + lineSpacing;
+        }
+    }
+}
+
+void initDisplay() {
+    tft.init();
+    tft.setRotation(0);
+    spr.createSprite(tft.width(), tft.height());
+    spr.fillSprite(TFT_BLACK);
+    spr.setTextColor(TFT_WHITE, TFT_BLACK);
+    spr.setTextSize(2);
+    spr.setCursor(10, 80);
+    spr.println("SMARTUP BIKE");
+    spr.pushSprite(0, 0);
+    setupLayout();
+    displayNeedsFullRedraw = true;
+    ts_log_printf("TFT Display Initialized. Sprite created (%dx%d).", spr.width(), spr.height());
+    displayInitialized = true;
+}
+
+void displayInvalidate() {
+    displayNeedsFullRedraw = true;
+}
+
+// Builds the text and colour every cell should show for this frame.
+static void computeCells(const TelemetryFrame& frame, char text[CELL_COUNT][24], uint16_t color[CELL_COUNT]) {
+    if (!pTargetBikeDevice && !bikeSensorConnected && !bikeAttemptingConnection && bikeLinkReconnecting()) {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: RECONNECT..."); color[CELL_BIKE_STATUS] = TFT_BLUE;
+    } else if (!pTargetBikeDevice && !bikeSensorConnected && !bikeAttemptingConnection) {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: SCAN (BTN)"); color[CELL_BIKE_STATUS] = TFT_ORANGE;
+    } else if (pTargetBikeDevice && !bikeSensorConnected && !bikeAttemptingConnection) {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: PAIR (BTN)"); color[CELL_BIKE_STATUS] = TFT_YELLOW;
+    } else if (bikeAttemptingConnection) {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: CONNECTING..."); color[CELL_BIKE_STATUS] = TFT_BLUE;
+    } else if (bikeSensorConnected) {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: CONNECTED"); color[CELL_BIKE_STATUS] = TFT_GREEN;
+    } else {
+        strcpy(text[CELL_BIKE_STATUS], "Bike: OFFLINE"); color[CELL_BIKE_STATUS] = TFT_RED;
+    }
+
+    bool currentMyWhooshStatus = mywhooshConnected;
+    snprintf(text[CELL_APP_STATUS], 24, "App:  %s", currentMyWhooshStatus ? "CONNECTED" : "OFFLINE");
+    color[CELL_APP_STATUS] = currentMyWhooshStatus ? TFT_GREEN : TFT_RED;
+
+    snprintf(text[CELL_BIKE_RES], 24, "%u", frame.resistanceLevel);
+    color[CELL_BIKE_RES] = TFT_WHITE;
+    snprintf(text[CELL_TARGET_RES], 24, "%u", targetResistanceLevel_App);
+    color[CELL_TARGET_RES] = TFT_GOLD;
+    snprintf(text[CELL_TARGET_INC], 24, "%.1f%%", (float)targetInclinationPercentX100 / 100.0f); // 1 decimal for space
+    color[CELL_TARGET_INC] = TFT_VIOLET;
+
+    // Resistance Match Status
+    if (mywhooshConnected && bikeSensorConnected && targetResistanceLevel_App > 0) {
+        targetResistanceMatchesBike = (frame.resistanceLevel == targetResistanceLevel_App);
+        strcpy(text[CELL_MATCH], targetResistanceMatchesBike ? "YES" : "NO");
+        color[CELL_MATCH] = targetResistanceMatchesBike ? TFT_GREEN : TFT_RED;
+    } else {
+        targetResistanceMatchesBike = false;
+        strcpy(text[CELL_MATCH], "N/A");
+        color[CELL_MATCH] = TFT_DARKGREY;
+    }
+
+    snprintf(text[CELL_SPEED], 24, "%.1f", (float)rideFilterValue(frame, DISPLAY_FILTER, TELEMETRY_METRIC_SPEED) / 100.0);
+    color[CELL_SPEED] = TFT_GREENYELLOW;
+    snprintf(text[CELL_CADENCE], 24, "%.0f", (float)rideFilterValue(frame, DISPLAY_FILTER, TELEMETRY_METRIC_CADENCE)); // Display cadence directly
+    color[CELL_CADENCE] = TFT_ORANGE;
+    snprintf(text[CELL_POWER], 24, "%u", rideFilterValue(frame, DISPLAY_FILTER, TELEMETRY_METRIC_POWER));
+    color[CELL_POWER] = TFT_MAGENTA;
+    snprintf(text[CELL_CALORIES], 24, "%.1f", (float)rideSessionKcalX10(frame.totals.workJ) / 10.0); // Kept across bike reconnects
+    color[CELL_CALORIES] = TFT_SKYBLUE;
+}
+
+// Clears the old value's rectangle, draws the new one and returns the width that must be pushed.
+static int16_t renderCell(DisplayField& field, const char* text, uint16_t color) {
+    spr.setTextSize(field.textSize);
+    int16_t newWidth = spr.textWidth(text);
+    int16_t dirtyWidth = newWidth > field.width ? newWidth : field.width;
+    if (dirtyWidth > 0) {
+        spr.fillRect(field.x, field.y, dirtyWidth, spr.fontHeight(), TFT_BLACK);
+    }
+    spr.setTextColor(color, TFT_BLACK);
+    spr.setCursor(field.x, field.y);
+    spr.print(text);
+
+    strncpy(field.text, text, sizeof(field.text) - 1);
+    field.text[sizeof(field.text) - 1] = '\0';
+    field.color = color;
+    field.width = newWidth;
+    return dirtyWidth;
+}
+
+static void fullRedraw(char text[CELL_COUNT][24], uint16_t color[CELL_COUNT]) {
+    spr.fillSprite(TFT_BLACK);
+    spr.setTextWrap(false);
+
+    // Header
+    spr.setTextSize(2);
+    spr.setTextColor(TFT_CYAN, TFT_BLACK);
+    spr.setCursor(5, 0);
+    spr.print("SMARTUP BIKE");
+
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        DisplayField& field = displayFields[cell];
+        if (field.label) {
+            spr.setTextSize(1);
+            spr.setTextColor(TFT_WHITE, TFT_BLACK);
+            spr.setCursor(5, field.y);
+            spr.print(field.label);
+        }
+        field.width = 0; // Sprite was just cleared
+        renderCell(field, text[cell], color[cell]);
+    }
+    spr.pushSprite(0, 0);
+    displayStats.pushes++;
+    displayStats.pixelsPushed += (uint32_t)spr.width() * spr.height();
+    displayStats.fullRedraws++;
+    displayStats.cellsRedrawn += CELL_COUNT;
+}
+
+void updateDisplay() {
+    if (!displayInitialized) return;
+    int64_t startUs = esp_timer_get_time();
+
+    TelemetryFrame frame;
+    telemetryRead(frame); // One consistent snapshot for the whole screen
+
+    char text[CELL_COUNT][24];
+    uint16_t color[CELL_COUNT];
+    computeCells(frame, text, color);
+
+    if (displayNeedsFullRedraw) {
+        displayNeedsFullRedraw = false;
+        fullRedraw(text, color);
+    } else {
+        for (int cell = 0; cell < CELL_COUNT; cell++) {
+            DisplayField& field = displayFields[cell];
+            if (field.color == color[cell] && strcmp(field.text, text[cell]) == 0) continue;
+            int16_t dirtyWidth = renderCell(field, text[cell], color[cell]);
+            int16_t height = spr.fontHeight();
+            if (dirtyWidth > 0) {
+                spr.pushSprite(field.x, field.y, field.x, field.y, dirtyWidth, height);
+                displayStats.pushes++;
+                displayStats.pixelsPushed += (uint32_t)dirtyWidth * height;
+            }
+            displayStats.cellsRedrawn++;
+        }
+    }
+
+    uint32_t elapsedUs = (uint32_t)(esp_timer_get_time() - startUs);
+    displayStats.frames++;
+    displayStats.lastUs = elapsedUs;
+    if (elapsedUs > displayStats.maxUs) displayStats.maxUs = elapsedUs;
+    displayStats.totalUs += elapsedUs;
+
+    if (DISPLAY_STATS_INTERVAL_MS > 0 && millis() - displayStatsLastLogMs >= DISPLAY_STATS_INTERVAL_MS) {
+        displayStatsLastLogMs = millis();
+        ts_log_printf("[Display] %lu frames (%lu full): avg %lu us, max %lu us, %lu cells redrawn, %lu px pushed (full frame = %lu px).",
+                      (unsigned long)displayStats.frames, (unsigned long)displayStats.fullRedraws,
+                      (unsigned long)(displayStats.totalUs / displayStats.frames), (unsigned long)displayStats.maxUs,
+                      (unsigned long)displayStats.cellsRedrawn, (unsigned long)displayStats.pixelsPushed,
+                      (unsigned long)spr.width() * spr.height());
+        displayResetFrameStats();
+    }
+}
+
+void displayGetFrameStats(DisplayFrameStats& out) {
+    out = displayStats;
+}
+
+void displayResetFrameStats() {
+    memset(&displayStats, 0, sizeof(displayStats));
+}
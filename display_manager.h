@@ -0,0 +1,35 @@
+#ifndef DISPLAY_MANAGER_H
+#define DISPLAY_MANAGER_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include "config.h"
+
+// --- Global Display Objects (defined in .ino) ---
+extern TFT_eSPI tft;
+extern TFT_eSprite spr;
+extern bool displayInitialized;
+extern bool targetResistanceMatchesBike;
+
+// --- Frame Statistics ---
+struct DisplayFrameStats {
+    uint32_t frames;        // updateDisplay() calls since the last reset
+    uint32_t fullRedraws;   // Frames that cleared and pushed the whole sprite
+    uint32_t cellsRedrawn;  // Value cells re-rendered because their text or colour changed
+    uint32_t pushes;        // pushSprite calls (full frame or sub-rectangle)
+    uint64_t pixelsPushed;  // Pixels sent over SPI
+    uint32_t lastUs;        // Time spent in the last updateDisplay()
+    uint32_t maxUs;
+    uint64_t totalUs;
+};
+
+// --- Display Functions (defined in display_manager.cpp) ---
+void initDisplay();
+// Renders only the cells whose text or colour changed since the last frame and pushes just
+// their bounding rectangles. The first frame (and any after displayInvalidate) is a full redraw.
+void updateDisplay();
+void displayInvalidate();
+void displayGetFrameStats(DisplayFrameStats& out);
+void displayResetFrameStats();
+
+#endif // DISPLAY_MANAGER_H
@@ -0,0 +1,168 @@
+#define LOG_MODULE LOG_MOD_ERG
+#include "erg_controller.h"
+#include "ftms_control_point.h"
+#include "app_sessions.h"
+#include "ble_client_manager.h"
+#include "telemetry.h"
+#include "ride_filter.h"
+#include "stepper_motion.h"
+#include "resistance_calibration.h"
+#include <math.h>
+
+static portMUX_TYPE ergStatusMux = portMUX_INITIALIZER_UNLOCKED;
+static ErgStatus ergStatus = {false, 0, 0.0f, 0, 0};
+
+static float clampLevel(const ErgControllerConfig& config, float level) {
+    if (level < config.levelMin) return config.levelMin;
+    if (level > config.levelMax) return config.levelMax;
+    return level;
+}
+
+static float crankRadPerS(float cadenceRpm) {
+    return cadenceRpm * (2.0f * (float)M_PI / 60.0f);
+}
+
+// --- Controller ---
+void ergDefaultConfig(ErgControllerConfig& config) {
+    config.kp = ERG_KP;
+    config.ki = ERG_KI;
+    config.feedForwardGain = ERG_FEED_FORWARD_GAIN;
+    config.torqueBaseNm = ERG_TORQUE_BASE_NM;
+    config.torquePerLevelNm = ERG_TORQUE_PER_LEVEL_NM;
+    calibrationTorqueModel(config.torqueBaseNm, config.torquePerLevelNm); // Learned model, when there is one
+    config.levelMin = ERG_LEVEL_MIN;
+    config.levelMax = ERG_LEVEL_MAX;
+    config.levelStep = ERG_LEVEL_STEP;
+    config.levelHysteresis = ERG_LEVEL_HYSTERESIS;
+    config.deadbandW = ERG_DEADBAND_W;
+    config.periodS = ERG_CONTROL_PERIOD_MS / 1000.0f;
+}
+
+void ergControllerReset(ErgController& controller) {
+    controller.integral = 0.0f;
+    controller.command = 0.0f;
+    controller.feedForward = 0.0f;
+    controller.level = 0.0f;
+}
+
+float ergModelLevel(const ErgControllerConfig& config, float targetW, float cadenceRpm) {
+    float omega = crankRadPerS(cadenceRpm);
+    if (omega <= 0.0f) return config.levelMin;
+    return (targetW / omega - config.torqueBaseNm) / config.torquePerLevelNm;
+}
+
+float ergModelPower(const ErgControllerConfig& config, float level, float cadenceRpm) {
+    return (config.torqueBaseNm + config.torquePerLevelNm * level) * crankRadPerS(cadenceRpm);
+}
+
+float ergControllerStep(ErgController& controller, const ErgControllerConfig& config,
+                        float targetW, float measuredW, float cadenceRpm) {
+    // Feed-forward follows cadence every period, so a cadence change moves the level before
+    // the power error shows up.
+    controller.feedForward = config.feedForwardGain * ergModelLevel(config, targetW, cadenceRpm);
+    float error = targetW - measuredW;
+    float proportional = config.kp * error;
+    float unclamped = controller.feedForward + proportional + controller.integral;
+
+    // Errors a single settable step cannot fix are left alone, otherwise the integrator
+    // walks the level back and forth around the target.
+    float stepW = config.torquePerLevelNm * config.levelStep * crankRadPerS(cadenceRpm);
+    bool inDeadband = fabsf(error) < config.deadbandW || fabsf(error) < 0.5f * stepW;
+    bool saturatedHigh = unclamped >= config.levelMax && error > 0.0f;
+    bool saturatedLow = unclamped <= config.levelMin && error < 0.0f;
+    if (!inDeadband && !saturatedHigh && !saturatedLow) {
+        controller.integral += config.ki * error * config.periodS;
+        float integralLimit = config.levelMax - config.levelMin;
+        if (controller.integral > integralLimit) controller.integral = integralLimit;
+        if (controller.integral < -integralLimit) controller.integral = -integralLimit;
+    }
+
+    controller.command = clampLevel(config, controller.feedForward + proportional + controller.integral);
+    return controller.command;
+}
+
+float ergQuantizeLevel(const ErgControllerConfig& config, float command, float previousLevel) {
+    float steps = roundf((command - config.levelMin) / config.levelStep);
+    float level = clampLevel(config, config.levelMin + steps * config.levelStep);
+    if (previousLevel > 0.0f && level != previousLevel &&
+        fabsf(command - previousLevel) < 0.5f * config.levelStep + config.levelHysteresis) {
+        return previousLevel;
+    }
+    return level;
+}
+
+// --- ergTask_func Implementation ---
+// Runs every ERG_CONTROL_PERIOD_MS while the app is in ERG mode and writes the level to
+// targetResistanceLevel_App (shown on the display) and to the knob motor.
+void ergTask_func(void *pvParameters) {
+    ts_log_printf("[ERG:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+
+    ErgControllerConfig config;
+    ergDefaultConfig(config);
+    ErgController controller;
+    ergControllerReset(controller);
+    bool wasActive = false;
+    TickType_t lastWake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ERG_CONTROL_PERIOD_MS));
+
+        FtmsControlTargets targets;
+        ftmsGetControlTargets(targets);
+        // Only while the app that set the target still holds control and the bike is there to follow it.
+        bool ergMode = targets.controlMode == FTMS_CONTROL_MODE_POWER && bikeSensorConnected &&
+                       appSessionControlOwner() != APP_SESSION_NONE;
+        if (!ergMode) {
+            if (wasActive) {
+                ts_log_printf("[ERG] Off.");
+                wasActive = false;
+                ergControllerReset(controller);
+                portENTER_CRITICAL(&ergStatusMux);
+                ergStatus.active = false;
+                portEXIT_CRITICAL(&ergStatusMux);
+            }
+            continue;
+        }
+
+        TelemetryFrame frame;
+        telemetryRead(frame);
+        float cadenceRpm = frame.cadence / 2.0f;
+        if (!wasActive) {
+            ts_log_printf("[ERG] On: target %d W, starting from level %u.", targets.targetPower, frame.resistanceLevel);
+            ergDefaultConfig(config); // Picks up power curves learned since the last session
+            ergControllerReset(controller);
+            controller.level = frame.resistanceLevel;
+            wasActive = true;
+        }
+        if (cadenceRpm < ERG_MIN_CADENCE_RPM) {
+            continue; // Not pedalling: hold the level and the integrator
+        }
+
+        uint16_t power = rideFilterValue(frame, ERG_POWER_FILTER, TELEMETRY_METRIC_POWER);
+        float command = ergControllerStep(controller, config, targets.targetPower, power, cadenceRpm);
+        float previousLevel = controller.level;
+        controller.level = ergQuantizeLevel(config, command, controller.level);
+        if (controller.level != previousLevel) motionRequestLevel(controller.level);
+        uint8_t level = (uint8_t)lroundf(controller.level);
+        if (level != targetResistanceLevel_App) {
+            targetResistanceLevel_App = level;
+            ts_log_debug("[ERG] Target %d W, measured %u W at %.0f RPM: command %.2f (ff %.2f, i %.2f) -> level %u",
+                         targets.targetPower, power, cadenceRpm, command, controller.feedForward,
+                         controller.integral, level);
+        }
+
+        portENTER_CRITICAL(&ergStatusMux);
+        ergStatus.active = true;
+        ergStatus.targetPower = targets.targetPower;
+        ergStatus.command = command;
+        ergStatus.level = level;
+        ergStatus.steps++;
+        portEXIT_CRITICAL(&ergStatusMux);
+    }
+}
+
+void ergGetStatus(ErgStatus& out) {
+    portENTER_CRITICAL(&ergStatusMux);
+    out = ergStatus;
+    portEXIT_CRITICAL(&ergStatusMux);
+}
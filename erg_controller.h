@@ -0,0 +1,61 @@
+#ifndef ERG_CONTROLLER_H
+#define ERG_CONTROLLER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Global Variables related to ERG (defined in .ino) ---
+extern TaskHandle_t ergTaskHandle;
+
+// --- Controller ---
+// Resistance command = feed-forward from a bike torque model (target power at the current cadence)
+// + PI on the power error. The integrator is clamped and frozen while the command is saturated in the
+// direction of the error (anti-windup). The command is continuous; ergQuantizeLevel() maps it to the
+// levels the bike (or, later, the motor) can actually set.
+struct ErgControllerConfig {
+    float kp;                 // Levels per W of error
+    float ki;                 // Levels per W·s of accumulated error
+    float feedForwardGain;    // 0 = pure PI, 1 = full model feed-forward
+    float torqueBaseNm;       // Bike model: crank torque = base + perLevel * level
+    float torquePerLevelNm;
+    float levelMin;
+    float levelMax;
+    float levelStep;          // Settable resolution (1 = whole levels)
+    float levelHysteresis;    // Extra distance past a step boundary before the quantized level moves
+    float deadbandW;          // Power errors smaller than this (or than half a level step) are not integrated
+    float periodS;            // Control period
+};
+
+struct ErgController {
+    float integral;           // Levels
+    float command;            // Continuous level, after clamping
+    float feedForward;        // Model part of the last command
+    float level;              // Last quantized level (0 = none yet)
+};
+
+void ergDefaultConfig(ErgControllerConfig& config); // From config.h
+void ergControllerReset(ErgController& controller);
+// Level the bike model needs for targetW at cadenceRpm.
+float ergModelLevel(const ErgControllerConfig& config, float targetW, float cadenceRpm);
+// Power the bike model produces at 'level' and cadenceRpm.
+float ergModelPower(const ErgControllerConfig& config, float level, float cadenceRpm);
+// One control period. Returns the continuous level command.
+float ergControllerStep(ErgController& controller, const ErgControllerConfig& config,
+                        float targetW, float measuredW, float cadenceRpm);
+// Rounds the command to the settable steps, holding the previous level inside the hysteresis band.
+float ergQuantizeLevel(const ErgControllerConfig& config, float command, float previousLevel);
+
+// --- Task ---
+struct ErgStatus {
+    bool active;              // App is in ERG (Set Target Power) mode and the rider is pedalling
+    int16_t targetPower;
+    float command;
+    uint8_t level;            // Level written to targetResistanceLevel_App
+    uint32_t steps;
+};
+
+void ergTask_func(void *pvParameters);
+void ergGetStatus(ErgStatus& out);
+
+#endif // ERG_CONTROLLER_H
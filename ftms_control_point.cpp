@@ -0,0 +1,301 @@
+#define LOG_MODULE LOG_MOD_APP
+#include "ftms_control_point.h"
+#include "ble_peripheral_manager.h"
+#include "stepper_motion.h"
+#include "app_sessions.h"
+#include "metrics.h"
+#include "ride_session.h"
+#include <math.h> // For roundf
+
+static QueueHandle_t controlPointQueue = NULL;
+static volatile uint32_t controlPointDropCount = 0;
+
+static portMUX_TYPE controlTargetsMux = portMUX_INITIALIZER_UNLOCKED;
+static FtmsControlTargets controlTargets = {FTMS_CONTROL_MODE_NONE, 0, 0, 0, 0, 0, 0, 0, CONTROL_POINT_WHEEL_CIRCUMFERENCE};
+
+static int16_t readS16(const uint8_t* p) { return (int16_t)(p[0] | (p[1] << 8)); }
+static uint16_t readU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static void setControlMode(uint8_t mode) {
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.controlMode = mode;
+    portEXIT_CRITICAL(&controlTargetsMux);
+}
+
+static void setStatus(FtmsCpEvent& event, uint8_t statusCode, const uint8_t* param, size_t paramLength) {
+    event.status[0] = statusCode;
+    memcpy(event.status + 1, param, paramLength);
+    event.statusLength = (uint8_t)(1 + paramLength);
+}
+
+// --- Op Code Handlers ---
+// Called with the parameter bytes after the op code, already checked against the table's length
+// limits. Return the result code; status notifications are added to 'event'.
+static uint8_t handleRequestControl(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    if (!appSessionRequestControl(event.connHandle)) return FTMS_CP_RESULT_CONTROL_NOT_PERMITTED;
+    event.trainingStatus = 0x0D;
+    setStatus(event, 0x02, NULL, 0);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleReset(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    ftmsClearControlTargets();
+    appSessionReleaseControl(event.connHandle); // Reset also hands control back
+    rideSessionRequestReset();                  // New workout: totals and session averages start over
+    event.trainingStatus = 0x01;
+    setStatus(event, 0x01, NULL, 0);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetTargetSpeed(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    uint16_t speed = readU16(param);
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.targetSpeed = speed;
+    portEXIT_CRITICAL(&controlTargetsMux);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Target Speed: %u (x0.01 km/h)", speed);
+    setStatus(event, 0x05, param, 2);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetTargetInclination(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    targetInclinationPercentX100 = readS16(param);
+    setControlMode(FTMS_CONTROL_MODE_INCLINATION);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Parsed targetInclinationPercentX100: %d (%.2f%%)",
+                 targetInclinationPercentX100, (float)targetInclinationPercentX100 / 100.0f);
+    setStatus(event, 0x06, param, 2);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetTargetResistance(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    // App sends 0.1 resolution (10-80); the bike has levels 1-8. 0 clears the target.
+    uint8_t rawResistanceValueFromApp = param[0];
+    uint8_t processedLevel = (uint8_t)roundf((float)rawResistanceValueFromApp / 10.0f);
+    if (rawResistanceValueFromApp == 0) {
+        targetResistanceLevel_App = 0;
+    } else if (processedLevel < 1) {
+        targetResistanceLevel_App = 1;
+    } else if (processedLevel > 8) {
+        targetResistanceLevel_App = 8;
+    } else {
+        targetResistanceLevel_App = processedLevel;
+    }
+    setControlMode(FTMS_CONTROL_MODE_RESISTANCE);
+    motionRequestLevel(targetResistanceLevel_App);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Raw Resistance %u -> targetResistanceLevel_App (1-8 scale): %u",
+                 rawResistanceValueFromApp, targetResistanceLevel_App);
+    setStatus(event, 0x07, param, 1);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetTargetPower(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    int16_t power = readS16(param);
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.targetPower = power;
+    controlTargets.controlMode = power > 0 ? FTMS_CONTROL_MODE_POWER : FTMS_CONTROL_MODE_NONE;
+    portEXIT_CRITICAL(&controlTargetsMux);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Target Power: %d W (ERG %s)", power, power > 0 ? "on" : "off");
+    setStatus(event, 0x08, param, 2);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleStartOrResume(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    setStatus(event, 0x04, NULL, 0);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleStopOrPause(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    // 0x01 = stop, 0x02 = pause; a missing parameter is treated as stop.
+    uint8_t control = length >= 1 ? param[0] : 0x01;
+    if (control != 0x01 && control != 0x02) return FTMS_CP_RESULT_INVALID_PARAMETER;
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Parameter: %s", control == 0x01 ? "Stop" : "Pause");
+    setStatus(event, 0x02, &control, 1);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetSimulationParams(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    // Wind speed (sint16, 0.001 m/s) | grade (sint16, 0.01 %) | Crr (uint8, 0.0001) | Cw (uint8, 0.01 kg/m)
+    int16_t grade = readS16(param + 2);
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.windSpeed = readS16(param);
+    controlTargets.grade = grade;
+    controlTargets.rollingResistance = param[4];
+    controlTargets.windResistance = param[5];
+    controlTargets.controlMode = FTMS_CONTROL_MODE_SIMULATION;
+    portEXIT_CRITICAL(&controlTargetsMux);
+    targetInclinationPercentX100 = grade; // Shown as the target inclination
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Simulation: wind %d mm/s, grade %d (x0.01%%), Crr %u, Cw %u",
+                 readS16(param), grade, param[4], param[5]);
+    setStatus(event, 0x12, param, 6);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSetWheelCircumference(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    uint16_t circumference = readU16(param);
+    if (circumference == 0) return FTMS_CP_RESULT_INVALID_PARAMETER;
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.wheelCircumference = circumference;
+    portEXIT_CRITICAL(&controlTargetsMux);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Wheel Circumference: %u (x0.1 mm)", circumference);
+    setStatus(event, 0x13, param, 2);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+static uint8_t handleSpinDownControl(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    // The bike has no spin-down calibration: "ignore" succeeds, "start" is refused.
+    if (param[0] == 0x02) return FTMS_CP_RESULT_SUCCESS;
+    if (param[0] == 0x01) return FTMS_CP_RESULT_OPERATION_FAILED;
+    return FTMS_CP_RESULT_INVALID_PARAMETER;
+}
+
+static uint8_t handleSetTargetCadence(const uint8_t* param, size_t length, FtmsCpEvent& event) {
+    uint16_t cadence = readU16(param);
+    portENTER_CRITICAL(&controlTargetsMux);
+    controlTargets.targetCadence = cadence;
+    portEXIT_CRITICAL(&controlTargetsMux);
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "      Target Cadence: %u (x0.5 RPM)", cadence);
+    setStatus(event, 0x15, param, 2);
+    return FTMS_CP_RESULT_SUCCESS;
+}
+
+// --- Op Code Table ---
+typedef uint8_t (*FtmsCpHandler)(const uint8_t* param, size_t length, FtmsCpEvent& event);
+
+struct FtmsCpOpDescriptor {
+    uint8_t opCode;
+    uint8_t minParam;  // Parameter bytes after the op code
+    uint8_t maxParam;
+    const char* name;
+    FtmsCpHandler handler;
+};
+
+static const FtmsCpOpDescriptor ftmsCpOps[] = {
+    {FTMS_CP_REQUEST_CONTROL,         0, 0, "Request Control",          handleRequestControl},
+    {FTMS_CP_RESET,                   0, 0, "Reset",                    handleReset},
+    {FTMS_CP_SET_TARGET_SPEED,        2, 2, "Set Target Speed",         handleSetTargetSpeed},
+    {FTMS_CP_SET_TARGET_INCLINATION,  2, 2, "Set Target Inclination",   handleSetTargetInclination},
+    {FTMS_CP_SET_TARGET_RESISTANCE,   1, 2, "Set Target Resistance",    handleSetTargetResistance},  // Some apps send a sint16
+    {FTMS_CP_SET_TARGET_POWER,        2, 2, "Set Target Power",         handleSetTargetPower},
+    {FTMS_CP_START_OR_RESUME,         0, 0, "Start or Resume",          handleStartOrResume},
+    {FTMS_CP_STOP_OR_PAUSE,           0, 1, "Stop or Pause",            handleStopOrPause},
+    {FTMS_CP_SET_SIMULATION_PARAMS,   6, 6, "Set Simulation Params",    handleSetSimulationParams},
+    {FTMS_CP_SET_WHEEL_CIRCUMFERENCE, 2, 2, "Set Wheel Circumference",  handleSetWheelCircumference},
+    {FTMS_CP_SPIN_DOWN_CONTROL,       1, 1, "Spin Down Control",        handleSpinDownControl},
+    {FTMS_CP_SET_TARGET_CADENCE,      2, 2, "Set Target Cadence",       handleSetTargetCadence},
+};
+
+static const FtmsCpOpDescriptor* findOp(uint8_t opCode) {
+    for (size_t i = 0; i < sizeof(ftmsCpOps) / sizeof(ftmsCpOps[0]); i++) {
+        if (ftmsCpOps[i].opCode == opCode) return &ftmsCpOps[i];
+    }
+    return NULL;
+}
+
+// --- Dispatcher ---
+void ftmsControlPointDispatch(uint16_t connHandle, const uint8_t* data, size_t length, FtmsCpEvent& event) {
+    event.connHandle = connHandle;
+    event.response[0] = FTMS_CP_RESPONSE_CODE;
+    event.response[1] = data[0];
+    event.trainingStatus = -1;
+    event.statusLength = 0;
+
+    const FtmsCpOpDescriptor* op = findOp(data[0]);
+    if (op == NULL) {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    CP Handler: Unrecognized Op Code: 0x%02X", data[0]);
+        event.response[2] = FTMS_CP_RESULT_NOT_SUPPORTED;
+        return;
+    }
+    if (op->opCode != FTMS_CP_REQUEST_CONTROL && !appSessionCheckControl(connHandle)) {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    CP Handler: %s (0x%02X) from conn %u refused: conn %u has control.",
+                     op->name, op->opCode, connHandle, appSessionControlOwner());
+        event.response[2] = FTMS_CP_RESULT_CONTROL_NOT_PERMITTED;
+        return;
+    }
+    size_t paramLength = length - 1;
+    if (paramLength < op->minParam || paramLength > op->maxParam) {
+        TS_LOG_TOKEN(LOG_LEVEL_ERROR, "      ERROR: %s (0x%02X) with %d parameter bytes, expected %d-%d.",
+                     op->name, op->opCode, paramLength, op->minParam, op->maxParam);
+        event.response[2] = FTMS_CP_RESULT_INVALID_PARAMETER;
+        return;
+    }
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, "    CP Handler: %s (0x%02X)", op->name, op->opCode);
+    event.response[2] = op->handler(data + 1, paramLength, event);
+    if (event.response[2] != FTMS_CP_RESULT_SUCCESS) {
+        event.trainingStatus = -1;
+        event.statusLength = 0;
+    }
+}
+
+void ftmsControlPointOnWrite(uint16_t connHandle, const uint8_t* data, size_t length) {
+    TS_LOG_TOKEN(LOG_LEVEL_INFO, ">>> App (conn %u) -> Wrote to ESP32's Control Point (0x2AD9), Length: %d <<<", connHandle, length);
+    TS_LOG_TOKEN_HEX(LOG_LEVEL_DEBUG, "    Raw CP Data from App: %s", data, length < FTMS_CP_MAX_WRITE ? length : FTMS_CP_MAX_WRITE);
+    if (length == 0) {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    Received empty Control Point write (length 0). Ignoring.");
+        return;
+    }
+    metricsCountControlPoint(data[0]);
+
+    FtmsCpEvent event;
+    ftmsControlPointDispatch(connHandle, data, length, event);
+    if (controlPointQueue == NULL || xQueueSend(controlPointQueue, &event, 0) != pdPASS) {
+        controlPointDropCount++;
+        TS_LOG_TOKEN(LOG_LEVEL_ERROR, "    CP response queue full: response to 0x%02X dropped.", data[0]);
+    }
+}
+
+void ftmsClearControlTargets() {
+    targetInclinationPercentX100 = 0;
+    targetResistanceLevel_App = 0;
+    portENTER_CRITICAL(&controlTargetsMux);
+    uint16_t wheelCircumference = controlTargets.wheelCircumference; // A property of the bike, not of the app
+    memset(&controlTargets, 0, sizeof(controlTargets));
+    controlTargets.wheelCircumference = wheelCircumference;
+    portEXIT_CRITICAL(&controlTargetsMux);
+}
+
+void ftmsGetControlTargets(FtmsControlTargets& out) {
+    portENTER_CRITICAL(&controlTargetsMux);
+    out = controlTargets;
+    portEXIT_CRITICAL(&controlTargetsMux);
+}
+
+uint32_t controlPointDropped() {
+    return controlPointDropCount;
+}
+
+bool controlPointBegin() {
+    if (controlPointQueue == NULL) {
+        controlPointQueue = xQueueCreate(CONTROL_POINT_QUEUE_DEPTH, sizeof(FtmsCpEvent));
+    }
+    if (controlPointQueue == NULL) {
+        ts_log_error("[ControlPoint] FAILED to create response queue.");
+        return false;
+    }
+    return true;
+}
+
+// --- controlPointTask_func Implementation ---
+// Sends queued responses outside the NimBLE host task: the 0x2AD9 indication to the writing app
+// first, then the Training Status and Fitness Machine Status notifications it triggered.
+void controlPointTask_func(void *pvParameters) {
+    ts_log_printf("[ControlPoint:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+
+    FtmsCpEvent event;
+    while (1) {
+        if (controlPointQueue == NULL || xQueueReceive(controlPointQueue, &event, portMAX_DELAY) != pdTRUE) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        if (pControlPointCharacteristic_Peripheral != nullptr) {
+            pControlPointCharacteristic_Peripheral->setValue(event.response, sizeof(event.response));
+            pControlPointCharacteristic_Peripheral->notify(false, event.connHandle); // Indication
+            TS_LOG_TOKEN(LOG_LEVEL_INFO, "    CP Response to App (conn %u): 0x%02X for op code 0x%02X.",
+                         event.connHandle, event.response[2], event.response[1]);
+        }
+        if (event.trainingStatus >= 0) {
+            sendTrainingStatusUpdate((uint8_t)event.trainingStatus, true);
+        }
+        if (event.statusLength > 0) {
+            sendFitnessMachineStatus(event.status, event.statusLength);
+        }
+    }
+}
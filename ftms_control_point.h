@@ -0,0 +1,81 @@
+#ifndef FTMS_CONTROL_POINT_H
+#define FTMS_CONTROL_POINT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Global Variables related to the Control Point (defined in .ino) ---
+extern TaskHandle_t controlPointTaskHandle;
+
+// --- FTMS Control Point (0x2AD9) Op Codes ---
+#define FTMS_CP_REQUEST_CONTROL        0x00
+#define FTMS_CP_RESET                  0x01
+#define FTMS_CP_SET_TARGET_SPEED       0x02
+#define FTMS_CP_SET_TARGET_INCLINATION 0x03
+#define FTMS_CP_SET_TARGET_RESISTANCE  0x04
+#define FTMS_CP_SET_TARGET_POWER       0x05
+#define FTMS_CP_START_OR_RESUME        0x07
+#define FTMS_CP_STOP_OR_PAUSE          0x08
+#define FTMS_CP_SET_SIMULATION_PARAMS  0x11
+#define FTMS_CP_SET_WHEEL_CIRCUMFERENCE 0x12
+#define FTMS_CP_SPIN_DOWN_CONTROL      0x13
+#define FTMS_CP_SET_TARGET_CADENCE     0x14
+#define FTMS_CP_RESPONSE_CODE          0x80
+
+// --- Result Codes (third byte of a 0x80 response) ---
+#define FTMS_CP_RESULT_SUCCESS           0x01
+#define FTMS_CP_RESULT_NOT_SUPPORTED     0x02
+#define FTMS_CP_RESULT_INVALID_PARAMETER 0x03
+#define FTMS_CP_RESULT_OPERATION_FAILED  0x04
+#define FTMS_CP_RESULT_CONTROL_NOT_PERMITTED 0x05 // Another app holds control (app_sessions.h)
+
+#define FTMS_CP_MAX_WRITE      20 // Longest accepted write (the default ATT payload); the longest op code needs 7
+#define FTMS_STATUS_MAX_LENGTH 8  // Fitness Machine Status op code + parameters
+
+// --- Control Modes (which target the app set last) ---
+#define FTMS_CONTROL_MODE_NONE        0
+#define FTMS_CONTROL_MODE_RESISTANCE  1 // Set Target Resistance (0x04)
+#define FTMS_CONTROL_MODE_POWER       2 // Set Target Power (0x05): ERG, driven by erg_controller.cpp
+#define FTMS_CONTROL_MODE_INCLINATION 3 // Set Target Inclination (0x03)
+#define FTMS_CONTROL_MODE_SIMULATION  4 // Set Indoor Bike Simulation Parameters (0x11)
+
+// Targets last set by the app. Resistance and inclination stay in their .ino globals
+// (targetResistanceLevel_App, targetInclinationPercentX100) for the display and the bike side.
+struct FtmsControlTargets {
+    uint8_t  controlMode;         // FTMS_CONTROL_MODE_*
+    uint16_t targetSpeed;         // 0.01 km/h
+    int16_t  targetPower;         // W
+    uint16_t targetCadence;       // 0.5 RPM
+    int16_t  windSpeed;           // 0.001 m/s (simulation)
+    int16_t  grade;               // 0.01 % (simulation)
+    uint8_t  rollingResistance;   // 0.0001 (simulation Crr)
+    uint8_t  windResistance;      // 0.01 kg/m (simulation Cw)
+    uint16_t wheelCircumference;  // 0.1 mm
+};
+
+// What one Control Point write produces: the 0x80 indication (to the writing app only) plus any
+// status notifications (to every subscribed app), delivered in this order by the Control Point task.
+struct FtmsCpEvent {
+    uint16_t connHandle;                    // Writing app's connection
+    uint8_t response[3];                    // 0x80 | request op code | result code
+    int16_t trainingStatus;                 // Training Status (0x2AD3) to notify, -1 = none
+    uint8_t statusLength;                   // Fitness Machine Status (0x2ADA) bytes, 0 = none
+    uint8_t status[FTMS_STATUS_MAX_LENGTH];
+};
+
+// --- Functions (defined in ftms_control_point.cpp) ---
+bool controlPointBegin(); // Creates the response queue; call before the peripheral starts advertising
+void controlPointTask_func(void *pvParameters);
+// Validates and applies one write from connHandle (no heap allocation) and fills the responses to send.
+// Target changes need control (Request Control, app_sessions.h).
+void ftmsControlPointDispatch(uint16_t connHandle, const uint8_t* data, size_t length, FtmsCpEvent& event);
+// Called from the 0x2AD9 onWrite callback: dispatches and queues the responses. Never blocks.
+void ftmsControlPointOnWrite(uint16_t connHandle, const uint8_t* data, size_t length);
+void ftmsGetControlTargets(FtmsControlTargets& out);
+// Drops every target and the control mode (ERG, simulation, ...): on Reset and whenever the app
+// holding control gives it up or disconnects.
+void ftmsClearControlTargets();
+uint32_t controlPointDropped(); // Responses lost because the queue was full
+
+#endif // FTMS_CONTROL_POINT_H
@@ -0,0 +1,85 @@
+#include "ftms_encoder.h"
+
+static uint8_t* putField(const FtmsIndoorBikeData& data, int field, uint8_t* p) {
+    uint8_t size = ftmsIndoorBikeFields[field].size;
+    for (uint8_t i = 0; i < size; i++) p[i] = (uint8_t)(data.value[field] >> (8 * i));
+    return p + size;
+}
+
+static void emitFragment(uint16_t mask, int firstField, int endField, bool last, const FtmsIndoorBikeData& data,
+                         FtmsFragmentSink sink, void* context) {
+    uint8_t payload[FTMS_IBD_MAX_LENGTH];
+    uint16_t flags = last ? 0 : FTMS_IBD_MORE_DATA;
+    uint8_t* p = payload + 2;
+    if (last) p = putField(data, FTMS_IBD_INST_SPEED, p); // Speed is the first field after the flags
+    for (int field = firstField; field < endField; field++) {
+        if (mask & FTMS_IBD_FIELD(field)) {
+            flags |= FTMS_IBD_FIELD(field);
+            p = putField(data, field, p);
+        }
+    }
+    payload[0] = (uint8_t)flags;
+    payload[1] = (uint8_t)(flags >> 8);
+    sink(payload, p - payload, context);
+}
+
+size_t ftmsEncodeIndoorBikeDataFragments(uint16_t mask, const FtmsIndoorBikeData& data, size_t maxPayload,
+                                         FtmsFragmentSink sink, void* context) {
+    // The last fragment holds the speed plus as many trailing fields as fit; everything before it is
+    // packed greedily, in field order, into More Data fragments.
+    // Nothing is sent unless every field fits in a fragment of its own, so a record is never cut short.
+    for (int field = 0; field < FTMS_IBD_FIELD_COUNT; field++) {
+        if ((mask & FTMS_IBD_FIELD(field) || field == FTMS_IBD_INST_SPEED) &&
+            2 + (size_t)ftmsIndoorBikeFields[field].size > maxPayload) {
+            return 0;
+        }
+    }
+    size_t lastLength = 2 + ftmsIndoorBikeFields[FTMS_IBD_INST_SPEED].size;
+    int lastStart = FTMS_IBD_FIELD_COUNT;
+    while (lastStart > 1) {
+        int field = lastStart - 1;
+        size_t size = (mask & FTMS_IBD_FIELD(field)) ? ftmsIndoorBikeFields[field].size : 0;
+        if (lastLength + size > maxPayload) break;
+        lastLength += size;
+        lastStart = field;
+    }
+
+    size_t fragments = 0;
+    int start = 1;
+    for (;;) {
+        while (start < lastStart && !(mask & FTMS_IBD_FIELD(start))) start++;
+        if (start >= lastStart) break;
+        size_t length = 2;
+        int end = start;
+        while (end < lastStart) {
+            size_t size = (mask & FTMS_IBD_FIELD(end)) ? ftmsIndoorBikeFields[end].size : 0;
+            if (length + size > maxPayload) break;
+            length += size;
+            end++;
+        }
+        emitFragment(mask, start, end, false, data, sink, context);
+        fragments++;
+        start = end;
+    }
+    emitFragment(mask, lastStart, FTMS_IBD_FIELD_COUNT, true, data, sink, context);
+    return fragments + 1;
+}
+
+uint16_t ftmsDecodeIndoorBikeData(const uint8_t* payload, size_t length, FtmsIndoorBikeData& data) {
+    if (length < 2) return 0;
+    uint16_t flags = (uint16_t)(payload[0] | (payload[1] << 8));
+    uint16_t present = (flags & ~FTMS_IBD_MORE_DATA) | ((flags & FTMS_IBD_MORE_DATA) ? 0 : FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED));
+    if (present >= FTMS_IBD_FIELD(FTMS_IBD_FIELD_COUNT)) return 0; // Reserved flag bits: layout unknown
+    const uint8_t* p = payload + 2;
+    const uint8_t* end = payload + length;
+    for (int field = 0; field < FTMS_IBD_FIELD_COUNT; field++) {
+        if (!(present & FTMS_IBD_FIELD(field))) continue;
+        uint8_t size = ftmsIndoorBikeFields[field].size;
+        if (end - p < size) return 0;
+        uint64_t value = 0;
+        for (uint8_t i = 0; i < size; i++) value |= (uint64_t)p[i] << (8 * i);
+        data.value[field] = value;
+        p += size;
+    }
+    return present;
+}
@@ -0,0 +1,139 @@
+#ifndef FTMS_ENCODER_H
+#define FTMS_ENCODER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// --- FTMS Indoor Bike Data (0x2ACC) Fields ---
+// Field index == flag bit. Field 0 (Instantaneous Speed) is present when flag bit 0 ("More Data")
+// is clear, so it is only ever carried by the last fragment of a record.
+enum FtmsIndoorBikeField {
+    FTMS_IBD_INST_SPEED = 0,    // uint16, 0.01 km/h
+    FTMS_IBD_AVG_SPEED,         // uint16, 0.01 km/h
+    FTMS_IBD_INST_CADENCE,      // uint16, 0.5 RPM
+    FTMS_IBD_AVG_CADENCE,       // uint16, 0.5 RPM
+    FTMS_IBD_TOTAL_DISTANCE,    // uint24, m
+    FTMS_IBD_RESISTANCE,        // sint16, unitless
+    FTMS_IBD_INST_POWER,        // sint16, W
+    FTMS_IBD_AVG_POWER,         // sint16, W
+    FTMS_IBD_EXPENDED_ENERGY,   // uint16 total kcal | uint16 kcal/h | uint8 kcal/min (0xFFFF/0xFF = not available)
+    FTMS_IBD_HEART_RATE,        // uint8, BPM
+    FTMS_IBD_METABOLIC_EQ,      // uint8, 0.1 MET
+    FTMS_IBD_ELAPSED_TIME,      // uint16, s
+    FTMS_IBD_REMAINING_TIME,    // uint16, s
+    FTMS_IBD_FIELD_COUNT
+};
+
+#define FTMS_IBD_MORE_DATA     0x0001
+#define FTMS_IBD_FIELD(f)      ((uint16_t)(1u << (f)))
+#define FTMS_IBD_MAX_LENGTH    30 // Flags + every field
+
+// Field values in FTMS units, indexed by FtmsIndoorBikeField. Each field is packed as its
+// low 'size' bytes, little-endian, so signed fields are stored as their two's complement.
+struct FtmsIndoorBikeData {
+    uint64_t value[FTMS_IBD_FIELD_COUNT];
+};
+
+inline uint64_t ftmsExpendedEnergy(uint16_t totalKcal, uint16_t kcalPerHour, uint8_t kcalPerMinute) {
+    return (uint64_t)totalKcal | ((uint64_t)kcalPerHour << 16) | ((uint64_t)kcalPerMinute << 32);
+}
+
+// --- Field Descriptor Table ---
+struct FtmsFieldDescriptor {
+    const char* name;
+    uint8_t size; // Bytes on the wire
+};
+
+constexpr FtmsFieldDescriptor ftmsIndoorBikeFields[FTMS_IBD_FIELD_COUNT] = {
+    {"Instantaneous Speed", 2},
+    {"Average Speed", 2},
+    {"Instantaneous Cadence", 2},
+    {"Average Cadence", 2},
+    {"Total Distance", 3},
+    {"Resistance Level", 2},
+    {"Instantaneous Power", 2},
+    {"Average Power", 2},
+    {"Expended Energy", 5},
+    {"Heart Rate", 1},
+    {"Metabolic Equivalent", 1},
+    {"Elapsed Time", 2},
+    {"Remaining Time", 2},
+};
+
+constexpr uint8_t ftmsIbdFieldSize(int field) {
+    return ftmsIndoorBikeFields[field].size;
+}
+
+constexpr size_t ftmsIbdLength(uint16_t mask, int field = 0) {
+    return field == FTMS_IBD_FIELD_COUNT ? 2 // Flags
+         : (((mask >> field) & 1) ? ftmsIbdFieldSize(field) : 0) + ftmsIbdLength(mask, field + 1);
+}
+
+// --- Compile-Time Packer ---
+// Unrolled at compile time for one field set: no per-field test at run time, just the stores.
+template <bool Present, int Size>
+struct FtmsPutField {
+    static uint8_t* put(uint64_t, uint8_t* p) { return p; }
+};
+
+template <int Size>
+struct FtmsPutField<true, Size> {
+    static uint8_t* put(uint64_t value, uint8_t* p) {
+        for (int i = 0; i < Size; i++) p[i] = (uint8_t)(value >> (8 * i));
+        return p + Size;
+    }
+};
+
+template <uint16_t Mask, int Field = 0>
+struct FtmsIbdPacker {
+    static uint8_t* pack(const FtmsIndoorBikeData& data, uint8_t* p) {
+        p = FtmsPutField<((Mask >> Field) & 1) != 0, ftmsIbdFieldSize(Field)>::put(data.value[Field], p);
+        return FtmsIbdPacker<Mask, Field + 1>::pack(data, p);
+    }
+};
+
+template <uint16_t Mask>
+struct FtmsIbdPacker<Mask, FTMS_IBD_FIELD_COUNT> {
+    static uint8_t* pack(const FtmsIndoorBikeData&, uint8_t* p) { return p; }
+};
+
+// Packs one complete record (Mask must include Instantaneous Speed). Returns bytes written.
+template <uint16_t Mask>
+size_t ftmsEncodeIndoorBikeData(const FtmsIndoorBikeData& data, uint8_t* out) {
+    static_assert(Mask & FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED), "Instantaneous Speed must be in the field set");
+    static_assert(Mask < FTMS_IBD_FIELD(FTMS_IBD_FIELD_COUNT), "Unknown Indoor Bike Data field");
+    const uint16_t flags = Mask & ~FTMS_IBD_MORE_DATA;
+    out[0] = (uint8_t)flags;
+    out[1] = (uint8_t)(flags >> 8);
+    return FtmsIbdPacker<Mask>::pack(data, out + 2) - out;
+}
+
+// --- Fragmentation ("More Data") ---
+typedef void (*FtmsFragmentSink)(const uint8_t* payload, size_t length, void* context);
+
+// Runtime, table-driven encoder for any field set. Splits the record into fragments of at most
+// maxPayload bytes: every fragment but the last has More Data set and no speed; the last carries
+// the speed. Returns the number of fragments delivered to 'sink' (0 if a field cannot fit at all).
+size_t ftmsEncodeIndoorBikeDataFragments(uint16_t mask, const FtmsIndoorBikeData& data, size_t maxPayload,
+                                         FtmsFragmentSink sink, void* context);
+
+// Sends one record through 'sink': a single packet from the compile-time packer when it fits in
+// maxPayload (MTU - 3), otherwise More Data fragments.
+template <uint16_t Mask>
+size_t ftmsSendIndoorBikeData(const FtmsIndoorBikeData& data, size_t maxPayload, FtmsFragmentSink sink, void* context) {
+    if (ftmsIbdLength(Mask) <= maxPayload) {
+        uint8_t payload[ftmsIbdLength(Mask)];
+        size_t length = ftmsEncodeIndoorBikeData<Mask>(data, payload);
+        sink(payload, length, context);
+        return 1;
+    }
+    return ftmsEncodeIndoorBikeDataFragments(Mask, data, maxPayload, sink, context);
+}
+
+// --- Decoder (bikes that speak FTMS themselves) ---
+// Reads the fields of one Indoor Bike Data packet into 'data' (fields not in the packet are left untouched, so
+// More Data fragments accumulate into one record). Returns the mask of fields read, with
+// FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED) meaning "last fragment"; 0 if the packet is truncated or malformed.
+uint16_t ftmsDecodeIndoorBikeData(const uint8_t* payload, size_t length, FtmsIndoorBikeData& data);
+
+#endif // FTMS_ENCODER_H
@@ -0,0 +1,131 @@
+#define LOG_MODULE LOG_MOD_FORWARDER
+#include "ftms_forwarder.h"
+#include "ble_peripheral_manager.h"
+#include "ble_client_manager.h"
+#include "sim_physics.h"
+#include "resistance_calibration.h"
+#include "metrics.h"
+#include <esp_timer.h>
+#include <atomic>
+
+static portMUX_TYPE forwarderStatsMux = portMUX_INITIALIZER_UNLOCKED;
+static ForwarderLatencyStats forwarderStats = {0, 0, 0, UINT32_MAX, 0, 0, 0, 0, 0};
+// esp_timer low 32 bits (| 1, 0 = none) of the first signal the task has not woken for yet; coalesced
+// signals keep the oldest stamp, so the wake latency is the longest any sample waited.
+static std::atomic<uint32_t> forwarderSignalUs(0);
+
+// --- forwarderSignalNewSample Implementation (runs in the NimBLE host task) ---
+void forwarderSignalNewSample() {
+    if (forwarderTaskHandle != NULL) {
+        uint32_t none = 0;
+        forwarderSignalUs.compare_exchange_strong(none, (uint32_t)esp_timer_get_time() | 1);
+        xTaskNotifyGive(forwarderTaskHandle);
+    }
+}
+
+void forwarderGetLatencyStats(ForwarderLatencyStats& out) {
+    portENTER_CRITICAL(&forwarderStatsMux);
+    out = forwarderStats;
+    portEXIT_CRITICAL(&forwarderStatsMux);
+}
+
+static void recordWakeLatency(uint32_t latencyUs) {
+    metricsObserve(METRIC_HIST_WAKE_US, latencyUs);
+    portENTER_CRITICAL(&forwarderStatsMux);
+    forwarderStats.wakeups++;
+    if (latencyUs > forwarderStats.wakeMaxUs) forwarderStats.wakeMaxUs = latencyUs;
+    forwarderStats.wakeTotalUs += latencyUs;
+    portEXIT_CRITICAL(&forwarderStatsMux);
+}
+
+static void recordForwardLatency(uint32_t latencyUs) {
+    metricsObserve(METRIC_HIST_FORWARD_US, latencyUs);
+    portENTER_CRITICAL(&forwarderStatsMux);
+    forwarderStats.samples++;
+    forwarderStats.lastUs = latencyUs;
+    if (latencyUs < forwarderStats.minUs) forwarderStats.minUs = latencyUs;
+    if (latencyUs > forwarderStats.maxUs) forwarderStats.maxUs = latencyUs;
+    forwarderStats.totalUs += latencyUs;
+    portEXIT_CRITICAL(&forwarderStatsMux);
+}
+
+static void logAndResetLatencyStats() {
+    ForwarderLatencyStats snapshot;
+    portENTER_CRITICAL(&forwarderStatsMux);
+    snapshot = forwarderStats;
+    forwarderStats = {0, 0, 0, UINT32_MAX, 0, 0, 0, 0, 0};
+    portEXIT_CRITICAL(&forwarderStatsMux);
+
+    if (snapshot.wakeups > 0) {
+        ts_log_printf("[Forwarder] Notify->wake over %lu wake-ups: avg %lu us, max %lu us.",
+                      (unsigned long)snapshot.wakeups, (unsigned long)(snapshot.wakeTotalUs / snapshot.wakeups),
+                      (unsigned long)snapshot.wakeMaxUs);
+    }
+    if (snapshot.samples > 0) {
+        ts_log_printf("[Forwarder] Publish->App latency over %lu samples: avg %lu us, min %lu us, max %lu us, last %lu us. Heartbeats: %lu",
+                      (unsigned long)snapshot.samples, (unsigned long)(snapshot.totalUs / snapshot.samples),
+                      (unsigned long)snapshot.minUs, (unsigned long)snapshot.maxUs,
+                      (unsigned long)snapshot.lastUs, (unsigned long)snapshot.heartbeats);
+    } else if (snapshot.heartbeats > 0) {
+        ts_log_printf("[Forwarder] No fresh bike samples. Heartbeats sent: %lu", (unsigned long)snapshot.heartbeats);
+    }
+}
+
+// --- forwarderTask_func Implementation ---
+// Wakes on every new bike frame and notifies 0x2ACC right away. When the bike goes
+// quiet the last frame is re-sent every FORWARDER_HEARTBEAT_MS so apps don't time out.
+void forwarderTask_func(void *pvParameters) {
+    ts_log_printf("[Forwarder:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+
+    uint32_t lastSentSequence = 0;
+    int64_t lastSendUs = 0;
+    int64_t lastStatsLogUs = esp_timer_get_time();
+
+    while (1) {
+        bool signalled = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FORWARDER_HEARTBEAT_MS)) > 0;
+
+        int64_t nowUs = esp_timer_get_time();
+        uint32_t signalUs = forwarderSignalUs.exchange(0);
+        if (signalled && signalUs != 0) recordWakeLatency(((uint32_t)nowUs | 1) - signalUs);
+        if (nowUs - lastStatsLogUs >= (int64_t)FORWARDER_STATS_INTERVAL_MS * 1000) {
+            logAndResetLatencyStats();
+            lastStatsLogUs = nowUs;
+        }
+
+        if (!mywhooshConnected || !bikeSensorConnected) {
+            continue;
+        }
+
+        // Max-rate cap: wait out the remainder of the interval, then send the newest frame.
+        int64_t sinceLastUs = nowUs - lastSendUs;
+        if (FORWARDER_MIN_INTERVAL_MS > 0 && signalled && sinceLastUs < (int64_t)FORWARDER_MIN_INTERVAL_MS * 1000) {
+            vTaskDelay(pdMS_TO_TICKS(FORWARDER_MIN_INTERVAL_MS - sinceLastUs / 1000));
+        }
+
+        TelemetryFrame frame;
+        telemetryRead(frame);
+        bool fresh = frame.sequence != lastSentSequence;
+        if (signalled && !fresh) {
+            continue; // Already forwarded this frame (coalesced wake-up)
+        }
+
+        bool sentFtms = sendDataToMyWhoosh(frame);
+        bool sentCycling = sendCyclingMeasurements(frame); // Same frame for watches on Cycling Power / CSC
+        if (sentFtms || sentCycling) {
+            lastSendUs = esp_timer_get_time();
+            lastSentSequence = frame.sequence;
+            if (signalled && fresh && frame.timestampUs > 0) {
+                recordForwardLatency((uint32_t)(lastSendUs - frame.timestampUs));
+            } else {
+                portENTER_CRITICAL(&forwarderStatsMux);
+                forwarderStats.heartbeats++;
+                portEXIT_CRITICAL(&forwarderStatsMux);
+            }
+        }
+        // After the notify, so the app's latency does not include it.
+        if (fresh) {
+            simulationOnSample(frame); // SIM / inclination mode: road load -> resistance level
+            calibrationOnSample(frame); // Learns each level's power vs cadence curve
+        }
+    }
+}
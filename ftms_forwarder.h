@@ -0,0 +1,32 @@
+#ifndef FTMS_FORWARDER_H
+#define FTMS_FORWARDER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+#include "telemetry.h"
+
+// --- Global Variables related to the Forwarder (defined in .ino) ---
+extern TaskHandle_t forwarderTaskHandle;
+
+// Publish -> app notify latency, measured on every forwarded fresh sample, and the notify-wake
+// latency inside it: forwarderSignalNewSample() -> the forwarder task running.
+struct ForwarderLatencyStats {
+    uint32_t samples;   // Fresh samples forwarded since the last reset
+    uint32_t heartbeats; // Idle re-sends (not counted in latency)
+    uint32_t lastUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t wakeups;   // Signalled wake-ups since the last reset
+    uint32_t wakeMaxUs;
+    uint64_t wakeTotalUs;
+};
+
+// --- Function Declarations (defined in ftms_forwarder.cpp) ---
+void forwarderTask_func(void *pvParameters);
+// Called from the bike notification callback after a new frame is published. Never blocks.
+void forwarderSignalNewSample();
+void forwarderGetLatencyStats(ForwarderLatencyStats& out);
+
+#endif // FTMS_FORWARDER_H
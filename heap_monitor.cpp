@@ -0,0 +1,210 @@
+#define LOG_MODULE LOG_MOD_SYSTEM
+#include "heap_monitor.h"
+#include <esp_heap_caps.h>
+#include <atomic>
+#include <new>
+
+// The heap the BLE stacks and the bridge share; the capture ring may live in PSRAM.
+static const uint32_t heapCaps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+// --- operator new / delete tracer ---
+// Lock-free: operator new runs in every task, including the NimBLE host, and must not wait or log.
+// Zero-initialized before any constructor runs, so allocations from static constructors are counted.
+struct HeapSiteSlot {
+    std::atomic<uintptr_t> address;
+    std::atomic<uint32_t>  count;
+    std::atomic<uint32_t>  bytes;
+};
+
+static std::atomic<uint32_t> heapNews(0);
+static std::atomic<uint32_t> heapNewBytes(0);
+static std::atomic<uint32_t> heapDeletes(0);
+static std::atomic<bool> heapSteady(false);
+static HeapSiteSlot heapSites[HEAP_MONITOR_SITES + 1]; // The last slot is "other"
+
+#if HEAP_MONITOR_TRACE_NEW
+// On Xtensa the top two bits of a return address hold the caller's register window size, not the PC's.
+static uintptr_t codeAddress(void* returnAddress) {
+    uintptr_t address = (uintptr_t)returnAddress;
+#if defined(__XTENSA__)
+    if (address & 0x80000000) address = (address & 0x3FFFFFFF) | 0x40000000;
+#endif
+    return address;
+}
+
+static void recordSite(uintptr_t address, size_t size) {
+    HeapSiteSlot* slot = &heapSites[HEAP_MONITOR_SITES];
+    for (uint8_t i = 0; i < HEAP_MONITOR_SITES; i++) {
+        uintptr_t current = heapSites[i].address.load(std::memory_order_relaxed);
+        if (current == 0 && heapSites[i].address.compare_exchange_strong(current, address)) current = address;
+        if (current == address) {
+            slot = &heapSites[i];
+            break;
+        }
+    }
+    slot->count.fetch_add(1, std::memory_order_relaxed);
+    slot->bytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+}
+
+static void* tracedNew(size_t size, void* caller) {
+    void* p = malloc(size ? size : 1);
+    heapNews.fetch_add(1, std::memory_order_relaxed);
+    heapNewBytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+    if (heapSteady.load(std::memory_order_relaxed)) recordSite(codeAddress(caller), size);
+    return p;
+}
+
+static void* tracedNewOrFail(size_t size, void* caller) {
+    void* p = tracedNew(size, caller);
+    if (p == nullptr) {
+#if __cpp_exceptions
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return p;
+}
+
+static void tracedDelete(void* p) {
+    if (p == nullptr) return;
+    heapDeletes.fetch_add(1, std::memory_order_relaxed);
+    free(p);
+}
+
+void* operator new(size_t size) { return tracedNewOrFail(size, __builtin_return_address(0)); }
+void* operator new[](size_t size) { return tracedNewOrFail(size, __builtin_return_address(0)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tracedNew(size, __builtin_return_address(0)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tracedNew(size, __builtin_return_address(0)); }
+void operator delete(void* p) noexcept { tracedDelete(p); }
+void operator delete[](void* p) noexcept { tracedDelete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracedDelete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracedDelete(p); }
+#if __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { tracedDelete(p); }
+void operator delete[](void* p, size_t) noexcept { tracedDelete(p); }
+#endif
+#endif // HEAP_MONITOR_TRACE_NEW
+
+uint32_t heapMonitorNewCount() {
+    return heapNews.load(std::memory_order_relaxed);
+}
+
+// --- Steady State (loop() only) ---
+static bool steadyState = false;
+static uint32_t steadyStartMs = 0;
+static uint32_t steadyStartNews = 0;
+static uint32_t steadyStartNewBytes = 0;
+static uint32_t steadyStartFree = 0;
+static uint32_t steadyStartBlocks = 0;
+static uint8_t sitesReported = 0;
+
+static uint32_t allocatedBlocks() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, heapCaps);
+    return (uint32_t)info.allocated_blocks;
+}
+
+void heapMonitorPoll(bool steady) {
+    if (steady && !steadyState) {
+        steadyStartMs = millis();
+        steadyStartNews = heapNews.load(std::memory_order_relaxed);
+        steadyStartNewBytes = heapNewBytes.load(std::memory_order_relaxed);
+        steadyStartFree = (uint32_t)heap_caps_get_free_size(heapCaps);
+        steadyStartBlocks = allocatedBlocks();
+        heapSteady.store(true, std::memory_order_relaxed);
+        ts_log_printf("[Heap] Steady state: %lu bytes free (min %lu), largest block %lu.", (unsigned long)steadyStartFree,
+                      (unsigned long)heap_caps_get_minimum_free_size(heapCaps),
+                      (unsigned long)heap_caps_get_largest_free_block(heapCaps));
+    } else if (!steady && steadyState) {
+        heapSteady.store(false, std::memory_order_relaxed);
+        int32_t freeDelta = (int32_t)((uint32_t)heap_caps_get_free_size(heapCaps) - steadyStartFree);
+        ts_log_printf("[Heap] Steady state over after %lu s: %lu operator new calls, free heap %+ld bytes.",
+                      (unsigned long)((millis() - steadyStartMs) / 1000),
+                      (unsigned long)(heapNews.load(std::memory_order_relaxed) - steadyStartNews), (long)freeDelta);
+    }
+    steadyState = steady;
+
+    // Each new call site is reported once, when it first shows up; 'h' lists them all.
+    while (sitesReported < HEAP_MONITOR_SITES && heapSites[sitesReported].address.load(std::memory_order_relaxed) != 0) {
+        const HeapSiteSlot& slot = heapSites[sitesReported++];
+        ts_log_warn("[Heap] operator new in steady state from 0x%08lx (%lu bytes).",
+                    (unsigned long)slot.address.load(std::memory_order_relaxed),
+                    (unsigned long)slot.bytes.load(std::memory_order_relaxed));
+    }
+
+#if HEAP_MONITOR_LOG_INTERVAL_MS > 0
+    static unsigned long lastLogTime = 0;
+    if (millis() - lastLogTime >= HEAP_MONITOR_LOG_INTERVAL_MS) {
+        heapMonitorLogStats();
+        lastLogTime = millis();
+    }
+#endif
+}
+
+// --- Stats ---
+void heapMonitorGetStats(HeapStats& out) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, heapCaps);
+    out.freeBytes = (uint32_t)info.total_free_bytes;
+    out.minFreeBytes = (uint32_t)heap_caps_get_minimum_free_size(heapCaps);
+    out.largestFreeBlock = (uint32_t)info.largest_free_block;
+    out.fragmentationPercent = out.freeBytes > 0 ? (uint8_t)(100 - (uint64_t)out.largestFreeBlock * 100 / out.freeBytes) : 0;
+    out.allocatedBlocks = (uint32_t)info.allocated_blocks;
+
+    out.newCount = heapNews.load(std::memory_order_relaxed);
+    out.deleteCount = heapDeletes.load(std::memory_order_relaxed);
+
+    out.steady = steadyState;
+    if (steadyState) {
+        out.steadyMs = millis() - steadyStartMs;
+        out.steadyNewCount = out.newCount - steadyStartNews;
+        out.steadyNewBytes = heapNewBytes.load(std::memory_order_relaxed) - steadyStartNewBytes;
+        out.steadyFreeDelta = (int32_t)(out.freeBytes - steadyStartFree);
+        out.steadyBlocksDelta = (int32_t)(out.allocatedBlocks - steadyStartBlocks);
+    } else {
+        out.steadyMs = 0;
+        out.steadyNewCount = 0;
+        out.steadyNewBytes = 0;
+        out.steadyFreeDelta = 0;
+        out.steadyBlocksDelta = 0;
+    }
+
+    out.siteCount = 0;
+    for (uint8_t i = 0; i <= HEAP_MONITOR_SITES; i++) {
+        uint32_t count = heapSites[i].count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        HeapSite& site = out.sites[out.siteCount++];
+        site.address = i < HEAP_MONITOR_SITES ? heapSites[i].address.load(std::memory_order_relaxed) : 0;
+        site.count = count;
+        site.bytes = heapSites[i].bytes.load(std::memory_order_relaxed);
+    }
+}
+
+void heapMonitorLogStats() {
+    static HeapStats stats; // UI task only; kept off its stack
+    heapMonitorGetStats(stats);
+    ts_log_printf("[Heap] Internal: %lu bytes free, %lu min free, largest block %lu (%u%% fragmented), %lu blocks allocated.",
+                  (unsigned long)stats.freeBytes, (unsigned long)stats.minFreeBytes, (unsigned long)stats.largestFreeBlock,
+                  stats.fragmentationPercent, (unsigned long)stats.allocatedBlocks);
+    if (!HEAP_MONITOR_TRACE_NEW) {
+        ts_log_printf("[Heap] operator new is not traced (HEAP_MONITOR_TRACE_NEW 0).");
+    } else {
+        ts_log_printf("[Heap] operator new / delete since boot: %lu / %lu.", (unsigned long)stats.newCount,
+                      (unsigned long)stats.deleteCount);
+    }
+    if (stats.steady) {
+        ts_log_printf("[Heap] Steady for %lu s: %lu operator new calls (%lu bytes), free %+ld bytes, blocks %+ld.",
+                      (unsigned long)(stats.steadyMs / 1000), (unsigned long)stats.steadyNewCount,
+                      (unsigned long)stats.steadyNewBytes, (long)stats.steadyFreeDelta, (long)stats.steadyBlocksDelta);
+    } else {
+        ts_log_printf("[Heap] Not in steady state (bike and an app connected).");
+    }
+    for (uint8_t i = 0; i < stats.siteCount; i++) {
+        const HeapSite& site = stats.sites[i];
+        char address[2 + 2 * sizeof(uintptr_t) + 1]; // "0x" + hex digits of a pointer + NUL
+        if (site.address != 0) snprintf(address, sizeof(address), "0x%08lx", (unsigned long)site.address);
+        else strcpy(address, "other");
+        ts_log_printf("[Heap]   %-10s %6lu calls %8lu bytes", address, (unsigned long)site.count, (unsigned long)site.bytes);
+    }
+}
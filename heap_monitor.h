@@ -0,0 +1,48 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Heap Monitor ---
+// Steady state: the bike and at least one app connected. Everything the bridge needs by then is
+// allocated: task stacks are static (system_tasks.cpp), queues and buffers were created at boot, so
+// any heap use from here on is a leak or fragmentation risk on a multi-hour ride. The monitor keeps
+// the internal heap's figures and, with HEAP_MONITOR_TRACE_NEW, the operator new call sites seen in
+// steady state. malloc() from C code (NimBLE host, newlib) is not traced; it shows up as free bytes
+// and allocated blocks drifting from their values at the start of the steady state.
+
+struct HeapSite {
+    uintptr_t address;  // Return address in the caller of operator new (0 = the "other" bucket)
+    uint32_t  count;
+    uint32_t  bytes;
+};
+
+struct HeapStats {
+    uint32_t freeBytes;         // Internal 8-bit capable heap
+    uint32_t minFreeBytes;      // Lowest free since boot
+    uint32_t largestFreeBlock;
+    uint8_t  fragmentationPercent; // 100 - largest block / free: how much of the free heap is in small pieces
+    uint32_t allocatedBlocks;
+
+    uint32_t newCount;          // operator new / delete since boot, every task (0 without HEAP_MONITOR_TRACE_NEW)
+    uint32_t deleteCount;
+
+    bool     steady;
+    uint32_t steadyMs;          // Time in the current steady state
+    uint32_t steadyNewCount;    // operator new calls in the current steady state
+    uint32_t steadyNewBytes;
+    int32_t  steadyFreeDelta;   // Free bytes now - at the start of the steady state (negative = eroding)
+    int32_t  steadyBlocksDelta; // Allocated blocks now - at the start
+
+    uint8_t  siteCount;         // Call sites seen in any steady state since boot
+    HeapSite sites[HEAP_MONITOR_SITES + 1]; // The last one is "other" when the table is full
+};
+
+void heapMonitorPoll(bool steady); // loop(): steady-state transitions, new call sites, periodic log
+void heapMonitorGetStats(HeapStats& out);
+void heapMonitorLogStats();
+uint32_t heapMonitorNewCount();    // operator new calls since boot; host tools count a code path with it
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,200 @@
+// Bike protocol drivers (bike_driver.cpp) on the host: driver selection from advertisements, test
+// vectors for each driver's decoder, connect -> discover -> control against simulated bikes, and the
+// per-packet decode cost.
+// Usage: bench_bike_drivers [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "ftms_control_point.h"
+#include "stepper_motion.h"
+#include "telemetry.h"
+#include "system_tasks.h"
+#include "bench_util.h"
+
+extern MyNimBLEAdvertisedDeviceCallbacks myAdvertisedDeviceCallbacks_global; // Defined in the sketch
+extern BikeClientCallbacks myBikeClientCallbacks_global;
+
+// Merach S26 0xFFF1 data packet: 25.00 km/h, 90 RPM (x2 = 180), 150.0 W (x10 = 1500)
+static uint8_t merachDataPacket[] = {0x02, 0x42, 0x00, 0xC4, 0x09, 0x00, 0xB4, 0x00, 0x00, 0xDC, 0x05};
+static uint8_t merachCaloriesPacket[] = {0x02, 0x43, 0x00, 0x00, 0x00, 0x00, 0x01, 0x2C}; // 30.0 kcal
+static uint8_t merachResistancePacket[] = {0x75, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00};
+// Standard Indoor Bike Data: cadence, distance, resistance, power, energy + speed.
+// 25.00 km/h, 90 RPM, 1234 m, resistance 40 (0.1 units), 210 W, 55 kcal
+static uint8_t ftmsDataPacket[] = {0x74, 0x01, 0xC4, 0x09, 0xB4, 0x00, 0xD2, 0x04, 0x00, 0x28, 0x00,
+                                   0xD2, 0x00, 0x37, 0x00, 0xFF, 0xFF, 0xFF};
+
+static NimBLEAdvertisedDevice advertisement(const char* address, const char* name, uint16_t service) {
+    NimBLEAdvertisedDevice device;
+    device.hostSet(NimBLEAddress(std::string(address)), name, -55);
+    if (service != 0) device.hostAddService(NimBLEUUID(service));
+    return device;
+}
+
+static void collectFragment(const uint8_t* payload, size_t length, void* context) {
+    std::vector<std::vector<uint8_t> >* fragments = (std::vector<std::vector<uint8_t> >*)context;
+    fragments->push_back(std::vector<uint8_t>(payload, payload + length));
+}
+
+static bool waitForWrite(NimBLERemoteCharacteristic* characteristic, uint8_t opCode) {
+    for (int i = 0; i < 200; i++) {
+        const std::vector<uint8_t>& last = characteristic->hostLastWrite();
+        if (!last.empty() && last[0] == opCode) return true;
+        delay(1);
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Registry ---
+    NimBLEAdvertisedDevice merachByName = advertisement("11:22:33:44:55:66", "MRK-S26-0417", FTMS_SERVICE_UUID_SHORT);
+    NimBLEAdvertisedDevice merachByService = advertisement("11:22:33:44:55:67", "", CUSTOM_SERVICE_UUID_SHORT);
+    NimBLEAdvertisedDevice ftmsBike = advertisement("11:22:33:44:55:68", "KICKR BIKE 1A2B", FTMS_SERVICE_UUID_SHORT);
+    NimBLEAdvertisedDevice strap = advertisement("11:22:33:44:55:69", "HRM-Pro", 0x180D);
+    BENCH_CHECK(bikeDriverMatch(&merachByName) == &merachBikeDriver); // Its FTMS service does not win
+    BENCH_CHECK(bikeDriverMatch(&merachByService) == &merachBikeDriver);
+    BENCH_CHECK(bikeDriverMatch(&ftmsBike) == &ftmsBikeDriver);
+    BENCH_CHECK(bikeDriverMatch(&strap) == nullptr);
+    BENCH_CHECK(bikeDriverByName("ftms") == &ftmsBikeDriver && bikeDriverByName("merach") == &merachBikeDriver);
+    BikeDriver byManufacturer = ftmsBikeDriver;
+    byManufacturer.serviceUuid16 = 0;
+    byManufacturer.manufacturerId = 0x0969;
+    strap.hostSetManufacturerData(std::string("\x69\x09\x01", 3));
+    BENCH_CHECK(bikeDriverMatches(byManufacturer, &strap) && !bikeDriverMatches(byManufacturer, &ftmsBike));
+    printf("Registry: %s -> %s, %s -> %s\n", merachByName.getName().c_str(), bikeDriverMatch(&merachByName)->name,
+           ftmsBike.getName().c_str(), bikeDriverMatch(&ftmsBike)->name);
+
+    // The configured MAC is taken even when no driver recognizes the advertisement (button scan only).
+    NimBLEAdvertisedDevice configured = advertisement(BIKE_MAC_ADDRESS, "", 0);
+    myAdvertisedDeviceCallbacks_global.onResult(&configured);
+    BENCH_CHECK(pTargetBikeDevice == nullptr); // Not a pairing scan: sensors or the bike link's background scan
+    bikeClientBegin();
+    systemTaskCreate(SYSTEM_TASK_BIKE_CONNECT);
+    bikeCommandPost(BIKE_COMMAND_SCAN); // The button
+    for (int i = 0; i < 200 && !NimBLEDevice::getScan()->isScanning(); i++) delay(1);
+    myAdvertisedDeviceCallbacks_global.onResult(&ftmsBike);
+    BENCH_CHECK(BIKE_MAC_ADDRESS[0] == '\0' || pTargetBikeDevice == nullptr);
+    myAdvertisedDeviceCallbacks_global.onResult(&configured);
+    BENCH_CHECK(BIKE_MAC_ADDRESS[0] == '\0' || (pTargetBikeDevice != nullptr && bikeDriverSelected() == &merachBikeDriver));
+
+    // --- Merach test vectors ---
+    TelemetryFrame frame;
+    merachBikeDriver.decode(merachDataPacket, sizeof(merachDataPacket));
+    merachBikeDriver.decode(merachCaloriesPacket, sizeof(merachCaloriesPacket));
+    parseBikeResistanceData(merachResistancePacket, sizeof(merachResistancePacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.speed == 2500 && frame.cadence == 180 && frame.bikePower == 150);
+    BENCH_CHECK(frame.caloriesX10 == 300 && frame.resistanceLevel == 5);
+
+    // --- FTMS test vectors ---
+    telemetryReset();
+    ftmsBikeDriver.decode(ftmsDataPacket, sizeof(ftmsDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.speed == 2500 && frame.cadence == 180 && frame.bikePower == 210 && frame.power == 210);
+    BENCH_CHECK(frame.caloriesX10 == 550 && frame.resistanceLevel == 4);
+    BENCH_CHECK(frame.totals.distanceM == 0); // The bike's Total Distance (1234 m) restarts with it: integrated instead
+    uint32_t sequence = telemetrySequence();
+    ftmsBikeDriver.decode(ftmsDataPacket, 9); // Truncated
+    BENCH_CHECK(telemetrySequence() == sequence);
+    uint8_t reserved[] = {0x00, 0x20, 0xC4, 0x09}; // Reserved flag bit 13
+    ftmsBikeDriver.decode(reserved, sizeof(reserved));
+    BENCH_CHECK(telemetrySequence() == sequence);
+    uint8_t backpedal[] = {0x40, 0x00, 0x10, 0x00, 0xF6, 0xFF}; // -10 W
+    ftmsBikeDriver.decode(backpedal, sizeof(backpedal));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.bikePower == 0 && frame.speed == 16 && frame.cadence == 180); // Absent fields hold
+
+    // A record split into More Data fragments is published once, from the last fragment.
+    FtmsIndoorBikeData record;
+    memset(&record, 0, sizeof(record));
+    record.value[FTMS_IBD_INST_SPEED] = 3120;
+    record.value[FTMS_IBD_INST_CADENCE] = 190;
+    record.value[FTMS_IBD_RESISTANCE] = 70;
+    record.value[FTMS_IBD_INST_POWER] = 305;
+    record.value[FTMS_IBD_EXPENDED_ENERGY] = ftmsExpendedEnergy(120, 700, 12);
+    std::vector<std::vector<uint8_t> > fragments;
+    BENCH_CHECK(ftmsEncodeIndoorBikeDataFragments(FTMS_IBD_FIELD_MASK, record, 8, collectFragment, &fragments) > 2);
+    sequence = telemetrySequence();
+    for (size_t i = 0; i < fragments.size(); i++) {
+        ftmsBikeDriver.decode(&fragments[i][0], fragments[i].size());
+        BENCH_CHECK(telemetrySequence() == sequence + (i + 1 == fragments.size() ? 1 : 0));
+    }
+    telemetryRead(frame);
+    BENCH_CHECK(frame.speed == 3120 && frame.cadence == 190 && frame.bikePower == 305);
+    BENCH_CHECK(frame.resistanceLevel == 7 && frame.caloriesX10 == 1200);
+    printf("FTMS: %u fragments -> one frame (%u W, level %u)\n", (unsigned)fragments.size(), frame.bikePower, frame.resistanceLevel);
+
+    // Level <-> resistance mapping and Set Target Resistance.
+    FtmsResistanceRange ours = {BIKE_FTMS_DEFAULT_RESISTANCE_MIN, BIKE_FTMS_DEFAULT_RESISTANCE_MAX};
+    FtmsResistanceRange wide = {0, 1000};
+    BENCH_CHECK(ftmsBikeResistanceFromLevel(1, ours) == 10 && ftmsBikeResistanceFromLevel(8, ours) == 80);
+    BENCH_CHECK(ftmsBikeResistanceFromLevel(4.5f, ours) == 45 && ftmsBikeResistanceFromLevel(20, ours) == 80);
+    BENCH_CHECK(ftmsBikeResistanceFromLevel(8, wide) == 1000 && ftmsBikeLevelFromResistance(500, wide) == 5);
+    BENCH_CHECK(ftmsBikeLevelFromResistance(-5, ours) == 1 && ftmsBikeLevelFromResistance(900, ours) == 8);
+    uint8_t request[3];
+    BENCH_CHECK(ftmsBikeEncodeSetResistance(45, request) == 2 && request[0] == 0x04 && request[1] == 45);
+    BENCH_CHECK(ftmsBikeEncodeSetResistance(1000, request) == 3 && request[1] == 0xE8 && request[2] == 0x03);
+
+    // --- Connect: FTMS bike, resistance over its Control Point ---
+    xTaskCreatePinnedToCore(bikeControlTask_func, "BikeControl", 3072, NULL, 2, &bikeControlTaskHandle, 0);
+    pBikeClient = NimBLEDevice::createClient();
+    pBikeClient->setClientCallbacks(&myBikeClientCallbacks_global);
+    NimBLERemoteService* ftmsService = pBikeClient->hostAddService(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    const uint8_t features[] = {0x86, 0x50, 0x00, 0x00, 0x0C, 0xE0, 0x00, 0x00};
+    const uint8_t range[] = {0x00, 0x00, 0xC8, 0x00, 0x0A, 0x00}; // 0..20.0, step 1.0
+    ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)BIKE_MACHINE_FEATURE_UUID_SHORT), 3, NIMBLE_PROPERTY::READ)
+        ->hostSetValue(features, sizeof(features));
+    ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)FTMS_SUPPORTED_RESISTANCE_RANGE_UUID_SHORT), 5, NIMBLE_PROPERTY::READ)
+        ->hostSetValue(range, sizeof(range));
+    NimBLERemoteCharacteristic* data = ftmsService->hostAddCharacteristic(
+        NimBLEUUID((uint16_t)BIKE_INDOOR_BIKE_DATA_UUID_SHORT), 7, NIMBLE_PROPERTY::NOTIFY);
+    NimBLERemoteCharacteristic* controlPoint = ftmsService->hostAddCharacteristic(
+        NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), 9, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::INDICATE);
+    bikeDriverSelect(bikeDriverMatch(&ftmsBike));
+    BENCH_CHECK(pBikeClient->connect(&ftmsBike));
+    BENCH_CHECK(bikeDriverActive() == &ftmsBikeDriver && bikeTargetSettingFeatures == 0xE00C);
+    BENCH_CHECK(controlPoint->hostLastWrite().size() == 1 && controlPoint->hostLastWrite()[0] == FTMS_CP_START_OR_RESUME);
+    motionRequestLevel(5); // Control Point, ERG and SIM all end here
+    BENCH_CHECK(waitForWrite(controlPoint, FTMS_CP_SET_TARGET_RESISTANCE));
+    BENCH_CHECK(controlPoint->hostLastWrite().size() == 2 && controlPoint->hostLastWrite()[1] == 114); // 4/7 of 0..200
+    data->hostNotify(ftmsDataPacket, sizeof(ftmsDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.bikePower == 210 && frame.resistanceLevel == 2); // 40 of 0..200
+    pBikeClient->disconnect();
+    BENCH_CHECK(bikeDriverActive() == nullptr && !bikeDriverRequestLevel(3));
+    pBikeClient->hostClearServices();
+
+    // --- Connect: Merach, resistance by the knob ---
+    NimBLERemoteService* customService = pBikeClient->hostAddService(NimBLEUUID((uint16_t)CUSTOM_SERVICE_UUID_SHORT));
+    NimBLERemoteCharacteristic* custom = customService->hostAddCharacteristic(NimBLEUUID(CUSTOM_DATA_CHAR_UUID_STR), 3, NIMBLE_PROPERTY::NOTIFY);
+    ftmsService = pBikeClient->hostAddService(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    controlPoint = ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), 9, NIMBLE_PROPERTY::WRITE);
+    bikeDriverSelect(bikeDriverMatch(&merachByName));
+    BENCH_CHECK(pBikeClient->connect(&merachByName));
+    BENCH_CHECK(bikeDriverActive() == &merachBikeDriver && !bikeDriverRequestLevel(3));
+    BENCH_CHECK(controlPoint->hostLastWrite().size() == 1 && controlPoint->hostLastWrite()[0] == FTMS_CP_START_OR_RESUME);
+    custom->hostNotify(merachDataPacket, sizeof(merachDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.speed == 2500 && frame.bikePower == 150);
+    pBikeClient->disconnect();
+
+    // --- Cost (NimBLE host task, per bike packet) ---
+    printf("Cost:\n");
+    benchRun("Merach decode (0x42 + merge + publish)", iterations / 10, []() {
+        merachBikeDriver.decode(merachDataPacket, sizeof(merachDataPacket));
+    });
+    benchRun("FTMS decode (0x2AD2 + merge + publish)", iterations / 10, []() {
+        ftmsBikeDriver.decode(ftmsDataPacket, sizeof(ftmsDataPacket));
+    });
+    FtmsIndoorBikeData decoded;
+    benchRun("ftmsDecodeIndoorBikeData (fields only)", iterations, [&]() {
+        benchKeep(ftmsDecodeIndoorBikeData(ftmsDataPacket, sizeof(ftmsDataPacket), decoded));
+    });
+    benchRun("bikeDriverMatch (scan result)", iterations / 10, [&]() {
+        benchKeep(bikeDriverMatch(&ftmsBike));
+    });
+    return 0;
+}
@@ -0,0 +1,304 @@
+// Host microbenchmarks for the bike -> app data path and the FTMS Control Point handler, with one
+// and with two connected apps (per-connection sessions and control ownership).
+// Usage: bench_data_path [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "system_tasks.h"
+#include "telemetry.h"
+#include "ftms_control_point.h"
+#include "app_sessions.h"
+#include "heap_monitor.h"
+#include "metrics.h"
+#include "bench_util.h"
+
+struct CpWriteBuffer {
+    uint8_t bytes[FTMS_CP_MAX_WRITE];
+};
+
+// Merach S26 0xFFF1 data packet: 25.00 km/h, 90 RPM (x2 = 180), 150.0 W (x10 = 1500)
+static uint8_t merachDataPacket[] = {0x02, 0x42, 0x00, 0xC4, 0x09, 0x00, 0xB4, 0x00, 0x00, 0xDC, 0x05};
+
+static uint32_t readUint32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool startPeripheral() {
+    systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP);
+    for (int i = 0; i < 200 && !NimBLEDevice::getAdvertising()->isAdvertising(); i++) {
+        delay(10);
+    }
+    return pIndoorBikeDataCharacteristic_Peripheral != nullptr && pControlPointCharacteristic_Peripheral != nullptr;
+}
+
+// Writes the Control Point like an app would and waits for the queued indication (and status
+// notification, if one is expected). Returns the indicated response.
+static std::vector<uint8_t> writeControlPoint(MyWhooshNimBLEControlPointCallbacks& callbacks, ble_gap_conn_desc* desc,
+                                              const uint8_t* data, size_t length, bool expectStatus) {
+    uint32_t indications = pControlPointCharacteristic_Peripheral->hostIndicateCount();
+    uint32_t statuses = pFitnessMachineStatusCharacteristic_Peripheral->hostNotifyCount();
+    pControlPointCharacteristic_Peripheral->setValue(data, length);
+    callbacks.onWrite(pControlPointCharacteristic_Peripheral, desc);
+    for (int i = 0; i < 1000; i++) {
+        bool statusDone = !expectStatus || pFitnessMachineStatusCharacteristic_Peripheral->hostNotifyCount() != statuses;
+        if (pControlPointCharacteristic_Peripheral->hostIndicateCount() != indications && statusDone) break;
+        delay(1);
+    }
+    return pControlPointCharacteristic_Peripheral->hostLastSent();
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 1000000;
+
+    hostSetSerialEcho(false);
+    BENCH_CHECK(ts_log_begin());
+    xTaskCreatePinnedToCore(logDrainTask_func, "LogDrain", 3072, NULL, 1, &logDrainTaskHandle, 1);
+    BENCH_CHECK(controlPointBegin());
+    xTaskCreatePinnedToCore(controlPointTask_func, "ControlPoint", 3072, NULL, 2, &controlPointTaskHandle, 0);
+    globalDeviceName = "DIY FTMS Bike";
+    BENCH_CHECK(startPeripheral());
+
+    // Simulate one subscribed app and a connected bike.
+    ble_gap_conn_desc appDesc;
+    pServer_Peripheral->hostConnect(1, 247, &appDesc);
+    pIndoorBikeDataCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0001);
+    pControlPointCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0002);
+    pFitnessMachineStatusCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0001);
+    bikeSensorConnected = true;
+
+    // --- Correctness of the path being measured ---
+    parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    TelemetryFrame frame;
+    telemetryRead(frame);
+    BENCH_CHECK(frame.speed == 2500 && frame.cadence == 180 && frame.power == 150);
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    const std::vector<uint8_t>& sent = pIndoorBikeDataCharacteristic_Peripheral->hostLastSent();
+    BENCH_CHECK(sent.size() == 20);                                 // One packet at the default MTU
+    BENCH_CHECK(sent[0] == 0x74 && sent[1] == 0x09);                // Flags: cadence, distance, resistance, power, energy, time
+    BENCH_CHECK(sent[2] == 0xC4 && sent[3] == 0x09);                // Speed 25.00 km/h
+    BENCH_CHECK(sent[4] == 0xB4 && sent[5] == 0x00);                // Cadence 90 RPM
+    BENCH_CHECK(sent[11] == 0x96 && sent[12] == 0x00);              // Power 150 W
+    BENCH_CHECK(sent[13] == 0x00 && sent[14] == 0x00);              // Total energy: the session starts here
+    BENCH_CHECK(sent[15] == 0x19 && sent[16] == 0x02 && sent[17] == 0x09); // 537 kcal/h, 9 kcal/min at 150 W
+    BENCH_CHECK(sent[18] == 0x00 && sent[19] == 0x00);              // Elapsed time
+
+    printf("Bike -> app data path:\n");
+    // Steady state: a bike sample through parse, encode and notify touches no heap.
+    uint32_t sampleNewsBefore = heapMonitorNewCount();
+    for (int i = 0; i < 1000; i++) {
+        parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+        TelemetryFrame f;
+        telemetryRead(f);
+        sendDataToMyWhoosh(f);
+        sendCyclingMeasurements(f);
+    }
+    uint32_t sampleAllocations = heapMonitorNewCount() - sampleNewsBefore;
+    printf("  Heap allocations per bike sample (parse + 0x2ACC / CPS / CSC notify): %.1f\n", sampleAllocations / 1000.0);
+    BENCH_CHECK(sampleAllocations == 0);
+    benchRun("parseCustomBikeData (0x42 data packet)", iterations, []() {
+        parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    });
+    benchRun("telemetryRead", iterations, []() {
+        TelemetryFrame f;
+        telemetryRead(f);
+        benchKeep(f);
+    });
+    benchRun("sendDataToMyWhoosh (0x2ACC encode + notify)", iterations, [&frame]() {
+        sendDataToMyWhoosh(frame);
+    });
+
+    printf("App -> bike control point:\n");
+    MyWhooshNimBLEControlPointCallbacks cpCallbacks;
+    uint8_t simulation[] = {0x11, 0x00, 0x00, 0xF4, 0x01, 0x28, 0x33}; // 5.00 % grade, Crr 0.0040, Cw 0.51
+    std::vector<uint8_t> response = writeControlPoint(cpCallbacks, &appDesc, simulation, sizeof(simulation), true);
+    BENCH_CHECK(response.size() == 3 && response[0] == 0x80 && response[1] == 0x11 && response[2] == FTMS_CP_RESULT_SUCCESS);
+    BENCH_CHECK(targetInclinationPercentX100 == 500);
+    const std::vector<uint8_t>& status = pFitnessMachineStatusCharacteristic_Peripheral->hostLastSent();
+    BENCH_CHECK(status.size() == 7 && status[0] == 0x12 && status[3] == 0xF4 && status[4] == 0x01);
+    uint8_t cadence[] = {0x14, 0xB4, 0x00}; // 90 RPM
+    response = writeControlPoint(cpCallbacks, &appDesc, cadence, sizeof(cadence), true);
+    FtmsControlTargets targets;
+    ftmsGetControlTargets(targets);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_SUCCESS && targets.targetCadence == 180);
+    uint8_t shortResistance[] = {0x04};
+    response = writeControlPoint(cpCallbacks, &appDesc, shortResistance, sizeof(shortResistance), false);
+    BENCH_CHECK(response[1] == 0x04 && response[2] == FTMS_CP_RESULT_INVALID_PARAMETER);
+    uint8_t longResistance[FTMS_CP_MAX_WRITE + 4] = {0x04, 0x32}; // Longer than any op code, and than the buffer
+    response = writeControlPoint(cpCallbacks, &appDesc, longResistance, sizeof(longResistance), false);
+    BENCH_CHECK(response[1] == 0x04 && response[2] == FTMS_CP_RESULT_INVALID_PARAMETER);
+    uint8_t spinDown[] = {0x13, 0x01};
+    response = writeControlPoint(cpCallbacks, &appDesc, spinDown, sizeof(spinDown), false);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_OPERATION_FAILED);
+    uint8_t unknown[] = {0x42};
+    response = writeControlPoint(cpCallbacks, &appDesc, unknown, sizeof(unknown), false);
+    BENCH_CHECK(response[1] == 0x42 && response[2] == FTMS_CP_RESULT_NOT_SUPPORTED);
+
+    uint8_t setResistance[] = {0x04, 0x32};
+    pControlPointCharacteristic_Peripheral->setValue(setResistance, sizeof(setResistance));
+    benchRun("CP dispatch (0x04 Set Target Resistance)", iterations / 10, [&setResistance, &appDesc]() {
+        FtmsCpEvent event;
+        ftmsControlPointDispatch(appDesc.conn_handle, setResistance, sizeof(setResistance), event);
+        benchKeep(event);
+    });
+    BENCH_CHECK(targetResistanceLevel_App == 5);
+    // Same steps as onWrite(): fixed-buffer copy of the written bytes, then the dispatch.
+    uint32_t newsBefore = heapMonitorNewCount(); // operator new in any task (heap_monitor.cpp)
+    for (int i = 0; i < 1000; i++) {
+        size_t length = pControlPointCharacteristic_Peripheral->getDataLength();
+        if (length > FTMS_CP_MAX_WRITE) length = FTMS_CP_MAX_WRITE;
+        CpWriteBuffer buffer = pControlPointCharacteristic_Peripheral->getValue<CpWriteBuffer>(nullptr, true);
+        FtmsCpEvent event;
+        ftmsControlPointDispatch(appDesc.conn_handle, buffer.bytes, length, event);
+        benchKeep(event);
+    }
+    uint32_t allocations = heapMonitorNewCount() - newsBefore;
+    printf("  Heap allocations per CP write (copy + dispatch): %.1f\n", allocations / 1000.0);
+    BENCH_CHECK(allocations == 0);
+    for (int i = 0; i < 50; i++) {
+        writeControlPoint(cpCallbacks, &appDesc, setResistance, sizeof(setResistance), true);
+    }
+    BENCH_CHECK(controlPointDropped() == 0);
+
+    // --- Heap monitor: steady-state operator new call sites are recorded, the data path adds none ---
+    heapMonitorPoll(true);
+    for (int i = 0; i < 100; i++) {
+        parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+        sendDataToMyWhoosh(frame);
+    }
+    static HeapStats heap;
+    heapMonitorGetStats(heap);
+    BENCH_CHECK(heap.steady && heap.siteCount == 0);
+    std::vector<uint8_t>* leak = new std::vector<uint8_t>(64); // Two call sites: the vector and its buffer
+    heapMonitorGetStats(heap);
+    BENCH_CHECK(heap.steadyNewCount == 2 && heap.siteCount == 2 && heap.steadyNewBytes == sizeof(*leak) + 64);
+    delete leak;
+    heapMonitorPoll(false);
+    printf("  Heap monitor: %u call sites recorded for one deliberate allocation in steady state\n", heap.siteCount);
+
+    // --- Metrics: the path above is counted, and the diagnostics service reads it back ---
+    printf("Metrics:\n");
+    uint32_t packets = metricsCounter(METRIC_BIKE_PACKETS);
+    uint32_t rejects = metricsCounter(METRIC_BIKE_PARSE_REJECTS);
+    uint32_t notifies = metricsCounter(METRIC_APP_NOTIFIES);
+    uint32_t failures = metricsCounter(METRIC_APP_NOTIFY_FAILURES);
+    MetricHistogramSnapshot parseTimes;
+    metricsGetHistogram(METRIC_HIST_PARSE_US, parseTimes);
+    uint32_t parsesBefore = parseTimes.count;
+    for (int i = 0; i < 10; i++) {
+        customDataNotificationCallback(nullptr, merachDataPacket, sizeof(merachDataPacket), true);
+    }
+    uint8_t unknownPacket[] = {0x02, 0x55, 0x00};
+    parseCustomBikeData(unknownPacket, sizeof(unknownPacket));
+    BENCH_CHECK(metricsCounter(METRIC_BIKE_PACKETS) - packets == 11);
+    BENCH_CHECK(metricsCounter(METRIC_BIKE_PARSE_REJECTS) - rejects == 1);
+    metricsGetHistogram(METRIC_HIST_PARSE_US, parseTimes);
+    BENCH_CHECK(parseTimes.count - parsesBefore == 10);
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    hostSetMsysFree(0); // No notify buffer left: notify() reports the drop
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    hostSetMsysFree(os_msys_count());
+    BENCH_CHECK(metricsCounter(METRIC_APP_NOTIFIES) - notifies == 2);
+    BENCH_CHECK(metricsCounter(METRIC_APP_NOTIFY_FAILURES) - failures == 1);
+    uint32_t cpWrites = metricsCounter(METRIC_CP_WRITES);
+    uint32_t cpResistance = metricsCounter(METRIC_CP_OP_FIRST + 0x04);
+    uint32_t cpOther = metricsCounter(METRIC_CP_OP_FIRST + METRICS_CP_OP_SLOTS - 1);
+    writeControlPoint(cpCallbacks, &appDesc, setResistance, sizeof(setResistance), true);
+    writeControlPoint(cpCallbacks, &appDesc, unknown, sizeof(unknown), false);
+    BENCH_CHECK(metricsCounter(METRIC_CP_WRITES) - cpWrites == 2);
+    BENCH_CHECK(metricsCounter(METRIC_CP_OP_FIRST + 0x04) - cpResistance == 1);
+    BENCH_CHECK(metricsCounter(METRIC_CP_OP_FIRST + METRICS_CP_OP_SLOTS - 1) - cpOther == 1);
+
+    NimBLEService* pMetricsService = pServer_Peripheral->getServiceByUUID(NimBLEUUID(METRICS_SERVICE_UUID_STR));
+    BENCH_CHECK(pMetricsService != nullptr);
+    NimBLEAttValue counters = pMetricsService->getCharacteristic(NimBLEUUID(METRICS_COUNTERS_UUID_STR))->hostRead(&appDesc);
+    BENCH_CHECK(counters.length() == METRICS_COUNTERS_LENGTH);
+    BENCH_CHECK(counters.data()[0] == METRICS_RECORD_VERSION && counters.data()[1] == METRIC_COUNTER_COUNT);
+    BENCH_CHECK(readUint32(counters.data() + 2 + 4 * METRIC_BIKE_PACKETS) == metricsCounter(METRIC_BIKE_PACKETS));
+    BENCH_CHECK(readUint32(counters.data() + 2 + 4 * METRIC_APP_NOTIFY_FAILURES) == metricsCounter(METRIC_APP_NOTIFY_FAILURES));
+    NimBLEAttValue histograms = pMetricsService->getCharacteristic(NimBLEUUID(METRICS_HISTOGRAMS_UUID_STR))->hostRead(&appDesc);
+    BENCH_CHECK(histograms.length() == METRICS_HISTOGRAMS_LENGTH);
+    BENCH_CHECK(histograms.data()[1] == METRIC_HIST_COUNT && histograms.data()[2] == METRICS_HISTOGRAM_BUCKETS);
+    const uint8_t* parseRecord = histograms.data() + 3 + METRIC_HIST_PARSE_US * 4 * (1 + METRICS_HISTOGRAM_BUCKETS);
+    uint32_t parseCount = 0;
+    for (uint8_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) parseCount += readUint32(parseRecord + 4 + 4 * i);
+    metricsGetHistogram(METRIC_HIST_PARSE_US, parseTimes);
+    BENCH_CHECK(parseCount == parseTimes.count && readUint32(parseRecord) == parseTimes.max);
+    printf("  Parse p50 <= %lu us, p99 <= %lu us over %lu notifications; records %u + %u bytes\n",
+           (unsigned long)metricsPercentile(parseTimes, 50), (unsigned long)metricsPercentile(parseTimes, 99),
+           (unsigned long)parseTimes.count, (unsigned)counters.length(), (unsigned)histograms.length());
+    benchRun("metricsObserve", iterations, []() {
+        metricsObserve(METRIC_HIST_NOTIFY_US, 37);
+    });
+
+    // --- A second app (a watch, default MTU): one encode fanned out, control stays with the first ---
+    printf("Two apps connected:\n");
+    BENCH_CHECK(appSessionCount() == 1 && NimBLEDevice::getAdvertising()->isAdvertising()); // A slot is still free
+    ble_gap_conn_desc watchDesc;
+    pServer_Peripheral->hostConnect(2, 23, &watchDesc);
+    pIndoorBikeDataCharacteristic_Peripheral->hostSubscribe(&watchDesc, 0x0001);
+    pControlPointCharacteristic_Peripheral->hostSubscribe(&watchDesc, 0x0002);
+    BENCH_CHECK(appSessionCount() == APP_SESSION_MAX && !NimBLEDevice::getAdvertising()->isAdvertising());
+    ble_gap_conn_desc extraDesc;
+    pServer_Peripheral->hostConnect(3, 247, &extraDesc); // No slot left: refused
+    BENCH_CHECK(appSessionCount() == APP_SESSION_MAX && pServer_Peripheral->getConnectedCount() == APP_SESSION_MAX);
+
+    uint32_t notifiesBefore = pIndoorBikeDataCharacteristic_Peripheral->hostNotifyCount();
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral->hostNotifyCount() - notifiesBefore == 2); // 20 bytes fit MTU 23 - 3: one each
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral->hostLastSent().size() == 20);
+    benchRun("sendDataToMyWhoosh (encode once, notify 2 apps)", iterations, [&frame]() {
+        sendDataToMyWhoosh(frame);
+    });
+
+    uint8_t requestControl[] = {0x00};
+    uint8_t watchResistance[] = {0x04, 0x14}; // Level 2
+    response = writeControlPoint(cpCallbacks, &watchDesc, requestControl, sizeof(requestControl), false);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_CONTROL_NOT_PERMITTED);
+    BENCH_CHECK(pControlPointCharacteristic_Peripheral->hostLastConnHandle() == watchDesc.conn_handle); // Only the writer
+    response = writeControlPoint(cpCallbacks, &watchDesc, watchResistance, sizeof(watchResistance), false);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_CONTROL_NOT_PERMITTED && targetResistanceLevel_App == 5);
+    uint8_t targetPower[] = {0x05, 0xC8, 0x00}; // 200 W: ERG
+    response = writeControlPoint(cpCallbacks, &appDesc, targetPower, sizeof(targetPower), false);
+    ftmsGetControlTargets(targets);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_SUCCESS && targets.controlMode == FTMS_CONTROL_MODE_POWER);
+    // The controlling app leaves: its targets go with it, the watch keeps its session and data, and
+    // may now take control.
+    pServer_Peripheral->hostDisconnect(appDesc.conn_handle);
+    BENCH_CHECK(appSessionCount() == 1 && appSessionControlOwner() == APP_SESSION_NONE);
+    ftmsGetControlTargets(targets);
+    BENCH_CHECK(targets.controlMode == FTMS_CONTROL_MODE_NONE && targets.targetPower == 0 && targetResistanceLevel_App == 0);
+    BENCH_CHECK(mywhooshConnected && NimBLEDevice::getAdvertising()->isAdvertising());
+    notifiesBefore = pIndoorBikeDataCharacteristic_Peripheral->hostNotifyCount();
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral->hostNotifyCount() - notifiesBefore == 1);
+    response = writeControlPoint(cpCallbacks, &watchDesc, requestControl, sizeof(requestControl), true);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_SUCCESS && appSessionControlOwner() == watchDesc.conn_handle);
+    response = writeControlPoint(cpCallbacks, &watchDesc, watchResistance, sizeof(watchResistance), true);
+    BENCH_CHECK(response[2] == FTMS_CP_RESULT_SUCCESS && targetResistanceLevel_App == 2);
+    printf("  Refused third app, control handed over on disconnect, %u session(s) left\n", appSessionCount());
+
+    // Panic mode formats and writes each line in the caller, so this is the full per-line CPU cost.
+    printf("Logging (per line, formatted and written synchronously):\n");
+    ts_log_flush();
+    ts_log_set_panic_mode(true);
+    unsigned long bytesBefore = hostSerialBytesWritten();
+    benchRun("ts_log_printf (text)", iterations / 10, []() {
+        ts_log_printf("    CP Handler: Set Target Resistance Level (0x%02X), level %u", 0x04, 5u);
+    });
+    unsigned long textBytes = hostSerialBytesWritten() - bytesBefore;
+    ts_log_set_tokenized(true);
+    bytesBefore = hostSerialBytesWritten();
+    benchRun("TS_LOG_TOKEN (tokenized)", iterations / 10, []() {
+        TS_LOG_TOKEN(LOG_LEVEL_INFO, "    CP Handler: Set Target Resistance Level (0x%02X), level %u", 0x04, 5u);
+    });
+    unsigned long tokenBytes = hostSerialBytesWritten() - bytesBefore;
+    ts_log_set_tokenized(false);
+    ts_log_set_panic_mode(false);
+    printf("  Serial bytes per line: text %.1f, tokenized %.1f\n",
+           (double)textBytes / (iterations / 10), (double)tokenBytes / (iterations / 10));
+
+    printf("Serial bytes generated by logging: %lu (%lu lines dropped while queued)\n",
+           hostSerialBytesWritten(), (unsigned long)ts_log_dropped());
+    return 0;
+}
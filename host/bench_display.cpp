@@ -0,0 +1,65 @@
+// Compares full-frame and dirty-cell rendering of updateDisplay() over a simulated ride.
+// The host sprite draws nothing; what matters is how many pixels each strategy pushes over SPI.
+// Usage: bench_display [frames]
+#include <Arduino.h>
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "display_manager.h"
+#include "telemetry.h"
+#include "ride_filter.h"
+#include "ride_session.h"
+#include "bench_util.h"
+
+// The display shows filtered speed/cadence/power and session calories, so samples go through the same
+// hooks as sensorMergeAndPublish(), on a simulated clock that keeps running across rides.
+static int64_t rideClockUs = 1000000;
+
+static void simulateRide(uint32_t frames, bool forceFullRedraw, DisplayFrameStats& stats) {
+    telemetryReset();
+    displayInvalidate();
+    displayResetFrameStats();
+    for (uint32_t i = 0; i < frames; i++) {
+        // 500 ms display period: speed/cadence/power move every frame, calories and resistance rarely.
+        rideClockUs += 500000;
+        TelemetryFrame& f = telemetryBeginUpdate();
+        f.speed = (uint16_t)(2500 + (i * 37) % 400);
+        f.cadence = (uint16_t)(170 + (i * 7) % 20);
+        f.power = (uint16_t)(140 + (i * 13) % 40);
+        f.resistanceLevel = (uint8_t)(1 + (i / 120) % 8);
+        if (rideSessionApply(f, rideClockUs)) rideFilterRequestSessionReset();
+        rideFilterApply(f, rideClockUs);
+        telemetryPublish();
+        if (forceFullRedraw) displayInvalidate();
+        updateDisplay();
+    }
+    displayGetFrameStats(stats);
+}
+
+static void report(const char* name, const DisplayFrameStats& stats) {
+    printf("  %-22s %6lu frames, %5lu pushes, %9.0f px/frame, %6.1f cells/frame, avg %.2f us\n", name,
+           (unsigned long)stats.frames, (unsigned long)stats.pushes, (double)stats.pixelsPushed / stats.frames,
+           (double)stats.cellsRedrawn / stats.frames, (double)stats.totalUs / stats.frames);
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 7200; // One hour at 2 Hz
+    hostSetSerialEcho(false);
+    initDisplay();
+    bikeSensorConnected = true;
+    mywhooshConnected = true;
+    targetResistanceLevel_App = 4;
+
+    DisplayFrameStats full, partial;
+    simulateRide(frames, true, full);
+    simulateRide(frames, false, partial);
+
+    printf("updateDisplay over %lu simulated frames:\n", (unsigned long)frames);
+    report("full frame every time", full);
+    report("dirty cells only", partial);
+    BENCH_CHECK(partial.fullRedraws == 1);
+    double cellsPerFrame = (double)partial.cellsRedrawn / partial.frames;
+    BENCH_CHECK(cellsPerFrame > 1.0 && cellsPerFrame < 6.0); // The riding cells change, the rest mostly don't
+    BENCH_CHECK(partial.pixelsPushed * 10 < full.pixelsPushed);
+    printf("  SPI pixels saved: %.1f%%\n", 100.0 - 100.0 * partial.pixelsPushed / full.pixelsPushed);
+    return 0;
+}
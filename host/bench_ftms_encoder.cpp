@@ -0,0 +1,118 @@
+// Compares the table-driven Indoor Bike Data (0x2ACC) encoder with the hand-rolled one it replaced,
+// and checks the More Data fragmentation against the single-packet layout.
+// Usage: bench_ftms_encoder [iterations]
+#include <Arduino.h>
+#include "config.h"
+#include "ftms_encoder.h"
+#include "bench_util.h"
+#include <vector>
+
+// The pre-table encoder from sendDataToMyWhoosh: speed, cadence and power in a fixed 8-byte payload.
+static size_t handRolledEncode(uint16_t speed, uint16_t cadence, uint16_t power, uint8_t* payload) {
+    uint16_t ftms_flags = 0;
+    bool cadence_present = true;
+    bool power_present = true;
+    if (cadence_present) ftms_flags |= (1 << 2);
+    if (power_present) ftms_flags |= (1 << 6);
+    int offset = 0;
+    memcpy(payload + offset, &ftms_flags, 2); offset += 2;
+    memcpy(payload + offset, &speed, 2); offset += 2;
+    if (cadence_present) { memcpy(payload + offset, &cadence, 2); offset += 2; }
+    if (power_present) { int16_t powerForFtms_val = (int16_t)power; memcpy(payload + offset, &powerForFtms_val, 2); offset += 2; }
+    return offset;
+}
+
+static const uint16_t BASIC_FIELDS = FTMS_IBD_FIELD(FTMS_IBD_INST_SPEED) | FTMS_IBD_FIELD(FTMS_IBD_INST_CADENCE) |
+                                     FTMS_IBD_FIELD(FTMS_IBD_INST_POWER);
+static const uint16_t ALL_FIELDS = FTMS_IBD_FIELD(FTMS_IBD_FIELD_COUNT) - 1;
+
+struct Collected {
+    std::vector<std::vector<uint8_t>> fragments;
+};
+
+static void collect(const uint8_t* payload, size_t length, void* context) {
+    ((Collected*)context)->fragments.push_back(std::vector<uint8_t>(payload, payload + length));
+}
+
+// Rebuilds the field bytes of a fragmented record in single-packet order (speed first).
+static std::vector<uint8_t> reassemble(const Collected& c) {
+    const std::vector<uint8_t>& last = c.fragments.back();
+    std::vector<uint8_t> fields(last.begin() + 2, last.begin() + 4);
+    for (size_t i = 0; i + 1 < c.fragments.size(); i++) fields.insert(fields.end(), c.fragments[i].begin() + 2, c.fragments[i].end());
+    fields.insert(fields.end(), last.begin() + 4, last.end());
+    return fields;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+
+    FtmsIndoorBikeData data;
+    for (int field = 0; field < FTMS_IBD_FIELD_COUNT; field++) data.value[field] = 0x0101 * (field + 1);
+    data.value[FTMS_IBD_INST_SPEED] = 2500;
+    data.value[FTMS_IBD_INST_CADENCE] = 180;
+    data.value[FTMS_IBD_INST_POWER] = 150;
+
+    // --- Same bytes as the hand-rolled encoder for its field set ---
+    uint8_t legacy[8], table[FTMS_IBD_MAX_LENGTH];
+    BENCH_CHECK(handRolledEncode(2500, 180, 150, legacy) == 8);
+    BENCH_CHECK(ftmsEncodeIndoorBikeData<BASIC_FIELDS>(data, table) == 8);
+    BENCH_CHECK(memcmp(legacy, table, 8) == 0);
+    BENCH_CHECK(ftmsIbdLength(ALL_FIELDS) == FTMS_IBD_MAX_LENGTH);
+
+    // --- More Data fragmentation at the default MTU (23 -> 20 byte payload) ---
+    size_t fullLength = ftmsEncodeIndoorBikeData<ALL_FIELDS>(data, table);
+    Collected c;
+    size_t fragments = ftmsEncodeIndoorBikeDataFragments(ALL_FIELDS, data, 20, collect, &c);
+    BENCH_CHECK(fragments == 2 && c.fragments.size() == 2);
+    BENCH_CHECK(c.fragments[0][0] & FTMS_IBD_MORE_DATA);
+    BENCH_CHECK(!(c.fragments[1][0] & FTMS_IBD_MORE_DATA));
+    uint16_t flagsUnion = 0;
+    for (size_t i = 0; i < c.fragments.size(); i++) {
+        BENCH_CHECK(c.fragments[i].size() <= 20);
+        flagsUnion |= (uint16_t)(c.fragments[i][0] | c.fragments[i][1] << 8);
+    }
+    BENCH_CHECK((flagsUnion & ~FTMS_IBD_MORE_DATA) == (ALL_FIELDS & ~FTMS_IBD_MORE_DATA));
+    std::vector<uint8_t> fields = reassemble(c);
+    BENCH_CHECK(fields.size() == fullLength - 2 && memcmp(fields.data(), table + 2, fields.size()) == 0);
+    for (size_t limit = 4; limit <= FTMS_IBD_MAX_LENGTH; limit++) {
+        Collected any;
+        if (ftmsEncodeIndoorBikeDataFragments(ALL_FIELDS, data, limit, collect, &any) == 0) {
+            BENCH_CHECK(limit < 7 && any.fragments.empty()); // Expended Energy (5 bytes) cannot fit: nothing sent
+            continue;
+        }
+        std::vector<uint8_t> again = reassemble(any);
+        BENCH_CHECK(again.size() == fullLength - 2 && memcmp(again.data(), table + 2, again.size()) == 0);
+    }
+    printf("All fields (%u bytes) at MTU 23: %u fragments of %u + %u bytes.\n", (unsigned)fullLength,
+           (unsigned)fragments, (unsigned)c.fragments[0].size(), (unsigned)c.fragments[1].size());
+
+    printf("Indoor Bike Data encode:\n");
+    volatile uint16_t speed = 2500;
+    benchRun("hand-rolled (speed, cadence, power)", iterations, [&]() {
+        uint8_t payload[8];
+        handRolledEncode(speed, 180, 150, payload);
+        benchKeep(payload);
+    });
+    benchRun("table, compile-time (speed, cadence, power)", iterations, [&]() {
+        data.value[FTMS_IBD_INST_SPEED] = speed;
+        uint8_t payload[ftmsIbdLength(BASIC_FIELDS)];
+        ftmsEncodeIndoorBikeData<BASIC_FIELDS>(data, payload);
+        benchKeep(payload);
+    });
+    benchRun("table, compile-time (firmware field set)", iterations, [&]() {
+        data.value[FTMS_IBD_INST_SPEED] = speed;
+        uint8_t payload[ftmsIbdLength(FTMS_IBD_FIELD_MASK)];
+        ftmsEncodeIndoorBikeData<FTMS_IBD_FIELD_MASK>(data, payload);
+        benchKeep(payload);
+    });
+    benchRun("table, compile-time (all 13 fields)", iterations, [&]() {
+        data.value[FTMS_IBD_INST_SPEED] = speed;
+        uint8_t payload[FTMS_IBD_MAX_LENGTH];
+        ftmsEncodeIndoorBikeData<ALL_FIELDS>(data, payload);
+        benchKeep(payload);
+    });
+    benchRun("table, runtime fragments (all fields, MTU 23)", iterations / 10, [&]() {
+        ftmsEncodeIndoorBikeDataFragments(ALL_FIELDS, data, 20, [](const uint8_t* p, size_t n, void*) { benchKeep(p[n - 1]); }, NULL);
+    });
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Ride filter (ride_filter.cpp) against a brute-force reference over the whole sample history:
+// windowed and session averages must match exactly, the EMA must follow a step with its time
+// constant, pauses must not be averaged, and the per-frame cost must not grow with the window.
+// Usage: bench_ride_filter [iterations]
+#include <Arduino.h>
+#include "ride_filter.h"
+#include "bench_util.h"
+#include <math.h>
+#include <vector>
+
+struct RefSample {
+    uint32_t endMs;
+    uint16_t weightMs;
+    uint16_t value[TELEMETRY_METRIC_COUNT];
+};
+
+// Same rules as the filter, recomputed from scratch: samples whose end is within the window.
+static uint16_t refAverage(const std::vector<RefSample>& history, size_t first, uint32_t nowMs, uint32_t lengthMs,
+                           uint8_t metric, uint16_t current) {
+    uint64_t sum = 0, weight = 0;
+    for (size_t i = first; i < history.size(); i++) {
+        if (lengthMs != 0 && nowMs - history[i].endMs >= lengthMs) continue;
+        sum += (uint64_t)history[i].value[metric] * history[i].weightMs;
+        weight += history[i].weightMs;
+    }
+    return weight == 0 ? current : (uint16_t)((sum + weight / 2) / weight);
+}
+
+static uint32_t lcg(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static double stdDev(const std::vector<uint16_t>& values) {
+    double mean = 0, square = 0;
+    for (size_t i = 0; i < values.size(); i++) mean += values[i];
+    mean /= values.size();
+    for (size_t i = 0; i < values.size(); i++) square += (values[i] - mean) * (values[i] - mean);
+    return sqrt(square / values.size());
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 1000000;
+
+    static RideFilter filter; // ~1.6 KB: kept off the stack, as on the device
+    rideFilterInit(filter);
+    std::vector<RefSample> history;
+    size_t sessionStart = 0;
+    int64_t lastUs = 0;
+
+    // --- 4 Hz bike frames with jitter, a 1 Hz heart-rate publish in between, noisy power ---
+    // 120 s of riding, a 6 s stop with no frames, 60 s more; the session restarts at 150 s.
+    uint32_t rng = 12345;
+    int64_t nowUs = 0;
+    int64_t nextBikeUs = 1000000;
+    int64_t nextHrUs = 1500000;
+    uint32_t frames = 0, mismatches = 0;
+    std::vector<uint16_t> rawPower, shortPower, emaPower;
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    while (nowUs < 187000000) {
+        int64_t previousUs = nowUs;
+        bool hrPublish = nextHrUs < nextBikeUs;
+        if (hrPublish) {
+            nowUs = nextHrUs;
+            nextHrUs += 1000000;
+        } else { // A bike sample: new values
+            nowUs = nextBikeUs;
+            nextBikeUs += 250000 + (int64_t)(lcg(rng) % 60001) - 30000;
+            frame.speed = (uint16_t)(2500 + lcg(rng) % 200);
+            frame.cadence = (uint16_t)(170 + lcg(rng) % 20);
+            frame.power = (uint16_t)(180 + lcg(rng) % 81); // 220 +- 40 W
+        }
+        if (nextBikeUs > 120000000 && nextBikeUs < 126000000) { // Stopped: no frames at all
+            nextBikeUs = 126000000;
+            nextHrUs = 126500000;
+        }
+        if (previousUs < 150000000 && nowUs >= 150000000) {
+            rideFilterResetSession(filter);
+            sessionStart = history.size();
+        }
+        rideFilterUpdate(filter, frame, nowUs);
+        frames++;
+
+        // Reference bookkeeping, written independently of the filter's ring.
+        int64_t gapUs = nowUs - lastUs;
+        bool paused = lastUs == 0 || gapUs > (int64_t)RIDE_FILTER_MAX_GAP_MS * 1000;
+        if (paused) {
+            lastUs = nowUs;
+        } else {
+            uint16_t weightMs = (uint16_t)(gapUs / 1000);
+            lastUs += (int64_t)weightMs * 1000;
+            if (weightMs > 0) {
+                RefSample sample = {(uint32_t)(nowUs / 1000), weightMs, {frame.speed, frame.cadence, frame.power}};
+                history.push_back(sample);
+            }
+        }
+        uint32_t nowMs = (uint32_t)(nowUs / 1000);
+        const uint16_t current[TELEMETRY_METRIC_COUNT] = {frame.speed, frame.cadence, frame.power};
+        for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) {
+            if (frame.filtered[TELEMETRY_FILTER_SHORT][m] != refAverage(history, 0, nowMs, RIDE_FILTER_SHORT_MS, m, current[m]) ||
+                frame.filtered[TELEMETRY_FILTER_LONG][m] != refAverage(history, 0, nowMs, RIDE_FILTER_LONG_MS, m, current[m]) ||
+                frame.filtered[TELEMETRY_FILTER_SESSION][m] != refAverage(history, sessionStart, nowMs, 0, m, current[m])) {
+                mismatches++;
+            }
+        }
+        if (nowUs > 20000000 && nowUs < 120000000 && !hrPublish) {
+            rawPower.push_back(frame.power);
+            shortPower.push_back(frame.filtered[TELEMETRY_FILTER_SHORT][TELEMETRY_METRIC_POWER]);
+            emaPower.push_back(frame.filtered[TELEMETRY_FILTER_EMA][TELEMETRY_METRIC_POWER]);
+        }
+    }
+    printf("Ride filter vs brute force: %u frames (4 Hz bike + 1 Hz HR, 6 s stop, session reset)\n", frames);
+    printf("  Mismatches: %u\n", mismatches);
+    BENCH_CHECK(mismatches == 0);
+    printf("  Power std dev: raw %.1f W, %u s average %.1f W, EMA (tau %u ms) %.1f W\n", stdDev(rawPower),
+           RIDE_FILTER_SHORT_MS / 1000, stdDev(shortPower), RIDE_FILTER_EMA_TAU_MS, stdDev(emaPower));
+    BENCH_CHECK(stdDev(shortPower) < stdDev(rawPower) / 2);
+    BENCH_CHECK(stdDev(emaPower) < stdDev(rawPower) * 0.8);
+
+    // --- EMA: a power step reaches 1 - 1/e of the way after one time constant ---
+    rideFilterInit(filter);
+    memset(&frame, 0, sizeof(frame));
+    nowUs = 1000000;
+    frame.power = 100;
+    for (int i = 0; i < 20; i++, nowUs += 250000) rideFilterUpdate(filter, frame, nowUs);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_EMA][TELEMETRY_METRIC_POWER] == 100);
+    frame.power = 300;
+    for (uint32_t t = 0; t < RIDE_FILTER_EMA_TAU_MS; t += 250, nowUs += 250000) rideFilterUpdate(filter, frame, nowUs);
+    uint16_t afterTau = frame.filtered[TELEMETRY_FILTER_EMA][TELEMETRY_METRIC_POWER];
+    printf("  EMA step 100 -> 300 W: %u W after %u ms (ideal %.0f W)\n", afterTau, RIDE_FILTER_EMA_TAU_MS,
+           300 - 200 * exp(-1.0));
+    BENCH_CHECK(afterTau > 100 + 200 * 0.55 && afterTau < 100 + 200 * 0.72); // Discrete steps lag the ideal a little
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_SHORT][TELEMETRY_METRIC_POWER] < 300); // Still holds 100 W samples
+    for (int i = 0; i < 40; i++, nowUs += 250000) rideFilterUpdate(filter, frame, nowUs); // 10 time constants
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_EMA][TELEMETRY_METRIC_POWER] == 300);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_SHORT][TELEMETRY_METRIC_POWER] == 300);
+    BENCH_CHECK(rideFilterValue(frame, TELEMETRY_FILTER_RAW, TELEMETRY_METRIC_POWER) == 300);
+
+    // --- Pause: the stop is not averaged, the windows empty and the first frame after it stands alone ---
+    nowUs += (int64_t)(RIDE_FILTER_LONG_MS + 1000) * 1000;
+    frame.power = 150;
+    rideFilterUpdate(filter, frame, nowUs);
+    BENCH_CHECK(filter.window[TELEMETRY_FILTER_LONG].count == 0);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_LONG][TELEMETRY_METRIC_POWER] == 150);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_EMA][TELEMETRY_METRIC_POWER] == 150);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_SESSION][TELEMETRY_METRIC_POWER] > 150); // 300 W dominated the ride
+
+    // --- Ring full: at 50 frames/s the long window keeps the newest RIDE_FILTER_RING frames ---
+    rideFilterInit(filter);
+    nowUs = 1000000;
+    for (int i = 0; i < 1000; i++, nowUs += 20000) rideFilterUpdate(filter, frame, nowUs);
+    BENCH_CHECK(filter.window[TELEMETRY_FILTER_LONG].count == RIDE_FILTER_RING);
+    BENCH_CHECK(filter.window[TELEMETRY_FILTER_LONG].weightMs == RIDE_FILTER_RING * 20);
+    BENCH_CHECK(filter.window[TELEMETRY_FILTER_SHORT].weightMs == RIDE_FILTER_SHORT_MS ||
+                filter.window[TELEMETRY_FILTER_SHORT].count == RIDE_FILTER_RING);
+    BENCH_CHECK(frame.filtered[TELEMETRY_FILTER_LONG][TELEMETRY_METRIC_POWER] == 150);
+
+    // --- Cost per frame: constant, whatever the window holds ---
+    printf("Cost per frame:\n");
+    rideFilterInit(filter);
+    nowUs = 1000000;
+    uint32_t i = 0;
+    benchRun("rideFilterUpdate (4 Hz frames)", iterations, [&]() {
+        frame.power = (uint16_t)(200 + (i++ & 31));
+        nowUs += 250000;
+        rideFilterUpdate(filter, frame, nowUs);
+        benchKeep(frame);
+    });
+    benchRun("rideFilterUpdate (50 Hz frames, ring full)", iterations, [&]() {
+        frame.power = (uint16_t)(200 + (i++ & 31));
+        nowUs += 20000;
+        rideFilterUpdate(filter, frame, nowUs);
+        benchKeep(frame);
+    });
+    return 0;
+}
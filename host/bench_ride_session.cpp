@@ -0,0 +1,124 @@
+// Ride session (ride_session.cpp) over a three-hour ride against a double-precision reference:
+// distance and work must not drift, stops must count toward elapsed but not moving time, a bike
+// reconnect must keep the totals, and a long stop or an FTMS Reset must start a new session.
+// Usage: bench_ride_session [iterations]
+#include <Arduino.h>
+#include "ride_session.h"
+#include "bench_util.h"
+#include <math.h>
+
+static uint32_t lcg(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 1000000;
+
+    RideSession session;
+    rideSessionInit(session);
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+
+    // --- 4 Hz frames with jitter for three hours, a 60 s stop with 1 Hz frames in the middle ---
+    // Reference: the same rectangle rule on the exact microsecond gaps, in double precision.
+    // Naive: whole metres / joules per frame, and a float accumulator.
+    uint32_t rng = 777;
+    int64_t nowUs = 1000000;
+    double refMetres = 0, refJoules = 0, refMovingS = 0;
+    uint32_t naiveMetres = 0;
+    float floatMetres = 0;
+    int64_t previousUs = 0;
+    uint32_t frames = 0;
+    bool started = false;
+    while (nowUs < 1000000 + 3 * 3600 * 1000000LL) {
+        bool stopped = nowUs > 5400000000LL && nowUs < 5460000000LL;
+        frame.speed = stopped ? 0 : (uint16_t)(2800 + lcg(rng) % 400);  // 28-32 km/h
+        frame.cadence = stopped ? 0 : (uint16_t)(170 + lcg(rng) % 20);
+        frame.power = stopped ? 0 : (uint16_t)(180 + lcg(rng) % 81);
+        if (rideSessionUpdate(session, frame, nowUs)) started = true;
+        if (previousUs != 0) {
+            double dtS = (nowUs - previousUs) / 1e6;
+            refMetres += frame.speed / 360.0 * dtS;
+            refJoules += frame.power * dtS;
+            if (frame.speed > 0 || frame.cadence > 0) refMovingS += dtS;
+            uint32_t dtMs = (uint32_t)((nowUs - previousUs) / 1000);
+            naiveMetres += (uint32_t)frame.speed * dtMs / 360000;
+            floatMetres += frame.speed / 360.0f * (nowUs - previousUs) / 1e6f;
+        }
+        previousUs = nowUs;
+        frames++;
+        nowUs += stopped ? 1000000 : 250000 + (int64_t)(lcg(rng) % 60001) - 30000;
+    }
+    printf("Ride session vs double reference: %u frames over 3 h (4 Hz, 60 s stop)\n", frames);
+    printf("  Distance: %u m (reference %.1f m; whole metres per frame %u m, float %.1f m)\n",
+           frame.totals.distanceM, refMetres, naiveMetres, floatMetres);
+    printf("  Work: %u J (reference %.1f J), %.1f kcal at %u%% efficiency\n", frame.totals.workJ, refJoules,
+           rideSessionKcalX10(frame.totals.workJ) / 10.0, RIDE_SESSION_EFFICIENCY_PCT);
+    printf("  Elapsed %u s, moving %u s (reference %.1f s)\n", frame.totals.elapsedS, frame.totals.movingS, refMovingS);
+    BENCH_CHECK(started && session.active);
+    // Only the rest below one metre / joule is held back.
+    BENCH_CHECK(fabs(frame.totals.distanceM - refMetres) < 1.0);
+    BENCH_CHECK(fabs(frame.totals.workJ - refJoules) < 1.0);
+    BENCH_CHECK(fabs(frame.totals.movingS - refMovingS) < 1.0);
+    BENCH_CHECK(frame.totals.elapsedS == (uint32_t)((previousUs - 1000000) / 1000000));
+    BENCH_CHECK(frame.totals.elapsedS >= frame.totals.movingS + 59);
+    BENCH_CHECK(refMetres - naiveMetres > 1000); // What per-frame rounding would have lost
+
+    // --- Reconnect: no frames for 20 s, then the bike's live fields restart from zero ---
+    TelemetryTotals before = frame.totals;
+    nowUs = previousUs + 20000000;
+    memset(&frame, 0, sizeof(frame)); // telemetryReset() and the first frame of the new link
+    frame.speed = 3000;
+    frame.power = 200;
+    BENCH_CHECK(!rideSessionUpdate(session, frame, nowUs));
+    BENCH_CHECK(frame.totals.distanceM == before.distanceM && frame.totals.workJ == before.workJ); // Gap not integrated
+    BENCH_CHECK(frame.totals.elapsedS == before.elapsedS + 20);
+    for (int i = 0; i < 4; i++) rideSessionUpdate(session, frame, nowUs += 250000);
+    BENCH_CHECK(frame.totals.workJ == before.workJ + 200); // 1 s at 200 W
+    BENCH_CHECK(frame.totals.movingS == before.movingS + 1);
+
+    // --- Timeout: idle frames past RIDE_SESSION_TIMEOUT_MS end the session, the next ride starts one ---
+    frame.speed = 0;
+    frame.power = 0;
+    int64_t idleEndUs = nowUs + (int64_t)RIDE_SESSION_TIMEOUT_MS * 1000 + 1000000;
+    while (nowUs < idleEndUs) rideSessionUpdate(session, frame, nowUs += 1000000);
+    BENCH_CHECK(!session.active);
+    BENCH_CHECK(frame.totals.distanceM > 0); // Still on show
+    frame.speed = 3000;
+    BENCH_CHECK(rideSessionUpdate(session, frame, nowUs += 1000000));
+    BENCH_CHECK(frame.totals.distanceM == 0 && frame.totals.elapsedS == 0);
+
+    // --- Bridge: telemetryReset() keeps the totals, an FTMS Reset starts over on the next ride ---
+    TelemetryFrame& staging = telemetryBeginUpdate();
+    staging.speed = 3000;
+    rideSessionApply(staging, 1000000);
+    rideSessionApply(staging, 2000000);
+    telemetryPublish();
+    TelemetryFrame published;
+    telemetryRead(published);
+    BENCH_CHECK(published.totals.distanceM == 8 && published.totals.elapsedS == 1); // 30 km/h for 1 s
+    telemetryReset();
+    telemetryRead(published);
+    BENCH_CHECK(published.speed == 0 && published.totals.distanceM == 8);
+    rideSessionRequestReset();
+    TelemetryFrame& next = telemetryBeginUpdate();
+    BENCH_CHECK(!rideSessionApply(next, 3000000) && next.totals.distanceM == 0); // Not moving yet
+    next.speed = 3000;
+    BENCH_CHECK(rideSessionApply(next, 4000000));
+
+    // --- Cost per frame ---
+    printf("Cost per frame:\n");
+    rideSessionInit(session);
+    memset(&frame, 0, sizeof(frame));
+    nowUs = 1000000;
+    uint32_t i = 0;
+    benchRun("rideSessionUpdate (4 Hz frames)", iterations, [&]() {
+        frame.speed = (uint16_t)(3000 + (i & 63));
+        frame.power = (uint16_t)(200 + (i++ & 31));
+        nowUs += 250000;
+        rideSessionUpdate(session, frame, nowUs);
+        benchKeep(frame);
+    });
+    return 0;
+}
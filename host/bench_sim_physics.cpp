@@ -0,0 +1,99 @@
+// Checks the fixed-point SIM-mode road-load model (sim_physics.cpp) against a float reference over a
+// grid of golden cases, and times both.
+// Usage: bench_sim_physics [iterations]
+#include <Arduino.h>
+#include "sim_physics.h"
+#include "erg_controller.h"
+#include "bench_util.h"
+#include <math.h>
+
+// --- Float Reference (exact slope angle, no integer rounding) ---
+static double referencePowerW(const SimParams& p, double speedKmh) {
+    double v = speedKmh / 3.6;
+    double air = v + p.windSpeed / 1000.0;
+    double theta = atan(p.grade / 10000.0);
+    double mass = p.massGrams / 1000.0;
+    double force = mass * 9.80665 * (sin(theta) + p.rollingResistance / 10000.0 * cos(theta)) +
+                   p.windResistance / 100.0 * air * fabs(air);
+    return force * v;
+}
+
+struct GoldenCase {
+    uint16_t speed;    // 0.01 km/h
+    int16_t grade;     // 0.01 %
+    int16_t wind;      // mm/s
+    uint8_t crr;
+    uint8_t cw;
+    uint32_t massGrams;
+};
+
+static const GoldenCase goldenCases[] = {
+    {3000,     0,     0, 40, 51,  85000}, // Flat, 30 km/h
+    {4000,     0,     0, 40, 51,  85000}, // Flat, 40 km/h
+    {1500,   500,     0, 40, 51,  85000}, // 5 % climb
+    {1000,  1000,     0, 40, 51,  85000}, // 10 % climb
+    { 800,  2000,     0, 50, 51, 100000}, // 20 % wall, heavy rider
+    {4000, -1000,     0, 40, 51,  85000}, // Steep descent (negative power)
+    {2500,     0,  5000, 40, 51,  85000}, // 5 m/s headwind
+    {2500,     0, -8000, 40, 51,  85000}, // Tailwind faster than the rider
+    {3500,   150,  1500, 30, 40,  70000}, // Rolling road, TT position
+    {   0,   800,     0, 40, 51,  85000}, // Stopped
+    {6500,     0,     0, 20, 25,  80000}, // Sprint, aero
+    {2000,   300,     0, 80, 60,  90000}, // Gravel
+};
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Golden values: fixed point within 1 % or 0.5 W of the float reference ---
+    printf("Road load, fixed point vs float reference:\n");
+    printf("  %8s %7s %7s %4s %4s %6s %10s %10s\n", "km/h", "grade%", "wind", "Crr", "Cw", "kg", "fixed W", "float W");
+    double worstError = 0.0;
+    for (size_t i = 0; i < sizeof(goldenCases) / sizeof(goldenCases[0]); i++) {
+        const GoldenCase& c = goldenCases[i];
+        SimParams p = {c.wind, c.grade, c.crr, c.cw, c.massGrams};
+        double fixedW = simRequiredPowerMilliwatts(p, c.speed) / 1000.0;
+        double floatW = referencePowerW(p, c.speed / 100.0);
+        printf("  %8.2f %7.2f %7.3f %4u %4u %6.1f %10.2f %10.2f\n", c.speed / 100.0, c.grade / 100.0, c.wind / 1000.0,
+               c.crr, c.cw, c.massGrams / 1000.0, fixedW, floatW);
+        double error = fabs(fixedW - floatW);
+        double allowed = fabs(floatW) * 0.01 > 0.5 ? fabs(floatW) * 0.01 : 0.5;
+        BENCH_CHECK(error <= allowed);
+        if (error > worstError) worstError = error;
+    }
+    printf("  Worst absolute error: %.3f W\n", worstError);
+
+    // --- Level mapping matches the ERG controller's float bike model ---
+    ErgControllerConfig erg;
+    ergDefaultConfig(erg);
+    for (uint16_t cadence = 80; cadence <= 240; cadence += 20) {
+        for (int32_t powerW = 50; powerW <= 400; powerW += 25) {
+            int32_t fixedX100 = simLevelX100(powerW * 1000, cadence);
+            float expected = ergModelLevel(erg, (float)powerW, cadence / 2.0f);
+            if (expected < erg.levelMin) expected = erg.levelMin;
+            if (expected > erg.levelMax) expected = erg.levelMax;
+            BENCH_CHECK(fabsf(fixedX100 / 100.0f - expected) <= 0.02f);
+        }
+    }
+    BENCH_CHECK(simLevelX100(200000, 0) == -1);
+    BENCH_CHECK(simQuantizeLevel(449, 0) == 4);
+    BENCH_CHECK(simQuantizeLevel(455, 4) == 4);   // Inside the hysteresis band
+    BENCH_CHECK(simQuantizeLevel(470, 4) == 5);
+    printf("  Level mapping matches the ERG bike model within 0.02 levels.\n");
+
+    // --- Cost per bike sample ---
+    printf("Per-sample cost:\n");
+    SimParams p = {1500, 350, 40, 51, 85000};
+    volatile uint16_t speed = 2750;
+    volatile uint16_t cadence = 176;
+    benchRun("fixed point: power + level", iterations, [&]() {
+        int32_t levelX100 = simLevelX100(simRequiredPowerMilliwatts(p, speed), cadence);
+        benchKeep(levelX100);
+    });
+    benchRun("float reference: power + level", iterations, [&]() {
+        float level = ergModelLevel(erg, (float)referencePowerW(p, speed / 100.0), cadence / 2.0f);
+        benchKeep(level);
+    });
+    return 0;
+}
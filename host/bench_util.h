@@ -0,0 +1,32 @@
+#ifndef HOST_BENCH_UTIL_H
+#define HOST_BENCH_UTIL_H
+
+// Minimal timing helpers shared by the host benchmark tools.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+// Defeats dead-code elimination of benchmark results.
+template<typename T>
+inline void benchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs fn() 'iterations' times and prints ns per call.
+template<typename Fn>
+double benchRun(const char* name, uint32_t iterations, Fn fn) {
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++) fn(); // Warm-up
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) fn();
+    double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start).count();
+    double nsPerOp = elapsedNs / iterations;
+    printf("  %-44s %10.1f ns/op  (%u iterations)\n", name, nsPerOp, iterations);
+    return nsPerOp;
+}
+
+#define BENCH_CHECK(cond) \
+    do { if (!(cond)) { fprintf(stderr, "CHECK FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); return 1; } } while (0)
+
+#endif // HOST_BENCH_UTIL_H
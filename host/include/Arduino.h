@@ -0,0 +1,81 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host (Linux) stand-in for the parts of the ESP32 Arduino core used by the bridge.
+// Only what the sketch and its modules actually call is provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#define IRAM_ATTR
+
+#define LOW    0x0
+#define HIGH   0x1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// --- Host pin control (not part of the Arduino API) ---
+void hostSetPinLevel(uint8_t pin, int level); // Drives what digitalRead() returns
+int hostGetPinLevel(uint8_t pin);             // Last digitalWrite() value
+
+// --- Hardware timer (esp32-hal-timer.h) ---
+// Runs the alarm callback on a host thread; one tick is one microsecond whatever the divider.
+struct hw_timer_s;
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerEnd(hw_timer_t* timer);
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool edge);
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload);
+void timerAlarmEnable(hw_timer_t* timer);
+void timerAlarmDisable(hw_timer_t* timer);
+void timerWrite(hw_timer_t* timer, uint64_t value);
+
+// --- Serial ---
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+    operator bool() const { return true; }
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t print(const char* str);
+    size_t print(const std::string& str) { return print(str.c_str()); }
+    size_t print(int value);
+    size_t println(const char* str);
+    size_t println(const std::string& str) { return println(str.c_str()); }
+    size_t println();
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void flush();
+    int available();
+    int read();
+};
+extern HardwareSerial Serial;
+
+// --- Host serial control (not part of the Arduino API) ---
+void hostSetSerialEcho(bool enabled);       // false = swallow output (benchmarks)
+void hostFeedSerialInput(const char* text); // Bytes returned by Serial.read()
+unsigned long hostSerialBytesWritten();
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,549 @@
+#ifndef HOST_NIMBLE_DEVICE_H
+#define HOST_NIMBLE_DEVICE_H
+
+// Host (Linux) stand-in for the NimBLE-Arduino 1.4 API surface used by the bridge.
+// Characteristics keep their value in memory and record what was notified/indicated,
+// so the data path can be driven and inspected without a radio.
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+// --- NimBLE host types ---
+#define BLE_ADDR_PUBLIC 0
+#define BLE_ADDR_RANDOM 1
+
+#define BLE_HCI_SCAN_FILT_NO_WL        0
+#define BLE_HCI_SCAN_FILT_USE_WL       1
+#define BLE_HCI_SCAN_FILT_NO_WL_INITA  2
+#define BLE_HCI_SCAN_FILT_USE_WL_INITA 3
+
+#define BLE_HS_CONN_HANDLE_NONE 0xFFFF
+
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct ble_gap_sec_state {
+    unsigned encrypted:1;
+    unsigned authenticated:1;
+    unsigned bonded:1;
+    unsigned key_size:5;
+};
+
+struct ble_gap_conn_desc {
+    struct ble_gap_sec_state sec_state;
+    ble_addr_t our_id_addr;
+    ble_addr_t peer_id_addr;
+    ble_addr_t our_ota_addr;
+    ble_addr_t peer_ota_addr;
+    uint16_t conn_handle;
+    uint16_t conn_itvl;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;
+    uint8_t role;
+    uint8_t master_clock_accuracy;
+};
+
+struct ble_gap_upd_params {
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+    uint16_t min_ce_len;
+    uint16_t max_ce_len;
+};
+
+#define BLE_HS_ENOTCONN 7
+#define BLE_HS_ENOMEM 6
+
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t* out_rssi);
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc* out_desc);
+
+// NimBLE's msys buffer pool (os/os_mbuf.h): every notification draws one until the controller sends it.
+int os_msys_count(void);
+int os_msys_num_free(void);
+
+// --- Host GAP simulation (not part of NimBLE) ---
+// Links opened by NimBLEServer::hostConnect and NimBLEClient::connect, as ble_gap_conn_find reports them.
+// A peer takes the low end of a requested interval range (and the latency) unless told to refuse.
+void hostGapSetRssi(uint16_t connHandle, int8_t rssi);
+void hostGapRefuseUpdates(uint16_t connHandle, bool refuse);
+uint32_t hostGapUpdateRequests(uint16_t connHandle);
+void hostSetMsysFree(int freeBuffers); // Default: the whole pool
+
+namespace NIMBLE_PROPERTY {
+    enum {
+        READ = 0x0002, READ_ENC = 0x0004, READ_AUTHEN = 0x0008, READ_AUTHOR = 0x0010,
+        WRITE = 0x0020, WRITE_NR = 0x0040, WRITE_ENC = 0x0080, WRITE_AUTHEN = 0x0100,
+        WRITE_AUTHOR = 0x0200, BROADCAST = 0x0001, NOTIFY = 0x0400, INDICATE = 0x0800
+    };
+}
+
+// --- NimBLEUUID ---
+class NimBLEUUID {
+public:
+    NimBLEUUID() : m_str() {}
+    NimBLEUUID(uint16_t uuid16);
+    NimBLEUUID(const char* uuid) : m_str(normalize(uuid)) {}
+    NimBLEUUID(const std::string& uuid) : m_str(normalize(uuid)) {}
+    bool equals(const NimBLEUUID& uuid) const { return m_str == uuid.m_str; }
+    bool operator==(const NimBLEUUID& rhs) const { return equals(rhs); }
+    bool operator!=(const NimBLEUUID& rhs) const { return !equals(rhs); }
+    std::string toString() const { return m_str; }
+private:
+    static std::string normalize(const std::string& uuid);
+    std::string m_str; // Full 128-bit form, lower case
+};
+
+// --- NimBLEAddress ---
+class NimBLEAddress {
+public:
+    NimBLEAddress();
+    NimBLEAddress(ble_addr_t address);
+    NimBLEAddress(const std::string& stringAddress, uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(const uint8_t address[6], uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(const uint64_t& address, uint8_t type = BLE_ADDR_PUBLIC);
+    bool equals(const NimBLEAddress& otherAddress) const;
+    const uint8_t* getNative() const { return m_address; }
+    uint8_t getType() const { return m_addrType; }
+    std::string toString() const;
+    bool operator==(const NimBLEAddress& rhs) const { return equals(rhs); }
+    bool operator!=(const NimBLEAddress& rhs) const { return !equals(rhs); }
+    operator uint64_t() const;
+private:
+    uint8_t m_address[6]; // Little-endian, as in NimBLE
+    uint8_t m_addrType;
+};
+
+// --- NimBLEAttValue ---
+class NimBLEAttValue {
+public:
+    NimBLEAttValue() {}
+    NimBLEAttValue(const uint8_t* value, size_t len) : m_value(value, value + len) {}
+    // Like NimBLE's, the buffer only grows: a value no longer than the largest so far is copied in place.
+    void setValue(const uint8_t* value, size_t len) { m_value.assign(value, value + len); }
+    const uint8_t* data() const { return m_value.data(); }
+    size_t length() const { return m_value.size(); }
+    size_t size() const { return m_value.size(); }
+    operator std::string() const { return std::string(m_value.begin(), m_value.end()); }
+    template<typename T>
+    T getValue(time_t* timestamp = nullptr, bool skipSizeCheck = false) const {
+        T result = T();
+        if (!skipSizeCheck && m_value.size() < sizeof(T)) return result;
+        memcpy(&result, m_value.data(), m_value.size() < sizeof(T) ? m_value.size() : sizeof(T));
+        return result;
+    }
+private:
+    std::vector<uint8_t> m_value;
+};
+
+class NimBLEServer;
+class NimBLEService;
+class NimBLECharacteristic;
+class NimBLEClient;
+class NimBLERemoteService;
+class NimBLERemoteCharacteristic;
+class NimBLEAdvertisedDevice;
+
+// --- Callback interfaces ---
+class NimBLEServerCallbacks {
+public:
+    virtual ~NimBLEServerCallbacks() {}
+    virtual void onConnect(NimBLEServer* pServer) {}
+    virtual void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {}
+    virtual void onDisconnect(NimBLEServer* pServer) {}
+    virtual void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {}
+    virtual void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) {}
+};
+
+class NimBLECharacteristicCallbacks {
+public:
+    virtual ~NimBLECharacteristicCallbacks() {}
+    virtual void onRead(NimBLECharacteristic* pCharacteristic) {}
+    virtual void onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {}
+    virtual void onWrite(NimBLECharacteristic* pCharacteristic) {}
+    virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {}
+    virtual void onNotify(NimBLECharacteristic* pCharacteristic) {}
+    virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {}
+    enum Status {
+        SUCCESS_INDICATE, SUCCESS_NOTIFY, ERROR_INDICATE_DISABLED, ERROR_NOTIFY_DISABLED,
+        ERROR_GATT, ERROR_NO_CLIENT, ERROR_INDICATE_TIMEOUT, ERROR_INDICATE_FAILURE
+    };
+    virtual void onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) {}
+};
+
+class NimBLEClientCallbacks {
+public:
+    virtual ~NimBLEClientCallbacks() {}
+    virtual void onConnect(NimBLEClient* pClient) {}
+    virtual void onDisconnect(NimBLEClient* pClient) {}
+    virtual bool onConnParamsUpdateRequest(NimBLEClient* pClient, const ble_gap_upd_params* params) { return true; }
+    virtual uint32_t onPassKeyRequest() { return 123456; }
+    virtual void onAuthenticationComplete(ble_gap_conn_desc* desc) {}
+    virtual bool onConfirmPIN(uint32_t pin) { return true; }
+};
+
+class NimBLEAdvertisedDeviceCallbacks {
+public:
+    virtual ~NimBLEAdvertisedDeviceCallbacks() {}
+    virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) = 0;
+};
+
+// --- Peripheral side ---
+class NimBLECharacteristic {
+public:
+    NimBLECharacteristic(const NimBLEUUID& uuid, uint16_t properties, NimBLEService* pService)
+        : m_uuid(uuid), m_properties(properties), m_pService(pService) {}
+
+    NimBLEUUID getUUID() const { return m_uuid; }
+    uint16_t getProperties() const { return m_properties; }
+    uint16_t getHandle() const { return m_handle; }
+    NimBLEService* getService() { return m_pService; }
+
+    void setCallbacks(NimBLECharacteristicCallbacks* pCallbacks) { m_pCallbacks = pCallbacks; }
+    NimBLECharacteristicCallbacks* getCallbacks() { return m_pCallbacks; }
+
+    void setValue(const uint8_t* data, size_t size);
+    void setValue(const std::vector<uint8_t>& vec) { setValue(vec.data(), vec.size()); }
+    void setValue(const std::string& value) { setValue((const uint8_t*)value.data(), value.length()); }
+    void setValue(const char* value) { setValue((const uint8_t*)value, strlen(value)); }
+    template<typename T>
+    void setValue(const T& s) { setValue((const uint8_t*)&s, sizeof(T)); }
+
+    NimBLEAttValue getValue(time_t* timestamp = nullptr) const { return m_value; }
+    template<typename T>
+    T getValue(time_t* timestamp = nullptr, bool skipSizeCheck = false) const {
+        return m_value.getValue<T>(timestamp, skipSizeCheck);
+    }
+    size_t getDataLength() const { return m_value.length(); }
+
+    // conn_handle: one central only; BLE_HS_CONN_HANDLE_NONE = every subscribed central.
+    void notify(bool is_notification = true, uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE);
+    void notify(const uint8_t* value, size_t length, bool is_notification = true, uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE);
+    void notify(const std::vector<uint8_t>& value, bool is_notification = true) { notify(value.data(), value.size(), is_notification); }
+    void indicate();
+    void indicate(const uint8_t* value, size_t length);
+    size_t getSubscribedCount() const { return m_subscribedCount; }
+
+    // --- Host inspection (not part of NimBLE) ---
+    void hostSetSubscribedCount(size_t count) { m_subscribedCount = count; }
+    // Writes the CCCD as a central would: updates the count and calls onSubscribe.
+    void hostSubscribe(ble_gap_conn_desc* desc, uint16_t subValue);
+    // Reads the value as a central would: onRead first, then the value it left.
+    NimBLEAttValue hostRead(ble_gap_conn_desc* desc);
+    uint16_t hostLastConnHandle() const { return m_lastConnHandle; } // Target of the last send
+    uint32_t hostNotifyCount() const { return m_notifyCount; }
+    uint32_t hostIndicateCount() const { return m_indicateCount; }
+    const std::vector<uint8_t>& hostLastSent() const { return m_lastSent; }
+    // Called with every notified/indicated payload; used by host benchmarks and tools.
+    std::function<void(NimBLECharacteristic*, const uint8_t*, size_t, bool isNotify)> hostOnSend;
+
+private:
+    void hostRecordSend(const uint8_t* value, size_t length, bool isNotify, uint16_t connHandle);
+
+    NimBLEUUID m_uuid;
+    uint16_t m_properties;
+    uint16_t m_handle = 0;
+    NimBLEService* m_pService;
+    NimBLECharacteristicCallbacks* m_pCallbacks = nullptr;
+    NimBLEAttValue m_value;
+    size_t m_subscribedCount = 0;
+    uint32_t m_notifyCount = 0;
+    uint32_t m_indicateCount = 0;
+    std::vector<uint8_t> m_lastSent;
+    uint16_t m_lastConnHandle = BLE_HS_CONN_HANDLE_NONE;
+};
+
+class NimBLEService {
+public:
+    NimBLEService(const NimBLEUUID& uuid, NimBLEServer* pServer) : m_uuid(uuid), m_pServer(pServer) {}
+    ~NimBLEService();
+    NimBLECharacteristic* createCharacteristic(const NimBLEUUID& uuid,
+                                               uint32_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                                               uint16_t max_len = 512);
+    NimBLECharacteristic* getCharacteristic(const NimBLEUUID& uuid);
+    NimBLEUUID getUUID() const { return m_uuid; }
+    bool start() { m_started = true; return true; }
+    bool isStarted() const { return m_started; }
+private:
+    NimBLEUUID m_uuid;
+    NimBLEServer* m_pServer;
+    bool m_started = false;
+    std::vector<NimBLECharacteristic*> m_chars;
+};
+
+class NimBLEServer {
+public:
+    ~NimBLEServer();
+    NimBLEService* createService(const NimBLEUUID& uuid);
+    NimBLEService* getServiceByUUID(const NimBLEUUID& uuid);
+    void setCallbacks(NimBLEServerCallbacks* pCallbacks, bool deleteCallbacks = true) { m_pCallbacks = pCallbacks; }
+    NimBLEServerCallbacks* getCallbacks() { return m_pCallbacks; }
+    size_t getConnectedCount() const { return m_connectedCount; }
+    uint16_t getPeerMTU(uint16_t conn_id);
+    void updateConnParams(uint16_t conn_handle, uint16_t minInterval, uint16_t maxInterval,
+                          uint16_t latency, uint16_t timeout);
+    int disconnect(uint16_t connID, uint8_t reason = 0x13);
+    void advertiseOnDisconnect(bool aod) {}
+    bool startAdvertising();
+    bool stopAdvertising();
+
+    // --- Host connection simulation (not part of NimBLE) ---
+    // Fills 'desc' and invokes the server callbacks as the stack would on a new central.
+    void hostConnect(uint16_t connHandle, uint16_t mtu, ble_gap_conn_desc* desc);
+    void hostDisconnect(uint16_t connHandle);
+    uint32_t hostConnParamUpdates() const { return m_connParamUpdates; }
+private:
+    NimBLEServerCallbacks* m_pCallbacks = nullptr;
+    std::vector<NimBLEService*> m_services;
+    size_t m_connectedCount = 0;
+    uint16_t m_peerMtu[8] = {0};
+    uint16_t m_peerHandle[8] = {BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE,
+                                BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE, BLE_HS_CONN_HANDLE_NONE};
+    uint32_t m_connParamUpdates = 0;
+};
+
+class NimBLEAdvertisementData {
+public:
+    void setFlags(uint8_t flag) { m_flags = flag; }
+    void setCompleteServices(const NimBLEUUID& uuid) { m_services.push_back(uuid); }
+    void setCompleteServices16(const std::vector<NimBLEUUID>& uuids) { m_services.insert(m_services.end(), uuids.begin(), uuids.end()); }
+    void setAppearance(uint16_t appearance) { m_appearance = appearance; }
+    void setName(const std::string& name) { m_name = name; }
+    void setManufacturerData(const std::string& data) {}
+    std::string getPayload() const { return m_name; }
+private:
+    uint8_t m_flags = 0;
+    std::vector<NimBLEUUID> m_services;
+    uint16_t m_appearance = 0;
+    std::string m_name;
+};
+
+class NimBLEAdvertising {
+public:
+    void addServiceUUID(const NimBLEUUID& serviceUUID) {}
+    void setAdvertisementData(NimBLEAdvertisementData& advertisementData) {}
+    void setScanResponseData(NimBLEAdvertisementData& advertisementData) {}
+    void setScanResponse(bool) {}
+    void setMinPreferred(uint16_t) {}
+    void setMaxPreferred(uint16_t) {}
+    void setMinInterval(uint16_t) {}
+    void setMaxInterval(uint16_t) {}
+    bool start(uint32_t duration = 0, void (*advCompleteCB)(NimBLEAdvertising*) = nullptr) { m_advertising = true; return true; }
+    bool stop() { m_advertising = false; return true; }
+    bool isAdvertising() const { return m_advertising; }
+private:
+    bool m_advertising = false;
+};
+
+// --- Central side ---
+class NimBLEScanResults {
+public:
+    int getCount() { return 0; }
+};
+
+class NimBLEAdvertisedDevice {
+public:
+    NimBLEAdvertisedDevice() {}
+    NimBLEAddress getAddress() const { return m_address; }
+    uint8_t getAddressType() const { return m_address.getType(); }
+    std::string getName() const { return m_name; }
+    int getRSSI() const { return m_rssi; }
+    bool haveName() const { return !m_name.empty(); }
+    bool haveServiceUUID() const { return !m_services.empty(); }
+    bool isAdvertisingService(const NimBLEUUID& uuid) const;
+    bool haveManufacturerData() const { return !m_manufacturerData.empty(); }
+    std::string getManufacturerData() const { return m_manufacturerData; }
+
+    // --- Host construction (not part of NimBLE) ---
+    void hostSet(const NimBLEAddress& address, const std::string& name, int rssi) { m_address = address; m_name = name; m_rssi = rssi; }
+    void hostAddService(const NimBLEUUID& uuid) { m_services.push_back(uuid); }
+    void hostSetManufacturerData(const std::string& data) { m_manufacturerData = data; }
+private:
+    NimBLEAddress m_address;
+    std::string m_name;
+    int m_rssi = -127;
+    std::vector<NimBLEUUID> m_services;
+    std::string m_manufacturerData;
+};
+
+class NimBLEScan {
+public:
+    void setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks* pCallbacks, bool wantDuplicates = false) { m_pCallbacks = pCallbacks; }
+    void setActiveScan(bool active) { m_active = active; }
+    void setInterval(uint16_t intervalMSecs) { m_interval = intervalMSecs; }
+    void setWindow(uint16_t windowMSecs) { m_window = windowMSecs; }
+    void setFilterPolicy(uint8_t filter) { m_filterPolicy = filter; }
+    void setDuplicateFilter(bool enabled) {}
+    void setMaxResults(uint8_t maxResults) {}
+    bool start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResults), bool is_continue = false) {
+        m_scanning = true;
+        m_duration = duration;
+        m_scanCompleteCB = scanCompleteCB;
+        m_starts++;
+        return true;
+    }
+    NimBLEScanResults start(uint32_t duration, bool is_continue = false) { m_scanning = false; m_starts++; return NimBLEScanResults(); }
+    bool stop(); // Calls the completion callback, as NimBLE 1.4 does
+    bool isScanning() const { return m_scanning; }
+    void clearResults() {}
+
+    // --- Host inspection (not part of NimBLE) ---
+    // Applies the filter policy as the controller would: with the white list in use, others never reach the callback.
+    void hostDeliver(NimBLEAdvertisedDevice* device);
+    void hostFinish() { stop(); } // The scan's duration ran out
+    uint16_t hostInterval() const { return m_interval; }
+    uint16_t hostWindow() const { return m_window; }
+    uint8_t hostFilterPolicy() const { return m_filterPolicy; }
+    bool hostActive() const { return m_active; }
+    uint32_t hostDuration() const { return m_duration; }
+    uint32_t hostStarts() const { return m_starts; }
+    uint32_t hostFiltered() const { return m_filtered; } // Dropped by the white list
+private:
+    NimBLEAdvertisedDeviceCallbacks* m_pCallbacks = nullptr;
+    void (*m_scanCompleteCB)(NimBLEScanResults) = nullptr;
+    bool m_scanning = false;
+    bool m_active = false;
+    uint16_t m_interval = 0;
+    uint16_t m_window = 0;
+    uint8_t m_filterPolicy = 0;
+    uint32_t m_duration = 0;
+    uint32_t m_starts = 0;
+    uint32_t m_filtered = 0;
+};
+
+class NimBLERemoteCharacteristic {
+public:
+    typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                uint8_t* pData, size_t length, bool isNotify)> notify_callback;
+
+    NimBLERemoteCharacteristic(const NimBLEUUID& uuid, uint16_t handle, uint16_t properties, NimBLERemoteService* pService)
+        : m_uuid(uuid), m_handle(handle), m_properties(properties), m_pService(pService) {}
+
+    NimBLEUUID getUUID() const { return m_uuid; }
+    uint16_t getHandle() const { return m_handle; }
+    NimBLERemoteService* getRemoteService() { return m_pService; }
+    bool canRead() const { return m_properties & NIMBLE_PROPERTY::READ; }
+    bool canWrite() const { return m_properties & (NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR); }
+    bool canWriteNoResponse() const { return m_properties & NIMBLE_PROPERTY::WRITE_NR; }
+    bool canNotify() const { return m_properties & NIMBLE_PROPERTY::NOTIFY; }
+    bool canIndicate() const { return m_properties & NIMBLE_PROPERTY::INDICATE; }
+
+    NimBLEAttValue readValue(time_t* timestamp = nullptr) { return m_value; }
+    bool writeValue(const uint8_t* data, size_t length, bool response = false);
+    bool writeValue(const std::vector<uint8_t>& v, bool response = false) { return writeValue(v.data(), v.size(), response); }
+    template<typename T>
+    bool writeValue(const T& s, bool response = false) { return writeValue((const uint8_t*)&s, sizeof(T), response); }
+    bool subscribe(bool notifications = true, notify_callback notifyCallback = nullptr, bool response = false);
+    bool unsubscribe(bool response = false) { m_notifyCallback = nullptr; return true; }
+
+    // --- Host simulation (not part of NimBLE) ---
+    void hostSetValue(const uint8_t* data, size_t length) { m_value = NimBLEAttValue(data, length); }
+    void hostNotify(uint8_t* data, size_t length) { if (m_notifyCallback) m_notifyCallback(this, data, length, true); }
+    const std::vector<uint8_t>& hostLastWrite() const { return m_lastWrite; }
+private:
+    NimBLEUUID m_uuid;
+    uint16_t m_handle;
+    uint16_t m_properties;
+    NimBLERemoteService* m_pService;
+    NimBLEAttValue m_value;
+    notify_callback m_notifyCallback;
+    std::vector<uint8_t> m_lastWrite;
+};
+
+class NimBLERemoteService {
+public:
+    NimBLERemoteService(const NimBLEUUID& uuid, NimBLEClient* pClient) : m_uuid(uuid), m_pClient(pClient) {}
+    ~NimBLERemoteService();
+    NimBLEUUID getUUID() const { return m_uuid; }
+    NimBLEClient* getClient() { return m_pClient; }
+    NimBLERemoteCharacteristic* getCharacteristic(const char* uuid) { return getCharacteristic(NimBLEUUID(uuid)); }
+    NimBLERemoteCharacteristic* getCharacteristic(const NimBLEUUID& uuid);
+
+    // --- Host construction (not part of NimBLE) ---
+    NimBLERemoteCharacteristic* hostAddCharacteristic(const NimBLEUUID& uuid, uint16_t handle, uint16_t properties);
+    // Whether the client holds this service locally (NimBLE's attribute cache), i.e. getService() skips the GATT round trip.
+    bool hostDiscovered() const { return m_discovered; }
+    void hostSetDiscovered(bool discovered) { m_discovered = discovered; }
+private:
+    NimBLEUUID m_uuid;
+    NimBLEClient* m_pClient;
+    std::vector<NimBLERemoteCharacteristic*> m_chars;
+    bool m_discovered = false;
+};
+
+class NimBLEClient {
+public:
+    ~NimBLEClient();
+    bool connect(NimBLEAdvertisedDevice* device, bool deleteAttributes = true);
+    bool connect(const NimBLEAddress& address, bool deleteAttributes = true);
+    bool connect(bool deleteAttributes = true) { return connect(m_peerAddress, deleteAttributes); }
+    int disconnect(uint8_t reason = 0x13);
+    bool isConnected() const { return m_connected; }
+    NimBLEAddress getPeerAddress() const { return m_peerAddress; }
+    void setPeerAddress(const NimBLEAddress& address) { m_peerAddress = address; }
+    uint16_t getConnId() const { return m_connHandle; }
+    uint16_t getMTU() const { return m_mtu; }
+    int getRssi() { return m_rssi; }
+    void setClientCallbacks(NimBLEClientCallbacks* pClientCallbacks, bool deleteCallbacks = true) { m_pCallbacks = pClientCallbacks; }
+    void setConnectionParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout,
+                             uint16_t scanInterval = 16, uint16_t scanWindow = 16);
+    void updateConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout);
+    void setConnectTimeout(uint8_t timeout) {}
+    NimBLERemoteService* getService(const char* uuid) { return getService(NimBLEUUID(uuid)); }
+    NimBLERemoteService* getService(const NimBLEUUID& uuid);
+    bool discoverAttributes() { return true; }
+    void deleteServices();
+
+    // --- Host simulation (not part of NimBLE) ---
+    // The bike's GATT database; deleteServices() and connect(..., true) only forget what was discovered of it.
+    NimBLERemoteService* hostAddService(const NimBLEUUID& uuid);
+    void hostClearServices();
+    void hostSetConnectResult(bool success) { m_connectResult = success; }
+    void hostSetRssi(int rssi) { m_rssi = rssi; }
+    uint16_t hostConnIntervalMax() const { return m_maxInterval; }
+    uint16_t hostConnLatency() const { return m_latency; }
+    uint32_t hostServiceLookups() const { return m_serviceLookups; }
+    uint32_t hostGattDiscoveries() const { return m_gattDiscoveries; } // Services fetched over the air
+private:
+    NimBLEClientCallbacks* m_pCallbacks = nullptr;
+    NimBLEAddress m_peerAddress;
+    std::vector<NimBLERemoteService*> m_services;
+    bool m_connected = false;
+    bool m_connectResult = true;
+    uint16_t m_connHandle = BLE_HS_CONN_HANDLE_NONE;
+    uint16_t m_mtu = 23;
+    int m_rssi = -60;
+    uint16_t m_minInterval = 0, m_maxInterval = 0, m_latency = 0, m_timeout = 0;
+    uint32_t m_serviceLookups = 0;
+    uint32_t m_gattDiscoveries = 0;
+};
+
+// --- NimBLEDevice ---
+class NimBLEDevice {
+public:
+    static void init(const std::string& deviceName);
+    static void deinit(bool clearAll = false);
+    static NimBLEServer* createServer();
+    static NimBLEServer* getServer();
+    static NimBLEAdvertising* getAdvertising();
+    static bool startAdvertising();
+    static bool stopAdvertising();
+    static NimBLEScan* getScan();
+    static NimBLEClient* createClient(NimBLEAddress peerAddress = NimBLEAddress());
+    static bool deleteClient(NimBLEClient* pClient);
+    static size_t getClientListSize();
+    static bool setMTU(uint16_t mtu);
+    static uint16_t getMTU();
+    static void setPower(int powerLevel) {}
+    static bool whiteListAdd(const NimBLEAddress& address);
+    static bool whiteListRemove(const NimBLEAddress& address);
+    static bool onWhiteList(const NimBLEAddress& address);
+    static size_t getWhiteListCount();
+    static NimBLEAddress getWhiteListAddress(size_t index);
+};
+
+#endif // HOST_NIMBLE_DEVICE_H
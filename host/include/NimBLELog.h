@@ -0,0 +1,3 @@
+#ifndef HOST_NIMBLE_LOG_H
+#define HOST_NIMBLE_LOG_H
+#endif // HOST_NIMBLE_LOG_H
@@ -0,0 +1,33 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// Host (Linux) stand-in for the ESP32 Preferences (NVS) library.
+// Namespaces and keys live in process memory, so a save/load round trip can be checked.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class Preferences {
+public:
+    Preferences() : started(false), readOnly(false) {}
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = NULL);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    bool isKey(const char* key);
+
+private:
+    std::string name;
+    bool started;
+    bool readOnly;
+};
+
+// --- Host NVS control (not part of the Preferences API) ---
+void hostNvsErase();               // Forget every namespace ("erase flash")
+unsigned long hostNvsWriteCount(); // putBytes() calls that stored data
+
+#endif // HOST_PREFERENCES_H
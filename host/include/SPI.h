@@ -0,0 +1,4 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+#include <Arduino.h>
+#endif // HOST_SPI_H
@@ -0,0 +1,84 @@
+#ifndef HOST_TFT_ESPI_H
+#define HOST_TFT_ESPI_H
+
+// Host (Linux) stand-in for TFT_eSPI / TFT_eSprite. Drawing calls are accepted and
+// discarded; pushes are counted (with their pixel area) so display work can be measured.
+
+#include <Arduino.h>
+
+#define TFT_BLACK       0x0000
+#define TFT_NAVY        0x000F
+#define TFT_DARKGREEN   0x03E0
+#define TFT_DARKCYAN    0x03EF
+#define TFT_MAROON      0x7800
+#define TFT_PURPLE      0x780F
+#define TFT_OLIVE       0x7BE0
+#define TFT_LIGHTGREY   0xD69A
+#define TFT_DARKGREY    0x7BEF
+#define TFT_BLUE        0x001F
+#define TFT_GREEN       0x07E0
+#define TFT_CYAN        0x07FF
+#define TFT_RED         0xF800
+#define TFT_MAGENTA     0xF81F
+#define TFT_YELLOW      0xFFE0
+#define TFT_WHITE       0xFFFF
+#define TFT_ORANGE      0xFDA0
+#define TFT_GREENYELLOW 0xB7E0
+#define TFT_PINK        0xFE19
+#define TFT_BROWN       0x9A60
+#define TFT_GOLD        0xFEA0
+#define TFT_SILVER      0xC618
+#define TFT_SKYBLUE     0x867D
+#define TFT_VIOLET      0x915C
+
+class TFT_eSPI {
+public:
+    TFT_eSPI(int16_t w = 320, int16_t h = 240) : m_width(w), m_height(h) {}
+    void init() {}
+    void setRotation(uint8_t r) {}
+    int16_t width() const { return m_width; }
+    int16_t height() const { return m_height; }
+    void fillScreen(uint32_t color) {}
+protected:
+    int16_t m_width;
+    int16_t m_height;
+};
+
+class TFT_eSprite {
+public:
+    explicit TFT_eSprite(TFT_eSPI* tft) : m_tft(tft) {}
+    void* createSprite(int16_t w, int16_t h) { m_width = w; m_height = h; return this; }
+    int16_t width() const { return m_width; }
+    int16_t height() const { return m_height; }
+    void fillSprite(uint32_t color) {}
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {}
+    void setTextColor(uint16_t fg, uint16_t bg) {}
+    void setTextColor(uint16_t fg) {}
+    void setTextSize(uint8_t size) { m_textSize = size; }
+    void setTextWrap(bool wrapX, bool wrapY = false) {}
+    void setCursor(int16_t x, int16_t y) {}
+    int16_t textWidth(const char* string) const { return (int16_t)(strlen(string) * 6 * m_textSize); }
+    int16_t fontHeight() const { return (int16_t)(8 * m_textSize); }
+    size_t print(const char* str) { return strlen(str); }
+    size_t print(int value) { return 1; }
+    size_t println(const char* str) { return strlen(str) + 1; }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) { return 0; }
+    void drawString(const char* string, int32_t x, int32_t y) {}
+    void pushSprite(int32_t x, int32_t y) { m_pushCount++; m_pushedPixels += (uint32_t)m_width * m_height; }
+    bool pushSprite(int32_t tx, int32_t ty, int32_t sx, int32_t sy, int32_t sw, int32_t sh) {
+        m_pushCount++; m_pushedPixels += (uint32_t)sw * sh; return true;
+    }
+
+    // --- Host inspection (not part of TFT_eSPI) ---
+    uint32_t hostPushCount() const { return m_pushCount; }
+    uint32_t hostPushedPixels() const { return m_pushedPixels; }
+private:
+    TFT_eSPI* m_tft;
+    int16_t m_width = 0;
+    int16_t m_height = 0;
+    uint8_t m_textSize = 1;
+    uint32_t m_pushCount = 0;
+    uint32_t m_pushedPixels = 0;
+};
+
+#endif // HOST_TFT_ESPI_H
@@ -0,0 +1,48 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Host (Linux) stand-in for the subset of FreeRTOS used by the bridge.
+// Tasks run on std::thread, one tick is one millisecond (configTICK_RATE_HZ 1000 on the ESP32 core).
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY (-1)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+#define configUSE_TRACE_FACILITY 1        // uxTaskGetSystemState
+#define configGENERATE_RUN_TIME_STATS 1   // Run-time counters: thread CPU time in microseconds on the host
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+// Critical sections: one process-wide recursive lock on the host.
+typedef struct {
+    volatile uint32_t owner;
+    volatile uint32_t count;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+void hostEnterCritical(portMUX_TYPE* mux);
+void hostExitCritical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux)     hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      hostExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  hostExitCritical(mux)
+#define portYIELD_FROM_ISR(x)       ((void)(x))
+
+BaseType_t xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
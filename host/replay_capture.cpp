@@ -0,0 +1,165 @@
+// Replays a raw bike capture (see bike_capture.h) through the parse -> encode path on the host.
+// Usage:
+//   replay_capture <capture.bin | serial.log> [--realtime]   Replay a capture (binary image or a serial
+//                                                             log containing CAP: lines)
+//   replay_capture --synthesize <out.bin> <seconds>           Write a synthetic Merach S26 ride
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "system_tasks.h"
+#include "bike_capture.h"
+#include "telemetry.h"
+#include <vector>
+#include <string>
+#include <chrono>
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Extracts the capture image from a serial log: every "CAP:<hex>" line, in order.
+static std::vector<uint8_t> decodeSerialDump(const std::vector<uint8_t>& text) {
+    std::vector<uint8_t> image;
+    std::string log(text.begin(), text.end());
+    size_t pos = 0;
+    while ((pos = log.find("CAP:", pos)) != std::string::npos) {
+        pos += 4;
+        while (pos + 1 < log.size() && hexValue(log[pos]) >= 0 && hexValue(log[pos + 1]) >= 0) {
+            image.push_back((uint8_t)(hexValue(log[pos]) << 4 | hexValue(log[pos + 1])));
+            pos += 2;
+        }
+    }
+    return image;
+}
+
+static int synthesize(const char* path, uint32_t seconds) {
+    captureBegin(64 * 1024 * 1024);
+    int64_t t = 0;
+    uint8_t level = 3;
+    for (uint32_t tick = 0; tick < seconds * 4; tick++, t += 250000) {
+        // Rider surges every 30 s; power follows cadence and the resistance level.
+        uint32_t phase = (tick / 120) % 2;
+        uint16_t rpm = (uint16_t)(80 + phase * 15 + (tick % 7));
+        uint16_t speed = (uint16_t)(rpm * 30);                  // 0.01 km/h
+        uint16_t powerX10 = (uint16_t)(rpm * (8 + level * 4) * 10 / 5);
+        uint16_t rpmX2 = (uint16_t)(rpm * 2);
+        uint8_t data[] = {0x02, 0x42, 0x00, (uint8_t)speed, (uint8_t)(speed >> 8), 0x00,
+                          (uint8_t)rpmX2, (uint8_t)(rpmX2 >> 8), 0x00, (uint8_t)powerX10, (uint8_t)(powerX10 >> 8)};
+        captureRecordAt(CAPTURE_SOURCE_CUSTOM_DATA, data, sizeof(data), t);
+        if (tick % 4 == 2) {
+            uint16_t caloriesX10 = (uint16_t)(tick / 4);
+            uint8_t calories[] = {0x02, 0x43, 0x00, 0x00, 0x00, 0x00, (uint8_t)(caloriesX10 >> 8), (uint8_t)caloriesX10};
+            captureRecordAt(CAPTURE_SOURCE_CUSTOM_DATA, calories, sizeof(calories), t + 100000);
+        }
+        if (tick % 240 == 0) {
+            level = (uint8_t)(1 + (tick / 240) % 8);
+            uint8_t feature[] = {0x75, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, level, 0x00, 0x00, 0x00};
+            captureRecordAt(CAPTURE_SOURCE_FTMS_FEATURE, feature, sizeof(feature), t + 50000);
+        }
+    }
+    std::vector<uint8_t> image(captureExportSize());
+    size_t length = captureExport(image.data(), image.size());
+    FILE* f = fopen(path, "wb");
+    if (!f || fwrite(image.data(), 1, length, f) != length) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return 1;
+    }
+    fclose(f);
+    CaptureStats stats;
+    captureGetStats(stats);
+    printf("Wrote %s: %lu records, %u bytes, %u s of riding.\n", path, (unsigned long)stats.records, (unsigned)length, seconds);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    hostSetSerialEcho(false);
+    if (argc >= 4 && strcmp(argv[1], "--synthesize") == 0) {
+        return synthesize(argv[2], (uint32_t)strtoul(argv[3], nullptr, 10));
+    }
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <capture.bin|serial.log> [--realtime]\n       %s --synthesize <out.bin> <seconds>\n", argv[0], argv[0]);
+        return 2;
+    }
+    bool realTime = argc > 2 && strcmp(argv[2], "--realtime") == 0;
+
+    std::vector<uint8_t> raw;
+    if (!readFile(argv[1], raw)) {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> image = (raw.size() >= 4 && memcmp(raw.data(), CAPTURE_MAGIC, 4) == 0) ? raw : decodeSerialDump(raw);
+
+    // Encode every replayed sample the same way the forwarder would, for one subscribed app.
+    systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP);
+    for (int i = 0; i < 200 && !NimBLEDevice::getAdvertising()->isAdvertising(); i++) delay(10);
+    ble_gap_conn_desc appDesc;
+    pServer_Peripheral->hostConnect(1, 247, &appDesc);
+    pIndoorBikeDataCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0001);
+    bikeSensorConnected = true;
+
+    struct FastReplay {
+        CaptureReplayStats stats;
+        uint32_t lastSequence;
+        uint32_t encodes;
+    } fast;
+    memset(&fast, 0, sizeof(fast));
+    fast.lastSequence = telemetrySequence();
+
+    CaptureReplayStats stats;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok;
+    if (realTime) {
+        ok = captureReplay(image.data(), image.size(), true, &stats);
+    } else {
+        // As fast as possible: parse each record, then encode 0x2ACC whenever a new frame was published,
+        // as the forwarder task would.
+        ok = captureForEachRecord(image.data(), image.size(), [](const CaptureRecord& record, void* context) {
+            FastReplay* replay = (FastReplay*)context;
+            replay->stats.records++;
+            if (record.source == CAPTURE_SOURCE_CUSTOM_DATA) replay->stats.customDataRecords++;
+            else if (record.source == CAPTURE_SOURCE_FTMS_FEATURE) replay->stats.featureRecords++;
+            if (!captureReplayRecord(record)) replay->stats.malformed++;
+
+            uint32_t sequence = telemetrySequence();
+            if (sequence != replay->lastSequence) {
+                replay->lastSequence = sequence;
+                TelemetryFrame frame;
+                telemetryRead(frame);
+                if (sendDataToMyWhoosh(frame)) replay->encodes++;
+            }
+        }, &fast);
+        stats = fast.stats;
+    }
+    double elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+
+    if (!ok) {
+        fprintf(stderr, "Capture image is invalid or truncated (%u bytes).\n", (unsigned)image.size());
+        return 1;
+    }
+    TelemetryFrame last;
+    telemetryRead(last);
+    printf("Replayed %lu records (%lu 0xFFF1, %lu 0x2AD2, %lu unknown) in %.2f ms%s.\n",
+           (unsigned long)stats.records, (unsigned long)stats.customDataRecords, (unsigned long)stats.featureRecords,
+           (unsigned long)stats.malformed, elapsedMs, realTime ? " (real time)" : "");
+    if (stats.records > 0 && !realTime) {
+        printf("  %.1f ns per record (parse + 0x2ACC encode), %lu frames encoded.\n",
+               elapsedMs * 1e6 / stats.records, (unsigned long)fast.encodes);
+    }
+    printf("  Final frame: speed %.2f km/h, cadence %u (0.5 RPM), power %u W, calories %.1f, resistance %u\n",
+           last.speed / 100.0, last.cadence, last.power, last.caloriesX10 / 10.0, last.resistanceLevel);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Bike link (bike_link.cpp) on the host: reconnect policy and backoff, the known bike in NVS, attribute
+// reuse keyed by the bike's GATT Database Hash, automatic reconnects after a drop, and time to first sample.
+// Usage: sim_bike_link [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include "bike_link.h"
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "system_tasks.h"
+#include "bench_util.h"
+
+// Merach S26 0xFFF1 data packet: 25.00 km/h, 90 RPM (x2 = 180), 150.0 W (x10 = 1500)
+static uint8_t merachDataPacket[] = {0x02, 0x42, 0x00, 0xC4, 0x09, 0x00, 0xB4, 0x00, 0x00, 0xDC, 0x05};
+
+static bool waitForConnects(uint32_t connects, uint32_t timeoutMs) {
+    BikeLinkStats stats;
+    for (uint32_t waited = 0; waited < timeoutMs; waited++) {
+        bikeLinkGetStats(stats);
+        if (stats.connects >= connects && bikeSensorConnected) return true;
+        delay(1);
+    }
+    return false;
+}
+
+static bool storedHash(uint8_t* hash) {
+    bikeRegistryBegin(); // Reloaded from NVS
+    BikeRecord record;
+    if (!bikeRegistryGet(0, record) || !record.hashValid) return false;
+    memcpy(hash, record.databaseHash, BIKE_REGISTRY_HASH_SIZE);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Policy ---
+    printf("Reconnect backoff (ms):");
+    for (uint8_t failures = 1; failures <= 8; failures++) printf(" %lu", (unsigned long)bikeLinkBackoffMs(failures));
+    printf("\n");
+    BENCH_CHECK(bikeLinkBackoffMs(0) == 0 && bikeLinkBackoffMs(1) == BIKE_LINK_RETRY_MIN_MS);
+    BENCH_CHECK(bikeLinkBackoffMs(2) == 2 * BIKE_LINK_RETRY_MIN_MS && bikeLinkBackoffMs(255) == BIKE_LINK_RETRY_MAX_MS);
+
+    BikeLinkPolicy policy;
+    bikeLinkPolicyInit(policy, false, 1000);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, 1000) == BIKE_LINK_ACTION_NONE); // Nothing known: wait for the button
+    bikeLinkPolicyInit(policy, true, 1000);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, 1000) == BIKE_LINK_ACTION_CONNECT); // Boot: at once
+    bikeLinkPolicyAttempt(policy);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, 1000) == BIKE_LINK_ACTION_NONE);
+    bikeLinkPolicyFailed(policy, 1000);
+    BENCH_CHECK(policy.nextAttemptMs == 1000 + BIKE_LINK_RETRY_MIN_MS && bikeLinkPolicyNext(policy, 1100) == BIKE_LINK_ACTION_NONE);
+    uint32_t nowMs = policy.nextAttemptMs;
+    for (uint8_t failures = 2; failures <= 10; failures++) {
+        BENCH_CHECK(bikeLinkPolicyNext(policy, nowMs) == BIKE_LINK_ACTION_CONNECT);
+        bikeLinkPolicyAttempt(policy);
+        bikeLinkPolicyFailed(policy, nowMs);
+        BENCH_CHECK(policy.nextAttemptMs - nowMs == bikeLinkBackoffMs(failures) && policy.nextAttemptMs - nowMs <= BIKE_LINK_RETRY_MAX_MS);
+        nowMs = policy.nextAttemptMs;
+    }
+    bikeLinkPolicyAttempt(policy);
+    bikeLinkPolicyConnected(policy);
+    BENCH_CHECK(policy.failures == 0 && bikeLinkPolicyNext(policy, nowMs) == BIKE_LINK_ACTION_NONE);
+    bikeLinkPolicyDropped(policy, nowMs + 5);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, nowMs + 5) == BIKE_LINK_ACTION_CONNECT); // A drop retries at once
+    bikeLinkPolicyPause(policy);
+    bikeLinkPolicyFailed(policy, nowMs);
+    bikeLinkPolicyDropped(policy, nowMs);
+    BENCH_CHECK(policy.state == BIKE_LINK_IDLE && bikeLinkPolicyNext(policy, nowMs + 60000) == BIKE_LINK_ACTION_NONE);
+    // millis() wraps after 49.7 days; the wait must still end.
+    bikeLinkPolicyInit(policy, true, 0xFFFFFFC0u);
+    bikeLinkPolicyAttempt(policy);
+    bikeLinkPolicyFailed(policy, 0xFFFFFFC0u);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, 0x00000010u) == BIKE_LINK_ACTION_NONE);
+    BENCH_CHECK(bikeLinkPolicyNext(policy, 0xFFFFFFC0u + BIKE_LINK_RETRY_MIN_MS) == BIKE_LINK_ACTION_CONNECT);
+
+    // --- First connection: scan + button, full discovery, bike remembered ---
+    hostNvsErase();
+    bikeLinkBegin();
+    BENCH_CHECK(!bikeLinkKnown() && !bikeLinkReconnecting());
+
+    NimBLEClient* client = bikeClientGet();
+    NimBLERemoteService* gatt = client->hostAddService(NimBLEUUID((uint16_t)GENERIC_ATTRIBUTE_UUID_SHORT));
+    NimBLERemoteCharacteristic* hash = gatt->hostAddCharacteristic(NimBLEUUID((uint16_t)DATABASE_HASH_UUID_SHORT), 3, NIMBLE_PROPERTY::READ);
+    uint8_t hashValue[BIKE_REGISTRY_HASH_SIZE];
+    for (uint8_t i = 0; i < sizeof(hashValue); i++) hashValue[i] = (uint8_t)(0xA0 + i);
+    hash->hostSetValue(hashValue, sizeof(hashValue));
+    NimBLERemoteService* customService = client->hostAddService(NimBLEUUID((uint16_t)CUSTOM_SERVICE_UUID_SHORT));
+    NimBLERemoteCharacteristic* custom = customService->hostAddCharacteristic(NimBLEUUID(CUSTOM_DATA_CHAR_UUID_STR), 5, NIMBLE_PROPERTY::NOTIFY);
+    NimBLERemoteService* ftmsService = client->hostAddService(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), 9, NIMBLE_PROPERTY::WRITE);
+
+    NimBLEAdvertisedDevice bike;
+    bike.hostSet(NimBLEAddress(std::string("11:22:33:44:55:66")), "MRK-S26-0417", -55);
+    pTargetBikeDevice = new NimBLEAdvertisedDevice(bike);
+    bikeDriverSelect(bikeDriverMatch(&bike));
+    bikeAttemptingConnection = true;
+    bikeClientBegin();
+    systemTaskCreate(SYSTEM_TASK_BIKE_CONNECT);
+    bikeCommandPost(BIKE_COMMAND_CONNECT); // The button
+    BENCH_CHECK(waitForConnects(1, 2000));
+    uint32_t firstDiscoveries = client->hostGattDiscoveries();
+    custom->hostNotify(merachDataPacket, sizeof(merachDataPacket));
+    BikeLinkStats stats;
+    bikeLinkGetStats(stats);
+    BENCH_CHECK(bikeLinkKnown() && stats.connects == 1 && stats.autoConnects == 0 && stats.cacheHits == 0);
+    BENCH_CHECK(stats.lastFirstSampleMs >= stats.lastConnectMs && stats.lastOutageMs == 0);
+    uint8_t stored[BIKE_REGISTRY_HASH_SIZE];
+    BENCH_CHECK(storedHash(stored) && memcmp(stored, hashValue, sizeof(stored)) == 0);
+    printf("First connection: %u services discovered, link up %lu ms, first sample %lu ms\n", (unsigned)firstDiscoveries,
+           (unsigned long)stats.lastConnectMs, (unsigned long)stats.lastFirstSampleMs);
+
+    // --- Link lost: reconnected by address, attributes reused ---
+    delete pTargetBikeDevice; // As after a reboot: no scan result, only the known bike
+    pTargetBikeDevice = nullptr;
+    xTaskCreatePinnedToCore(bikeLinkTask_func, "BikeLink", 4096, NULL, 2, &bikeLinkTaskHandle, 0);
+    unsigned long nvsWrites = hostNvsWriteCount();
+    int64_t lostUs = esp_timer_get_time();
+    client->disconnect(); // Bike out of range for a moment
+    BENCH_CHECK(waitForConnects(2, 2000));
+    int64_t upUs = esp_timer_get_time();
+    custom->hostNotify(merachDataPacket, sizeof(merachDataPacket));
+    bikeLinkGetStats(stats);
+    BENCH_CHECK(stats.autoConnects == 1 && stats.cacheHits == 1 && stats.lastOutageMs > 0);
+    BENCH_CHECK(client->hostGattDiscoveries() == firstDiscoveries); // No GATT round trips
+    BENCH_CHECK(hostNvsWriteCount() == nvsWrites);                   // Same record: no flash write
+    printf("Reconnect after drop: link up %.1f ms, data outage %lu ms (driver start sequence included)\n",
+           (upUs - lostUs) / 1000.0, (unsigned long)stats.lastOutageMs);
+
+    // --- Bike firmware updated: new Database Hash, full discovery, record rewritten ---
+    bikeLinkPause();
+    client->disconnect();
+    delay(2 * BIKE_LINK_POLL_MS);
+    BENCH_CHECK(!bikeSensorConnected && !bikeLinkReconnecting()); // Paused by the button: stays down
+    hashValue[0] ^= 0xFF;
+    hash->hostSetValue(hashValue, sizeof(hashValue));
+    bikeLinkKick();
+    BENCH_CHECK(waitForConnects(3, 2000));
+    bikeLinkGetStats(stats);
+    BENCH_CHECK(stats.cacheHits == 1 && client->hostGattDiscoveries() > firstDiscoveries);
+    BENCH_CHECK(storedHash(stored) && memcmp(stored, hashValue, sizeof(stored)) == 0);
+
+    // --- Bike off: bounded backoff until it comes back ---
+    bikeLinkPause();
+    client->disconnect();
+    client->hostSetConnectResult(false);
+    bikeLinkKick();
+    for (int i = 0; i < 3000 && stats.failures < 3; i++) {
+        delay(1);
+        bikeLinkGetStats(stats);
+    }
+    BENCH_CHECK(stats.failures >= 3 && bikeLinkReconnecting());
+    client->hostSetConnectResult(true);
+    BENCH_CHECK(waitForConnects(4, 2 * BIKE_LINK_RETRY_MAX_MS));
+    custom->hostNotify(merachDataPacket, sizeof(merachDataPacket));
+    bikeLinkGetStats(stats);
+    BENCH_CHECK(stats.cacheHits == 2 && stats.lastOutageMs == 0); // Paused outage: not counted as a drop
+    bikeLinkLogStats();
+
+    // --- Boot with the record: driver chosen without a scan; forget clears it ---
+    bikeDriverSelect(nullptr);
+    bikeLinkPause();
+    client->disconnect();
+    bikeLinkBegin();
+    BENCH_CHECK(bikeLinkKnown() && bikeDriverSelected() == &merachBikeDriver);
+    BENCH_CHECK(waitForConnects(5, 2000));
+    bikeLinkForget();
+    bikeLinkPause();
+    client->disconnect();
+    bikeLinkBegin();
+    BENCH_CHECK(!bikeLinkKnown() && !bikeLinkReconnecting());
+
+    // --- Cost (NimBLE host task, per bike packet; bike link task, per poll) ---
+    printf("Cost:\n");
+    benchRun("bikeLinkOnSample (steady state)", iterations, []() {
+        bikeLinkOnSample();
+    });
+    bikeLinkPolicyInit(policy, true, 0);
+    benchRun("bikeLinkPolicyNext", iterations, [&]() {
+        benchKeep(bikeLinkPolicyNext(policy, 1));
+    });
+    return 0;
+}
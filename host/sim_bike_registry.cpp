@@ -0,0 +1,172 @@
+// Known-bike registry (bike_registry.cpp) on the host: MRU order and eviction, NVS round trip and the
+// single-bike record it replaces, the controller white list, RSSI / last seen, background scan settings,
+// and a reconnect that follows whichever known bike is heard.
+// Usage: sim_bike_registry [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <Preferences.h>
+#include <strings.h>
+#include "bike_registry.h"
+#include "bike_link.h"
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "system_tasks.h"
+#include "bench_util.h"
+
+extern MyNimBLEAdvertisedDeviceCallbacks myAdvertisedDeviceCallbacks_global; // Defined in the sketch
+
+static BikeRecord bikeRecord(uint8_t last, const char* driver) {
+    BikeRecord record;
+    memset(&record, 0, sizeof(record));
+    record.addressType = BLE_ADDR_RANDOM;
+    uint8_t address[6] = {last, 0x55, 0x44, 0x33, 0x22, 0xC1}; // Little-endian: C1:22:33:44:55:<last>
+    memcpy(record.address, address, sizeof(address));
+    strncpy(record.driver, driver, sizeof(record.driver) - 1);
+    return record;
+}
+
+static NimBLEAdvertisedDevice advertisement(const BikeRecord& record, const char* name, int rssi) {
+    NimBLEAdvertisedDevice device;
+    device.hostSet(bikeRecordAddress(record), name, rssi);
+    return device;
+}
+
+static bool waitFor(bool (*condition)(), uint32_t timeoutMs) {
+    for (uint32_t waited = 0; waited < timeoutMs; waited++) {
+        if (condition()) return true;
+        delay(1);
+    }
+    return condition();
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+    NimBLEScan* scan = NimBLEDevice::getScan();
+    BikeRecord record;
+    BikeSighting sighting;
+
+    // --- The single-bike record (before the registry) is carried over ---
+    hostNvsErase();
+    struct { uint8_t version; BikeRecord record; } v1 = {1, bikeRecord(0x01, "FTMS")};
+    Preferences prefs;
+    prefs.begin(BIKE_REGISTRY_NVS_NAMESPACE, false);
+    prefs.putBytes("known", &v1, sizeof(v1));
+    prefs.end();
+    bikeRegistryBegin();
+    BENCH_CHECK(bikeRegistryCount() == 1 && bikeRegistryGet(0, record) && strcmp(record.driver, "FTMS") == 0);
+    BENCH_CHECK(NimBLEDevice::onWhiteList(bikeRecordAddress(record)));
+    // The entry is the address the bike advertises, not its bytes reversed
+    NimBLEAddress advertised(std::string("c1:22:33:44:55:01"), BLE_ADDR_RANDOM);
+    BENCH_CHECK(bikeRecordAddress(record) == advertised && NimBLEDevice::onWhiteList(advertised));
+    bool listed = false;
+    for (size_t i = 0; i < NimBLEDevice::getWhiteListCount(); i++) {
+        NimBLEAddress entry = NimBLEDevice::getWhiteListAddress(i);
+        listed |= entry == advertised && entry.getType() == BLE_ADDR_RANDOM;
+    }
+    BENCH_CHECK(listed);
+    if (BIKE_MAC_ADDRESS[0] != '\0') { // A pinned bike gets through the controller whichever address type it uses
+        BENCH_CHECK(NimBLEDevice::onWhiteList(NimBLEAddress(std::string(BIKE_MAC_ADDRESS), BLE_ADDR_PUBLIC)));
+        BENCH_CHECK(NimBLEDevice::onWhiteList(NimBLEAddress(std::string(BIKE_MAC_ADDRESS), BLE_ADDR_RANDOM)));
+    }
+
+    // --- Most recent first; the oldest is evicted (and leaves the white list) ---
+    for (uint8_t i = 2; i <= BIKE_REGISTRY_MAX + 1; i++) bikeRegistryRemember(bikeRecord(i, "Merach"));
+    BENCH_CHECK(bikeRegistryCount() == BIKE_REGISTRY_MAX);
+    BENCH_CHECK(bikeRegistryGet(0, record) && record.address[0] == BIKE_REGISTRY_MAX + 1);
+    BENCH_CHECK(bikeRegistryFind(bikeRecordAddress(bikeRecord(0x01, "FTMS"))) < 0);
+    BENCH_CHECK(!NimBLEDevice::onWhiteList(bikeRecordAddress(bikeRecord(0x01, "FTMS"))));
+    unsigned long nvsWrites = hostNvsWriteCount();
+    bikeRegistryRemember(bikeRecord(BIKE_REGISTRY_MAX + 1, "Merach")); // Already first: no flash write
+    BENCH_CHECK(hostNvsWriteCount() == nvsWrites);
+    bikeRegistryRemember(bikeRecord(0x02, "Merach"));                  // Back to the front
+    BENCH_CHECK(bikeRegistryGet(0, record) && record.address[0] == 0x02 && bikeRegistryCount() == BIKE_REGISTRY_MAX);
+    bikeRegistryBegin();                                               // NVS round trip
+    BENCH_CHECK(bikeRegistryCount() == BIKE_REGISTRY_MAX && bikeRegistryGet(0, record) && record.address[0] == 0x02);
+    BENCH_CHECK(bikeRegistryGet(1, record) && record.address[0] == BIKE_REGISTRY_MAX + 1);
+    printf("Registry: %u bikes, white list %u entries (registered bikes + pinned MAC)\n",
+           bikeRegistryCount(), (unsigned)NimBLEDevice::getWhiteListCount());
+
+    // --- Advertisements: RSSI / last seen; only the button's scan picks a new bike ---
+    NimBLEAdvertisedDevice known = advertisement(bikeRecord(0x03, "Merach"), "MRK-S26-0003", -61);
+    NimBLEAdvertisedDevice stranger = advertisement(bikeRecord(0x77, "Merach"), "MRK-S26-0077", -40);
+    myAdvertisedDeviceCallbacks_global.onResult(&known);
+    myAdvertisedDeviceCallbacks_global.onResult(&stranger);
+    int index = bikeRegistryFind(known.getAddress());
+    BENCH_CHECK(index >= 0 && bikeRegistryGet((uint8_t)index, record, &sighting) && sighting.seen && sighting.rssi == -61);
+    BENCH_CHECK(pTargetBikeDevice == nullptr);
+    BENCH_CHECK(bikeRegistryPickTarget(millis(), record) && record.address[0] == 0x03); // Heard beats most recent
+    BENCH_CHECK(bikeRegistryPickTarget(millis() + BIKE_REGISTRY_FRESH_MS, record) && record.address[0] == 0x02);
+    scan->setFilterPolicy(BLE_HCI_SCAN_FILT_USE_WL);
+    scan->hostDeliver(&stranger);
+    BENCH_CHECK(scan->hostFiltered() == 1); // Dropped by the controller, never reaches the callback
+    bikeRegistryLog();
+
+    // --- Reconnect: last bike away, a background scan hears another known bike ---
+    bikeRegistryForget();
+    BENCH_CHECK(bikeRegistryCount() == 0 && NimBLEDevice::getWhiteListCount() == (BIKE_MAC_ADDRESS[0] != '\0' ? 2u : 0u));
+    BikeRecord bikeA = bikeRecord(0xA0, "Merach");
+    BikeRecord bikeB = bikeRecord(0xB0, "Merach");
+    bikeRegistryRemember(bikeB);
+    bikeRegistryRemember(bikeA); // A was ridden last
+    NimBLEClient* client = bikeClientGet();
+    NimBLERemoteService* customService = client->hostAddService(NimBLEUUID((uint16_t)CUSTOM_SERVICE_UUID_SHORT));
+    customService->hostAddCharacteristic(NimBLEUUID(CUSTOM_DATA_CHAR_UUID_STR), 5, NIMBLE_PROPERTY::NOTIFY);
+    NimBLERemoteService* ftmsService = client->hostAddService(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), 9, NIMBLE_PROPERTY::WRITE);
+    client->hostSetConnectResult(false); // Bike A is off
+    bikeLinkBegin();
+    xTaskCreatePinnedToCore(bikeLinkTask_func, "BikeLink", 4096, NULL, 2, &bikeLinkTaskHandle, 0);
+    uint32_t startsBefore = scan->hostStarts();
+    BENCH_CHECK(waitFor([]() { return NimBLEDevice::getScan()->isScanning(); }, 3 * BIKE_SCAN_IDLE_MIN_WAIT_MS + 1000));
+    BENCH_CHECK(scan->hostStarts() == startsBefore + 1 && scan->hostFilterPolicy() == BLE_HCI_SCAN_FILT_USE_WL);
+    BENCH_CHECK(!scan->hostActive() && scan->hostInterval() == BIKE_SCAN_IDLE_INTERVAL_MS && scan->hostWindow() == BIKE_SCAN_IDLE_WINDOW_MS);
+    BENCH_CHECK(scan->hostDuration() >= 1);
+    BikeLinkStats stats;
+    bikeLinkGetStats(stats);
+    printf("Background scan after %lu failed attempts: %u/%u ms (%.1f%% duty), passive, white list, %lu s\n",
+           (unsigned long)stats.failures, BIKE_SCAN_IDLE_WINDOW_MS, BIKE_SCAN_IDLE_INTERVAL_MS,
+           100.0 * BIKE_SCAN_IDLE_WINDOW_MS / BIKE_SCAN_IDLE_INTERVAL_MS, (unsigned long)scan->hostDuration());
+
+    client->hostSetConnectResult(true);
+    NimBLEAdvertisedDevice heardB = advertisement(bikeB, "MRK-S26-00B0", -58);
+    int64_t heardUs = esp_timer_get_time();
+    scan->hostDeliver(&heardB);
+    BENCH_CHECK(waitFor([]() {
+        BikeLinkStats linkStats;
+        bikeLinkGetStats(linkStats);
+        return linkStats.connects >= 1 && bikeSensorConnected;
+    }, 2000));
+    double heardToLinkMs = (esp_timer_get_time() - heardUs) / 1000.0;
+    BENCH_CHECK(client->getPeerAddress() == bikeRecordAddress(bikeB) && !scan->isScanning());
+    BENCH_CHECK(bikeRegistryGet(0, record) && record.address[0] == 0xB0);
+    printf("Known bike heard -> connected in %.1f ms (Merach start sequence included)\n", heardToLinkMs);
+
+    // --- Button scan: full duty, bounded, unfiltered unless a MAC is pinned ---
+    bikeLinkPause();
+    client->disconnect();
+    bikeRegistryForget();
+    bikeClientBegin();
+    systemTaskCreate(SYSTEM_TASK_BIKE_CONNECT);
+    bikeCommandPost(BIKE_COMMAND_SCAN); // The button
+    BENCH_CHECK(waitFor([]() { return NimBLEDevice::getScan()->isScanning(); }, 1000));
+    BENCH_CHECK(scan->hostActive() && scan->hostInterval() == 100 && scan->hostDuration() == BIKE_SCAN_PAIRING_SECONDS);
+    BENCH_CHECK(scan->hostFilterPolicy() == (BIKE_MAC_ADDRESS[0] != '\0' ? BLE_HCI_SCAN_FILT_USE_WL : BLE_HCI_SCAN_FILT_NO_WL));
+    scan->hostFinish(); // Nothing found
+    myAdvertisedDeviceCallbacks_global.onResult(&stranger);
+    BENCH_CHECK(pTargetBikeDevice == nullptr); // The scan is over
+
+    // --- Cost (NimBLE host task, per advertisement) ---
+    printf("Cost:\n");
+    for (uint8_t i = 1; i <= BIKE_REGISTRY_MAX; i++) bikeRegistryRemember(bikeRecord(i, "Merach"));
+    benchRun("onResult (background / sensor scan, registry full)", iterations / 10, [&]() {
+        myAdvertisedDeviceCallbacks_global.onResult(&stranger);
+    });
+    benchRun("bikeRegistryOnAdvertisement (registry full)", iterations / 10, [&]() {
+        benchKeep(bikeRegistryOnAdvertisement(&stranger));
+    });
+    benchRun("MAC check as before (toString + strcasecmp)", iterations / 10, [&]() {
+        benchKeep(strcasecmp(stranger.getAddress().toString().c_str(), BIKE_MAC_ADDRESS));
+    });
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Resistance calibration (resistance_calibration.cpp) on the host: a knob sweep against a simulated
+// bike with level hysteresis, power curve learning from noisy rides, the NVS round trip, and the
+// cost of loading the map and looking up a level.
+// Usage: sim_calibration [iterations]
+#include <Arduino.h>
+#include <Preferences.h>
+#include "resistance_calibration.h"
+#include "stepper_motion.h"
+#include "erg_controller.h"
+#include "bench_util.h"
+#include <math.h>
+
+// --- Simulated Bike Knob ---
+// Level L spans [edges[L-1], edges[L]) knob steps; the bike switches level HYSTERESIS steps late.
+static const int32_t knobEdges[CALIBRATION_LEVEL_COUNT + 1] = {0, 1300, 2500, 3900, 5100, 6400, 7700, 9100, 11200};
+static const int32_t knobHysteresis = 60;
+
+struct SimKnob {
+    uint8_t level;
+};
+
+static uint8_t trueLevel(int32_t position) {
+    for (uint8_t level = 1; level < CALIBRATION_LEVEL_COUNT; level++) {
+        if (position < knobEdges[level]) return level;
+    }
+    return CALIBRATION_LEVEL_COUNT;
+}
+
+static uint8_t simKnobMove(SimKnob& knob, int32_t position) {
+    uint8_t level = trueLevel(position);
+    if (level > knob.level && trueLevel(position - knobHysteresis) > knob.level) knob.level = trueLevel(position - knobHysteresis);
+    else if (level < knob.level && trueLevel(position + knobHysteresis) < knob.level) knob.level = trueLevel(position + knobHysteresis);
+    return knob.level;
+}
+
+static uint32_t noiseState = 12345u;
+static float noise(float amplitude) {
+    noiseState = noiseState * 1664525u + 1013904223u;
+    return ((float)(noiseState >> 8) / 16777216.0f * 2.0f - 1.0f) * amplitude;
+}
+
+static float truePower(uint8_t level, float cadenceRpm) {
+    return (2.0f + 3.5f * level) * cadenceRpm * (2.0f * (float)M_PI / 60.0f) + 12.0f; // Torque model + bearing loss
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Sweep: up and down through the travel, like calibrationTask_func ---
+    CalibrationSweep sweep;
+    calibrationSweepReset(sweep);
+    SimKnob knob = {1};
+    for (int32_t position = 0; position <= STEPPER_TRAVEL_STEPS; position += CALIBRATION_SWEEP_STEP) {
+        calibrationSweepRecord(sweep, position, simKnobMove(knob, position));
+    }
+    for (int32_t position = STEPPER_TRAVEL_STEPS; position >= 0; position -= CALIBRATION_SWEEP_STEP) {
+        calibrationSweepRecord(sweep, position, simKnobMove(knob, position));
+    }
+    CalibrationMap map;
+    calibrationMapReset(map);
+    BENCH_CHECK(calibrationSweepFinish(sweep, map));
+    printf("Knob sweep (%u readings, %d-step hysteresis):\n", sweep.readings, knobHysteresis);
+    for (uint8_t level = 1; level <= CALIBRATION_LEVEL_COUNT; level++) {
+        int32_t steps;
+        BENCH_CHECK(calibrationMapLevelToSteps(map, level, steps));
+        printf("  level %u: seen at %5d..%5d, target %5ld (true band %5ld..%5ld)\n", level,
+               map.levels[level - 1].lowSteps, map.levels[level - 1].highSteps, (long)steps,
+               (long)knobEdges[level - 1], (long)knobEdges[level]);
+        // Approached from either side, the bike must show the requested level.
+        SimKnob fromBelow = {1}, fromAbove = {CALIBRATION_LEVEL_COUNT};
+        BENCH_CHECK(simKnobMove(fromBelow, steps) == level && simKnobMove(fromAbove, steps) == level);
+    }
+    int32_t previousSteps = -1;
+    for (float level = 1.0f; level <= CALIBRATION_LEVEL_COUNT; level += 0.1f) {
+        int32_t steps;
+        calibrationMapLevelToSteps(map, level, steps);
+        BENCH_CHECK(steps >= previousSteps); // Fractional levels interpolate monotonically
+        previousSteps = steps;
+    }
+
+    // A level the knob never reached, or levels out of knob order, must not produce a map.
+    CalibrationSweep partial;
+    calibrationSweepReset(partial);
+    for (int32_t position = 0; position < 7000; position += CALIBRATION_SWEEP_STEP) {
+        calibrationSweepRecord(partial, position, trueLevel(position));
+    }
+    CalibrationMap rejected;
+    calibrationMapReset(rejected);
+    BENCH_CHECK(!calibrationSweepFinish(partial, rejected) && !(rejected.flags & CALIBRATION_HAS_POSITIONS));
+    CalibrationSweep reversed;
+    calibrationSweepReset(reversed);
+    for (int32_t position = 0; position <= STEPPER_TRAVEL_STEPS; position += CALIBRATION_SWEEP_STEP) {
+        calibrationSweepRecord(reversed, position, CALIBRATION_LEVEL_COUNT + 1 - trueLevel(position));
+    }
+    BENCH_CHECK(!calibrationSweepFinish(reversed, rejected));
+
+    // --- Power curve learning: noisy rides at varying cadence ---
+    printf("Power curves learned from noisy samples (+/-15 W):\n");
+    for (uint8_t level = 1; level <= CALIBRATION_LEVEL_COUNT; level++) {
+        PowerCurveLearner learner;
+        calibrationLearnerReset(learner);
+        for (int i = 0; i < 3000; i++) {
+            float cadence = 75.0f + 20.0f * sinf(i * 0.01f) + noise(3.0f);
+            calibrationLearnerAdd(learner, cadence, truePower(level, cadence) + noise(15.0f));
+        }
+        uint16_t torqueMnm;
+        int16_t offsetW;
+        BENCH_CHECK(calibrationLearnerFit(learner, torqueMnm, offsetW));
+        map.levels[level - 1].torqueMnm = torqueMnm;
+        map.levels[level - 1].offsetW = offsetW;
+        float expectedMnm = (2.0f + 3.5f * level) * 1000.0f;
+        printf("  level %u: %5u mNm (true %5.0f), offset %+3d W (true +12)\n", level, torqueMnm, expectedMnm, offsetW);
+        BENCH_CHECK(fabsf(torqueMnm - expectedMnm) <= expectedMnm * 0.03f);
+        BENCH_CHECK(abs(offsetW - 12) <= 8);
+    }
+    float baseNm, perLevelNm;
+    BENCH_CHECK(calibrationMapTorqueModel(map, baseNm, perLevelNm));
+    float expectedBase = 2.0f + 12.0f / (CALIBRATION_REFERENCE_RPM * 2.0f * (float)M_PI / 60.0f);
+    printf("  ERG torque model: %.2f + %.2f Nm/level (true %.2f + 3.50 at %.0f RPM)\n", baseNm, perLevelNm,
+           expectedBase, CALIBRATION_REFERENCE_RPM);
+    BENCH_CHECK(fabsf(perLevelNm - 3.5f) < 0.1f && fabsf(baseNm - expectedBase) < 0.3f);
+
+    // Steady cadence: no slope information, so the curve goes through the origin.
+    PowerCurveLearner steady;
+    calibrationLearnerReset(steady);
+    for (int i = 0; i < 1000; i++) calibrationLearnerAdd(steady, 80.0f, 250.0f);
+    uint16_t steadyTorque;
+    int16_t steadyOffset;
+    BENCH_CHECK(calibrationLearnerFit(steady, steadyTorque, steadyOffset) && steadyOffset == 0);
+    BENCH_CHECK(abs((int)steadyTorque - 29842) <= 30); // 250 W / 8.378 rad/s
+    // Too few samples: no curve.
+    PowerCurveLearner fresh;
+    calibrationLearnerReset(fresh);
+    for (int i = 0; i < 100; i++) calibrationLearnerAdd(fresh, 80.0f, 250.0f);
+    BENCH_CHECK(!calibrationLearnerFit(fresh, steadyTorque, steadyOffset));
+    // The bike changes (belt tension, temperature): old samples fade out.
+    for (int i = 0; i < 6000; i++) calibrationLearnerAdd(steady, 80.0f, 200.0f);
+    BENCH_CHECK(calibrationLearnerFit(steady, steadyTorque, steadyOffset) && abs((int)steadyTorque - 23873) <= 300);
+
+    // --- NVS round trip and the bridge hooks ---
+    hostNvsErase();
+    BENCH_CHECK(!calibrationBegin());
+    int32_t defaultSteps = motionLevelToSteps(4.0f);
+    BENCH_CHECK(defaultSteps == STEPPER_STEPS_AT_LEVEL_MIN + 3 * STEPPER_STEPS_PER_LEVEL);
+    Preferences prefs;
+    prefs.begin(CALIBRATION_NVS_NAMESPACE, false);
+    CalibrationMap oldVersion = map;
+    oldVersion.version = CALIBRATION_MAP_VERSION + 1;
+    prefs.putBytes("map", &oldVersion, sizeof(oldVersion));
+    prefs.end();
+    BENCH_CHECK(!calibrationBegin()); // A map from another firmware layout is ignored
+    prefs.begin(CALIBRATION_NVS_NAMESPACE, false);
+    prefs.putBytes("map", &map, sizeof(map));
+    prefs.end();
+    BENCH_CHECK(calibrationBegin());
+    int32_t mapSteps;
+    calibrationMapLevelToSteps(map, 4.0f, mapSteps);
+    BENCH_CHECK(motionLevelToSteps(4.0f) == mapSteps && mapSteps != defaultSteps);
+    ErgControllerConfig erg;
+    ergDefaultConfig(erg);
+    BENCH_CHECK(erg.torquePerLevelNm == perLevelNm && erg.torqueBaseNm == baseNm);
+    printf("  NVS: %u-byte map loaded; level 4 -> %ld steps (uncalibrated %ld)\n", (unsigned)sizeof(CalibrationMap),
+           (long)mapSteps, (long)defaultSteps);
+
+    // Learning through the forwarder hook: a level change is ignored until it has settled.
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.resistanceLevel = 5;
+    for (int i = 0; i < 5000; i++) {
+        frame.timestampUs = (int64_t)i * 100000; // 10 Hz
+        float cadence = 70.0f + 25.0f * sinf(i * 0.02f);
+        frame.cadence = (uint16_t)lroundf(cadence * 2.0f);
+        frame.power = (uint16_t)lroundf(truePower(5, cadence) * 1.1f); // The bike got 10 % harder
+        calibrationOnSample(frame);
+    }
+    CalibrationMap learned;
+    calibrationGetMap(learned);
+    printf("  Learned in the forwarder: level 5 %u mNm (was %u)\n", learned.levels[4].torqueMnm, map.levels[4].torqueMnm);
+    BENCH_CHECK(fabsf(learned.levels[4].torqueMnm - 19500.0f * 1.1f) <= 19500.0f * 1.1f * 0.03f);
+    BENCH_CHECK(learned.levels[3].torqueMnm == map.levels[3].torqueMnm);
+
+    // --- Cost ---
+    printf("Cost:\n");
+    benchRun("calibrationBegin (NVS load)", iterations / 1000, [&]() {
+        benchKeep(calibrationBegin());
+    });
+    volatile float level = 4.3f;
+    benchRun("calibrationMapLevelToSteps", iterations, [&]() {
+        int32_t steps;
+        calibrationMapLevelToSteps(map, level, steps);
+        benchKeep(steps);
+    });
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Cycling Power / CSC measurements (cycling_encoder.cpp) on the host: a ride decoded the way a watch
+// does it (revolution and event-time deltas), 16-bit wraparound, the peripheral fan-out to a watch,
+// and the cost of one encode pass.
+// Usage: sim_cycling_services [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include "cycling_encoder.h"
+#include "ble_peripheral_manager.h"
+#include "system_tasks.h"
+#include "ble_client_manager.h"
+#include "app_sessions.h"
+#include "bench_util.h"
+#include <math.h>
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t getU32(const uint8_t* p) { return getU16(p) | ((uint32_t)getU16(p + 2) << 16); }
+
+// What a watch computes between two CSC measurements.
+struct WatchView {
+    float cadenceRpm;
+    float speedKmh;
+};
+
+static bool watchDecode(const uint8_t* previous, const uint8_t* current, uint16_t circumferenceMm, WatchView& view) {
+    uint16_t crankRevs = getU16(current + 7) - getU16(previous + 7);
+    uint16_t crankTicks = getU16(current + 9) - getU16(previous + 9);
+    uint32_t wheelRevs = getU32(current + 1) - getU32(previous + 1);
+    uint16_t wheelTicks = getU16(current + 5) - getU16(previous + 5);
+    if (crankTicks == 0 || wheelTicks == 0) return false;
+    view.cadenceRpm = crankRevs * 60.0f * 1024.0f / crankTicks;
+    view.speedKmh = wheelRevs * circumferenceMm / 1000.0f * 1024.0f / wheelTicks * 3.6f;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+    const uint16_t circumference = CONTROL_POINT_WHEEL_CIRCUMFERENCE; // 0.1 mm
+
+    // --- Ride: 90 RPM / 32.4 km/h at 4 Hz, then 45 RPM / 18 km/h, decoded every 2 s like a watch ---
+    CyclingMeasurementState state;
+    cyclingStateReset(state);
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    CyclingMeasurements measurements, previous;
+    int64_t startUs = 3600000000ll; // Not aligned to the 16-bit event time wrap
+    printf("Ride decoded like a watch:\n");
+    for (int step = 0; step <= 400; step++) {
+        bool slow = step > 200;
+        frame.timestampUs = startUs + (int64_t)step * 250000;
+        frame.cadence = slow ? 90 : 180;       // 0.5 RPM
+        frame.speed = slow ? 1800 : 3240;      // 0.01 km/h
+        frame.power = slow ? 120 : 250;
+        cyclingEncodeMeasurements(state, frame, circumference, measurements);
+        BENCH_CHECK(getU32(measurements.cps + 4) == getU32(measurements.csc + 1));   // Same wheel count
+        BENCH_CHECK(getU16(measurements.cps + 10) == getU16(measurements.csc + 7));  // Same crank count
+        BENCH_CHECK(getU16(measurements.cps + 12) == getU16(measurements.csc + 9));  // Same crank event
+        if (step >= 16 && step % 8 == 0 && step != 208) { // Skip the first revolution and the change
+            WatchView view;
+            BENCH_CHECK(watchDecode(previous.csc, measurements.csc, circumference / 10, view));
+            float expectedRpm = frame.cadence / 2.0f, expectedKmh = frame.speed / 100.0f;
+            if (step % 80 == 0) printf("  t=%5.1f s: %5.1f RPM (bike %4.1f), %5.2f km/h (bike %5.2f)\n",
+                                       step * 0.25f, view.cadenceRpm, expectedRpm, view.speedKmh, expectedKmh);
+            BENCH_CHECK(fabsf(view.cadenceRpm - expectedRpm) <= 1.0f);
+            BENCH_CHECK(fabsf(view.speedKmh - expectedKmh) <= 0.4f);
+        }
+        if (step % 8 == 0) previous = measurements;
+    }
+    BENCH_CHECK(getU16(measurements.cps) == (CPS_FLAG_WHEEL_REVOLUTIONS | CPS_FLAG_CRANK_REVOLUTIONS));
+    BENCH_CHECK(getU16(measurements.cps + 2) == 120);
+    BENCH_CHECK(measurements.csc[0] == (CSC_FLAG_WHEEL_REVOLUTIONS | CSC_FLAG_CRANK_REVOLUTIONS));
+    // 50 s at 90 RPM + 50 s at 45 RPM = 112.5 revolutions
+    BENCH_CHECK(state.crank.revolutions == 112);
+
+    // Re-sending the same frame (forwarder heartbeat) adds nothing.
+    CyclingMeasurements again;
+    cyclingEncodeMeasurements(state, frame, circumference, again);
+    BENCH_CHECK(memcmp(&again, &measurements, sizeof(again)) == 0);
+
+    // Stopping holds the count and the last event time.
+    frame.timestampUs += 1000000;
+    frame.cadence = 0;
+    frame.speed = 0;
+    cyclingEncodeMeasurements(state, frame, circumference, again);
+    BENCH_CHECK(getU16(again.csc + 7) == getU16(measurements.csc + 7) && getU16(again.csc + 9) == getU16(measurements.csc + 9));
+
+    // A long gap (bike reconnect) integrates at most CYCLING_MAX_GAP_MS.
+    uint32_t before = state.crank.revolutions;
+    frame.cadence = 120; // 60 RPM
+    frame.timestampUs += 60000000;
+    cyclingEncodeMeasurements(state, frame, circumference, again);
+    BENCH_CHECK(state.crank.revolutions - before <= CYCLING_MAX_GAP_MS / 1000 + 1);
+
+    // --- Peripheral: a watch subscribed to Cycling Power only ---
+    systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP);
+    for (int i = 0; i < 200 && !NimBLEDevice::getAdvertising()->isAdvertising(); i++) delay(10);
+    BENCH_CHECK(pCyclingPowerMeasurementCharacteristic_Peripheral != nullptr && pCscMeasurementCharacteristic_Peripheral != nullptr);
+    ble_gap_conn_desc watchDesc;
+    pServer_Peripheral->hostConnect(7, 23, &watchDesc);
+    BENCH_CHECK(!sendCyclingMeasurements(frame)); // Connected, not subscribed
+    pCyclingPowerMeasurementCharacteristic_Peripheral->hostSubscribe(&watchDesc, 0x0001);
+    frame.timestampUs += 2000000; // 2 s at 60 RPM
+    frame.power = 210;
+    BENCH_CHECK(sendCyclingMeasurements(frame));
+    const std::vector<uint8_t>& sent = pCyclingPowerMeasurementCharacteristic_Peripheral->hostLastSent();
+    BENCH_CHECK(sent.size() == CPS_MEASUREMENT_LENGTH && getU16(&sent[2]) == 210 && getU16(&sent[10]) == 2);
+    BENCH_CHECK(pCyclingPowerMeasurementCharacteristic_Peripheral->hostLastConnHandle() == 7);
+    BENCH_CHECK(pCscMeasurementCharacteristic_Peripheral->hostNotifyCount() == 0);
+    printf("  CPS notify to the watch (%u bytes):", (unsigned)sent.size());
+    for (size_t i = 0; i < sent.size(); i++) printf(" %02X", sent[i]);
+    printf("\n");
+
+    // --- Cost (forwarder task, per frame) ---
+    printf("Cost:\n");
+    benchRun("cyclingEncodeMeasurements (CPS + CSC)", iterations, [&]() {
+        frame.timestampUs += 250000;
+        cyclingEncodeMeasurements(state, frame, circumference, measurements);
+        benchKeep(measurements);
+    });
+    return 0;
+}
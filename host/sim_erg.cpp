@@ -0,0 +1,184 @@
+// Closed-loop ERG simulation: the firmware's controller (erg_controller.cpp) against a simple bike
+// power model, reporting settle time and overshoot for target-power steps and a cadence change.
+// The simulated bike deliberately differs from the controller's model so the PI part has work to do.
+// Usage: sim_erg [--kp levels/W] [--ki levels/W·s] [--ff gain] [--trace]
+#include <Arduino.h>
+#include "erg_controller.h"
+#include "bench_util.h"
+#include <math.h>
+#include <string.h>
+
+// --- Simulated Bike ---
+struct SimBike {
+    float torqueBaseNm;      // Real bike: crank torque = base + perLevel * level
+    float torquePerLevelNm;
+    float levelRatePerS;     // How fast the resistance follows a new level
+    float powerTauS;         // Smoothing of the bike's reported power
+    float noiseW;            // Peak reported-power noise
+    float level;             // Applied level
+    float reportedW;
+    uint32_t noiseState;
+};
+
+static float simNoise(SimBike& bike) {
+    bike.noiseState = bike.noiseState * 1664525u + 1013904223u;
+    return ((float)(bike.noiseState >> 8) / 16777216.0f * 2.0f - 1.0f) * bike.noiseW;
+}
+
+static float simTruePower(const SimBike& bike, float cadenceRpm) {
+    return (bike.torqueBaseNm + bike.torquePerLevelNm * bike.level) * cadenceRpm * (2.0f * (float)M_PI / 60.0f);
+}
+
+static void simAdvance(SimBike& bike, float commandedLevel, float cadenceRpm, float dt) {
+    float maxMove = bike.levelRatePerS * dt;
+    float delta = commandedLevel - bike.level;
+    bike.level += delta > maxMove ? maxMove : (delta < -maxMove ? -maxMove : delta);
+    bike.reportedW += (simTruePower(bike, cadenceRpm) - bike.reportedW) * (dt / (bike.powerTauS + dt));
+}
+
+// --- Scenario ---
+struct SimEvent {
+    float timeS;
+    float targetW;
+    float cadenceRpm;
+    const char* name;
+};
+
+static const SimEvent simEvents[] = {
+    {0.0f,   150.0f, 90.0f, "start 150 W @ 90 RPM"},
+    {30.0f,  220.0f, 90.0f, "step 150 -> 220 W"},
+    {60.0f,  220.0f, 75.0f, "cadence 90 -> 75 RPM"},
+    {90.0f,  120.0f, 75.0f, "step 220 -> 120 W"},
+    {120.0f, 120.0f, 95.0f, "cadence 75 -> 95 RPM"},
+};
+static const int simEventCount = sizeof(simEvents) / sizeof(simEvents[0]);
+static const float simEndS = 150.0f;
+static const float simDtS = 0.01f;
+
+struct SimResult {
+    float settleS[simEventCount];     // < 0: did not settle before the next event
+    float overshoot[simEventCount];   // % of the step for power steps, W of deviation otherwise
+    float steadyErrorW[simEventCount];
+    int levelChanges;
+};
+
+static void runScenario(const ErgControllerConfig& config, SimResult& result, bool trace) {
+    SimBike bike = {2.8f, 3.6f, 4.0f, 0.8f, 3.0f, 1.0f, 0.0f, 12345u};
+    ErgController controller;
+    ergControllerReset(controller);
+    controller.level = bike.level;
+    float commanded = bike.level;
+    result.levelChanges = 0;
+
+    int controlEvery = (int)lroundf(config.periodS / simDtS);
+    int steps = (int)lroundf(simEndS / simDtS);
+    int event = 0;
+    float lastOutsideS = 0.0f, peak = 0.0f, errorSum = 0.0f;
+    int errorSamples = 0;
+    for (int i = 0; i <= steps; i++) {
+        float t = i * simDtS;
+        bool segmentEnd = i == steps || (event + 1 < simEventCount && t >= simEvents[event + 1].timeS);
+        if (i == 0 || segmentEnd) {
+            if (i > 0) {
+                // Close the previous segment.
+                float segmentLength = (i == steps ? simEndS : simEvents[event + 1].timeS) - simEvents[event].timeS;
+                float settle = lastOutsideS - simEvents[event].timeS;
+                result.settleS[event] = settle >= segmentLength - 5.0f ? -1.0f : settle; // Needs 5 s in band
+                result.overshoot[event] = peak;
+                result.steadyErrorW[event] = errorSamples ? errorSum / errorSamples : 0.0f;
+                if (i == steps) break;
+                event++;
+            }
+            lastOutsideS = simEvents[event].timeS;
+            peak = 0.0f; errorSum = 0.0f; errorSamples = 0;
+        }
+
+        const SimEvent& e = simEvents[event];
+        float previousTarget = event > 0 ? simEvents[event - 1].targetW : 0.0f;
+        if (i % controlEvery == 0) {
+            float measured = roundf(bike.reportedW + simNoise(bike)); // The bike reports whole watts
+            float command = ergControllerStep(controller, config, e.targetW, measured, e.cadenceRpm);
+            float level = ergQuantizeLevel(config, command, controller.level);
+            if (level != controller.level) result.levelChanges++;
+            controller.level = level;
+            commanded = level;
+            if (trace) {
+                printf("    t=%6.2f target %5.0f measured %6.1f cadence %3.0f command %5.2f level %4.1f\n",
+                       t, e.targetW, measured, e.cadenceRpm, command, level);
+            }
+        }
+        simAdvance(bike, commanded, e.cadenceRpm, simDtS);
+
+        // Settling band: 5 % of target, or half a settable step of the real bike, whichever is wider.
+        float stepW = 0.5f * bike.torquePerLevelNm * config.levelStep * e.cadenceRpm * (2.0f * (float)M_PI / 60.0f);
+        float band = 0.05f * e.targetW > stepW + 5.0f ? 0.05f * e.targetW : stepW + 5.0f;
+        float error = bike.reportedW - e.targetW;
+        if (fabsf(error) > band) lastOutsideS = t;
+        if (e.targetW != previousTarget && event > 0) {
+            float direction = e.targetW > previousTarget ? 1.0f : -1.0f;
+            float beyond = direction * error / fabsf(e.targetW - previousTarget) * 100.0f;
+            if (beyond > peak) peak = beyond;
+        } else if (event > 0 && fabsf(error) > peak) {
+            peak = fabsf(error);
+        }
+        if (t - e.timeS >= 10.0f) {
+            errorSum += fabsf(error);
+            errorSamples++;
+        }
+    }
+}
+
+static bool report(const char* name, const SimResult& result, float maxSettleS, float maxOvershootPct) {
+    printf("%s (%d level changes):\n", name, result.levelChanges);
+    printf("  %-24s %10s %16s %16s\n", "event", "settle", "overshoot", "mean |error|");
+    bool ok = true;
+    for (int i = 0; i < simEventCount; i++) {
+        char settle[16], overshoot[24];
+        if (result.settleS[i] < 0.0f) snprintf(settle, sizeof(settle), "never");
+        else snprintf(settle, sizeof(settle), "%.2f s", result.settleS[i]);
+        bool powerStep = i > 0 && simEvents[i].targetW != simEvents[i - 1].targetW;
+        if (i == 0) snprintf(overshoot, sizeof(overshoot), "-");
+        else snprintf(overshoot, sizeof(overshoot), powerStep ? "%.1f %% of step" : "%.1f W dev", result.overshoot[i]);
+        printf("  %-24s %10s %16s %14.1f W\n", simEvents[i].name, settle, overshoot, result.steadyErrorW[i]);
+        if (result.settleS[i] < 0.0f || result.settleS[i] > maxSettleS) ok = false;
+        if (powerStep && result.overshoot[i] > maxOvershootPct) ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    hostSetSerialEcho(false);
+    ErgControllerConfig config;
+    ergDefaultConfig(config);
+    bool trace = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--kp") && i + 1 < argc) config.kp = strtof(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "--ki") && i + 1 < argc) config.ki = strtof(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "--ff") && i + 1 < argc) config.feedForwardGain = strtof(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "--trace")) trace = true;
+    }
+    printf("ERG controller: kp %.4f, ki %.4f, feed-forward %.2f, period %.0f ms\n\n",
+           config.kp, config.ki, config.feedForwardGain, config.periodS * 1000.0f);
+
+    SimResult withFeedForward, piOnly, motor;
+    runScenario(config, withFeedForward, trace);
+    bool ok = report("PI + feed-forward, whole levels (bike today)", withFeedForward, 10.0f, 20.0f);
+
+    ErgControllerConfig noFeedForward = config;
+    noFeedForward.feedForwardGain = 0.0f;
+    runScenario(noFeedForward, piOnly, false);
+    printf("\n");
+    report("PI only, whole levels", piOnly, 1e9f, 1e9f);
+
+    ErgControllerConfig fine = config;
+    fine.levelStep = 0.1f;
+    fine.levelHysteresis = 0.02f;
+    runScenario(fine, motor, false);
+    printf("\n");
+    ok = report("PI + feed-forward, 0.1-level steps (motor)", motor, 10.0f, 15.0f) && ok;
+
+    BENCH_CHECK(ok);
+    // Feed-forward must absorb a cadence change better than waiting for the power error.
+    BENCH_CHECK(withFeedForward.overshoot[2] < piOnly.overshoot[2]);
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Link manager (link_manager.cpp) on the host: profile rules, the harmonic bike interval, requests as the
+// rider goes from riding to ERG and back, an app that refuses, late bike samples and dropped notifies.
+// Usage: sim_link_manager [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <Preferences.h>
+#include "link_manager.h"
+#include "bike_link.h"
+#include "bike_driver.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "ftms_control_point.h"
+#include "erg_controller.h"
+#include "telemetry.h"
+#include "system_tasks.h"
+#include "bench_util.h"
+
+// Merach S26 0xFFF1 data packet: 25.00 km/h, 90 RPM (x2 = 180), 150.0 W (x10 = 1500)
+static uint8_t merachDataPacket[] = {0x02, 0x42, 0x00, 0xC4, 0x09, 0x00, 0xB4, 0x00, 0x00, 0xDC, 0x05};
+
+// The bike notifies every 100 ms while 'pedalling' is set.
+static NimBLERemoteCharacteristic* bikeData = nullptr;
+static volatile bool pedalling = false;
+
+static void bikeFeedTask_func(void* pvParameters) {
+    while (1) {
+        if (pedalling) bikeData->hostNotify(merachDataPacket, sizeof(merachDataPacket));
+        delay(100);
+    }
+}
+
+static const LinkStats* findLink(const LinkManagerStats& stats, uint8_t role) {
+    for (uint8_t i = 0; i < stats.linkCount; i++) {
+        if (stats.links[i].role == role) return &stats.links[i];
+    }
+    return nullptr;
+}
+
+// Polls the stats until both links sit at the given intervals (1.25 ms units).
+static bool waitForIntervals(uint16_t bikeInterval, uint16_t appInterval, uint32_t timeoutMs) {
+    LinkManagerStats stats;
+    for (uint32_t waited = 0; waited < timeoutMs; waited += 10) {
+        linkManagerGetStats(stats);
+        const LinkStats* bike = findLink(stats, LINK_ROLE_BIKE);
+        const LinkStats* app = findLink(stats, LINK_ROLE_APP);
+        if (bike && app && bike->interval == bikeInterval && app->interval == appInterval) return true;
+        delay(10);
+    }
+    return false;
+}
+
+static void writeControlPoint(uint16_t connHandle, const uint8_t* data, size_t length) {
+    FtmsCpEvent event;
+    ftmsControlPointDispatch(connHandle, data, length, event);
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Profiles: one 15 ms grid, inside Apple's limits ---
+    for (uint8_t activity = 0; activity < LINK_ACTIVITY_COUNT; activity++) {
+        const LinkProfile& profile = linkProfile(activity);
+        BENCH_CHECK(profile.bikeIntervalMin % 12 == 0 && profile.appIntervalMin % 12 == 0 && profile.appIntervalMax % 12 == 0);
+        BENCH_CHECK(profile.appIntervalMin >= 12 && (profile.appIntervalMax >= profile.appIntervalMin + 12 ||
+                                                      profile.appIntervalMax == 12));
+        BENCH_CHECK(profile.appIntervalMax * 1.25 * (profile.appLatency + 1) <= 2000.0);
+        BENCH_CHECK(profile.timeout >= 200 && profile.timeout <= 600);
+        BENCH_CHECK(profile.timeout * 10 > 2 * 1.25 * profile.appIntervalMax * (profile.appLatency + 1));
+        BENCH_CHECK(profile.timeout * 10 > 2 * 1.25 * profile.bikeIntervalMax * (profile.bikeLatency + 1));
+        printf("Profile %u: bike %.1f ms latency %u, app %.1f-%.1f ms latency %u\n", activity,
+               profile.bikeIntervalMin * 1.25, profile.bikeLatency, profile.appIntervalMin * 1.25,
+               profile.appIntervalMax * 1.25, profile.appLatency);
+    }
+    BENCH_CHECK(linkProfile(LINK_ACTIVITY_ERG).appIntervalMin < linkProfile(LINK_ACTIVITY_RIDING).appIntervalMin);
+    BENCH_CHECK(linkProfile(LINK_ACTIVITY_IDLE).appLatency > 0 && linkProfile(LINK_ACTIVITY_RIDING).appLatency == 0);
+    BENCH_CHECK(linkHarmonicInterval(24, 48, 0) == 24);  // No app
+    BENCH_CHECK(linkHarmonicInterval(24, 48, 24) == 24); // Same interval
+    BENCH_CHECK(linkHarmonicInterval(24, 48, 12) == 24); // Every second app event
+    BENCH_CHECK(linkHarmonicInterval(24, 48, 36) == 36); // App got 45 ms
+    BENCH_CHECK(linkHarmonicInterval(12, 24, 60) == 12); // 75 ms = 5 x 15 ms
+    BENCH_CHECK(linkHarmonicInterval(48, 96, 39) == 78);
+    BENCH_CHECK(linkHarmonicInterval(24, 30, 31) == 24);  // Nothing in range: the profile's own
+    BENCH_CHECK(linkActivity(true, 0, 100000) == LINK_ACTIVITY_ERG);
+    BENCH_CHECK(linkActivity(false, 100000, 100000 + LINK_IDLE_AFTER_MS - 1) == LINK_ACTIVITY_RIDING);
+    BENCH_CHECK(linkActivity(false, 100000, 100000 + LINK_IDLE_AFTER_MS) == LINK_ACTIVITY_IDLE);
+    BENCH_CHECK(linkActivity(false, 0xFFFFFF00u, 0x00000100u) == LINK_ACTIVITY_RIDING); // millis() wrap
+
+    // --- One app and the bike ---
+    BENCH_CHECK(controlPointBegin());
+    systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP);
+    for (int i = 0; i < 200 && !NimBLEDevice::getAdvertising()->isAdvertising(); i++) delay(10);
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral != nullptr);
+    ble_gap_conn_desc appDesc;
+    pServer_Peripheral->hostConnect(1, 247, &appDesc);
+    pIndoorBikeDataCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0001);
+    hostGapSetRssi(1, -48);
+
+    hostNvsErase();
+    bikeLinkBegin();
+    NimBLEClient* client = bikeClientGet();
+    NimBLERemoteService* customService = client->hostAddService(NimBLEUUID((uint16_t)CUSTOM_SERVICE_UUID_SHORT));
+    bikeData = customService->hostAddCharacteristic(NimBLEUUID(CUSTOM_DATA_CHAR_UUID_STR), 5, NIMBLE_PROPERTY::NOTIFY);
+    NimBLERemoteService* ftmsService = client->hostAddService(NimBLEUUID((uint16_t)FTMS_SERVICE_UUID_SHORT));
+    ftmsService->hostAddCharacteristic(NimBLEUUID((uint16_t)FTMS_CONTROL_POINT_UUID_SHORT), 9, NIMBLE_PROPERTY::WRITE);
+    NimBLEAdvertisedDevice bike;
+    bike.hostSet(NimBLEAddress(std::string("11:22:33:44:55:66")), "MRK-S26-0417", -55);
+    pTargetBikeDevice = new NimBLEAdvertisedDevice(bike);
+    bikeDriverSelect(bikeDriverMatch(&bike));
+    bikeAttemptingConnection = true;
+    bikeClientBegin();
+    systemTaskCreate(SYSTEM_TASK_BIKE_CONNECT);
+    bikeCommandPost(BIKE_COMMAND_CONNECT); // The button
+    for (int i = 0; i < 2000 && !bikeSensorConnected; i++) delay(1);
+    BENCH_CHECK(bikeSensorConnected && client->hostConnIntervalMax() == LINK_RIDE_BIKE_INTERVAL); // Boot: riding profile
+    hostGapSetRssi(client->getConnId(), -71);
+
+    xTaskCreatePinnedToCore(bikeFeedTask_func, "BikeFeed", 2048, NULL, 2, NULL, 1);
+    xTaskCreatePinnedToCore(ergTask_func, "ERG", 3072, NULL, 2, &ergTaskHandle, 1);
+    xTaskCreatePinnedToCore(linkManagerTask_func, "LinkManager", 3072, NULL, 1, &linkManagerTaskHandle, 0);
+    pedalling = true;
+    delay(1500);
+
+    // --- Riding: both links already on the profile, nothing requested ---
+    LinkManagerStats stats;
+    linkManagerGetStats(stats);
+    const LinkStats* bikeLink = findLink(stats, LINK_ROLE_BIKE);
+    const LinkStats* appLink = findLink(stats, LINK_ROLE_APP);
+    BENCH_CHECK(stats.activity == LINK_ACTIVITY_RIDING && stats.linkCount == 2 && bikeLink && appLink);
+    BENCH_CHECK(bikeLink->interval == LINK_RIDE_BIKE_INTERVAL && appLink->interval == LINK_RIDE_APP_INTERVAL);
+    BENCH_CHECK(bikeLink->updatesRequested == 0 && appLink->updatesRequested == 0);
+    BENCH_CHECK(bikeLink->rssi == -71 && appLink->rssi == -48 && bikeLink->timeout == LINK_SUPERVISION_TIMEOUT);
+
+    // --- Late bike samples and notifies without a buffer ---
+    pedalling = false;
+    delay(600);
+    pedalling = true;
+    delay(300);
+    TelemetryFrame frame;
+    telemetryRead(frame);
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    hostSetMsysFree(0);
+    BENCH_CHECK(sendDataToMyWhoosh(frame)); // The stack drops it
+    hostSetMsysFree(os_msys_count());
+    linkManagerGetStats(stats);
+    bikeLink = findLink(stats, LINK_ROLE_BIKE);
+    appLink = findLink(stats, LINK_ROLE_APP);
+    BENCH_CHECK(bikeLink->lateEvents == 1 && bikeLink->maxGapMs >= 600);
+    BENCH_CHECK(appLink->notifies >= 1 && appLink->lateEvents == 1 && stats.notifyBuffersMax == os_msys_count());
+    printf("Bike: %lu late sample(s), longest gap %lu ms. App: %lu notifies, %lu dropped without a buffer\n",
+           (unsigned long)bikeLink->lateEvents, (unsigned long)bikeLink->maxGapMs,
+           (unsigned long)appLink->notifies, (unsigned long)appLink->lateEvents);
+
+    // --- ERG: both links go to 15 ms; the bike takes the app's interval ---
+    uint8_t requestControl[] = {0x00};
+    uint8_t setTargetPower[] = {0x05, 0x96, 0x00}; // 150 W
+    writeControlPoint(appDesc.conn_handle, requestControl, sizeof(requestControl));
+    writeControlPoint(appDesc.conn_handle, setTargetPower, sizeof(setTargetPower));
+    int64_t ergUs = esp_timer_get_time();
+    BENCH_CHECK(waitForIntervals(LINK_ERG_BIKE_INTERVAL, LINK_ERG_APP_INTERVAL, 3 * LINK_MANAGER_PERIOD_MS));
+    printf("ERG on -> both links at %.1f ms after %.0f ms\n", LINK_ERG_APP_INTERVAL * 1.25,
+           (esp_timer_get_time() - ergUs) / 1000.0);
+    linkManagerGetStats(stats);
+    BENCH_CHECK(stats.activity == LINK_ACTIVITY_ERG);
+    BENCH_CHECK(findLink(stats, LINK_ROLE_BIKE)->updatesRequested == 1 && findLink(stats, LINK_ROLE_APP)->updatesRequested == 1);
+
+    // --- ERG off, and the app refuses: asked once, bike stays harmonic with it ---
+    hostGapRefuseUpdates(appDesc.conn_handle, true);
+    uint8_t stopErg[] = {0x05, 0x00, 0x00};
+    writeControlPoint(appDesc.conn_handle, stopErg, sizeof(stopErg));
+    BENCH_CHECK(waitForIntervals(LINK_RIDE_BIKE_INTERVAL, LINK_ERG_APP_INTERVAL, LINK_UPDATE_MIN_MS + 3 * LINK_MANAGER_PERIOD_MS));
+    for (int i = 0; i < (int)(LINK_UPDATE_MIN_MS + 3 * LINK_MANAGER_PERIOD_MS) / 10; i++) {
+        linkManagerGetStats(stats);
+        if (findLink(stats, LINK_ROLE_APP)->updatesRefused > 0) break;
+        delay(10);
+    }
+    appLink = findLink(stats, LINK_ROLE_APP);
+    BENCH_CHECK(stats.activity == LINK_ACTIVITY_RIDING && appLink->updatesRequested == 2 && appLink->updatesRefused == 1);
+    BENCH_CHECK(hostGapUpdateRequests(appDesc.conn_handle) == 2);
+    delay(2 * LINK_MANAGER_PERIOD_MS);
+    BENCH_CHECK(hostGapUpdateRequests(appDesc.conn_handle) == 2); // Not asked again
+    printf("ERG off, app refuses 30-45 ms: asked once, stays at 15 ms; bike back to 30 ms (every second app event)\n");
+    linkManagerLogStats();
+
+    // --- Cost (NimBLE host task per bike sample; forwarder per notify) ---
+    printf("Cost:\n");
+    pedalling = false;
+    benchRun("linkManagerOnBikeSample", iterations, []() {
+        linkManagerOnBikeSample();
+    });
+    benchRun("linkManagerOnNotify", iterations, []() {
+        linkManagerOnNotify(1);
+    });
+    benchRun("linkHarmonicInterval (no match in range)", iterations, []() {
+        benchKeep(linkHarmonicInterval(24, 30, 31));
+    });
+    return 0;
+}
@@ -0,0 +1,167 @@
+// External sensor links (sensor_links.cpp) on the host: Heart Rate / Cycling Power parsing, per-link
+// retry backoff, discovery, the merge rules (meter priority, staleness) and heart rate in 0x2ACC.
+// Usage: sim_sensor_links [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <esp_timer.h>
+#include "sensor_links.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "system_tasks.h"
+#include "telemetry.h"
+#include "bench_util.h"
+
+extern MyNimBLEAdvertisedDeviceCallbacks myAdvertisedDeviceCallbacks_global; // Defined in the sketch
+
+// Merach S26 0xFFF1 data packet: 25.00 km/h, 90 RPM (x2 = 180), 150.0 W (x10 = 1500)
+static uint8_t merachDataPacket[] = {0x02, 0x42, 0x00, 0xC4, 0x09, 0x00, 0xB4, 0x00, 0x00, 0xDC, 0x05};
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    // --- Parsers ---
+    uint16_t bpm;
+    const uint8_t hr8[] = {0x06, 142};                  // uint8 BPM, contact detected
+    const uint8_t hr16[] = {0x01, 0x2C, 0x01};          // uint16 BPM (300)
+    const uint8_t hrNoContact[] = {0x04, 90};           // Contact supported, not detected
+    const uint8_t hrRr[] = {0x10, 71, 0x00, 0x04};      // uint8 BPM + RR interval
+    BENCH_CHECK(sensorParseHeartRate(hr8, sizeof(hr8), bpm) && bpm == 142);
+    BENCH_CHECK(sensorParseHeartRate(hr16, sizeof(hr16), bpm) && bpm == 300);
+    BENCH_CHECK(sensorParseHeartRate(hrRr, sizeof(hrRr), bpm) && bpm == 71);
+    BENCH_CHECK(!sensorParseHeartRate(hrNoContact, sizeof(hrNoContact), bpm));
+    BENCH_CHECK(!sensorParseHeartRate(hr16, 2, bpm) && !sensorParseHeartRate(hr8, 1, bpm));
+    int16_t powerW;
+    const uint8_t cp[] = {0x20, 0x00, 0xF5, 0x00, 0x10, 0x27};  // Flags (crank data), 245 W, ...
+    const uint8_t cpNegative[] = {0x00, 0x00, 0xF6, 0xFF};      // -10 W (backpedalling)
+    BENCH_CHECK(sensorParseCyclingPower(cp, sizeof(cp), powerW) && powerW == 245);
+    BENCH_CHECK(sensorParseCyclingPower(cpNegative, sizeof(cpNegative), powerW) && powerW == -10);
+    BENCH_CHECK(!sensorParseCyclingPower(cp, 3, powerW));
+
+    // --- Link policy ---
+    printf("Link backoff (ms):");
+    for (uint8_t failures = 1; failures <= 8; failures++) printf(" %lu", (unsigned long)sensorLinkBackoffMs(failures));
+    printf("\n");
+    BENCH_CHECK(sensorLinkBackoffMs(1) == SENSOR_RETRY_MIN_MS && sensorLinkBackoffMs(2) == 2 * SENSOR_RETRY_MIN_MS);
+    BENCH_CHECK(sensorLinkBackoffMs(255) == SENSOR_RETRY_MAX_MS);
+
+    SensorLink disabled;
+    sensorLinkInit(disabled, false);
+    BENCH_CHECK(sensorLinkNext(disabled, 0, false) == SENSOR_ACTION_NONE);
+
+    SensorLink link;
+    sensorLinkInit(link, true);
+    BENCH_CHECK(sensorLinkNext(link, 1000, true) == SENSOR_ACTION_NONE);   // Bike scanning: wait
+    BENCH_CHECK(sensorLinkNext(link, 1000, false) == SENSOR_ACTION_SCAN);
+    sensorLinkFailed(link, 1000);                                           // Nothing found
+    BENCH_CHECK(link.state == SENSOR_LINK_BACKOFF && link.nextAttemptMs == 1000 + SENSOR_RETRY_MIN_MS);
+    BENCH_CHECK(sensorLinkNext(link, 1500, false) == SENSOR_ACTION_NONE);
+    sensorLinkFound(link);                                                  // Seen during the bike's scan
+    BENCH_CHECK(sensorLinkNext(link, 1600, false) == SENSOR_ACTION_CONNECT && link.state == SENSOR_LINK_CONNECTING);
+    sensorLinkConnected(link);
+    BENCH_CHECK(link.failures == 0 && sensorLinkNext(link, 1700, false) == SENSOR_ACTION_NONE);
+    sensorLinkDropped(link, 5000);
+    BENCH_CHECK(link.drops == 1 && link.hasDevice && link.nextAttemptMs == 5000 + SENSOR_RETRY_MIN_MS);
+    uint32_t nowMs = link.nextAttemptMs;
+    for (uint8_t attempt = 1; attempt < SENSOR_FORGET_AFTER; attempt++) {
+        BENCH_CHECK(sensorLinkNext(link, nowMs, false) == SENSOR_ACTION_CONNECT);
+        sensorLinkFailed(link, nowMs);
+        BENCH_CHECK(link.hasDevice && link.nextAttemptMs - nowMs == sensorLinkBackoffMs(attempt));
+        nowMs = link.nextAttemptMs;
+    }
+    BENCH_CHECK(sensorLinkNext(link, nowMs, false) == SENSOR_ACTION_CONNECT);
+    sensorLinkFailed(link, nowMs);                                          // Forgotten: search again
+    BENCH_CHECK(!link.hasDevice && link.nextAttemptMs - nowMs == SENSOR_RETRY_MIN_MS);
+    BENCH_CHECK(sensorLinkNext(link, link.nextAttemptMs, false) == SENSOR_ACTION_SCAN);
+    // millis() wraps after 49.7 days; the wait must still end.
+    SensorLink wrapping;
+    sensorLinkInit(wrapping, true);
+    sensorLinkFailed(wrapping, 0xFFFFFC00u);
+    BENCH_CHECK(sensorLinkNext(wrapping, 0x00000100u, false) == SENSOR_ACTION_NONE);
+    BENCH_CHECK(sensorLinkNext(wrapping, 0xFFFFFC00u + SENSOR_RETRY_MIN_MS, false) == SENSOR_ACTION_SCAN);
+
+    // --- Merge rules ---
+    SensorFusion fusion;
+    sensorFusionReset(fusion);
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.bikePower = 150;
+    int64_t frameUs = 100000000;
+    sensorFusionApply(fusion, frame, frameUs);
+    BENCH_CHECK(frame.power == 150 && frame.powerSource == TELEMETRY_SOURCE_BIKE && frame.heartRate == 0);
+    fusion.meterPower = 182;
+    fusion.meterPowerUs = frameUs - 400000;
+    fusion.heartRate = 131;
+    fusion.heartRateUs = frameUs + 20000; // Arrived just after the bike packet
+    sensorFusionApply(fusion, frame, frameUs);
+    BENCH_CHECK(frame.power == (SENSOR_PREFER_METER_POWER ? 182 : 150) && frame.heartRate == 131);
+    frame.bikePower = 0;
+    sensorFusionApply(fusion, frame, frameUs);
+    BENCH_CHECK(frame.power == 182 && frame.powerSource == TELEMETRY_SOURCE_METER);
+    frame.bikePower = 150;
+    int64_t staleUs = fusion.meterPowerUs + (int64_t)SENSOR_MAX_AGE_MS * 1000 + 1;
+    sensorFusionApply(fusion, frame, staleUs);                              // Meter went quiet
+    BENCH_CHECK(frame.power == 150 && frame.powerSource == TELEMETRY_SOURCE_BIKE);
+    sensorFusionApply(fusion, frame, fusion.heartRateUs + (int64_t)SENSOR_MAX_AGE_MS * 1000 + 1);
+    BENCH_CHECK(frame.heartRate == 0);
+    printf("Merge: bike 150 W + meter 182 W -> %u W; stale after %u ms\n", SENSOR_PREFER_METER_POWER ? 182 : 150,
+           SENSOR_MAX_AGE_MS);
+
+    // --- Bridge: discovery, sensor notifications, bike packets and 0x2ACC ---
+    systemTaskCreate(SYSTEM_TASK_PERIPHERAL_SETUP);
+    for (int i = 0; i < 200 && !NimBLEDevice::getAdvertising()->isAdvertising(); i++) delay(10);
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral != nullptr);
+    ble_gap_conn_desc appDesc;
+    pServer_Peripheral->hostConnect(1, 247, &appDesc);
+    pIndoorBikeDataCharacteristic_Peripheral->hostSubscribe(&appDesc, 0x0001);
+    bikeSensorConnected = true;
+
+    sensorBegin();
+    SensorLink links[SENSOR_LINK_COUNT];
+    NimBLEAdvertisedDevice strap;
+    strap.hostSet(NimBLEAddress(std::string("c0:ff:ee:00:00:01"), BLE_ADDR_RANDOM), "HRM-Pro", -60);
+    strap.hostAddService(NimBLEUUID((uint16_t)HEART_RATE_SERVICE_UUID_SHORT));
+    myAdvertisedDeviceCallbacks_global.onResult(&strap);
+    sensorGetLinks(links);
+    BENCH_CHECK(links[SENSOR_LINK_HEART_RATE].hasDevice == (bool)SENSOR_HR_ENABLED);
+    BENCH_CHECK(!links[SENSOR_LINK_POWER].hasDevice); // A strap is not a power meter
+
+    parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.power == 150 && frame.bikePower == 150 && frame.heartRate == 0);
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    BENCH_CHECK(pIndoorBikeDataCharacteristic_Peripheral->hostLastSent().size() == 20); // No strap yet: no HR field
+
+    uint8_t hrSample[] = {0x06, 128};
+    heartRateNotificationCallback(nullptr, hrSample, sizeof(hrSample), true);
+    parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.heartRate == 128 && frame.speed == 2500);
+    BENCH_CHECK(sendDataToMyWhoosh(frame));
+    const std::vector<uint8_t>& sent = pIndoorBikeDataCharacteristic_Peripheral->hostLastSent();
+    BENCH_CHECK(sent.size() == 21 && sent[0] == 0x74 && sent[1] == 0x0B); // Flags + Heart Rate Present
+    BENCH_CHECK(sent[18] == 128);
+    printf("0x2ACC with heart rate (%u bytes):", (unsigned)sent.size());
+    for (size_t i = 0; i < sent.size(); i++) printf(" %02X", sent[i]);
+    printf("\n");
+
+    uint8_t meterSample[] = {0x00, 0x00, 0xC8, 0x00}; // 200 W
+    cyclingPowerNotificationCallback(nullptr, meterSample, sizeof(meterSample), true);
+    parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    telemetryRead(frame);
+    BENCH_CHECK(frame.bikePower == 150 && frame.power == (SENSOR_PREFER_METER_POWER ? 200 : 150));
+
+    // --- Cost (NimBLE host task, per bike packet) ---
+    printf("Cost:\n");
+    benchRun("sensorFusionApply", iterations, [&]() {
+        sensorFusionApply(fusion, frame, frameUs);
+        benchKeep(frame);
+    });
+    benchRun("parseCustomBikeData + merge + publish", iterations / 10, []() {
+        parseCustomBikeData(merachDataPacket, sizeof(merachDataPacket));
+    });
+    benchRun("heartRateNotificationCallback", iterations / 10, [&]() {
+        heartRateNotificationCallback(nullptr, hrSample, sizeof(hrSample), true);
+    });
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Stepper motion planner (stepper_motion.cpp) on the host: runs moves step by step, checks speed and
+// acceleration limits, retargeting, cancellation and homing, then drives the real motion task and
+// step timer ISR through the queue, and times one planner step (the ISR's work).
+// Usage: sim_stepper [iterations]
+#include <Arduino.h>
+#include "stepper_motion.h"
+#include "bench_util.h"
+#include <math.h>
+
+// --- Profile Recorder ---
+// Speed is averaged over windows of at least profileWindowS: single whole-us intervals are too
+// coarse to differentiate at full speed.
+static const double profileWindowS = 0.02;
+
+struct ProfileStats {
+    uint32_t steps;
+    uint32_t reversals;
+    double timeS;
+    double maxSpeedSps;
+    double maxAccelSps2;
+};
+
+// Runs the planner until it is idle (or maxSteps). 'event' is called before every step and may retarget.
+template <typename Event>
+static ProfileStats runProfile(StepperPlanner& planner, uint32_t maxSteps, bool homeSwitchAtZero, Event event) {
+    ProfileStats stats = {0, 0, 0.0, 0.0, 0.0};
+    int8_t previousDirection = 0;
+    uint32_t windowSteps = 0;
+    double windowTime = 0.0, previousWindowSpeed = -1.0, previousWindowCenter = 0.0;
+    while (stats.steps < maxSteps) {
+        event(stats.steps);
+        bool homeSwitch = homeSwitchAtZero && planner.state == STEPPER_STATE_HOMING && planner.position <= 0;
+        uint32_t intervalUs = stepperPlannerNext(planner, homeSwitch);
+        if (intervalUs == 0) break;
+        double dt = intervalUs / 1e6;
+        if (previousDirection != 0 && planner.direction != previousDirection) {
+            stats.reversals++;
+            windowSteps = 0;
+            windowTime = 0.0;
+            previousWindowSpeed = -1.0; // Came to rest; the ramp restarts
+        }
+        previousDirection = planner.direction;
+        if (1.0 / dt > stats.maxSpeedSps) stats.maxSpeedSps = 1.0 / dt;
+        stats.timeS += dt;
+        stats.steps++;
+
+        windowSteps++;
+        windowTime += dt;
+        if (windowTime >= profileWindowS) {
+            double speed = windowSteps / windowTime;
+            double center = stats.timeS - windowTime / 2.0;
+            if (previousWindowSpeed >= 0.0) {
+                double accel = fabs(speed - previousWindowSpeed) / (center - previousWindowCenter);
+                if (accel > stats.maxAccelSps2) stats.maxAccelSps2 = accel;
+            }
+            previousWindowSpeed = speed;
+            previousWindowCenter = center;
+            windowSteps = 0;
+            windowTime = 0.0;
+        }
+    }
+    return stats;
+}
+
+static ProfileStats runProfile(StepperPlanner& planner, uint32_t maxSteps = 100000) {
+    return runProfile(planner, maxSteps, false, [](uint32_t) {});
+}
+
+// Time for an ideal trapezoid (or triangle) of 'distance' steps.
+static double idealMoveTime(const StepperConfig& config, double distance) {
+    double rampSteps = config.maxSpeedSps * config.maxSpeedSps / (2.0 * config.accelSps2);
+    if (distance <= 2.0 * rampSteps) return 2.0 * sqrt(distance / config.accelSps2);
+    return 2.0 * config.maxSpeedSps / config.accelSps2 + (distance - 2.0 * rampSteps) / config.maxSpeedSps;
+}
+
+static void printProfile(const char* name, const ProfileStats& stats) {
+    printf("  %-36s %6u steps %8.3f s  max %7.1f steps/s  max accel %7.1f steps/s^2  reversals %u\n",
+           name, stats.steps, stats.timeS, stats.maxSpeedSps, stats.maxAccelSps2, stats.reversals);
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+
+    StepperConfig config;
+    stepperDefaultConfig(config);
+    // The discrete ramp runs slightly hot on its first steps (Austin: < 10 % after step 2).
+    double accelLimit = config.accelSps2 * 1.1;
+    printf("Planner: max %.0f steps/s, accel %.0f steps/s^2, travel 0..%ld\n",
+           config.maxSpeedSps, config.accelSps2, (long)config.maxPosition);
+
+    // --- Point-to-point moves ---
+    const int32_t distances[] = {1, 2, 10, 100, 640, 3000, 9000};
+    for (size_t i = 0; i < sizeof(distances) / sizeof(distances[0]); i++) {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        stepperPlannerMoveTo(planner, distances[i]);
+        ProfileStats stats = runProfile(planner);
+        char name[48];
+        snprintf(name, sizeof(name), "move 0 -> %ld", (long)distances[i]);
+        printProfile(name, stats);
+        BENCH_CHECK(planner.position == distances[i] && planner.state == STEPPER_STATE_IDLE);
+        BENCH_CHECK(stats.steps == (uint32_t)distances[i] && stats.reversals == 0);
+        BENCH_CHECK(stats.maxSpeedSps <= 1e6 / (floor(1e6 / config.maxSpeedSps) - 1.0)); // Whole-us dithering
+        BENCH_CHECK(stats.maxAccelSps2 <= accelLimit);
+        if (distances[i] >= 100) BENCH_CHECK(stats.timeS <= idealMoveTime(config, distances[i]) * 1.1);
+    }
+
+    // --- Retarget behind the motor at full speed: brake, reverse once, land on the new target ---
+    {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        stepperPlannerMoveTo(planner, 9000);
+        ProfileStats stats = runProfile(planner, 100000, false, [&](uint32_t step) {
+            if (step == 2000) stepperPlannerMoveTo(planner, 1000);
+        });
+        printProfile("9000, retarget to 1000 at step 2000", stats);
+        BENCH_CHECK(planner.position == 1000 && stats.reversals == 1);
+        BENCH_CHECK(stats.maxAccelSps2 <= accelLimit);
+    }
+
+    // --- Target moved further away while braking: accelerate again without stopping ---
+    {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        stepperPlannerMoveTo(planner, 1000);
+        ProfileStats stats = runProfile(planner, 100000, false, [&](uint32_t step) {
+            if (step == 900) stepperPlannerMoveTo(planner, 4000);
+        });
+        printProfile("1000, extended to 4000 while braking", stats);
+        BENCH_CHECK(planner.position == 4000 && stats.reversals == 0);
+        BENCH_CHECK(stats.maxAccelSps2 <= accelLimit);
+    }
+
+    // --- Cancel at cruise: stops within the braking distance ---
+    {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        stepperPlannerMoveTo(planner, 9000);
+        int32_t rampSteps = (int32_t)ceil(config.maxSpeedSps * config.maxSpeedSps / (2.0 * config.accelSps2));
+        ProfileStats stats = runProfile(planner, 100000, false, [&](uint32_t step) {
+            if (step == 3000) stepperPlannerStop(planner);
+        });
+        printProfile("9000, cancelled at step 3000", stats);
+        BENCH_CHECK(planner.state == STEPPER_STATE_IDLE && stats.reversals == 0);
+        BENCH_CHECK(planner.position > 3000 && planner.position <= 3000 + rampSteps + 1);
+        BENCH_CHECK(stats.maxAccelSps2 <= accelLimit);
+    }
+
+    // --- Homing: against a switch, then back to the target requested meanwhile ---
+    {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        planner.position = 2500; // Unknown to the planner; the switch is at 0
+        stepperPlannerHome(planner);
+        stepperPlannerMoveTo(planner, 800);
+        ProfileStats stats = runProfile(planner, 100000, true, [](uint32_t) {});
+        printProfile("home from 2500 (switch), then 800", stats);
+        BENCH_CHECK(planner.homed && planner.position == 800 && planner.state == STEPPER_STATE_IDLE);
+        BENCH_CHECK(stats.steps == 2500 + 800);
+    }
+    {
+        StepperPlanner planner;
+        stepperPlannerInit(planner, config);
+        ProfileStats first = runProfile(planner, 100000); // Idle: no steps
+        BENCH_CHECK(first.steps == 0);
+        stepperPlannerMoveTo(planner, 5000);
+        ProfileStats stats = runProfile(planner, 100000, false, [&](uint32_t step) {
+            if (step == 2000) stepperPlannerHome(planner); // No switch: brakes, then full homing travel
+        });
+        printProfile("5000, home (no switch) at step 2000", stats);
+        BENCH_CHECK(planner.homed && planner.position == 0);
+        BENCH_CHECK(stats.reversals == 1 && stats.maxAccelSps2 <= accelLimit);
+        BENCH_CHECK(stats.steps > (uint32_t)config.homingMaxSteps);
+    }
+
+    // --- End to end: queue -> motion task -> step timer ISR -> STEP pin ---
+    {
+        motionBegin();
+        TaskHandle_t handle = NULL;
+        xTaskCreatePinnedToCore(motionTask_func, "Motion", 3072, NULL, 2, &handle, 1);
+        delay(20);
+        motionRequestStop(); // Abort the boot homing (no switch on the host: it would take seconds)
+        delay(20);
+        MotionStatus status;
+        motionGetStatus(status);
+        int32_t start = status.position;
+        uint32_t pulsesBefore = status.pulses;
+        BENCH_CHECK(!status.homed);
+
+        motionRequestLevel(ERG_LEVEL_MIN);
+        unsigned long startMs = millis();
+        do {
+            delay(10);
+            motionGetStatus(status);
+        } while ((status.state != STEPPER_STATE_IDLE || status.position != status.target) && millis() - startMs < 5000);
+        int32_t target = motionLevelToSteps(ERG_LEVEL_MIN);
+        printf("  motion task: %ld -> %ld steps in %lu ms (%u pulses, %u commands, %u dropped)\n", (long)start,
+               (long)status.position, millis() - startMs, status.pulses - pulsesBefore, status.commands, status.dropped);
+        BENCH_CHECK(status.position == target && status.state == STEPPER_STATE_IDLE);
+        BENCH_CHECK(status.pulses - pulsesBefore == (uint32_t)(target - start));
+        BENCH_CHECK(status.dropped == 0);
+    }
+
+    // --- Cost of one planner step (runs in the step timer ISR) ---
+    printf("Per-step cost:\n");
+    StepperPlanner planner;
+    stepperPlannerInit(planner, config);
+    planner.maxPosition = INT32_MAX;
+    stepperPlannerMoveTo(planner, INT32_MAX);
+    benchRun("stepperPlannerNext (cruise)", iterations, [&]() {
+        benchKeep(stepperPlannerNext(planner, false));
+    });
+    uint32_t rampIterations = iterations / 100;
+    benchRun("stepperPlannerNext (ramp up / down)", rampIterations, [&]() {
+        if (planner.state == STEPPER_STATE_IDLE || planner.position >= 3000) {
+            stepperPlannerInit(planner, config);
+            stepperPlannerMoveTo(planner, 3000);
+        }
+        benchKeep(stepperPlannerNext(planner, false));
+    });
+    return 0;
+}
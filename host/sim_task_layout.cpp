@@ -0,0 +1,128 @@
+// Task layout (system_tasks.cpp) on the host: the sketch's own setup() and loop() with every task, the
+// core each task is pinned to, the one-shot peripheral setup freeing its stack, the button -> bike connect
+// task and BLE callbacks -> UI queues, and per-task CPU shares.
+// Usage: sim_task_layout [iterations]
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include "system_tasks.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "app_sessions.h"
+#include "bench_util.h"
+
+void setup(); // FTMS_test.ino (host/sketch_host.cpp)
+void loop();
+
+static const SystemTaskStats* findTask(const SystemTasksStats& stats, const char* name) {
+    for (uint8_t i = 0; i < stats.count; i++) {
+        if (strcmp(stats.tasks[i].name, name) == 0) return &stats.tasks[i];
+    }
+    return nullptr;
+}
+
+static void runLoop(uint32_t ms) {
+    uint32_t start = millis();
+    while (millis() - start < ms) loop();
+}
+
+// Stand-in for a future motor / ERG load: busy for dutyPercent of every 10 ms.
+static volatile uint8_t loadDutyPercent = 0;
+static void loadTask_func(void* pvParameters) {
+    for (;;) {
+        int64_t startUs = esp_timer_get_time();
+        while (esp_timer_get_time() - startUs < loadDutyPercent * 100) {
+        }
+        vTaskDelay(pdMS_TO_TICKS(10 - loadDutyPercent / 10));
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 10000000;
+    hostSetSerialEcho(false);
+    hostNvsErase();
+    hostSetPinLevel(PAIR_BUTTON_PIN, HIGH);
+
+    // --- Boot: the sketch's setup() ---
+    setup();
+    for (int i = 0; i < 500 && blePeripheralTaskHandle != NULL; i++) delay(10);
+    BENCH_CHECK(blePeripheralTaskHandle == NULL && pServer_Peripheral != nullptr);
+    BENCH_CHECK(NimBLEDevice::getAdvertising()->isAdvertising());
+
+    static SystemTasksStats stats;
+    systemTasksGetStats(stats);
+    const SystemTaskStats* setupTask = findTask(stats, "PeripheralSetup");
+    BENCH_CHECK(setupTask != nullptr && !setupTask->running && setupTask->stackBytes == 20480);
+    const char* dataPath[] = {"Forwarder"};
+    const char* appCore[] = {"LogDrain", "ControlPoint", "BikeControl", "BikeConnect", "BikeLink", "ERG", "LinkManager", "Sensors"};
+    for (const char* name : dataPath) {
+        const SystemTaskStats* task = findTask(stats, name);
+        BENCH_CHECK(task != nullptr && task->running && task->core == TASK_CORE_DATA);
+    }
+    for (const char* name : appCore) {
+        const SystemTaskStats* task = findTask(stats, name);
+        BENCH_CHECK(task != nullptr && task->running && task->core == TASK_CORE_APP);
+    }
+    uint8_t tasksAfterBoot = stats.count;
+    printf("Boot: %u tasks (the peripheral setup task ended and freed its 20480-byte stack)\n", tasksAfterBoot);
+
+    // --- Button -> bike connect task: a scan without creating a task ---
+    NimBLEScan* scan = NimBLEDevice::getScan();
+    uint32_t startsBefore = scan->hostStarts();
+    hostSetPinLevel(PAIR_BUTTON_PIN, LOW);
+    runLoop(120);
+    hostSetPinLevel(PAIR_BUTTON_PIN, HIGH);
+    for (int i = 0; i < 500 && !(scan->isScanning() && scan->hostDuration() == BIKE_SCAN_PAIRING_SECONDS); i++) runLoop(1);
+    BENCH_CHECK(scan->hostStarts() > startsBefore && scan->hostActive() && scan->hostDuration() == BIKE_SCAN_PAIRING_SECONDS);
+    systemTasksGetStats(stats);
+    BENCH_CHECK(stats.count == tasksAfterBoot);
+    scan->hostFinish();
+
+    // --- BLE callbacks -> UI: the app in control leaves, loop() clears its targets ---
+    ble_gap_conn_desc appDesc;
+    pServer_Peripheral->hostConnect(1, 247, &appDesc);
+    BENCH_CHECK(appSessionRequestControl(1));
+    runLoop(20);
+    targetResistanceLevel_App = 5;
+    targetInclinationPercentX100 = 250;
+    int64_t leftUs = esp_timer_get_time();
+    pServer_Peripheral->hostDisconnect(1);
+    while (targetResistanceLevel_App != 0 && esp_timer_get_time() - leftUs < 1000000) loop();
+    double clearedMs = (esp_timer_get_time() - leftUs) / 1000.0;
+    BENCH_CHECK(targetResistanceLevel_App == 0 && targetInclinationPercentX100 == 0);
+    BENCH_CHECK(uiEventsDropped() == 0);
+    printf("App in control left -> targets cleared by loop() in %.2f ms (was a 10 ms poll of globals)\n", clearedMs);
+
+    // --- CPU shares: a 30% load on core 1 next to the idle system ---
+    TaskHandle_t loadTask = NULL;
+    xTaskCreatePinnedToCore(loadTask_func, "Load", 2048, NULL, 1, &loadTask, TASK_CORE_APP);
+    loadDutyPercent = 30;
+    systemTasksGetStats(stats);
+    runLoop(1000);
+    systemTasksGetStats(stats);
+    const SystemTaskStats* load = findTask(stats, "Load");
+    BENCH_CHECK(load != nullptr && load->core == TASK_CORE_APP && load->cpuPermille >= 200 && load->cpuPermille <= 400);
+    printf("Task table over %lu ms (host: stacks are not instrumented, the high-water mark is the whole stack):\n",
+           (unsigned long)stats.sampleMs);
+    for (uint8_t i = 0; i < stats.count; i++) {
+        const SystemTaskStats& task = stats.tasks[i];
+        printf("  %-18s core %c prio %2u cpu %5.1f%% stack %5lu%s\n", task.name, task.core >= 0 ? (char)('0' + task.core) : '*',
+               task.priority, task.cpuPermille >= 0 ? task.cpuPermille / 10.0 : 0.0, (unsigned long)task.stackBytes,
+               task.running ? "" : " (ended)");
+    }
+    loadDutyPercent = 0;
+
+    // --- Cost ---
+    printf("Cost:\n");
+    UiEvent event;
+    benchRun("uiPostEvent + uiWaitEvent", iterations / 10, [&]() {
+        uiPostEvent(UI_EVENT_APP_LINK, 1);
+        benchKeep(uiWaitEvent(event, 0));
+    });
+    benchRun("systemTasksGetStats", iterations / 1000, [&]() {
+        systemTasksGetStats(stats);
+        benchKeep(stats.count);
+    });
+    return 0;
+}
@@ -0,0 +1,3 @@
+// Compiles the Arduino sketch as a regular C++ translation unit for the host build.
+// It provides the sketch's globals (and setup()/loop()) to the host tools.
+#include "../FTMS_test.ino"
@@ -0,0 +1,232 @@
+// Host (Linux) implementation of the Arduino core stand-in (see host/include/Arduino.h).
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+
+static const std::chrono::steady_clock::time_point hostStartTime = std::chrono::steady_clock::now();
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - hostStartTime).count();
+}
+
+unsigned long millis() {
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// --- GPIO ---
+static int hostPinLevels[64];
+static bool hostPinLevelsInitialized = false;
+
+static void initPinLevels() {
+    if (!hostPinLevelsInitialized) {
+        for (int i = 0; i < 64; i++) hostPinLevels[i] = HIGH; // Pull-ups: buttons idle high
+        hostPinLevelsInitialized = true;
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    initPinLevels();
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    initPinLevels();
+    if (pin < 64) hostPinLevels[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    initPinLevels();
+    return pin < 64 ? hostPinLevels[pin] : LOW;
+}
+
+void hostSetPinLevel(uint8_t pin, int level) {
+    initPinLevels();
+    if (pin < 64) hostPinLevels[pin] = level;
+}
+
+int hostGetPinLevel(uint8_t pin) {
+    initPinLevels();
+    return pin < 64 ? hostPinLevels[pin] : LOW;
+}
+
+// --- Hardware timer ---
+struct hw_timer_s {
+    std::mutex mutex;
+    std::condition_variable changed;
+    void (*isr)(void);
+    uint64_t alarm;
+    bool autoreload;
+    bool enabled;
+    bool quit;
+    uint64_t generation; // Bumped on every change so the waiting thread re-reads the alarm
+    std::chrono::steady_clock::time_point start;
+};
+
+static void hostTimerRun(hw_timer_t* timer) {
+    std::unique_lock<std::mutex> lock(timer->mutex);
+    while (!timer->quit) {
+        if (!timer->enabled || timer->isr == nullptr) {
+            timer->changed.wait(lock);
+            continue;
+        }
+        std::chrono::steady_clock::time_point deadline = timer->start + std::chrono::microseconds(timer->alarm);
+        uint64_t generation = timer->generation;
+        if (timer->changed.wait_until(lock, deadline, [&]() { return timer->quit || timer->generation != generation; })) {
+            continue;
+        }
+        // Like the ESP32 timer, auto-reload restarts the count at the alarm, not when the ISR runs.
+        if (timer->autoreload) timer->start = deadline;
+        else timer->enabled = false;
+        void (*isr)(void) = timer->isr;
+        lock.unlock();
+        isr();
+        lock.lock();
+    }
+}
+
+static void hostTimerChanged(hw_timer_t* timer) {
+    timer->generation++;
+    timer->changed.notify_all();
+}
+
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp) {
+    hw_timer_t* timer = new hw_timer_t();
+    timer->isr = nullptr;
+    timer->alarm = 0;
+    timer->autoreload = false;
+    timer->enabled = false;
+    timer->quit = false;
+    timer->generation = 0;
+    timer->start = std::chrono::steady_clock::now();
+    std::thread(hostTimerRun, timer).detach();
+    return timer;
+}
+
+void timerEnd(hw_timer_t* timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->quit = true; // The thread exits; the timer itself is leaked like on the ESP32 core
+    hostTimerChanged(timer);
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool edge) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->isr = fn;
+    hostTimerChanged(timer);
+}
+
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->alarm = alarmValue;
+    timer->autoreload = autoreload;
+    hostTimerChanged(timer);
+}
+
+void timerAlarmEnable(hw_timer_t* timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->enabled = true;
+    hostTimerChanged(timer);
+}
+
+void timerAlarmDisable(hw_timer_t* timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->enabled = false;
+    hostTimerChanged(timer);
+}
+
+void timerWrite(hw_timer_t* timer, uint64_t value) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->start = std::chrono::steady_clock::now() - std::chrono::microseconds(value);
+    hostTimerChanged(timer);
+}
+
+// --- Serial ---
+HardwareSerial Serial;
+static bool hostSerialEcho = true;
+static unsigned long hostSerialWritten = 0;
+static std::mutex hostSerialMutex;
+static std::deque<char> hostSerialInput;
+
+void hostSetSerialEcho(bool enabled) {
+    hostSerialEcho = enabled;
+}
+
+void hostFeedSerialInput(const char* text) {
+    std::lock_guard<std::mutex> lock(hostSerialMutex);
+    while (*text) hostSerialInput.push_back(*text++);
+}
+
+unsigned long hostSerialBytesWritten() {
+    return hostSerialWritten;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(hostSerialMutex);
+    hostSerialWritten += size;
+    if (hostSerialEcho) fwrite(buffer, 1, size, stdout);
+    return size;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::print(const char* str) {
+    return write((const uint8_t*)str, strlen(str));
+}
+
+size_t HardwareSerial::print(int value) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", value);
+    return print(buf);
+}
+
+size_t HardwareSerial::println(const char* str) {
+    return print(str) + println();
+}
+
+size_t HardwareSerial::println() {
+    return write((const uint8_t*)"\r\n", 2);
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    char buf[512];
+    va_list arg;
+    va_start(arg, format);
+    vsnprintf(buf, sizeof(buf), format, arg);
+    va_end(arg);
+    return print(buf);
+}
+
+void HardwareSerial::flush() {
+    std::lock_guard<std::mutex> lock(hostSerialMutex);
+    if (hostSerialEcho) fflush(stdout);
+}
+
+int HardwareSerial::available() {
+    std::lock_guard<std::mutex> lock(hostSerialMutex);
+    return (int)hostSerialInput.size();
+}
+
+int HardwareSerial::read() {
+    std::lock_guard<std::mutex> lock(hostSerialMutex);
+    if (hostSerialInput.empty()) return -1;
+    char c = hostSerialInput.front();
+    hostSerialInput.pop_front();
+    return (uint8_t)c;
+}
@@ -0,0 +1,401 @@
+// Host (Linux) implementation of the FreeRTOS stand-in (see host/include/freertos/*.h).
+// Each task is a detached std::thread; vTaskDelete(NULL) unwinds the calling task's thread.
+#include <Arduino.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <pthread.h>
+#include <time.h>
+
+struct HostTask {
+    char name[16];
+    UBaseType_t priority;
+    uint32_t stackDepth;
+    BaseType_t coreId;
+    eTaskState state;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifyCount;
+    UBaseType_t number;
+    clockid_t cpuClock;  // The thread's CPU-time clock: the task's run-time counter
+    bool hasCpuClock;
+};
+
+struct HostTaskExit {}; // Thrown by vTaskDelete(NULL) to leave the task function
+
+static thread_local HostTask* hostCurrentTask = nullptr;
+static std::mutex hostTasksMutex;
+static std::vector<HostTask*> hostTasks; // Every task ever created (handles stay valid after vTaskDelete)
+static UBaseType_t hostTaskNumber = 0;
+
+static HostTask* newHostTask(const char* name, UBaseType_t priority, uint32_t stackDepth, BaseType_t coreId) {
+    HostTask* task = new HostTask();
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = '\0';
+    task->priority = priority;
+    task->stackDepth = stackDepth;
+    task->coreId = coreId;
+    task->state = eReady;
+    task->notifyCount = 0;
+    task->hasCpuClock = false;
+    std::lock_guard<std::mutex> lock(hostTasksMutex);
+    task->number = ++hostTaskNumber;
+    hostTasks.push_back(task);
+    return task;
+}
+
+// Called on the task's own thread.
+static void attachCpuClock(HostTask* task) {
+    task->hasCpuClock = pthread_getcpuclockid(pthread_self(), &task->cpuClock) == 0;
+}
+
+static HostTask* currentTask() {
+    if (hostCurrentTask == nullptr) {
+        hostCurrentTask = newHostTask("loopTask", 1, 8192, 1); // Threads not created through xTaskCreate*
+        attachCpuClock(hostCurrentTask);
+    }
+    return hostCurrentTask;
+}
+
+static TickType_t ticksNow() {
+    return (TickType_t)millis();
+}
+
+static void sleepTicks(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+// --- Critical sections ---
+static std::recursive_mutex hostCriticalMutex;
+
+void hostEnterCritical(portMUX_TYPE* mux) {
+    hostCriticalMutex.lock();
+}
+
+void hostExitCritical(portMUX_TYPE* mux) {
+    hostCriticalMutex.unlock();
+}
+
+BaseType_t xPortGetCoreID() {
+    return currentTask()->coreId == tskNO_AFFINITY ? 0 : currentTask()->coreId;
+}
+
+// --- Tasks ---
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t ulStackDepth,
+                                           void* pvParameters, UBaseType_t uxPriority, StackType_t* puxStackBuffer,
+                                           StaticTask_t* pxTaskBuffer, BaseType_t xCoreID) {
+    HostTask* task = newHostTask(pcName, uxPriority, ulStackDepth, xCoreID);
+    task->state = eRunning;
+    std::thread([task, pvTaskCode, pvParameters]() {
+        hostCurrentTask = task;
+        attachCpuClock(task);
+        try {
+            pvTaskCode(pvParameters);
+        } catch (const HostTaskExit&) {
+        }
+        task->state = eDeleted;
+    }).detach();
+    return task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth,
+                                   void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask,
+                                   BaseType_t xCoreID) {
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters,
+                                                        uxPriority, nullptr, nullptr, xCoreID);
+    if (pvCreatedTask) *pvCreatedTask = handle;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth,
+                       void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask) {
+    return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority,
+                                   pvCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTask) {
+    if (xTask == nullptr || xTask == hostCurrentTask) {
+        throw HostTaskExit();
+    }
+    // Threads can't be killed from outside on the host; the task is only marked deleted.
+    xTask->state = eDeleted;
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    sleepTicks(xTicksToDelay);
+}
+
+void vTaskDelayUntil(TickType_t* pxPreviousWakeTime, TickType_t xTimeIncrement) {
+    TickType_t wakeTime = *pxPreviousWakeTime + xTimeIncrement;
+    TickType_t now = ticksNow();
+    if ((int32_t)(wakeTime - now) > 0) {
+        sleepTicks(wakeTime - now);
+    }
+    *pxPreviousWakeTime = wakeTime;
+}
+
+TickType_t xTaskGetTickCount() {
+    return ticksNow();
+}
+
+char* pcTaskGetName(TaskHandle_t xTask) {
+    return (xTask ? xTask : currentTask())->name;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return currentTask();
+}
+
+eTaskState eTaskGetState(TaskHandle_t xTask) {
+    return xTask ? xTask->state : eInvalid;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+    return (xTask ? xTask : currentTask())->stackDepth; // Host stacks are not instrumented
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask) {
+    return (xTask ? xTask : currentTask())->coreId;
+}
+
+static uint32_t cpuMicros(HostTask* task) {
+    struct timespec ts;
+    if (!task->hasCpuClock || task->state == eDeleted || clock_gettime(task->cpuClock, &ts) != 0) return 0;
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* pxTaskStatusArray, UBaseType_t uxArraySize, uint32_t* pulTotalRunTime) {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(hostTasksMutex);
+    UBaseType_t live = 0;
+    for (HostTask* task : hostTasks) {
+        if (task->state != eDeleted) live++;
+    }
+    if (live > uxArraySize) return 0; // As FreeRTOS: the array must hold every task
+    UBaseType_t count = 0;
+    for (HostTask* task : hostTasks) {
+        if (task->state == eDeleted) continue;
+        TaskStatus_t& status = pxTaskStatusArray[count++];
+        status.xHandle = task;
+        status.pcTaskName = task->name;
+        status.xTaskNumber = task->number;
+        status.eCurrentState = task->state;
+        status.uxCurrentPriority = task->priority;
+        status.uxBasePriority = task->priority;
+        status.ulRunTimeCounter = cpuMicros(task);
+        status.pxStackBase = nullptr;
+        status.usStackHighWaterMark = task->stackDepth;
+        status.xCoreID = task->coreId;
+    }
+    if (pulTotalRunTime) {
+        *pulTotalRunTime = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start).count();
+    }
+    return count;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask) {
+    return (xTask ? xTask : currentTask())->priority;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+    {
+        std::lock_guard<std::mutex> lock(xTaskToNotify->mutex);
+        xTaskToNotify->notifyCount++;
+    }
+    xTaskToNotify->cv.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    HostTask* task = currentTask();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    if (xTicksToWait == portMAX_DELAY) {
+        task->cv.wait(lock, [task]() { return task->notifyCount > 0; });
+    } else {
+        task->cv.wait_for(lock, std::chrono::milliseconds(xTicksToWait), [task]() { return task->notifyCount > 0; });
+    }
+    uint32_t count = task->notifyCount;
+    if (count > 0) {
+        task->notifyCount = xClearCountOnExit ? 0 : count - 1;
+    }
+    return count;
+}
+
+// --- Queues ---
+struct HostQueue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::vector<uint8_t> storage; // length x itemSize, allocated once: sends and receives never touch the heap
+    UBaseType_t head;            // Oldest item
+    UBaseType_t count;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread::id holder;      // Recursive mutexes only
+    UBaseType_t recursion;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+    HostQueue* queue = new HostQueue();
+    queue->length = uxQueueLength;
+    queue->itemSize = uxItemSize;
+    queue->storage.resize((size_t)uxQueueLength * uxItemSize);
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+    delete xQueue;
+}
+
+static bool waitFor(std::unique_lock<std::mutex>& lock, HostQueue* queue, TickType_t ticks,
+                    const std::function<bool()>& ready) {
+    if (ticks == portMAX_DELAY) {
+        queue->cv.wait(lock, ready);
+        return true;
+    }
+    return queue->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// Caller holds the mutex and has checked for space.
+static void pushItem(HostQueue* queue, const void* item) {
+    if (item && queue->itemSize > 0) {
+        size_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->storage[tail * queue->itemSize], item, queue->itemSize);
+    }
+    queue->count++;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
+    std::unique_lock<std::mutex> lock(xQueue->mutex);
+    if (!waitFor(lock, xQueue, xTicksToWait, [xQueue]() { return xQueue->count < xQueue->length; })) {
+        return errQUEUE_FULL;
+    }
+    pushItem(xQueue, pvItemToQueue);
+    lock.unlock();
+    xQueue->cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
+    return xQueueSend(xQueue, pvItemToQueue, xTicksToWait);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void* pvItemToQueue, BaseType_t* pxHigherPriorityTaskWoken) {
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+    return xQueueSend(xQueue, pvItemToQueue, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void* pvItemToQueue) {
+    {
+        std::lock_guard<std::mutex> lock(xQueue->mutex);
+        xQueue->count = 0;
+        pushItem(xQueue, pvItemToQueue);
+    }
+    xQueue->cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+    std::unique_lock<std::mutex> lock(xQueue->mutex);
+    if (!waitFor(lock, xQueue, xTicksToWait, [xQueue]() { return xQueue->count > 0; })) {
+        return pdFALSE;
+    }
+    if (pvBuffer && xQueue->itemSize > 0) {
+        memcpy(pvBuffer, &xQueue->storage[(size_t)xQueue->head * xQueue->itemSize], xQueue->itemSize);
+    }
+    xQueue->head = (xQueue->head + 1) % xQueue->length;
+    xQueue->count--;
+    lock.unlock();
+    xQueue->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+    std::unique_lock<std::mutex> lock(xQueue->mutex);
+    if (!waitFor(lock, xQueue, xTicksToWait, [xQueue]() { return xQueue->count > 0; })) {
+        return pdFALSE;
+    }
+    if (pvBuffer && xQueue->itemSize > 0) {
+        memcpy(pvBuffer, &xQueue->storage[(size_t)xQueue->head * xQueue->itemSize], xQueue->itemSize);
+    }
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+    std::lock_guard<std::mutex> lock(xQueue->mutex);
+    return xQueue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue) {
+    std::lock_guard<std::mutex> lock(xQueue->mutex);
+    return xQueue->length - xQueue->count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue) {
+    {
+        std::lock_guard<std::mutex> lock(xQueue->mutex);
+        xQueue->count = 0;
+    }
+    xQueue->cv.notify_all();
+    return pdPASS;
+}
+
+// --- Semaphores (queues of zero-size items) ---
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    xQueueSend(mutex, nullptr, 0); // Mutexes start available
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime) {
+    return xQueueReceive(xSemaphore, nullptr, xBlockTime);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+    return xQueueSend(xSemaphore, nullptr, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    mutex->recursion = 0;
+    return mutex;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xBlockTime) {
+    // holder/recursion are only touched by the thread that owns the mutex.
+    if (xMutex->recursion > 0 && xMutex->holder == std::this_thread::get_id()) {
+        xMutex->recursion++;
+        return pdTRUE;
+    }
+    if (xSemaphoreTake(xMutex, xBlockTime) != pdTRUE) return pdFALSE;
+    xMutex->holder = std::this_thread::get_id();
+    xMutex->recursion = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex) {
+    if (xMutex->recursion == 0 || xMutex->holder != std::this_thread::get_id()) return pdFALSE;
+    if (--xMutex->recursion == 0) {
+        xMutex->holder = std::thread::id();
+        return xSemaphoreGive(xMutex);
+    }
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+    vQueueDelete(xSemaphore);
+}
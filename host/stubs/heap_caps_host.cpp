@@ -0,0 +1,46 @@
+// Host (Linux) implementation of the heap capability stand-in (see host/include/esp_heap_caps.h).
+// All capabilities map to malloc. The reported sizes model a HOST_HEAP_SIZE heap of which the
+// process's malloc in-use bytes (mallinfo2) are taken, so leaks show up as falling free bytes.
+// There is no fragmentation model: the largest free block is the whole free size.
+#include <esp_heap_caps.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+static const size_t HOST_HEAP_SIZE = 4 * 1024 * 1024;
+static std::atomic<size_t> hostMinFree(HOST_HEAP_SIZE);
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    size_t used = mallinfo2().uordblks;
+    size_t freeBytes = used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+    size_t minFree = hostMinFree.load();
+    while (freeBytes < minFree && !hostMinFree.compare_exchange_weak(minFree, freeBytes)) {
+    }
+    return freeBytes;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    heap_caps_get_free_size(caps);
+    return hostMinFree.load();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps) {
+    memset(info, 0, sizeof(*info));
+    info->total_free_bytes = heap_caps_get_free_size(caps);
+    info->total_allocated_bytes = HOST_HEAP_SIZE - info->total_free_bytes;
+    info->largest_free_block = info->total_free_bytes;
+    info->minimum_free_bytes = hostMinFree.load();
+}
@@ -0,0 +1,539 @@
+// Host (Linux) implementation of the NimBLE-Arduino stand-in (see host/include/NimBLEDevice.h).
+#include <NimBLEDevice.h>
+#include <algorithm>
+
+// --- NimBLEUUID ---
+NimBLEUUID::NimBLEUUID(uint16_t uuid16) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "0000%04x-0000-1000-8000-00805f9b34fb", uuid16);
+    m_str = buf;
+}
+
+std::string NimBLEUUID::normalize(const std::string& uuid) {
+    std::string lower(uuid);
+    for (size_t i = 0; i < lower.size(); i++) lower[i] = (char)tolower((unsigned char)lower[i]);
+    if (lower.size() == 4) return "0000" + lower + "-0000-1000-8000-00805f9b34fb";
+    if (lower.size() == 8) return lower + "-0000-1000-8000-00805f9b34fb";
+    return lower;
+}
+
+// --- NimBLEAddress ---
+NimBLEAddress::NimBLEAddress() : m_addrType(BLE_ADDR_PUBLIC) {
+    memset(m_address, 0, sizeof(m_address));
+}
+
+NimBLEAddress::NimBLEAddress(ble_addr_t address) : m_addrType(address.type) {
+    memcpy(m_address, address.val, sizeof(m_address));
+}
+
+NimBLEAddress::NimBLEAddress(const std::string& stringAddress, uint8_t type) : m_addrType(type) {
+    memset(m_address, 0, sizeof(m_address));
+    unsigned int b[6];
+    if (sscanf(stringAddress.c_str(), "%02x:%02x:%02x:%02x:%02x:%02x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) == 6) {
+        for (int i = 0; i < 6; i++) m_address[5 - i] = (uint8_t)b[i];
+    }
+}
+
+// Like NimBLE-Arduino 1.4: the bytes are taken most significant first and reversed, so an address
+// from getNative() (little-endian) must go through ble_addr_t instead.
+NimBLEAddress::NimBLEAddress(const uint8_t address[6], uint8_t type) : m_addrType(type) {
+    for (int i = 0; i < 6; i++) m_address[i] = address[5 - i];
+}
+
+NimBLEAddress::NimBLEAddress(const uint64_t& address, uint8_t type) : m_addrType(type) {
+    for (int i = 0; i < 6; i++) m_address[i] = (uint8_t)(address >> (8 * i));
+}
+
+bool NimBLEAddress::equals(const NimBLEAddress& otherAddress) const {
+    return memcmp(m_address, otherAddress.m_address, sizeof(m_address)) == 0;
+}
+
+std::string NimBLEAddress::toString() const {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+             m_address[5], m_address[4], m_address[3], m_address[2], m_address[1], m_address[0]);
+    return buf;
+}
+
+NimBLEAddress::operator uint64_t() const {
+    uint64_t value = 0;
+    for (int i = 0; i < 6; i++) value |= (uint64_t)m_address[i] << (8 * i);
+    return value;
+}
+
+// --- GAP helpers ---
+struct HostGapLink {
+    uint16_t connHandle;   // BLE_HS_CONN_HANDLE_NONE = free
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    int8_t   rssi;
+    bool     refuseUpdates;
+    uint32_t updateRequests;
+};
+
+static HostGapLink hostGapLinks[16];
+static bool hostGapInitialized = false;
+static const int hostMsysCount = 24;
+static int hostMsysFree = hostMsysCount;
+
+static HostGapLink* hostGapFind(uint16_t connHandle) {
+    if (!hostGapInitialized) {
+        for (size_t i = 0; i < sizeof(hostGapLinks) / sizeof(hostGapLinks[0]); i++) hostGapLinks[i].connHandle = BLE_HS_CONN_HANDLE_NONE;
+        hostGapInitialized = true;
+    }
+    for (size_t i = 0; i < sizeof(hostGapLinks) / sizeof(hostGapLinks[0]); i++) {
+        if (hostGapLinks[i].connHandle == connHandle) return &hostGapLinks[i];
+    }
+    return nullptr;
+}
+
+static void hostGapOpen(uint16_t connHandle, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    HostGapLink* link = hostGapFind(connHandle);
+    if (link == nullptr) link = hostGapFind(BLE_HS_CONN_HANDLE_NONE);
+    if (link == nullptr) return;
+    link->connHandle = connHandle;
+    link->interval = interval;
+    link->latency = latency;
+    link->timeout = timeout;
+    link->rssi = -60;
+    link->refuseUpdates = false;
+    link->updateRequests = 0;
+}
+
+static void hostGapClose(uint16_t connHandle) {
+    HostGapLink* link = hostGapFind(connHandle);
+    if (link != nullptr) link->connHandle = BLE_HS_CONN_HANDLE_NONE;
+}
+
+static void hostGapUpdate(uint16_t connHandle, uint16_t minInterval, uint16_t latency, uint16_t timeout) {
+    HostGapLink* link = hostGapFind(connHandle);
+    if (link == nullptr) return;
+    link->updateRequests++;
+    if (link->refuseUpdates) return;
+    link->interval = minInterval;
+    link->latency = latency;
+    link->timeout = timeout;
+}
+
+void hostGapSetRssi(uint16_t connHandle, int8_t rssi) {
+    HostGapLink* link = hostGapFind(connHandle);
+    if (link != nullptr) link->rssi = rssi;
+}
+
+void hostGapRefuseUpdates(uint16_t connHandle, bool refuse) {
+    HostGapLink* link = hostGapFind(connHandle);
+    if (link != nullptr) link->refuseUpdates = refuse;
+}
+
+uint32_t hostGapUpdateRequests(uint16_t connHandle) {
+    HostGapLink* link = hostGapFind(connHandle);
+    return link != nullptr ? link->updateRequests : 0;
+}
+
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t* out_rssi) {
+    HostGapLink* link = hostGapFind(conn_handle);
+    if (link == nullptr) return BLE_HS_ENOTCONN;
+    if (out_rssi) *out_rssi = link->rssi;
+    return 0;
+}
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc* out_desc) {
+    HostGapLink* link = hostGapFind(handle);
+    if (link == nullptr) return BLE_HS_ENOTCONN;
+    if (out_desc) {
+        memset(out_desc, 0, sizeof(*out_desc));
+        out_desc->conn_handle = handle;
+        out_desc->conn_itvl = link->interval;
+        out_desc->conn_latency = link->latency;
+        out_desc->supervision_timeout = link->timeout;
+    }
+    return 0;
+}
+
+int os_msys_count(void) {
+    return hostMsysCount;
+}
+
+int os_msys_num_free(void) {
+    return hostMsysFree;
+}
+
+void hostSetMsysFree(int freeBuffers) {
+    hostMsysFree = freeBuffers;
+}
+
+// --- NimBLECharacteristic ---
+void NimBLECharacteristic::setValue(const uint8_t* data, size_t size) {
+    m_value.setValue(data, size);
+}
+
+void NimBLECharacteristic::hostRecordSend(const uint8_t* value, size_t length, bool isNotify, uint16_t connHandle) {
+    if (isNotify) m_notifyCount++; else m_indicateCount++;
+    m_lastSent.assign(value, value + length);
+    m_lastConnHandle = connHandle;
+    if (hostOnSend) hostOnSend(this, value, length, isNotify);
+}
+
+void NimBLECharacteristic::notify(bool is_notification, uint16_t conn_handle) {
+    notify(m_value.data(), m_value.length(), is_notification, conn_handle);
+}
+
+void NimBLECharacteristic::notify(const uint8_t* value, size_t length, bool is_notification, uint16_t conn_handle) {
+    if (m_subscribedCount == 0) return;
+    if (is_notification && hostMsysFree <= 0) { // Like ble_gattc_notify_custom(): no mbuf, nothing sent
+        if (m_pCallbacks) m_pCallbacks->onStatus(this, NimBLECharacteristicCallbacks::ERROR_GATT, BLE_HS_ENOMEM);
+        return;
+    }
+    hostRecordSend(value, length, is_notification, conn_handle);
+    if (m_pCallbacks) {
+        m_pCallbacks->onStatus(this, is_notification ? NimBLECharacteristicCallbacks::SUCCESS_NOTIFY
+                                                     : NimBLECharacteristicCallbacks::SUCCESS_INDICATE, 0);
+    }
+}
+
+void NimBLECharacteristic::hostSubscribe(ble_gap_conn_desc* desc, uint16_t subValue) {
+    if (subValue != 0) m_subscribedCount++;
+    else if (m_subscribedCount > 0) m_subscribedCount--;
+    if (m_pCallbacks) m_pCallbacks->onSubscribe(this, desc, subValue);
+}
+
+NimBLEAttValue NimBLECharacteristic::hostRead(ble_gap_conn_desc* desc) {
+    if (m_pCallbacks) m_pCallbacks->onRead(this, desc);
+    return m_value;
+}
+
+void NimBLECharacteristic::indicate() {
+    notify(false);
+}
+
+void NimBLECharacteristic::indicate(const uint8_t* value, size_t length) {
+    notify(value, length, false);
+}
+
+// --- NimBLEService ---
+NimBLEService::~NimBLEService() {
+    for (size_t i = 0; i < m_chars.size(); i++) delete m_chars[i];
+}
+
+NimBLECharacteristic* NimBLEService::createCharacteristic(const NimBLEUUID& uuid, uint32_t properties, uint16_t max_len) {
+    NimBLECharacteristic* pChar = new NimBLECharacteristic(uuid, (uint16_t)properties, this);
+    m_chars.push_back(pChar);
+    return pChar;
+}
+
+NimBLECharacteristic* NimBLEService::getCharacteristic(const NimBLEUUID& uuid) {
+    for (size_t i = 0; i < m_chars.size(); i++) {
+        if (m_chars[i]->getUUID() == uuid) return m_chars[i];
+    }
+    return nullptr;
+}
+
+// --- NimBLEServer ---
+NimBLEServer::~NimBLEServer() {
+    for (size_t i = 0; i < m_services.size(); i++) delete m_services[i];
+}
+
+NimBLEService* NimBLEServer::createService(const NimBLEUUID& uuid) {
+    NimBLEService* pService = new NimBLEService(uuid, this);
+    m_services.push_back(pService);
+    return pService;
+}
+
+NimBLEService* NimBLEServer::getServiceByUUID(const NimBLEUUID& uuid) {
+    for (size_t i = 0; i < m_services.size(); i++) {
+        if (m_services[i]->getUUID() == uuid) return m_services[i];
+    }
+    return nullptr;
+}
+
+uint16_t NimBLEServer::getPeerMTU(uint16_t conn_id) {
+    for (int i = 0; i < 8; i++) {
+        if (m_peerHandle[i] == conn_id) return m_peerMtu[i];
+    }
+    return 0;
+}
+
+void NimBLEServer::updateConnParams(uint16_t conn_handle, uint16_t minInterval, uint16_t maxInterval,
+                                    uint16_t latency, uint16_t timeout) {
+    m_connParamUpdates++;
+    hostGapUpdate(conn_handle, minInterval, latency, timeout);
+}
+
+int NimBLEServer::disconnect(uint16_t connID, uint8_t reason) {
+    hostDisconnect(connID);
+    return 0;
+}
+
+bool NimBLEServer::startAdvertising() {
+    return NimBLEDevice::getAdvertising()->start();
+}
+
+bool NimBLEServer::stopAdvertising() {
+    return NimBLEDevice::getAdvertising()->stop();
+}
+
+void NimBLEServer::hostConnect(uint16_t connHandle, uint16_t mtu, ble_gap_conn_desc* desc) {
+    for (int i = 0; i < 8; i++) {
+        if (m_peerHandle[i] == BLE_HS_CONN_HANDLE_NONE) {
+            m_peerHandle[i] = connHandle;
+            m_peerMtu[i] = mtu;
+            break;
+        }
+    }
+    m_connectedCount++;
+    hostGapOpen(connHandle, 24, 0, 400);
+    NimBLEDevice::getAdvertising()->stop(); // NimBLE stops advertising when a central connects
+    memset(desc, 0, sizeof(*desc));
+    desc->conn_handle = connHandle;
+    desc->conn_itvl = 24;
+    desc->supervision_timeout = 400;
+    desc->peer_ota_addr.type = BLE_ADDR_RANDOM;
+    desc->peer_ota_addr.val[0] = (uint8_t)connHandle;
+    desc->peer_id_addr = desc->peer_ota_addr;
+    if (m_pCallbacks) m_pCallbacks->onConnect(this, desc);
+    if (m_pCallbacks && mtu > 23) m_pCallbacks->onMTUChange(mtu, desc);
+}
+
+void NimBLEServer::hostDisconnect(uint16_t connHandle) {
+    for (int i = 0; i < 8; i++) {
+        if (m_peerHandle[i] == connHandle) {
+            m_peerHandle[i] = BLE_HS_CONN_HANDLE_NONE;
+            m_peerMtu[i] = 0;
+            if (m_connectedCount > 0) m_connectedCount--;
+            hostGapClose(connHandle);
+            ble_gap_conn_desc desc;
+            memset(&desc, 0, sizeof(desc));
+            desc.conn_handle = connHandle;
+            if (m_pCallbacks) m_pCallbacks->onDisconnect(this, &desc);
+            return;
+        }
+    }
+}
+
+// --- NimBLEAdvertisedDevice ---
+bool NimBLEAdvertisedDevice::isAdvertisingService(const NimBLEUUID& uuid) const {
+    for (size_t i = 0; i < m_services.size(); i++) {
+        if (m_services[i] == uuid) return true;
+    }
+    return false;
+}
+
+// --- NimBLERemoteCharacteristic / NimBLERemoteService ---
+bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length, bool response) {
+    m_lastWrite.assign(data, data + length);
+    return true;
+}
+
+bool NimBLERemoteCharacteristic::subscribe(bool notifications, notify_callback notifyCallback, bool response) {
+    m_notifyCallback = notifyCallback;
+    return true;
+}
+
+NimBLERemoteService::~NimBLERemoteService() {
+    for (size_t i = 0; i < m_chars.size(); i++) delete m_chars[i];
+}
+
+NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(const NimBLEUUID& uuid) {
+    for (size_t i = 0; i < m_chars.size(); i++) {
+        if (m_chars[i]->getUUID() == uuid) return m_chars[i];
+    }
+    return nullptr;
+}
+
+NimBLERemoteCharacteristic* NimBLERemoteService::hostAddCharacteristic(const NimBLEUUID& uuid, uint16_t handle, uint16_t properties) {
+    NimBLERemoteCharacteristic* pChar = new NimBLERemoteCharacteristic(uuid, handle, properties, this);
+    m_chars.push_back(pChar);
+    return pChar;
+}
+
+// --- NimBLEClient ---
+NimBLEClient::~NimBLEClient() {
+    hostClearServices();
+}
+
+bool NimBLEClient::connect(NimBLEAdvertisedDevice* device, bool deleteAttributes) {
+    return connect(device->getAddress(), deleteAttributes);
+}
+
+bool NimBLEClient::connect(const NimBLEAddress& address, bool deleteAttributes) {
+    if (!m_connectResult) return false;
+    if (deleteAttributes) deleteServices();
+    m_peerAddress = address;
+    static uint16_t nextClientHandle = 0x40; // Clear of the handles tools give app connections
+    m_connected = true;
+    m_connHandle = nextClientHandle++;
+    hostGapOpen(m_connHandle, m_maxInterval, m_latency, m_timeout);
+    m_mtu = NimBLEDevice::getMTU();
+    if (m_pCallbacks) m_pCallbacks->onConnect(this);
+    return true;
+}
+
+int NimBLEClient::disconnect(uint8_t reason) {
+    if (!m_connected) return 0;
+    m_connected = false;
+    hostGapClose(m_connHandle);
+    m_connHandle = BLE_HS_CONN_HANDLE_NONE;
+    if (m_pCallbacks) m_pCallbacks->onDisconnect(this);
+    return 0;
+}
+
+void NimBLEClient::setConnectionParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout,
+                                       uint16_t scanInterval, uint16_t scanWindow) {
+    m_minInterval = minInterval;
+    m_maxInterval = maxInterval;
+    m_latency = latency;
+    m_timeout = timeout;
+}
+
+void NimBLEClient::updateConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout) {
+    setConnectionParams(minInterval, maxInterval, latency, timeout);
+    if (m_connected) hostGapUpdate(m_connHandle, minInterval, latency, timeout);
+}
+
+NimBLERemoteService* NimBLEClient::getService(const NimBLEUUID& uuid) {
+    m_serviceLookups++;
+    for (size_t i = 0; i < m_services.size(); i++) {
+        if (m_services[i]->getUUID() != uuid) continue;
+        if (!m_services[i]->hostDiscovered()) {
+            m_services[i]->hostSetDiscovered(true);
+            m_gattDiscoveries++;
+        }
+        return m_services[i];
+    }
+    return nullptr;
+}
+
+void NimBLEClient::deleteServices() {
+    for (size_t i = 0; i < m_services.size(); i++) m_services[i]->hostSetDiscovered(false);
+}
+
+void NimBLEClient::hostClearServices() {
+    for (size_t i = 0; i < m_services.size(); i++) delete m_services[i];
+    m_services.clear();
+}
+
+NimBLERemoteService* NimBLEClient::hostAddService(const NimBLEUUID& uuid) {
+    NimBLERemoteService* pService = new NimBLERemoteService(uuid, this);
+    m_services.push_back(pService);
+    return pService;
+}
+
+// --- NimBLEScan ---
+bool NimBLEScan::stop() {
+    if (!m_scanning) return true;
+    m_scanning = false;
+    void (*scanCompleteCB)(NimBLEScanResults) = m_scanCompleteCB;
+    m_scanCompleteCB = nullptr;
+    if (scanCompleteCB != nullptr) scanCompleteCB(NimBLEScanResults());
+    return true;
+}
+
+void NimBLEScan::hostDeliver(NimBLEAdvertisedDevice* device) {
+    bool useWhiteList = m_filterPolicy == BLE_HCI_SCAN_FILT_USE_WL || m_filterPolicy == BLE_HCI_SCAN_FILT_USE_WL_INITA;
+    if (useWhiteList && !NimBLEDevice::onWhiteList(device->getAddress())) {
+        m_filtered++;
+        return;
+    }
+    if (m_pCallbacks) m_pCallbacks->onResult(device);
+}
+
+// --- NimBLEDevice ---
+static NimBLEServer* hostServer = nullptr;
+static NimBLEAdvertising hostAdvertising;
+static NimBLEScan hostScan;
+static std::vector<NimBLEClient*> hostClients;
+static std::vector<NimBLEAddress> hostWhiteList;
+static uint16_t hostMtu = 255;
+
+void NimBLEDevice::init(const std::string& deviceName) {}
+
+void NimBLEDevice::deinit(bool clearAll) {}
+
+NimBLEServer* NimBLEDevice::createServer() {
+    if (hostServer == nullptr) hostServer = new NimBLEServer();
+    return hostServer;
+}
+
+NimBLEServer* NimBLEDevice::getServer() {
+    return hostServer;
+}
+
+NimBLEAdvertising* NimBLEDevice::getAdvertising() {
+    return &hostAdvertising;
+}
+
+bool NimBLEDevice::startAdvertising() {
+    return hostAdvertising.start();
+}
+
+bool NimBLEDevice::stopAdvertising() {
+    return hostAdvertising.stop();
+}
+
+NimBLEScan* NimBLEDevice::getScan() {
+    return &hostScan;
+}
+
+NimBLEClient* NimBLEDevice::createClient(NimBLEAddress peerAddress) {
+    NimBLEClient* pClient = new NimBLEClient();
+    pClient->setPeerAddress(peerAddress);
+    hostClients.push_back(pClient);
+    return pClient;
+}
+
+bool NimBLEDevice::deleteClient(NimBLEClient* pClient) {
+    std::vector<NimBLEClient*>::iterator it = std::find(hostClients.begin(), hostClients.end(), pClient);
+    if (it == hostClients.end()) return false;
+    hostClients.erase(it);
+    delete pClient;
+    return true;
+}
+
+size_t NimBLEDevice::getClientListSize() {
+    return hostClients.size();
+}
+
+bool NimBLEDevice::setMTU(uint16_t mtu) {
+    hostMtu = mtu;
+    return true;
+}
+
+uint16_t NimBLEDevice::getMTU() {
+    return hostMtu;
+}
+
+// The controller matches white list entries on address and type.
+static bool sameWhiteListEntry(const NimBLEAddress& a, const NimBLEAddress& b) {
+    return a == b && a.getType() == b.getType();
+}
+
+bool NimBLEDevice::whiteListAdd(const NimBLEAddress& address) {
+    if (!onWhiteList(address)) hostWhiteList.push_back(address);
+    return true;
+}
+
+bool NimBLEDevice::whiteListRemove(const NimBLEAddress& address) {
+    for (size_t i = 0; i < hostWhiteList.size(); i++) {
+        if (sameWhiteListEntry(hostWhiteList[i], address)) {
+            hostWhiteList.erase(hostWhiteList.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NimBLEDevice::onWhiteList(const NimBLEAddress& address) {
+    for (size_t i = 0; i < hostWhiteList.size(); i++) {
+        if (sameWhiteListEntry(hostWhiteList[i], address)) return true;
+    }
+    return false;
+}
+
+size_t NimBLEDevice::getWhiteListCount() {
+    return hostWhiteList.size();
+}
+
+NimBLEAddress NimBLEDevice::getWhiteListAddress(size_t index) {
+    return index < hostWhiteList.size() ? hostWhiteList[index] : NimBLEAddress();
+}
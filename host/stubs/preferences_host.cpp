@@ -0,0 +1,77 @@
+// Host (Linux) implementation of the Preferences stand-in (see host/include/Preferences.h).
+#include <Preferences.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <string.h>
+
+static std::mutex hostNvsMutex;
+static std::map<std::string, std::vector<uint8_t> > hostNvs; // "namespace/key" -> value
+static unsigned long hostNvsWrites = 0;
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+    if (name == NULL || strlen(name) > 15) return false; // NVS namespace limit
+    this->name = name;
+    this->readOnly = readOnly;
+    started = true;
+    return true;
+}
+
+void Preferences::end() {
+    started = false;
+}
+
+bool Preferences::clear() {
+    if (!started || readOnly) return false;
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    std::string prefix = name + "/";
+    for (std::map<std::string, std::vector<uint8_t> >::iterator it = hostNvs.begin(); it != hostNvs.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) hostNvs.erase(it++);
+        else ++it;
+    }
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!started || readOnly) return false;
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    return hostNvs.erase(name + "/" + key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    if (!started || readOnly || key == NULL || strlen(key) > 15) return 0;
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    const uint8_t* bytes = (const uint8_t*)value;
+    hostNvs[name + "/" + key] = std::vector<uint8_t>(bytes, bytes + len);
+    hostNvsWrites++;
+    return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!started) return 0;
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    std::map<std::string, std::vector<uint8_t> >::iterator it = hostNvs.find(name + "/" + key);
+    return it == hostNvs.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!started) return 0;
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    std::map<std::string, std::vector<uint8_t> >::iterator it = hostNvs.find(name + "/" + key);
+    if (it == hostNvs.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+bool Preferences::isKey(const char* key) {
+    return getBytesLength(key) > 0;
+}
+
+void hostNvsErase() {
+    std::lock_guard<std::mutex> lock(hostNvsMutex);
+    hostNvs.clear();
+}
+
+unsigned long hostNvsWriteCount() {
+    return hostNvsWrites;
+}
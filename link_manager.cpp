@@ -0,0 +1,318 @@
+#define LOG_MODULE LOG_MOD_LINK
+#include "link_manager.h"
+#include "ble_client_manager.h"
+#include "app_sessions.h"
+#include "erg_controller.h"
+#include "telemetry.h"
+#include "metrics.h"
+#include <esp_timer.h>
+
+// --- Profiles ---
+// The bike link may take up to twice its interval to match the apps.
+static const LinkProfile linkProfiles[LINK_ACTIVITY_COUNT] = {
+    {LINK_IDLE_BIKE_INTERVAL, 2 * LINK_IDLE_BIKE_INTERVAL, LINK_IDLE_LATENCY,
+     LINK_IDLE_APP_INTERVAL, LINK_IDLE_APP_INTERVAL_MAX, LINK_IDLE_LATENCY, LINK_SUPERVISION_TIMEOUT},
+    {LINK_RIDE_BIKE_INTERVAL, 2 * LINK_RIDE_BIKE_INTERVAL, 0,
+     LINK_RIDE_APP_INTERVAL, LINK_RIDE_APP_INTERVAL_MAX, 0, LINK_SUPERVISION_TIMEOUT},
+    {LINK_ERG_BIKE_INTERVAL, 2 * LINK_ERG_BIKE_INTERVAL, 0,
+     LINK_ERG_APP_INTERVAL, LINK_ERG_APP_INTERVAL_MAX, 0, LINK_SUPERVISION_TIMEOUT},
+};
+
+static const char* const linkActivityNames[LINK_ACTIVITY_COUNT] = {"idle", "riding", "ERG"};
+
+const LinkProfile& linkProfile(uint8_t activity) {
+    return linkProfiles[activity < LINK_ACTIVITY_COUNT ? activity : LINK_ACTIVITY_IDLE];
+}
+
+// lastPedalMs is 0 until the first pedal stroke, so the links start on the riding profile for
+// LINK_IDLE_AFTER_MS after boot: connection setup and discovery go faster on short intervals.
+uint8_t linkActivity(bool ergActive, uint32_t lastPedalMs, uint32_t nowMs) {
+    if (ergActive) return LINK_ACTIVITY_ERG;
+    return nowMs - lastPedalMs < LINK_IDLE_AFTER_MS ? LINK_ACTIVITY_RIDING : LINK_ACTIVITY_IDLE;
+}
+
+uint16_t linkHarmonicInterval(uint16_t min, uint16_t max, uint16_t appInterval) {
+    if (appInterval == 0) return min;
+    for (uint16_t interval = min; interval <= max; interval++) {
+        if (interval % appInterval == 0 || appInterval % interval == 0) return interval;
+    }
+    return min;
+}
+
+// --- State ---
+// Slot 0 is the bike, the others follow the app sessions. The task owns the requests; the hooks
+// (NimBLE host task, forwarder task) only bump counters, under the mux like the task's writes.
+struct LinkSlot {
+    LinkStats stats;
+    bool     requested;       // A request is outstanding or was answered
+    bool     checkPending;    // Not yet known whether the peer took it
+    uint16_t requestMin;
+    uint16_t requestMax;
+    uint16_t requestLatency;
+    uint32_t lastRequestMs;
+};
+
+static portMUX_TYPE linkManagerMux = portMUX_INITIALIZER_UNLOCKED;
+static LinkSlot linkSlots[1 + APP_SESSION_MAX];
+static uint8_t linkCurrentActivity = LINK_ACTIVITY_RIDING;
+static int64_t bikeLastSampleUs = 0;
+static int64_t bikeUsualGapUs = 0;
+static uint16_t notifyBuffersInUse = 0;
+static uint16_t notifyBuffersMax = 0;
+
+static bool linkSlotsInitialized = false;
+
+static void resetSlot(LinkSlot& slot, uint16_t connHandle, uint8_t role) {
+    memset(&slot, 0, sizeof(slot));
+    slot.stats.connHandle = connHandle;
+    slot.stats.role = role;
+}
+
+// Called with linkManagerMux held.
+static void initSlotsLocked() {
+    if (linkSlotsInitialized) return;
+    for (uint8_t i = 0; i <= APP_SESSION_MAX; i++) {
+        resetSlot(linkSlots[i], BLE_HS_CONN_HANDLE_NONE, i == 0 ? LINK_ROLE_BIKE : LINK_ROLE_APP);
+    }
+    linkSlotsInitialized = true;
+}
+
+// Called with linkManagerMux held.
+static LinkSlot* findAppSlotLocked(uint16_t connHandle) {
+    initSlotsLocked();
+    for (uint8_t i = 1; i <= APP_SESSION_MAX; i++) {
+        if (linkSlots[i].stats.connHandle == connHandle) return &linkSlots[i];
+    }
+    return NULL;
+}
+
+// --- Hooks ---
+void linkManagerOnBikeSample() {
+    int64_t nowUs = esp_timer_get_time();
+    portENTER_CRITICAL(&linkManagerMux);
+    initSlotsLocked();
+    if (bikeLastSampleUs != 0) {
+        int64_t gapUs = nowUs - bikeLastSampleUs;
+        LinkStats& stats = linkSlots[0].stats;
+        if (bikeUsualGapUs > 0 && gapUs > LINK_LATE_SAMPLE_FACTOR * bikeUsualGapUs) {
+            stats.lateEvents++; // Not folded into the usual gap
+        } else {
+            bikeUsualGapUs = bikeUsualGapUs == 0 ? gapUs : bikeUsualGapUs + (gapUs - bikeUsualGapUs) / 8;
+        }
+        if (gapUs / 1000 > (int64_t)stats.maxGapMs) stats.maxGapMs = (uint32_t)(gapUs / 1000);
+        metricsObserve(METRIC_HIST_BIKE_INTERVAL_MS, (uint32_t)(gapUs / 1000));
+    }
+    bikeLastSampleUs = nowUs;
+    portEXIT_CRITICAL(&linkManagerMux);
+}
+
+// NimBLE gives notifications no per-link queue: every link draws on the msys pool, and a notify
+// with no buffer left is dropped by the stack without telling the caller.
+bool linkManagerOnNotify(uint16_t connHandle) {
+    int freeBuffers = os_msys_num_free();
+    uint16_t inUse = (uint16_t)(os_msys_count() - freeBuffers);
+    portENTER_CRITICAL(&linkManagerMux);
+    notifyBuffersInUse = inUse;
+    if (inUse > notifyBuffersMax) notifyBuffersMax = inUse;
+    LinkSlot* slot = findAppSlotLocked(connHandle);
+    if (slot != NULL) {
+        if (freeBuffers <= 0) slot->stats.lateEvents++;
+        else slot->stats.notifies++;
+    }
+    portEXIT_CRITICAL(&linkManagerMux);
+    return freeBuffers > 0;
+}
+
+// --- Requests (link manager task) ---
+static uint16_t smallestAppInterval() {
+    uint16_t smallest = 0;
+    portENTER_CRITICAL(&linkManagerMux);
+    initSlotsLocked();
+    for (uint8_t i = 1; i <= APP_SESSION_MAX; i++) {
+        const LinkStats& stats = linkSlots[i].stats;
+        if (stats.connHandle == BLE_HS_CONN_HANDLE_NONE || stats.interval == 0) continue;
+        if (smallest == 0 || stats.interval < smallest) smallest = stats.interval;
+    }
+    portEXIT_CRITICAL(&linkManagerMux);
+    return smallest;
+}
+
+static void bikeParams(uint8_t activity, uint16_t& interval, uint16_t& latency) {
+    const LinkProfile& profile = linkProfile(activity);
+    interval = linkHarmonicInterval(profile.bikeIntervalMin, profile.bikeIntervalMax, smallestAppInterval());
+    latency = profile.bikeLatency;
+}
+
+void linkManagerBikeConnectParams(NimBLEClient* pClient) {
+    uint16_t interval, latency;
+    bikeParams(linkCurrentActivity, interval, latency);
+    pClient->setConnectionParams(interval, interval, latency, LINK_SUPERVISION_TIMEOUT);
+}
+
+static void refreshLink(LinkSlot& slot) {
+    ble_gap_conn_desc desc;
+    int8_t rssi = 0;
+    bool found = ble_gap_conn_find(slot.stats.connHandle, &desc) == 0;
+    bool rssiRead = ble_gap_conn_rssi(slot.stats.connHandle, &rssi) == 0;
+    portENTER_CRITICAL(&linkManagerMux);
+    if (found) {
+        slot.stats.interval = desc.conn_itvl;
+        slot.stats.latency = desc.conn_latency;
+        slot.stats.timeout = desc.supervision_timeout;
+    }
+    if (rssiRead) slot.stats.rssi = rssi;
+    portEXIT_CRITICAL(&linkManagerMux);
+}
+
+// Asks once per wanted range: a peer that refuses is not asked again until the activity changes.
+// Returns true if a request is due now.
+static bool requestDue(LinkSlot& slot, uint16_t min, uint16_t max, uint16_t latency, uint32_t nowMs) {
+    bool inRange = slot.stats.interval >= min && slot.stats.interval <= max && slot.stats.latency == latency;
+    bool sameRequest = slot.requested && slot.requestMin == min && slot.requestMax == max && slot.requestLatency == latency;
+    bool waited = !slot.requested || nowMs - slot.lastRequestMs >= LINK_UPDATE_MIN_MS;
+    if (inRange) {
+        slot.checkPending = false;
+        return false;
+    }
+    if (sameRequest) {
+        if (slot.checkPending && waited) {
+            slot.checkPending = false;
+            portENTER_CRITICAL(&linkManagerMux);
+            slot.stats.updatesRefused++;
+            portEXIT_CRITICAL(&linkManagerMux);
+            ts_log_warn("[Link] Handle %u kept %u x 1.25 ms (asked %u-%u, latency %u).",
+                        slot.stats.connHandle, slot.stats.interval, min, max, latency);
+        }
+        return false;
+    }
+    if (!waited) return false;
+    slot.requested = true;
+    slot.checkPending = true;
+    slot.requestMin = min;
+    slot.requestMax = max;
+    slot.requestLatency = latency;
+    slot.lastRequestMs = nowMs;
+    portENTER_CRITICAL(&linkManagerMux);
+    slot.stats.updatesRequested++;
+    slot.stats.activity = linkCurrentActivity;
+    portEXIT_CRITICAL(&linkManagerMux);
+    return true;
+}
+
+static void manageBike(uint32_t nowMs) {
+    LinkSlot& slot = linkSlots[0]; // Initialized by manageApps, which runs first
+    uint16_t connHandle = bikeSensorConnected && pBikeClient != nullptr && pBikeClient->isConnected()
+                          ? pBikeClient->getConnId() : BLE_HS_CONN_HANDLE_NONE;
+    if (connHandle != slot.stats.connHandle) {
+        portENTER_CRITICAL(&linkManagerMux);
+        resetSlot(slot, connHandle, LINK_ROLE_BIKE);
+        bikeLastSampleUs = 0;
+        bikeUsualGapUs = 0;
+        portEXIT_CRITICAL(&linkManagerMux);
+    }
+    if (connHandle == BLE_HS_CONN_HANDLE_NONE) return;
+    refreshLink(slot);
+    uint16_t interval, latency;
+    bikeParams(linkCurrentActivity, interval, latency);
+    if (requestDue(slot, interval, interval, latency, nowMs)) {
+        ts_log_printf("[Link] Bike: %u x 1.25 ms, latency %u (%s).", interval, latency, linkActivityNames[linkCurrentActivity]);
+        pBikeClient->updateConnParams(interval, interval, latency, LINK_SUPERVISION_TIMEOUT);
+    }
+}
+
+static void manageApps(uint32_t nowMs) {
+    AppSession sessions[APP_SESSION_MAX];
+    uint8_t count = appSessionGetAll(sessions);
+    portENTER_CRITICAL(&linkManagerMux);
+    initSlotsLocked();
+    portEXIT_CRITICAL(&linkManagerMux);
+    // Slots of closed sessions are freed first, so a new session always finds one.
+    for (uint8_t i = 1; i <= APP_SESSION_MAX; i++) {
+        bool open = false;
+        for (uint8_t s = 0; s < count; s++) open |= sessions[s].connHandle == linkSlots[i].stats.connHandle;
+        if (!open && linkSlots[i].stats.connHandle != BLE_HS_CONN_HANDLE_NONE) {
+            portENTER_CRITICAL(&linkManagerMux);
+            resetSlot(linkSlots[i], BLE_HS_CONN_HANDLE_NONE, LINK_ROLE_APP);
+            portEXIT_CRITICAL(&linkManagerMux);
+        }
+    }
+    NimBLEServer* pServer = NimBLEDevice::getServer();
+    const LinkProfile& profile = linkProfile(linkCurrentActivity);
+    for (uint8_t s = 0; s < count; s++) {
+        portENTER_CRITICAL(&linkManagerMux);
+        LinkSlot* slot = findAppSlotLocked(sessions[s].connHandle);
+        if (slot == NULL && (slot = findAppSlotLocked(BLE_HS_CONN_HANDLE_NONE)) != NULL) {
+            resetSlot(*slot, sessions[s].connHandle, LINK_ROLE_APP);
+        }
+        portEXIT_CRITICAL(&linkManagerMux);
+        if (slot == NULL) continue;
+        refreshLink(*slot);
+        if (pServer != nullptr && requestDue(*slot, profile.appIntervalMin, profile.appIntervalMax, profile.appLatency, nowMs)) {
+            ts_log_printf("[Link] App %u: %u-%u x 1.25 ms, latency %u (%s).", sessions[s].connHandle, profile.appIntervalMin,
+                          profile.appIntervalMax, profile.appLatency, linkActivityNames[linkCurrentActivity]);
+            pServer->updateConnParams(sessions[s].connHandle, profile.appIntervalMin, profile.appIntervalMax,
+                                      profile.appLatency, profile.timeout);
+        }
+    }
+}
+
+// --- Stats ---
+void linkManagerGetStats(LinkManagerStats& out) {
+    memset(&out, 0, sizeof(out));
+    portENTER_CRITICAL(&linkManagerMux);
+    initSlotsLocked();
+    out.activity = linkCurrentActivity;
+    for (uint8_t i = 0; i <= APP_SESSION_MAX; i++) {
+        if (linkSlots[i].stats.connHandle != BLE_HS_CONN_HANDLE_NONE) out.links[out.linkCount++] = linkSlots[i].stats;
+    }
+    out.notifyBuffersInUse = notifyBuffersInUse;
+    out.notifyBuffersMax = notifyBuffersMax;
+    portEXIT_CRITICAL(&linkManagerMux);
+}
+
+void linkManagerLogStats() {
+    LinkManagerStats stats;
+    linkManagerGetStats(stats);
+    ts_log_printf("[Link] Activity: %s. Notify buffers in use: %u (max %u).", linkActivityNames[stats.activity],
+                  stats.notifyBuffersInUse, stats.notifyBuffersMax);
+    for (uint8_t i = 0; i < stats.linkCount; i++) {
+        const LinkStats& link = stats.links[i];
+        ts_log_printf("[Link]   %s %u: %.2f ms, latency %u, timeout %u ms, RSSI %d dBm. Requests %lu (%lu refused).",
+                      link.role == LINK_ROLE_BIKE ? "Bike" : "App", link.connHandle, link.interval * 1.25, link.latency,
+                      link.timeout * 10, link.rssi, (unsigned long)link.updatesRequested, (unsigned long)link.updatesRefused);
+        if (link.role == LINK_ROLE_BIKE) {
+            ts_log_printf("[Link]     Late samples %lu, longest gap %lu ms.",
+                          (unsigned long)link.lateEvents, (unsigned long)link.maxGapMs);
+        } else {
+            ts_log_printf("[Link]     Notifies %lu, dropped for lack of a buffer %lu.",
+                          (unsigned long)link.notifies, (unsigned long)link.lateEvents);
+        }
+    }
+}
+
+// --- Task ---
+// Once per LINK_MANAGER_PERIOD_MS: activity from cadence/speed and the ERG task, then the bike and
+// every app are brought to that activity's profile.
+void linkManagerTask_func(void *pvParameters) {
+    ts_log_printf("[Link:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+    uint32_t lastPedalMs = 0;
+
+    while (1) {
+        uint32_t nowMs = millis();
+        TelemetryFrame frame;
+        telemetryRead(frame);
+        if (bikeSensorConnected && (frame.cadence > 0 || frame.speed > 0)) lastPedalMs = nowMs;
+        ErgStatus erg;
+        ergGetStatus(erg);
+        uint8_t activity = linkActivity(erg.active, lastPedalMs, nowMs);
+        if (activity != linkCurrentActivity) {
+            ts_log_printf("[Link] Activity: %s -> %s.", linkActivityNames[linkCurrentActivity], linkActivityNames[activity]);
+            portENTER_CRITICAL(&linkManagerMux);
+            linkCurrentActivity = activity;
+            portEXIT_CRITICAL(&linkManagerMux);
+        }
+        manageApps(nowMs); // First: the bike follows the intervals the apps got
+        manageBike(nowMs);
+        vTaskDelay(pdMS_TO_TICKS(LINK_MANAGER_PERIOD_MS));
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef LINK_MANAGER_H
+#define LINK_MANAGER_H
+
+#include <NimBLEDevice.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Global Variables related to the Link Manager (defined in .ino) ---
+extern TaskHandle_t linkManagerTaskHandle;
+
+// --- Activity and Profiles ---
+// Short intervals while the rider pedals, shortest in ERG (resistance writes and Control Point
+// responses go out on the next event), long intervals with peripheral latency when idle.
+#define LINK_ACTIVITY_IDLE   0 // No cadence or speed for LINK_IDLE_AFTER_MS
+#define LINK_ACTIVITY_RIDING 1
+#define LINK_ACTIVITY_ERG    2 // ERG task active
+#define LINK_ACTIVITY_COUNT  3
+
+// Intervals in 1.25 ms units, latency in events, timeout in 10 ms units (as NimBLE takes them).
+struct LinkProfile {
+    uint16_t bikeIntervalMin; // We are the central: the bike link gets exactly one value in this range
+    uint16_t bikeIntervalMax;
+    uint16_t bikeLatency;
+    uint16_t appIntervalMin;  // Requested from the app, which picks within the range (or refuses)
+    uint16_t appIntervalMax;
+    uint16_t appLatency;
+    uint16_t timeout;
+};
+
+const LinkProfile& linkProfile(uint8_t activity);
+uint8_t linkActivity(bool ergActive, uint32_t lastPedalMs, uint32_t nowMs);
+// Bike interval in [min, max] that is a multiple or a divisor of the app's interval, so both links'
+// connection events keep a fixed offset on the one radio instead of drifting through each other.
+// Returns min when there is no app (appInterval 0) or no harmonic value in range.
+uint16_t linkHarmonicInterval(uint16_t min, uint16_t max, uint16_t appInterval);
+
+// --- Stats (per link) ---
+#define LINK_ROLE_BIKE 0
+#define LINK_ROLE_APP  1
+
+struct LinkStats {
+    uint16_t connHandle;       // BLE_HS_CONN_HANDLE_NONE = down
+    uint8_t  role;             // LINK_ROLE_*
+    uint8_t  activity;         // LINK_ACTIVITY_* of the last request
+    uint16_t interval;         // Current, from the controller (1.25 ms units)
+    uint16_t latency;
+    uint16_t timeout;          // 10 ms units
+    int8_t   rssi;
+    uint32_t updatesRequested;
+    uint32_t updatesRefused;   // The peer stayed outside the requested range
+    uint32_t lateEvents;       // Bike: samples more than LINK_LATE_SAMPLE_FACTOR x the usual gap apart.
+                               // App: notifies with no buffer left, which the stack drops.
+    uint32_t notifies;         // App only
+    uint32_t maxGapMs;         // Bike only: longest gap between samples
+};
+
+struct LinkManagerStats {
+    uint8_t  activity;
+    uint8_t  linkCount;                    // Bike first when connected, then the apps
+    LinkStats links[1 + APP_SESSION_MAX];
+    uint16_t notifyBuffersInUse;           // NimBLE msys buffers held after the last fan-out
+    uint16_t notifyBuffersMax;             // Shared by every link: the controller drains one queue
+};
+
+// --- API ---
+// Bike connection parameters for the current activity; set before NimBLEClient::connect.
+void linkManagerBikeConnectParams(NimBLEClient* pClient);
+void linkManagerGetStats(LinkManagerStats& out);
+void linkManagerLogStats();
+
+// Hot-path hooks (NimBLE host task / forwarder task)
+void linkManagerOnBikeSample();                 // Bike notification callbacks
+bool linkManagerOnNotify(uint16_t connHandle);  // Before each notify to an app; false: no buffer, the stack drops it
+
+void linkManagerTask_func(void *pvParameters);
+
+#endif // LINK_MANAGER_H
@@ -1,24 +1,258 @@
 #include "logger.h" // Include its own header
+#include <atomic>
 
-// Definition of the timestamped logging function
-void ts_log_printf(const char* format, ...) {
-    char loc_buf[256]; // Buffer for the final formatted string with timestamp
-    char temp_buf[200]; // Buffer for the message part (without timestamp)
-    va_list arg;        // For handling variable arguments
+// --- Log Ring (bounded lock-free MPSC queue, Vyukov style) ---
+// Every slot carries a stamp. For enqueue position 'pos' the slot is free when its stamp equals the
+// lap base (pos & ~LOG_RING_MASK), holds a finished line at base + 1, and is released for the next
+// lap at base + LOG_RING_SLOTS. Zero-initialized slots are therefore free for the first lap.
+#define LOG_RING_MASK (LOG_RING_SLOTS - 1)
+static_assert((LOG_RING_SLOTS & LOG_RING_MASK) == 0, "LOG_RING_SLOTS must be a power of two");
+
+struct LogSlot {
+    std::atomic<uint32_t> stamp;
+    uint32_t timestampMs;
+    uint8_t module;
+    uint8_t level;
+    uint8_t tokenLength;   // 0 = text line; otherwise bytes of token + arguments in text[]
+    char text[LOG_LINE_MAX];
+};
+
+static LogSlot logRing[LOG_RING_SLOTS];
+static std::atomic<uint32_t> logEnqueuePos(0);
+static uint32_t logDequeuePos = 0;               // Only touched while holding logOutputMutex
+static std::atomic<uint32_t> logDropped(0);
+static uint32_t logDroppedReported = 0;
+static volatile bool logPanicMode = LOG_PANIC_FLUSH;
+static volatile bool logTokenized = LOG_TOKENIZED;
+static SemaphoreHandle_t logOutputMutex = NULL;  // Serializes the consumer side and raw Serial dumps
+
+volatile uint8_t logModuleLevels[LOG_MODULE_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL
+};
+static_assert(LOG_MODULE_COUNT == 13, "Update the logModuleLevels initializer");
+
+static const char* levelTag(uint8_t level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR: return "ERROR: ";
+        case LOG_LEVEL_WARN:  return "WARN: ";
+        case LOG_LEVEL_DEBUG: return "DEBUG: ";
+        default:              return "";
+    }
+}
+
+static void writeLine(uint32_t timestampMs, uint8_t level, const char* text) {
+    char loc_buf[LOG_LINE_MAX + 32]; // Final line with timestamp and level tag
+    snprintf(loc_buf, sizeof(loc_buf), "[%08.3fs] %s%s", (double)timestampMs / 1000.0, levelTag(level), text);
+    Serial.println(loc_buf);
+}
+
+// Claims the next free slot. Returns NULL (and counts a drop) when the ring is full.
+static LogSlot* claimSlot(uint32_t& pos) {
+    pos = logEnqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        LogSlot* slot = &logRing[pos & LOG_RING_MASK];
+        uint32_t stamp = slot->stamp.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(stamp - (pos & ~(uint32_t)LOG_RING_MASK));
+        if (diff == 0) {
+            if (logEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return slot;
+        } else if (diff < 0) {
+            logDropped.fetch_add(1, std::memory_order_relaxed); // Drain task is a full lap behind
+            return NULL;
+        } else {
+            pos = logEnqueuePos.load(std::memory_order_relaxed); // Another producer took this slot
+        }
+    }
+}
+
+static void commitSlot(LogSlot* slot, uint32_t pos) {
+    slot->stamp.store((pos & ~(uint32_t)LOG_RING_MASK) + 1, std::memory_order_release);
+}
+
+// Formats the message straight into a claimed slot. Returns false when the ring is full.
+static bool enqueueLine(uint8_t module, uint8_t level, const char* format, va_list arg) {
+    uint32_t pos;
+    LogSlot* slot = claimSlot(pos);
+    if (slot == NULL) return false;
+    slot->timestampMs = millis();
+    slot->module = module;
+    slot->level = level;
+    slot->tokenLength = 0;
+    vsnprintf(slot->text, sizeof(slot->text), format, arg);
+    commitSlot(slot, pos);
+    return true;
+}
+
+static size_t putFrameVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        out[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    return n;
+}
+
+static void writeTokenFrame(const LogSlot& slot) {
+    uint8_t frame[2 + 1 + 5 + LOG_LINE_MAX];
+    size_t n = 2;
+    frame[n++] = (uint8_t)(slot.module << 3 | slot.level);
+    n += putFrameVarint(frame + n, slot.timestampMs);
+    memcpy(frame + n, slot.text, slot.tokenLength);
+    n += slot.tokenLength;
+    frame[0] = LOG_TOKEN_SYNC;
+    frame[1] = (uint8_t)(n - 2);
+    Serial.write(frame, n);
+}
+
+// Writes out every finished line in order. Caller holds the output lock (or runs before the scheduler
+// has other tasks logging). Stops at a slot that is claimed but still being formatted.
+static void drainRing() {
+    for (;;) {
+        LogSlot& slot = logRing[logDequeuePos & LOG_RING_MASK];
+        uint32_t lapBase = logDequeuePos & ~(uint32_t)LOG_RING_MASK;
+        if (slot.stamp.load(std::memory_order_acquire) != lapBase + 1) break;
+        if (slot.tokenLength > 0) {
+            writeTokenFrame(slot);
+        } else {
+            writeLine(slot.timestampMs, slot.level, slot.text);
+        }
+        slot.stamp.store(lapBase + LOG_RING_SLOTS, std::memory_order_release);
+        logDequeuePos++;
+    }
+    uint32_t dropped = logDropped.load(std::memory_order_relaxed);
+    if (dropped != logDroppedReported) {
+        char text[64];
+        snprintf(text, sizeof(text), "[Logger] %lu log lines dropped (ring full).", (unsigned long)(dropped - logDroppedReported));
+        writeLine(millis(), LOG_LEVEL_WARN, text);
+        logDroppedReported = dropped;
+    }
+}
+
+void ts_log_lock_output() {
+    if (logOutputMutex != NULL) xSemaphoreTakeRecursive(logOutputMutex, portMAX_DELAY);
+}
+
+void ts_log_unlock_output() {
+    if (logOutputMutex != NULL) xSemaphoreGiveRecursive(logOutputMutex);
+}
+
+void ts_log_flush() {
+    ts_log_lock_output();
+    drainRing();
+    Serial.flush();
+    ts_log_unlock_output();
+}
 
-    // Initialize va_list and format the message part
+// Definition of the timestamped logging function
+void ts_log_write(uint8_t module, uint8_t level, const char* format, ...) {
+    if (module >= LOG_MODULE_COUNT || level > logModuleLevels[module]) {
+        return;
+    }
+    va_list arg;
     va_start(arg, format);
-    vsnprintf(temp_buf, sizeof(temp_buf), format, arg);
+    bool queued = enqueueLine(module, level, format, arg);
     va_end(arg);
 
-    // Prepend timestamp to the message
-    // millis() gives unsigned long, format specifier %lu or cast to double for %f.
-    // Using %08.3f which expects a double.
-    snprintf(loc_buf, sizeof(loc_buf), "[%08.3fs] %s", (double)millis() / 1000.0, temp_buf);
+    if (logPanicMode || logDrainTaskHandle == NULL) {
+        // Synchronous path: panic mode, or early boot before the drain task exists.
+        ts_log_lock_output();
+        drainRing();
+        if (!queued) {
+            // Ring was full of lines nobody drained yet; they are out now, so retry once.
+            va_start(arg, format);
+            if (enqueueLine(module, level, format, arg)) logDropped.fetch_sub(1, std::memory_order_relaxed);
+            va_end(arg);
+            drainRing();
+        }
+        if (logPanicMode) Serial.flush(); // Ensures data is sent before a potential crash
+        ts_log_unlock_output();
+    } else if (queued) {
+        xTaskNotifyGive(logDrainTaskHandle);
+    }
+}
 
-    // Print to Serial and flush to ensure it's sent immediately
-    Serial.println(loc_buf);
-    Serial.flush(); // Ensures data is sent, useful for debugging before potential crashes
+void ts_log_token_write(uint8_t module, uint8_t level, uint32_t token, const LogArgWriter& args) {
+    if (module >= LOG_MODULE_COUNT || level > logModuleLevels[module]) {
+        return;
+    }
+    uint32_t pos;
+    LogSlot* slot = claimSlot(pos);
+    if (slot != NULL) {
+        slot->timestampMs = millis();
+        slot->module = module;
+        slot->level = level;
+        memcpy(slot->text, &token, sizeof(token)); // Little-endian on the ESP32
+        memcpy(slot->text + sizeof(token), args.bytes, args.length);
+        slot->tokenLength = (uint8_t)(sizeof(token) + args.length);
+        commitSlot(slot, pos);
+    }
+
+    if (logPanicMode || logDrainTaskHandle == NULL) {
+        ts_log_lock_output();
+        drainRing();
+        if (logPanicMode) Serial.flush();
+        ts_log_unlock_output();
+    } else if (slot != NULL) {
+        xTaskNotifyGive(logDrainTaskHandle);
+    }
+}
+
+// Text fallback for TS_LOG_TOKEN_HEX: renders the buffer as "AA BB CC " into the format's %s.
+void ts_log_hex_write(uint8_t module, uint8_t level, const char* format, const uint8_t* data, size_t length) {
+    char hexStr[LOG_LINE_MAX];
+    size_t maxBytes = (sizeof(hexStr) - 1) / 3;
+    if (length > maxBytes) length = maxBytes;
+    for (size_t i = 0; i < length; i++) {
+        sprintf(hexStr + i * 3, "%02X ", data[i]);
+    }
+    hexStr[length * 3] = '\0';
+    ts_log_write(module, level, format, hexStr);
+}
+
+void ts_log_set_tokenized(bool enabled) {
+    logTokenized = enabled;
+}
+
+bool ts_log_tokenized() {
+    return logTokenized;
+}
+
+void ts_log_set_level(uint8_t module, uint8_t level) {
+    if (module < LOG_MODULE_COUNT) logModuleLevels[module] = level;
+}
+
+void ts_log_set_all_levels(uint8_t level) {
+    for (uint8_t module = 0; module < LOG_MODULE_COUNT; module++) logModuleLevels[module] = level;
+}
+
+uint8_t ts_log_get_level(uint8_t module) {
+    return module < LOG_MODULE_COUNT ? logModuleLevels[module] : LOG_LEVEL_NONE;
+}
+
+uint32_t ts_log_dropped() {
+    return logDropped.load(std::memory_order_relaxed);
+}
+
+void ts_log_set_panic_mode(bool enabled) {
+    logPanicMode = enabled;
+    if (enabled) ts_log_flush();
+}
+
+bool ts_log_begin() {
+    if (logOutputMutex == NULL) logOutputMutex = xSemaphoreCreateRecursiveMutex();
+    return logOutputMutex != NULL;
+}
+
+// --- logDrainTask_func Implementation (lowest useful priority; the only task that waits on the UART) ---
+void logDrainTask_func(void* pvParameters) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+        ts_log_lock_output();
+        drainRing();
+        ts_log_unlock_output();
+    }
 }
 
 
@@ -3,12 +3,165 @@
 
 #include <Arduino.h> // For Serial, millis, etc.
 #include <stdarg.h>  // For va_list, vsnprintf
+#include <type_traits>
+#include "config.h"
 
-// Function declaration for timestamped logging
-void ts_log_printf(const char* format, ...);
+// --- Log Levels ---
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// --- Log Modules (each .cpp defines LOG_MODULE before its #includes) ---
+#define LOG_MOD_MAIN        0 // FTMS_test.ino, host tools
+#define LOG_MOD_BIKE        1 // ble_client_manager.cpp, bike_driver*.cpp, bike_link.cpp
+#define LOG_MOD_APP         2 // ble_peripheral_manager.cpp, app_sessions.cpp
+#define LOG_MOD_FORWARDER   3 // ftms_forwarder.cpp
+#define LOG_MOD_CAPTURE     4 // bike_capture.cpp
+#define LOG_MOD_DISPLAY     5 // display_manager.cpp
+#define LOG_MOD_ERG         6 // erg_controller.cpp
+#define LOG_MOD_SIM         7 // sim_physics.cpp
+#define LOG_MOD_MOTION      8 // stepper_motion.cpp
+#define LOG_MOD_CALIBRATION 9 // resistance_calibration.cpp
+#define LOG_MOD_SENSOR      10 // sensor_links.cpp
+#define LOG_MOD_LINK        11 // link_manager.cpp
+#define LOG_MOD_SYSTEM      12 // system_tasks.cpp, heap_monitor.cpp, metrics.cpp
+#define LOG_MODULE_COUNT    13
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MOD_MAIN
+#endif
+
+// Runtime level per module; lines above the module's level are discarded before formatting.
+extern volatile uint8_t logModuleLevels[LOG_MODULE_COUNT];
+
+#define ts_log_enabled(level) ((level) <= logModuleLevels[LOG_MODULE])
+#define TS_LOG_AT(level, ...) do { if (ts_log_enabled(level)) ts_log_write(LOG_MODULE, (level), __VA_ARGS__); } while (0)
+
+// Timestamped logging. Lines are queued in a lock-free ring and written to Serial by the
+// log drain task, so callers (including NimBLE callbacks) never wait on the UART.
+#define ts_log_printf(...) TS_LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define ts_log_error(...)  TS_LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define ts_log_warn(...)   TS_LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define ts_log_debug(...)  TS_LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// --- Logger (defined in logger.cpp) ---
+extern TaskHandle_t logDrainTaskHandle; // Defined in .ino
+
+void ts_log_write(uint8_t module, uint8_t level, const char* format, ...);
+// Creates the output lock; call before the drain task starts, so every path that drains the ring
+// (early boot, panic mode, ts_log_flush) is serialized from the first line on.
+bool ts_log_begin();
+void logDrainTask_func(void* pvParameters);
+
+void ts_log_set_level(uint8_t module, uint8_t level);
+void ts_log_set_all_levels(uint8_t level);
+uint8_t ts_log_get_level(uint8_t module);
+uint32_t ts_log_dropped(); // Lines lost because the ring was full
+
+// Panic mode writes every line synchronously and flushes the UART (the old behaviour),
+// so nothing is lost if the next instruction crashes. Enabled from boot by LOG_PANIC_FLUSH.
+void ts_log_set_panic_mode(bool enabled);
+// Writes out everything queued so far from the calling task.
+void ts_log_flush();
+// Holds the Serial output lock so a long raw dump is not interleaved with log lines.
+void ts_log_lock_output();
+void ts_log_unlock_output();
+
+// --- Tokenized Logging ---
+// TS_LOG_TOKEN lines carry only a 32-bit hash of the format string plus the raw arguments when
+// tokenized mode is on (LOG_TOKENIZED or serial 't'); tools/log_decode.py rebuilds the text from the
+// sources. With tokenized mode off they are ordinary text lines. Format strings must be literals.
+// Arguments: integers, enums, float/double and C strings (truncated to LOG_TOKEN_MAX_STRING bytes).
+// TS_LOG_TOKEN_HEX logs a byte buffer; the format string takes it as its single %s.
+//
+// Binary frame on Serial (text lines never contain the 0x1E sync byte, so the two can be interleaved):
+//   0x1E | length u8 | module << 3 | level u8 | timestamp ms varint | token u32 LE | arguments
+// Integer arguments are zigzag varints, floats are 4 bytes LE, strings/buffers are varint length + bytes.
+#define LOG_TOKEN_SYNC        0x1E
+#define LOG_TOKEN_MAX_STRING  32
+
+constexpr uint32_t logTokenHash(const char* s, uint32_t hash = 2166136261u) {
+    return *s ? logTokenHash(s + 1, (hash ^ (uint8_t)*s) * 16777619u) : hash; // FNV-1a
+}
+
+#define TS_LOG_TOKEN(level, format, ...) do { if (ts_log_enabled(level)) { \
+        if (ts_log_tokenized()) { \
+            LogArgWriter logArgs_; \
+            logPutArgs(logArgs_, ##__VA_ARGS__); \
+            ts_log_token_write(LOG_MODULE, (level), std::integral_constant<uint32_t, logTokenHash(format)>::value, logArgs_); \
+        } else { \
+            ts_log_write(LOG_MODULE, (level), format, ##__VA_ARGS__); \
+        } } } while (0)
+
+#define TS_LOG_TOKEN_HEX(level, format, data, length) do { if (ts_log_enabled(level)) { \
+        if (ts_log_tokenized()) { \
+            LogArgWriter logArgs_; \
+            logPutBytes(logArgs_, (const uint8_t*)(data), (length)); \
+            ts_log_token_write(LOG_MODULE, (level), std::integral_constant<uint32_t, logTokenHash(format)>::value, logArgs_); \
+        } else { \
+            ts_log_hex_write(LOG_MODULE, (level), format, (const uint8_t*)(data), (length)); \
+        } } } while (0)
+
+struct LogArgWriter {
+    uint8_t bytes[LOG_LINE_MAX - 4]; // Slot space left after the token
+    size_t length;
+    LogArgWriter() : length(0) {}
+};
+
+inline void logPutVarint(LogArgWriter& w, uint64_t value) {
+    do {
+        if (w.length >= sizeof(w.bytes)) return;
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        w.bytes[w.length++] = value ? (b | 0x80) : b;
+    } while (value);
+}
+
+inline void logPutBytes(LogArgWriter& w, const uint8_t* data, size_t length) {
+    if (length > sizeof(w.bytes) - 2) length = sizeof(w.bytes) - 2;
+    logPutVarint(w, length);
+    if (w.length + length > sizeof(w.bytes)) return;
+    memcpy(w.bytes + w.length, data, length);
+    w.length += length;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+logPutArg(LogArgWriter& w, T value) {
+    int64_t v = (int64_t)value;
+    logPutVarint(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); // zigzag
+}
+
+inline void logPutArg(LogArgWriter& w, double value) {
+    float f = (float)value;
+    if (w.length + sizeof(f) > sizeof(w.bytes)) return;
+    memcpy(w.bytes + w.length, &f, sizeof(f));
+    w.length += sizeof(f);
+}
+
+inline void logPutArg(LogArgWriter& w, const char* str) {
+    size_t length = 0; // Bounded scan; strnlen() warns when passed a short literal
+    while (str && length < LOG_TOKEN_MAX_STRING && str[length]) length++;
+    logPutBytes(w, (const uint8_t*)str, length);
+}
+
+inline void logPutArgs(LogArgWriter&) {}
+
+template <typename T, typename... Rest>
+inline void logPutArgs(LogArgWriter& w, T first, Rest... rest) {
+    logPutArg(w, first);
+    logPutArgs(w, rest...);
+}
+
+void ts_log_token_write(uint8_t module, uint8_t level, uint32_t token, const LogArgWriter& args);
+void ts_log_hex_write(uint8_t module, uint8_t level, const char* format, const uint8_t* data, size_t length);
+void ts_log_set_tokenized(bool enabled);
+bool ts_log_tokenized();
 
 #if 0 // Example of a hex dump utility, can be useful for debugging BLE data
 void hexDump(const uint8_t* data, size_t length);
 #endif
 
-#endif // LOGGER_H
\ No newline at end of file
+#endif // LOGGER_H
@@ -0,0 +1,147 @@
+#define LOG_MODULE LOG_MOD_SYSTEM
+#include "metrics.h"
+#include <atomic>
+
+// Zero-initialized statics: updates are safe from the first notification on, with no begin() call.
+static std::atomic<uint32_t> metricCounters[METRIC_COUNTER_COUNT];
+
+struct MetricHistogramSlot {
+    std::atomic<uint32_t> max;
+    std::atomic<uint32_t> buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+static MetricHistogramSlot metricHistograms[METRIC_HIST_COUNT];
+
+static const char* const metricCounterNames[METRIC_CP_OP_FIRST] = {
+    "bike_packets", "bike_parse_rejects", "app_notifies", "app_notify_failures", "cp_writes",
+};
+static const char* const metricHistogramNames[METRIC_HIST_COUNT] = {
+    "bike_interval_ms", "parse_us", "wake_us", "encode_us", "notify_us", "forward_us",
+};
+
+// --- Update ---
+void metricsCount(uint8_t counter) {
+    if (counter < METRIC_COUNTER_COUNT) metricCounters[counter].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metricsCountControlPoint(uint8_t opCode) {
+    metricCounters[METRIC_CP_WRITES].fetch_add(1, std::memory_order_relaxed);
+    uint8_t slot = opCode < METRICS_CP_OP_SLOTS - 1 ? opCode : METRICS_CP_OP_SLOTS - 1;
+    metricCounters[METRIC_CP_OP_FIRST + slot].fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint8_t bucketOf(uint32_t value) {
+    if (value == 0) return 0;
+    uint8_t bucket = (uint8_t)(32 - __builtin_clz(value));
+    return bucket < METRICS_HISTOGRAM_BUCKETS ? bucket : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+void metricsObserve(uint8_t histogram, uint32_t value) {
+    if (histogram >= METRIC_HIST_COUNT) return;
+    MetricHistogramSlot& slot = metricHistograms[histogram];
+    slot.buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    uint32_t max = slot.max.load(std::memory_order_relaxed);
+    while (value > max && !slot.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+// --- Read ---
+uint32_t metricsCounter(uint8_t counter) {
+    return counter < METRIC_COUNTER_COUNT ? metricCounters[counter].load(std::memory_order_relaxed) : 0;
+}
+
+void metricsGetHistogram(uint8_t histogram, MetricHistogramSnapshot& out) {
+    memset(&out, 0, sizeof(out));
+    if (histogram >= METRIC_HIST_COUNT) return;
+    const MetricHistogramSlot& slot = metricHistograms[histogram];
+    out.max = slot.max.load(std::memory_order_relaxed);
+    for (uint8_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        out.buckets[i] = slot.buckets[i].load(std::memory_order_relaxed);
+        out.count += out.buckets[i];
+    }
+}
+
+uint32_t metricsPercentile(const MetricHistogramSnapshot& histogram, uint8_t percent) {
+    if (histogram.count == 0) return 0;
+    uint64_t rank = ((uint64_t)histogram.count * percent + 99) / 100; // Samples at or below the answer
+    uint64_t seen = 0;
+    for (uint8_t i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = i == 0 ? 0 : (1u << i) - 1;
+            return upper < histogram.max ? upper : histogram.max;
+        }
+    }
+    return histogram.max;
+}
+
+const char* metricsCounterName(uint8_t counter) {
+    if (counter < METRIC_CP_OP_FIRST) return metricCounterNames[counter];
+    return counter < METRIC_COUNTER_COUNT ? "cp_op" : "?";
+}
+
+const char* metricsHistogramName(uint8_t histogram) {
+    return histogram < METRIC_HIST_COUNT ? metricHistogramNames[histogram] : "?";
+}
+
+// --- Diagnostics Service Records ---
+static uint8_t* putUint32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+    return out + 4;
+}
+
+size_t metricsEncodeCounters(uint8_t* out) {
+    uint8_t* p = out;
+    *p++ = METRICS_RECORD_VERSION;
+    *p++ = METRIC_COUNTER_COUNT;
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++) p = putUint32(p, metricsCounter(i));
+    return (size_t)(p - out);
+}
+
+size_t metricsEncodeHistograms(uint8_t* out) {
+    uint8_t* p = out;
+    *p++ = METRICS_RECORD_VERSION;
+    *p++ = METRIC_HIST_COUNT;
+    *p++ = METRICS_HISTOGRAM_BUCKETS;
+    MetricHistogramSnapshot histogram;
+    for (uint8_t h = 0; h < METRIC_HIST_COUNT; h++) {
+        metricsGetHistogram(h, histogram);
+        p = putUint32(p, histogram.max);
+        for (uint8_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) p = putUint32(p, histogram.buckets[i]);
+    }
+    return (size_t)(p - out);
+}
+
+// --- Console ---
+void metricsLogStats() {
+    ts_log_printf("[Metrics] %s %lu, %s %lu, %s %lu, %s %lu, %s %lu",
+                  metricCounterNames[METRIC_BIKE_PACKETS], (unsigned long)metricsCounter(METRIC_BIKE_PACKETS),
+                  metricCounterNames[METRIC_BIKE_PARSE_REJECTS], (unsigned long)metricsCounter(METRIC_BIKE_PARSE_REJECTS),
+                  metricCounterNames[METRIC_APP_NOTIFIES], (unsigned long)metricsCounter(METRIC_APP_NOTIFIES),
+                  metricCounterNames[METRIC_APP_NOTIFY_FAILURES], (unsigned long)metricsCounter(METRIC_APP_NOTIFY_FAILURES),
+                  metricCounterNames[METRIC_CP_WRITES], (unsigned long)metricsCounter(METRIC_CP_WRITES));
+    char line[LOG_LINE_MAX];
+    size_t length = 0;
+    for (uint8_t slot = 0; slot < METRICS_CP_OP_SLOTS && length < sizeof(line); slot++) {
+        uint32_t count = metricsCounter(METRIC_CP_OP_FIRST + slot);
+        if (count == 0) continue;
+        if (slot < METRICS_CP_OP_SLOTS - 1) {
+            length += snprintf(line + length, sizeof(line) - length, " 0x%02X:%lu", slot, (unsigned long)count);
+        } else {
+            length += snprintf(line + length, sizeof(line) - length, " other:%lu", (unsigned long)count);
+        }
+    }
+    if (length > 0) ts_log_printf("[Metrics] CP writes by op code:%s", line);
+
+    MetricHistogramSnapshot histogram;
+    for (uint8_t h = 0; h < METRIC_HIST_COUNT; h++) {
+        metricsGetHistogram(h, histogram);
+        if (histogram.count == 0) continue;
+        ts_log_printf("[Metrics] %-16s n %lu, p50 <= %lu, p90 <= %lu, p99 <= %lu, max %lu", metricHistogramNames[h],
+                      (unsigned long)histogram.count, (unsigned long)metricsPercentile(histogram, 50),
+                      (unsigned long)metricsPercentile(histogram, 90), (unsigned long)metricsPercentile(histogram, 99),
+                      (unsigned long)histogram.max);
+    }
+}
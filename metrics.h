@@ -0,0 +1,65 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Metrics Registry ---
+// Counters and fixed-bucket histograms of the data path, updated with one relaxed atomic add from any
+// task (NimBLE host, forwarder, Control Point), so they stay on in production. Totals since boot;
+// readers take differences.
+#define METRICS_CP_OP_SLOTS 0x16 // Op codes 0x00-0x14 (FTMS 1.0) each, the last slot the rest
+
+enum MetricCounter : uint8_t {
+    METRIC_BIKE_PACKETS,        // Bike data packets decoded (Merach 0xFFF1, FTMS Indoor Bike Data)
+    METRIC_BIKE_PARSE_REJECTS,  // ... of which not understood (format, length)
+    METRIC_APP_NOTIFIES,        // Indoor Bike Data (0x2ACC) notifications, per app and fragment
+    METRIC_APP_NOTIFY_FAILURES, // ... that notify() reported as not sent (e.g. no notify buffer left)
+    METRIC_CP_WRITES,           // Control Point (0x2AD9) writes, every op code
+    METRIC_CP_OP_FIRST,         // Control Point writes of op code 0x00, 0x01, ... (METRICS_CP_OP_SLOTS)
+    METRIC_COUNTER_COUNT = METRIC_CP_OP_FIRST + METRICS_CP_OP_SLOTS
+};
+
+enum MetricHistogram : uint8_t {
+    METRIC_HIST_BIKE_INTERVAL_MS, // Time between bike samples
+    METRIC_HIST_PARSE_US,         // Bike notification callback: decode and publish
+    METRIC_HIST_WAKE_US,          // Forwarder signalled -> its task runs (notify-wake latency)
+    METRIC_HIST_ENCODE_US,        // Indoor Bike Data encode
+    METRIC_HIST_NOTIFY_US,        // Notify calls of one record: every app, every fragment
+    METRIC_HIST_FORWARD_US,       // Publish -> last app notified (the forwarder's latency)
+    METRIC_HIST_COUNT
+};
+
+// --- Update (any task, never blocks) ---
+void metricsCount(uint8_t counter);
+void metricsCountControlPoint(uint8_t opCode); // METRIC_CP_WRITES and the op code's own counter
+void metricsObserve(uint8_t histogram, uint32_t value);
+
+// --- Read ---
+struct MetricHistogramSnapshot {
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+
+uint32_t metricsCounter(uint8_t counter);
+void metricsGetHistogram(uint8_t histogram, MetricHistogramSnapshot& out);
+// Upper bound of the bucket holding the given percentile (1-100); 0 without samples.
+uint32_t metricsPercentile(const MetricHistogramSnapshot& histogram, uint8_t percent);
+const char* metricsCounterName(uint8_t counter);
+const char* metricsHistogramName(uint8_t histogram);
+
+// --- Diagnostics Service Records (little-endian) ---
+// Counters:   version (1), counter count N, then N x uint32 in MetricCounter order.
+// Histograms: version (1), histogram count H, bucket count B, then per histogram uint32 max and
+//             B x uint32 bucket counts, in MetricHistogram order.
+#define METRICS_RECORD_VERSION    1
+#define METRICS_COUNTERS_LENGTH   (2 + 4 * METRIC_COUNTER_COUNT)
+#define METRICS_HISTOGRAMS_LENGTH (3 + METRIC_HIST_COUNT * 4 * (1 + METRICS_HISTOGRAM_BUCKETS))
+size_t metricsEncodeCounters(uint8_t* out);   // METRICS_COUNTERS_LENGTH bytes
+size_t metricsEncodeHistograms(uint8_t* out); // METRICS_HISTOGRAMS_LENGTH bytes
+
+void metricsLogStats(); // Console 'm'
+
+#endif // METRICS_H
@@ -0,0 +1,365 @@
+#define LOG_MODULE LOG_MOD_CALIBRATION
+#include "resistance_calibration.h"
+#include "stepper_motion.h"
+#include "ble_client_manager.h"
+#include "ble_peripheral_manager.h"
+#include "system_tasks.h"
+#include <Preferences.h>
+#include <math.h>
+
+static const char* CALIBRATION_NVS_KEY = "map";
+static const uint16_t CALIBRATION_REFIT_SAMPLES = 50; // Samples of one level between refits
+
+static portMUX_TYPE calibrationMux = portMUX_INITIALIZER_UNLOCKED;
+static CalibrationMap calibrationMap;
+static bool calibrationDirty = false;
+static unsigned long lastCalibrationSaveMs = 0;
+static volatile bool calibrationRunning = false;
+
+static float crankRadPerS(float cadenceRpm) {
+    return cadenceRpm * (2.0f * (float)M_PI / 60.0f);
+}
+
+// --- Calibration Map ---
+void calibrationMapReset(CalibrationMap& map) {
+    memset(&map, 0, sizeof(map));
+    map.version = CALIBRATION_MAP_VERSION;
+    map.levelCount = CALIBRATION_LEVEL_COUNT;
+    for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+        map.levels[i].lowSteps = -1;
+        map.levels[i].highSteps = -1;
+    }
+}
+
+static float levelCentreSteps(const CalibrationMap& map, uint8_t index) {
+    return (map.levels[index].lowSteps + map.levels[index].highSteps) / 2.0f;
+}
+
+bool calibrationMapLevelToSteps(const CalibrationMap& map, float level, int32_t& steps) {
+    if (!(map.flags & CALIBRATION_HAS_POSITIONS)) return false;
+    float position = level - 1.0f;
+    if (position <= 0.0f) {
+        steps = lroundf(levelCentreSteps(map, 0));
+    } else if (position >= CALIBRATION_LEVEL_COUNT - 1) {
+        steps = lroundf(levelCentreSteps(map, CALIBRATION_LEVEL_COUNT - 1));
+    } else {
+        uint8_t index = (uint8_t)position;
+        float fraction = position - index;
+        float low = levelCentreSteps(map, index);
+        steps = lroundf(low + fraction * (levelCentreSteps(map, index + 1) - low));
+    }
+    return true;
+}
+
+bool calibrationMapPower(const CalibrationMap& map, uint8_t level, float cadenceRpm, float& powerW) {
+    if (level < 1 || level > CALIBRATION_LEVEL_COUNT) return false;
+    const CalibrationLevel& entry = map.levels[level - 1];
+    if (entry.torqueMnm == 0) return false;
+    powerW = entry.torqueMnm / 1000.0f * crankRadPerS(cadenceRpm) + entry.offsetW;
+    return true;
+}
+
+bool calibrationMapTorqueModel(const CalibrationMap& map, float& baseNm, float& perLevelNm) {
+    float omega = crankRadPerS(CALIBRATION_REFERENCE_RPM);
+    float n = 0.0f, sumLevel = 0.0f, sumTorque = 0.0f, sumLevel2 = 0.0f, sumLevelTorque = 0.0f;
+    for (uint8_t level = 1; level <= CALIBRATION_LEVEL_COUNT; level++) {
+        float powerW;
+        if (!calibrationMapPower(map, level, CALIBRATION_REFERENCE_RPM, powerW)) continue;
+        float torque = powerW / omega;
+        n += 1.0f;
+        sumLevel += level;
+        sumTorque += torque;
+        sumLevel2 += (float)level * level;
+        sumLevelTorque += level * torque;
+    }
+    if (n < 2.0f) return false;
+    float slope = (n * sumLevelTorque - sumLevel * sumTorque) / (n * sumLevel2 - sumLevel * sumLevel);
+    if (!(slope > 0.0f)) return false; // Resistance must rise with the level
+    perLevelNm = slope;
+    baseNm = (sumTorque - slope * sumLevel) / n;
+    return true;
+}
+
+// --- Knob Sweep ---
+void calibrationSweepReset(CalibrationSweep& sweep) {
+    for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+        sweep.lowSteps[i] = -1;
+        sweep.highSteps[i] = -1;
+    }
+    sweep.readings = 0;
+}
+
+void calibrationSweepRecord(CalibrationSweep& sweep, int32_t position, uint8_t level) {
+    if (level < 1 || level > CALIBRATION_LEVEL_COUNT || position < 0 || position > INT16_MAX) return;
+    uint8_t i = level - 1;
+    if (sweep.lowSteps[i] < 0 || position < sweep.lowSteps[i]) sweep.lowSteps[i] = (int16_t)position;
+    if (position > sweep.highSteps[i]) sweep.highSteps[i] = (int16_t)position;
+    sweep.readings++;
+}
+
+bool calibrationSweepFinish(const CalibrationSweep& sweep, CalibrationMap& map) {
+    for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+        if (sweep.lowSteps[i] < 0) {
+            ts_log_error("[Calibration] Level %u never seen during the sweep.", i + 1);
+            return false;
+        }
+        if (i > 0 && sweep.lowSteps[i] + sweep.highSteps[i] <= sweep.lowSteps[i - 1] + sweep.highSteps[i - 1]) {
+            ts_log_error("[Calibration] Level %u is not above level %u on the knob.", i + 1, i);
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+        map.levels[i].lowSteps = sweep.lowSteps[i];
+        map.levels[i].highSteps = sweep.highSteps[i];
+    }
+    map.flags |= CALIBRATION_HAS_POSITIONS;
+    return true;
+}
+
+// --- Power Curve Learner ---
+void calibrationLearnerReset(PowerCurveLearner& learner) {
+    memset(&learner, 0, sizeof(learner));
+}
+
+void calibrationLearnerAdd(PowerCurveLearner& learner, float cadenceRpm, float powerW) {
+    const float keep = 1.0f - 1.0f / CALIBRATION_LEARN_WINDOW;
+    float omega = crankRadPerS(cadenceRpm);
+    learner.weight = learner.weight * keep + 1.0f;
+    learner.sumOmega = learner.sumOmega * keep + omega;
+    learner.sumPower = learner.sumPower * keep + powerW;
+    learner.sumOmega2 = learner.sumOmega2 * keep + omega * omega;
+    learner.sumOmegaPower = learner.sumOmegaPower * keep + omega * powerW;
+}
+
+bool calibrationLearnerFit(const PowerCurveLearner& learner, uint16_t& torqueMnm, int16_t& offsetW) {
+    if (learner.weight < CALIBRATION_MIN_SAMPLES) return false;
+    float meanOmega = learner.sumOmega / learner.weight;
+    float meanPower = learner.sumPower / learner.weight;
+    float varianceOmega = learner.sumOmega2 / learner.weight - meanOmega * meanOmega;
+    float minSpread = crankRadPerS(CALIBRATION_MIN_CADENCE_SPREAD_RPM);
+    float slope, offset;
+    if (varianceOmega >= minSpread * minSpread) {
+        slope = (learner.sumOmegaPower / learner.weight - meanOmega * meanPower) / varianceOmega;
+        offset = meanPower - slope * meanOmega;
+    } else {
+        slope = learner.sumOmegaPower / learner.sumOmega2; // Too little cadence variation for an offset
+        offset = 0.0f;
+    }
+    if (!(slope > 0.0f) || slope >= 65.0f) return false;
+    torqueMnm = (uint16_t)lroundf(slope * 1000.0f);
+    offsetW = (int16_t)lroundf(offset < -1000.0f ? -1000.0f : (offset > 1000.0f ? 1000.0f : offset));
+    return torqueMnm > 0;
+}
+
+// --- NVS ---
+static bool saveMap(const CalibrationMap& map) {
+    Preferences prefs;
+    if (!prefs.begin(CALIBRATION_NVS_NAMESPACE, false)) {
+        ts_log_error("[Calibration] FAILED to open NVS namespace '%s'.", CALIBRATION_NVS_NAMESPACE);
+        return false;
+    }
+    size_t written = prefs.putBytes(CALIBRATION_NVS_KEY, &map, sizeof(map));
+    prefs.end();
+    if (written != sizeof(map)) {
+        ts_log_error("[Calibration] FAILED to write the map to NVS.");
+        return false;
+    }
+    return true;
+}
+
+static void logMap(const CalibrationMap& map) {
+    for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+        const CalibrationLevel& entry = map.levels[i];
+        ts_log_printf("[Calibration]   Level %u: knob %d..%d steps, power %.3f Nm x omega %+d W",
+                      i + 1, entry.lowSteps, entry.highSteps, entry.torqueMnm / 1000.0f, entry.offsetW);
+    }
+}
+
+bool calibrationBegin() {
+    CalibrationMap loaded;
+    calibrationMapReset(loaded);
+    Preferences prefs;
+    bool found = false;
+    // One blob, one read: the map is usable as soon as this returns.
+    if (prefs.begin(CALIBRATION_NVS_NAMESPACE, true)) {
+        CalibrationMap stored;
+        if (prefs.getBytesLength(CALIBRATION_NVS_KEY) == sizeof(stored) &&
+            prefs.getBytes(CALIBRATION_NVS_KEY, &stored, sizeof(stored)) == sizeof(stored) &&
+            stored.version == CALIBRATION_MAP_VERSION && stored.levelCount == CALIBRATION_LEVEL_COUNT) {
+            loaded = stored;
+            found = true;
+        }
+        prefs.end();
+    }
+
+    portENTER_CRITICAL(&calibrationMux);
+    calibrationMap = loaded;
+    calibrationDirty = false;
+    portEXIT_CRITICAL(&calibrationMux);
+
+    if (!found) {
+        ts_log_printf("[Calibration] No stored calibration: using the config.h knob and bike models.");
+        return false;
+    }
+    ts_log_printf("[Calibration] Loaded from NVS (%s knob positions).",
+                  (loaded.flags & CALIBRATION_HAS_POSITIONS) ? "with" : "without");
+    logMap(loaded);
+    return true;
+}
+
+void calibrationGetMap(CalibrationMap& out) {
+    portENTER_CRITICAL(&calibrationMux);
+    out = calibrationMap;
+    portEXIT_CRITICAL(&calibrationMux);
+}
+
+bool calibrationLevelToSteps(float level, int32_t& steps) {
+    portENTER_CRITICAL(&calibrationMux);
+    bool ok = calibrationMapLevelToSteps(calibrationMap, level, steps);
+    portEXIT_CRITICAL(&calibrationMux);
+    return ok;
+}
+
+bool calibrationTorqueModel(float& baseNm, float& perLevelNm) {
+    CalibrationMap map;
+    calibrationGetMap(map);
+    return calibrationMapTorqueModel(map, baseNm, perLevelNm);
+}
+
+// --- calibrationOnSample Implementation (forwarder task, every fresh bike sample) ---
+// Learns each level's power curve while riding. Samples right after a level change are skipped:
+// the bike's power lags the knob.
+void calibrationOnSample(const TelemetryFrame& frame) {
+    static PowerCurveLearner learners[CALIBRATION_LEVEL_COUNT];
+    static uint16_t samplesSinceFit[CALIBRATION_LEVEL_COUNT];
+    static uint8_t lastLevel = 0;
+    static int64_t levelSinceUs = 0;
+
+    uint8_t level = frame.resistanceLevel;
+    if (level != lastLevel) {
+        lastLevel = level;
+        levelSinceUs = frame.timestampUs;
+        return;
+    }
+    if (level < 1 || level > CALIBRATION_LEVEL_COUNT || calibrationRunning) return;
+    if (frame.timestampUs - levelSinceUs < (int64_t)CALIBRATION_SETTLE_MS * 1000) return;
+    float cadenceRpm = frame.cadence / 2.0f;
+    if (cadenceRpm < CALIBRATION_MIN_CADENCE_RPM || frame.power == 0) return;
+
+    uint8_t i = level - 1;
+    calibrationLearnerAdd(learners[i], cadenceRpm, frame.power);
+    if (++samplesSinceFit[i] < CALIBRATION_REFIT_SAMPLES) return;
+    samplesSinceFit[i] = 0;
+
+    uint16_t torqueMnm;
+    int16_t offsetW;
+    if (!calibrationLearnerFit(learners[i], torqueMnm, offsetW)) return;
+    portENTER_CRITICAL(&calibrationMux);
+    bool changed = calibrationMap.levels[i].torqueMnm != torqueMnm || calibrationMap.levels[i].offsetW != offsetW;
+    calibrationMap.levels[i].torqueMnm = torqueMnm;
+    calibrationMap.levels[i].offsetW = offsetW;
+    if (changed) calibrationDirty = true;
+    portEXIT_CRITICAL(&calibrationMux);
+    if (changed) {
+        ts_log_debug("[Calibration] Level %u curve: %u mNm x omega %+d W (%.0f samples).",
+                     level, torqueMnm, offsetW, learners[i].weight);
+    }
+}
+
+void calibrationSaveIfDirty() {
+    if (!calibrationDirty || millis() - lastCalibrationSaveMs < CALIBRATION_SAVE_INTERVAL_MS) return;
+    CalibrationMap map;
+    portENTER_CRITICAL(&calibrationMux);
+    map = calibrationMap;
+    calibrationDirty = false;
+    portEXIT_CRITICAL(&calibrationMux);
+    lastCalibrationSaveMs = millis();
+    if (saveMap(map)) ts_log_printf("[Calibration] Learned power curves saved to NVS.");
+}
+
+bool calibrationActive() {
+    return calibrationRunning;
+}
+
+bool calibrationStart() {
+    if (calibrationRunning) {
+        ts_log_warn("[Calibration] A sweep is already running.");
+        return false;
+    }
+    if (!STEPPER_ENABLED) {
+        ts_log_error("[Calibration] No knob motor (STEPPER_ENABLED is 0).");
+        return false;
+    }
+    if (!bikeSensorConnected) {
+        ts_log_error("[Calibration] Connect the bike first: the sweep reads its apparent level.");
+        return false;
+    }
+    calibrationRunning = true;
+    if (!systemTaskCreate(SYSTEM_TASK_CALIBRATION)) {
+        calibrationRunning = false;
+        return false;
+    }
+    return true;
+}
+
+// --- calibrationTask_func Implementation ---
+// Homes the knob, steps it up and back down through its travel and records the bike's apparent
+// level at each stop. Takes a few minutes (2 * STEPPER_TRAVEL_STEPS / CALIBRATION_SWEEP_STEP stops).
+static bool waitForKnob(uint32_t timeoutMs) {
+    unsigned long startMs = millis();
+    MotionStatus status;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        motionGetStatus(status);
+        if (status.state == STEPPER_STATE_IDLE) return true;
+    } while (millis() - startMs < timeoutMs);
+    return false;
+}
+
+static bool readKnobPosition(CalibrationSweep& sweep, int32_t position) {
+    motionRequestPosition(position);
+    if (!waitForKnob(CALIBRATION_MOVE_TIMEOUT_MS) || !bikeSensorConnected) return false;
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_SETTLE_MS));
+    TelemetryFrame frame;
+    telemetryRead(frame);
+    calibrationSweepRecord(sweep, position, frame.resistanceLevel);
+    ts_log_debug("[Calibration] Knob %ld steps -> level %u", (long)position, frame.resistanceLevel);
+    return true;
+}
+
+void calibrationTask_func(void *pvParameters) {
+    ts_log_printf("[Calibration:%s] Sweep started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+
+    CalibrationSweep sweep;
+    calibrationSweepReset(sweep);
+    motionRequestHome();
+    bool ok = waitForKnob(CALIBRATION_MOVE_TIMEOUT_MS + STEPPER_HOMING_MAX_STEPS * 1000UL / (uint32_t)STEPPER_HOMING_SPEED_SPS);
+    for (int32_t position = 0; ok && position <= STEPPER_TRAVEL_STEPS; position += CALIBRATION_SWEEP_STEP) {
+        ok = readKnobPosition(sweep, position);
+    }
+    for (int32_t position = STEPPER_TRAVEL_STEPS; ok && position >= 0; position -= CALIBRATION_SWEEP_STEP) {
+        ok = readKnobPosition(sweep, position);
+    }
+
+    CalibrationMap map;
+    calibrationGetMap(map);
+    if (!ok) {
+        ts_log_error("[Calibration] Sweep aborted (knob move timed out or bike disconnected).");
+    } else if (calibrationSweepFinish(sweep, map)) {
+        portENTER_CRITICAL(&calibrationMux);
+        for (uint8_t i = 0; i < CALIBRATION_LEVEL_COUNT; i++) {
+            calibrationMap.levels[i].lowSteps = map.levels[i].lowSteps;
+            calibrationMap.levels[i].highSteps = map.levels[i].highSteps;
+        }
+        calibrationMap.flags |= CALIBRATION_HAS_POSITIONS;
+        map = calibrationMap;
+        portEXIT_CRITICAL(&calibrationMux);
+        ts_log_printf("[Calibration] Sweep done: %u readings.", sweep.readings);
+        logMap(map);
+        if (saveMap(map)) ts_log_printf("[Calibration] Saved to NVS.");
+    }
+
+    calibrationRunning = false;
+    motionRequestLevel(targetResistanceLevel_App); // Back to whatever the app wants now
+    systemTaskExit();
+}
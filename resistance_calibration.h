@@ -0,0 +1,83 @@
+#ifndef RESISTANCE_CALIBRATION_H
+#define RESISTANCE_CALIBRATION_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+#include "telemetry.h"
+
+// --- Global Variables related to Calibration (defined in .ino) ---
+extern TaskHandle_t calibrationTaskHandle; // Only while a sweep runs
+
+// --- Calibration Map (one NVS blob, loaded once at boot) ---
+// Which knob positions make the bike report each apparent level (from a sweep), and each level's
+// power vs cadence line (learned while riding): power = torque * crank speed + offset.
+#define CALIBRATION_MAP_VERSION   1
+#define CALIBRATION_HAS_POSITIONS 0x01
+
+struct CalibrationLevel {
+    int16_t lowSteps;       // Lowest / highest knob position that showed this level (-1 = not seen)
+    int16_t highSteps;
+    uint16_t torqueMnm;     // Power curve slope (0 = not learned yet)
+    int16_t offsetW;        // Power curve offset
+};
+
+struct CalibrationMap {
+    uint16_t version;       // CALIBRATION_MAP_VERSION
+    uint8_t levelCount;     // CALIBRATION_LEVEL_COUNT when saved
+    uint8_t flags;          // CALIBRATION_HAS_*
+    CalibrationLevel levels[CALIBRATION_LEVEL_COUNT]; // [0] = level 1
+};
+
+void calibrationMapReset(CalibrationMap& map);
+// Knob position for a (fractional) level, interpolated between level centres. O(1).
+// False without a position calibration.
+bool calibrationMapLevelToSteps(const CalibrationMap& map, float level, int32_t& steps);
+// Learned power of 'level' at cadenceRpm. False if that level has no curve yet.
+bool calibrationMapPower(const CalibrationMap& map, uint8_t level, float cadenceRpm, float& powerW);
+// Straight-line torque model (torque at CALIBRATION_REFERENCE_RPM vs level) across the learned
+// levels, in the form the ERG controller uses. False with fewer than two learned levels.
+bool calibrationMapTorqueModel(const CalibrationMap& map, float& baseNm, float& perLevelNm);
+
+// --- Knob Sweep ---
+// Readings (knob position, apparent level) from an up and a down sweep; finishing checks that every
+// level was seen and that the levels are in knob order, then writes the positions into a map.
+struct CalibrationSweep {
+    int16_t lowSteps[CALIBRATION_LEVEL_COUNT];
+    int16_t highSteps[CALIBRATION_LEVEL_COUNT];
+    uint16_t readings;
+};
+
+void calibrationSweepReset(CalibrationSweep& sweep);
+void calibrationSweepRecord(CalibrationSweep& sweep, int32_t position, uint8_t level);
+bool calibrationSweepFinish(const CalibrationSweep& sweep, CalibrationMap& map);
+
+// --- Power Curve Learner ---
+// Least squares of power on crank speed with exponential forgetting (CALIBRATION_LEARN_WINDOW samples),
+// so the curve follows the bike as it warms up or wears.
+struct PowerCurveLearner {
+    float weight;           // Effective sample count
+    float sumOmega;
+    float sumPower;
+    float sumOmega2;
+    float sumOmegaPower;
+};
+
+void calibrationLearnerReset(PowerCurveLearner& learner);
+void calibrationLearnerAdd(PowerCurveLearner& learner, float cadenceRpm, float powerW);
+// Line through the samples; through the origin when the cadence range is too narrow for a slope.
+bool calibrationLearnerFit(const PowerCurveLearner& learner, uint16_t& torqueMnm, int16_t& offsetW);
+
+// --- Bridge Hooks ---
+bool calibrationBegin();                 // Loads the map from NVS (setup())
+void calibrationGetMap(CalibrationMap& out);
+bool calibrationLevelToSteps(float level, int32_t& steps);
+bool calibrationTorqueModel(float& baseNm, float& perLevelNm);
+void calibrationOnSample(const TelemetryFrame& frame); // Forwarder, every fresh bike sample
+void calibrationSaveIfDirty();           // loop(): writes learned curves at most every CALIBRATION_SAVE_INTERVAL_MS
+bool calibrationStart();                 // Starts a knob sweep ('k' on the console)
+bool calibrationActive();                // A sweep owns the knob; level requests are ignored
+
+void calibrationTask_func(void *pvParameters);
+
+#endif // RESISTANCE_CALIBRATION_H
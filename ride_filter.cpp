@@ -0,0 +1,116 @@
+#include "ride_filter.h"
+#include <atomic>
+#include <string.h>
+
+#if (RIDE_FILTER_RING & (RIDE_FILTER_RING - 1)) != 0 || RIDE_FILTER_RING > 32768
+#error "RIDE_FILTER_RING must be a power of 2 (at most 32768)"
+#endif
+
+void rideFilterInit(RideFilter& filter) {
+    memset(&filter, 0, sizeof(filter));
+    filter.window[TELEMETRY_FILTER_SHORT].lengthMs = RIDE_FILTER_SHORT_MS;
+    filter.window[TELEMETRY_FILTER_LONG].lengthMs = RIDE_FILTER_LONG_MS;
+}
+
+void rideFilterResetSession(RideFilter& filter) {
+    filter.sessionWeightMs = 0;
+    memset(filter.sessionSum, 0, sizeof(filter.sessionSum));
+}
+
+static void windowDropOldest(RideFilter& filter, RideFilterWindow& window) {
+    const RideFilterSample& oldest = filter.ring[window.tail];
+    for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) window.sum[m] -= (uint64_t)oldest.value[m] * oldest.weightMs;
+    window.weightMs -= oldest.weightMs;
+    window.tail = (window.tail + 1) & (RIDE_FILTER_RING - 1);
+    window.count--;
+}
+
+static uint16_t average(uint64_t sum, uint64_t weightMs, uint16_t current) {
+    return weightMs == 0 ? current : (uint16_t)((sum + weightMs / 2) / weightMs);
+}
+
+void rideFilterUpdate(RideFilter& filter, TelemetryFrame& frame, int64_t nowUs) {
+    const uint16_t value[TELEMETRY_METRIC_COUNT] = {frame.speed, frame.cadence, frame.power};
+    uint32_t nowMs = (uint32_t)(nowUs / 1000);
+
+    int64_t gapUs = nowUs - filter.lastUs;
+    bool paused = filter.lastUs == 0 || gapUs < 0 || gapUs > (int64_t)RIDE_FILTER_MAX_GAP_MS * 1000;
+    uint16_t weightMs = 0;
+    if (paused) {
+        filter.lastUs = nowUs;
+    } else {
+        weightMs = (uint16_t)(gapUs / 1000);
+        filter.lastUs += (int64_t)weightMs * 1000; // The sub-ms rest counts toward the next frame
+    }
+
+    if (weightMs > 0) {
+        // A full ring drops its oldest sample from every window that still holds it.
+        for (uint8_t w = 0; w < RIDE_FILTER_WINDOW_COUNT; w++) {
+            if (filter.window[w].count == RIDE_FILTER_RING) windowDropOldest(filter, filter.window[w]);
+        }
+        RideFilterSample& sample = filter.ring[filter.head];
+        sample.endMs = nowMs;
+        sample.weightMs = weightMs;
+        memcpy(sample.value, value, sizeof(sample.value));
+        filter.head = (filter.head + 1) & (RIDE_FILTER_RING - 1);
+        for (uint8_t w = 0; w < RIDE_FILTER_WINDOW_COUNT; w++) {
+            RideFilterWindow& window = filter.window[w];
+            for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) window.sum[m] += (uint64_t)value[m] * weightMs;
+            window.weightMs += weightMs;
+            window.count++;
+        }
+        filter.sessionWeightMs += weightMs;
+        for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) filter.sessionSum[m] += (uint64_t)value[m] * weightMs;
+    }
+
+    for (uint8_t w = 0; w < RIDE_FILTER_WINDOW_COUNT; w++) {
+        RideFilterWindow& window = filter.window[w];
+        while (window.count > 0 && nowMs - filter.ring[window.tail].endMs >= window.lengthMs) {
+            windowDropOldest(filter, window);
+        }
+        for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) {
+            frame.filtered[w][m] = average(window.sum[m], window.weightMs, value[m]);
+        }
+    }
+
+    for (uint8_t m = 0; m < TELEMETRY_METRIC_COUNT; m++) {
+        frame.filtered[TELEMETRY_FILTER_SESSION][m] = average(filter.sessionSum[m], filter.sessionWeightMs, value[m]);
+
+        // alpha = dt / (tau + dt): the same smoothing per second whatever the frame rate.
+        int32_t targetX256 = (int32_t)value[m] << 8;
+        if (paused) {
+            filter.emaX256[m] = targetX256;
+        } else if (weightMs > 0) {
+            filter.emaX256[m] += (int32_t)((int64_t)(targetX256 - filter.emaX256[m]) * weightMs /
+                                           (RIDE_FILTER_EMA_TAU_MS + weightMs));
+        }
+        frame.filtered[TELEMETRY_FILTER_EMA][m] = (uint16_t)((filter.emaX256[m] + 128) >> 8);
+    }
+}
+
+uint16_t rideFilterValue(const TelemetryFrame& frame, uint8_t filter, uint8_t metric) {
+    if (filter < TELEMETRY_FILTER_COUNT && metric < TELEMETRY_METRIC_COUNT) return frame.filtered[filter][metric];
+    switch (metric) {
+        case TELEMETRY_METRIC_SPEED:   return frame.speed;
+        case TELEMETRY_METRIC_CADENCE: return frame.cadence;
+        default:                       return frame.power;
+    }
+}
+
+// --- Bridge Hooks ---
+static RideFilter rideFilter; // NimBLE host task only
+static bool rideFilterReady = false;
+static std::atomic<bool> rideFilterSessionResetPending(false);
+
+void rideFilterApply(TelemetryFrame& frame, int64_t nowUs) {
+    if (!rideFilterReady) {
+        rideFilterInit(rideFilter);
+        rideFilterReady = true;
+    }
+    if (rideFilterSessionResetPending.exchange(false)) rideFilterResetSession(rideFilter);
+    rideFilterUpdate(rideFilter, frame, nowUs);
+}
+
+void rideFilterRequestSessionReset() {
+    rideFilterSessionResetPending.store(true);
+}
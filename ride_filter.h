@@ -0,0 +1,52 @@
+#ifndef RIDE_FILTER_H
+#define RIDE_FILTER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "telemetry.h"
+
+// --- Ride Filter ---
+// Smoothed speed, cadence and power for the display, the ERG controller and the 0x2ACC average
+// fields. Every published frame is one sample, weighted by the time since the previous one, so
+// extra publishes (heart rate, power meter) do not skew the averages. All integer: windowed sums
+// over one ring of samples (each window drops what fell out of it), session sums, and an EMA in
+// 1/256 units. O(1) per sample, amortized. A gap longer than RIDE_FILTER_MAX_GAP_MS is a pause: it
+// is not averaged and restarts the EMA.
+#define RIDE_FILTER_WINDOW_COUNT 2 // TELEMETRY_FILTER_SHORT, TELEMETRY_FILTER_LONG
+
+struct RideFilterSample {
+    uint32_t endMs;    // Time of the frame
+    uint16_t weightMs; // Time it stands for: since the previous frame
+    uint16_t value[TELEMETRY_METRIC_COUNT];
+};
+
+struct RideFilterWindow {
+    uint32_t lengthMs;
+    uint16_t tail;     // Oldest sample in the window
+    uint16_t count;
+    uint32_t weightMs;
+    uint64_t sum[TELEMETRY_METRIC_COUNT]; // value x ms
+};
+
+struct RideFilter {
+    RideFilterSample ring[RIDE_FILTER_RING];
+    uint16_t head;     // Next sample written
+    RideFilterWindow window[RIDE_FILTER_WINDOW_COUNT];
+    uint64_t sessionWeightMs;
+    uint64_t sessionSum[TELEMETRY_METRIC_COUNT];
+    int32_t  emaX256[TELEMETRY_METRIC_COUNT];
+    int64_t  lastUs;   // Previous frame, advanced in whole ms so the remainder carries (0 = none)
+};
+
+void rideFilterInit(RideFilter& filter);
+void rideFilterResetSession(RideFilter& filter);
+// Adds the frame's speed, cadence and power at nowUs and fills frame.filtered.
+void rideFilterUpdate(RideFilter& filter, TelemetryFrame& frame, int64_t nowUs);
+// A consumer's value: TELEMETRY_FILTER_* or TELEMETRY_FILTER_RAW for the unfiltered field.
+uint16_t rideFilterValue(const TelemetryFrame& frame, uint8_t filter, uint8_t metric);
+
+// --- Bridge Hooks ---
+void rideFilterApply(TelemetryFrame& frame, int64_t nowUs); // Before each merged publish (NimBLE host task)
+void rideFilterRequestSessionReset();                      // Any task (FTMS Reset); applied on the next frame
+
+#endif // RIDE_FILTER_H
@@ -0,0 +1,63 @@
+#include "ride_session.h"
+#include <atomic>
+#include <string.h>
+
+#define RIDE_SESSION_US_PER_METRE 360000000ULL // 0.01 km/h x us in one metre
+
+void rideSessionInit(RideSession& session) {
+    memset(&session, 0, sizeof(session));
+}
+
+bool rideSessionUpdate(RideSession& session, TelemetryFrame& frame, int64_t nowUs) {
+    bool moving = frame.speed > 0 || frame.cadence > 0;
+    bool started = false;
+
+    if (session.active && nowUs - session.lastMovingUs > (int64_t)RIDE_SESSION_TIMEOUT_MS * 1000) {
+        session.active = false; // Totals stay on show until the next ride
+    }
+    if (!session.active && moving) {
+        rideSessionInit(session); // This frame stands for time before the ride: not integrated
+        session.active = true;
+        session.startUs = nowUs;
+        started = true;
+    }
+
+    int64_t gapUs = nowUs - session.lastUs;
+    bool integrate = session.active && session.lastUs != 0 && gapUs > 0 && gapUs <= (int64_t)RIDE_SESSION_MAX_GAP_MS * 1000;
+    session.lastUs = nowUs;
+    if (integrate) {
+        uint64_t dtUs = (uint64_t)gapUs;
+        session.distanceRest += frame.speed * dtUs;
+        session.totals.distanceM += (uint32_t)(session.distanceRest / RIDE_SESSION_US_PER_METRE);
+        session.distanceRest %= RIDE_SESSION_US_PER_METRE;
+
+        session.workRestUj += frame.power * dtUs;
+        session.totals.workJ += (uint32_t)(session.workRestUj / 1000000);
+        session.workRestUj %= 1000000;
+
+        if (moving) {
+            session.movingUs += dtUs;
+            session.totals.movingS = (uint32_t)(session.movingUs / 1000000);
+        }
+    }
+
+    if (session.active) {
+        if (moving) session.lastMovingUs = nowUs;
+        session.totals.elapsedS = (uint32_t)((nowUs - session.startUs) / 1000000);
+    }
+    frame.totals = session.totals;
+    return started;
+}
+
+// --- Bridge Hooks ---
+static RideSession rideSession; // NimBLE host task only; zero = no session yet
+static std::atomic<bool> rideSessionResetPending(false);
+
+bool rideSessionApply(TelemetryFrame& frame, int64_t nowUs) {
+    if (rideSessionResetPending.exchange(false)) rideSessionInit(rideSession);
+    return rideSessionUpdate(rideSession, frame, nowUs);
+}
+
+void rideSessionRequestReset() {
+    rideSessionResetPending.store(true);
+}
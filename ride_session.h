@@ -0,0 +1,44 @@
+#ifndef RIDE_SESSION_H
+#define RIDE_SESSION_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "telemetry.h"
+
+// --- Ride Session ---
+// Distance, mechanical work, elapsed and moving time of the ride, integrated from the published
+// frames (frame.totals). Each frame's speed and power count for the time since the previous frame,
+// to the microsecond: the products are exact integers (0.01 km/h x us, W x us = uJ) and only whole
+// metres and joules leave the remainder, so nothing is lost to rounding however long the ride. A gap longer than
+// RIDE_SESSION_MAX_GAP_MS (bike link down) is not integrated; the session, and elapsed time, carry on
+// across bike reconnects. It starts with the first frame that moves and ends after
+// RIDE_SESSION_TIMEOUT_MS without movement or on the app's FTMS Reset.
+struct RideSession {
+    bool     active;
+    int64_t  startUs;         // First moving frame
+    int64_t  lastUs;          // Previous frame (0 = none)
+    int64_t  lastMovingUs;
+    uint64_t distanceRest;    // 0.01 km/h x us not yet a whole metre
+    uint64_t workRestUj;      // uJ not yet a whole joule
+    uint64_t movingUs;
+    TelemetryTotals totals;
+};
+
+void rideSessionInit(RideSession& session);
+// Integrates the frame's speed and power up to nowUs and fills frame.totals. Returns true when the
+// frame started a new session.
+bool rideSessionUpdate(RideSession& session, TelemetryFrame& frame, int64_t nowUs);
+
+// Expended energy from mechanical work at RIDE_SESSION_EFFICIENCY_PCT (1 kcal = 4184 J).
+inline uint32_t rideSessionKcalX10(uint32_t workJ) {
+    return (uint32_t)((uint64_t)workJ * 1000 / (RIDE_SESSION_EFFICIENCY_PCT * 4184));
+}
+inline uint32_t rideSessionKcalPerHour(uint16_t power) {
+    return (uint32_t)((uint64_t)power * 3600 * 100 / (RIDE_SESSION_EFFICIENCY_PCT * 4184));
+}
+
+// --- Bridge Hooks ---
+bool rideSessionApply(TelemetryFrame& frame, int64_t nowUs); // Before each merged publish (NimBLE host task)
+void rideSessionRequestReset();                             // Any task (FTMS Reset); applied on the next frame
+
+#endif // RIDE_SESSION_H
@@ -0,0 +1,308 @@
+#define LOG_MODULE LOG_MOD_SENSOR
+#include "sensor_links.h"
+#include "ble_client_manager.h"
+#include "ride_filter.h"
+#include "ride_session.h"
+#include <esp_timer.h>
+
+extern MyNimBLEAdvertisedDeviceCallbacks myAdvertisedDeviceCallbacks_global;
+
+static const char* const sensorNames[SENSOR_LINK_COUNT] = {"HR", "Power"};
+static const uint16_t sensorServices[SENSOR_LINK_COUNT] = {HEART_RATE_SERVICE_UUID_SHORT, CYCLING_POWER_SERVICE_UUID_SHORT};
+static const char* const sensorAddressFilters[SENSOR_LINK_COUNT] = {SENSOR_HR_ADDRESS, SENSOR_POWER_ADDRESS};
+
+// Link table: the sensor task drives it, the NimBLE host task reports discoveries and drops.
+static portMUX_TYPE sensorLinksMux = portMUX_INITIALIZER_UNLOCKED;
+static SensorLink sensorLinks[SENSOR_LINK_COUNT];
+static NimBLEAddress sensorAddresses[SENSOR_LINK_COUNT]; // Valid while hasDevice
+static NimBLEClient* sensorClients[SENSOR_LINK_COUNT] = {nullptr, nullptr};
+
+// Latest samples. Only the NimBLE host task touches them (every notification callback runs there).
+static SensorFusion sensorFusion = {0, 0, 0, 0};
+
+// --- Link Policy ---
+void sensorLinkInit(SensorLink& link, bool enabled) {
+    memset(&link, 0, sizeof(link));
+    link.state = enabled ? SENSOR_LINK_SEARCHING : SENSOR_LINK_DISABLED;
+}
+
+uint32_t sensorLinkBackoffMs(uint8_t failures) {
+    uint32_t backoffMs = SENSOR_RETRY_MIN_MS;
+    for (uint8_t i = 1; i < failures && backoffMs < SENSOR_RETRY_MAX_MS; i++) backoffMs *= 2;
+    return backoffMs < SENSOR_RETRY_MAX_MS ? backoffMs : SENSOR_RETRY_MAX_MS;
+}
+
+uint8_t sensorLinkNext(SensorLink& link, uint32_t nowMs, bool centralBusy) {
+    if (link.state == SENSOR_LINK_BACKOFF) {
+        if ((int32_t)(nowMs - link.nextAttemptMs) < 0) return SENSOR_ACTION_NONE; // Wrap-safe
+        link.state = SENSOR_LINK_SEARCHING;
+    }
+    if (link.state != SENSOR_LINK_SEARCHING || centralBusy) return SENSOR_ACTION_NONE;
+    if (!link.hasDevice) return SENSOR_ACTION_SCAN;
+    link.state = SENSOR_LINK_CONNECTING;
+    return SENSOR_ACTION_CONNECT;
+}
+
+void sensorLinkFound(SensorLink& link) {
+    if (link.hasDevice || (link.state != SENSOR_LINK_SEARCHING && link.state != SENSOR_LINK_BACKOFF)) return;
+    link.hasDevice = true;
+    link.state = SENSOR_LINK_SEARCHING; // Connect on the next pass, even mid-backoff
+}
+
+void sensorLinkConnected(SensorLink& link) {
+    link.state = SENSOR_LINK_CONNECTED;
+    link.failures = 0;
+    link.connects++;
+}
+
+void sensorLinkFailed(SensorLink& link, uint32_t nowMs) {
+    if (link.state == SENSOR_LINK_DISABLED) return;
+    if (link.failures < 255) link.failures++;
+    if (link.hasDevice && link.failures >= SENSOR_FORGET_AFTER) {
+        link.hasDevice = false; // Gone or replaced: search again, starting from a short wait
+        link.failures = 1;
+    }
+    link.state = SENSOR_LINK_BACKOFF;
+    link.nextAttemptMs = nowMs + sensorLinkBackoffMs(link.failures);
+}
+
+void sensorLinkDropped(SensorLink& link, uint32_t nowMs) {
+    if (link.state != SENSOR_LINK_CONNECTED) return;
+    link.drops++;
+    link.failures = 0;
+    link.state = SENSOR_LINK_BACKOFF;
+    link.nextAttemptMs = nowMs + SENSOR_RETRY_MIN_MS;
+}
+
+// --- Measurement Parsers ---
+bool sensorParseHeartRate(const uint8_t* data, size_t length, uint16_t& bpm) {
+    if (length < 2) return false;
+    uint8_t flags = data[0];
+    if ((flags & 0x06) == 0x04) return false; // Contact supported but not detected
+    if (flags & 0x01) {
+        if (length < 3) return false;
+        bpm = (uint16_t)(data[1] | (data[2] << 8));
+    } else {
+        bpm = data[1];
+    }
+    return true;
+}
+
+bool sensorParseCyclingPower(const uint8_t* data, size_t length, int16_t& powerW) {
+    if (length < 4) return false;
+    powerW = (int16_t)(data[2] | (data[3] << 8));
+    return true;
+}
+
+// --- Fusion ---
+void sensorFusionReset(SensorFusion& fusion) {
+    memset(&fusion, 0, sizeof(fusion));
+}
+
+static bool sampleFresh(int64_t sampleUs, int64_t frameUs) {
+    return sampleUs != 0 && frameUs - sampleUs <= (int64_t)SENSOR_MAX_AGE_MS * 1000;
+}
+
+void sensorFusionApply(const SensorFusion& fusion, TelemetryFrame& frame, int64_t frameUs) {
+    bool meterFresh = sampleFresh(fusion.meterPowerUs, frameUs);
+    if (meterFresh && (SENSOR_PREFER_METER_POWER || frame.bikePower == 0)) {
+        frame.power = fusion.meterPower;
+        frame.powerSource = TELEMETRY_SOURCE_METER;
+    } else {
+        frame.power = frame.bikePower;
+        frame.powerSource = TELEMETRY_SOURCE_BIKE;
+    }
+    frame.heartRate = sampleFresh(fusion.heartRateUs, frameUs) ? fusion.heartRate : 0;
+}
+
+void sensorMergeAndPublish(TelemetryFrame& frame) {
+    int64_t nowUs = esp_timer_get_time();
+    sensorFusionApply(sensorFusion, frame, nowUs);
+    if (rideSessionApply(frame, nowUs)) rideFilterRequestSessionReset(); // A new ride: session averages start over
+    rideFilterApply(frame, nowUs); // Averages of the merged power, not the bike's alone
+    telemetryPublish();
+}
+
+// --- Notification Callbacks (NimBLE host task) ---
+// Sensor samples are merged into the next bike frame; they are published on their own only so the
+// display follows them while the bike is idle. The forwarder is not woken for them.
+void heartRateNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    uint16_t bpm;
+    if (!sensorParseHeartRate(pData, length, bpm)) {
+        sensorFusion.heartRateUs = 0;
+    } else {
+        sensorFusion.heartRate = bpm > 255 ? 255 : (uint8_t)bpm; // 0x2ACC carries uint8
+        sensorFusion.heartRateUs = esp_timer_get_time();
+    }
+    TS_LOG_TOKEN(LOG_LEVEL_DEBUG, "[Sensor] HR %u BPM (len %u)", sensorFusion.heartRate, (unsigned)length);
+    sensorMergeAndPublish(telemetryBeginUpdate());
+}
+
+void cyclingPowerNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
+    int16_t powerW;
+    if (!sensorParseCyclingPower(pData, length, powerW)) return;
+    sensorFusion.meterPower = powerW > 0 ? (uint16_t)powerW : 0;
+    sensorFusion.meterPowerUs = esp_timer_get_time();
+    TS_LOG_TOKEN(LOG_LEVEL_DEBUG, "[Sensor] Meter %d W", powerW);
+    sensorMergeAndPublish(telemetryBeginUpdate());
+}
+
+static int sensorIndexForClient(NimBLEClient* pClient) {
+    for (int i = 0; i < SENSOR_LINK_COUNT; i++) {
+        if (sensorClients[i] == pClient) return i;
+    }
+    return -1;
+}
+
+class SensorClientCallbacks : public NimBLEClientCallbacks {
+public:
+    void onDisconnect(NimBLEClient* pClient) override {
+        int index = sensorIndexForClient(pClient);
+        if (index < 0) return;
+        portENTER_CRITICAL(&sensorLinksMux);
+        sensorLinkDropped(sensorLinks[index], millis());
+        portEXIT_CRITICAL(&sensorLinksMux);
+        ts_log_printf("[Sensor] %s sensor disconnected. Bike data continues; retrying in the background.", sensorNames[index]);
+        // Stop merging the lost source right away instead of waiting for it to go stale.
+        if (index == SENSOR_LINK_HEART_RATE) sensorFusion.heartRateUs = 0;
+        else sensorFusion.meterPowerUs = 0;
+        sensorMergeAndPublish(telemetryBeginUpdate());
+    }
+};
+static SensorClientCallbacks sensorClientCallbacks;
+
+// --- Discovery (scan callback, NimBLE host task) ---
+void sensorOnAdvertisement(NimBLEAdvertisedDevice* advertisedDevice) {
+    for (int i = 0; i < SENSOR_LINK_COUNT; i++) {
+        if (!advertisedDevice->isAdvertisingService(NimBLEUUID(sensorServices[i]))) continue;
+        // By text, so a filter matches random (static) addresses too
+        if (sensorAddressFilters[i][0] != '\0' &&
+            strcasecmp(advertisedDevice->getAddress().toString().c_str(), sensorAddressFilters[i]) != 0) continue;
+        bool found = false;
+        portENTER_CRITICAL(&sensorLinksMux);
+        if (!sensorLinks[i].hasDevice) {
+            sensorLinkFound(sensorLinks[i]);
+            found = sensorLinks[i].hasDevice;
+            if (found) sensorAddresses[i] = advertisedDevice->getAddress();
+        }
+        portEXIT_CRITICAL(&sensorLinksMux);
+        if (found) {
+            ts_log_printf("[Sensor] Found %s sensor: Name=%s, Addr=%s", sensorNames[i],
+                          advertisedDevice->getName().c_str(), advertisedDevice->getAddress().toString().c_str());
+        }
+    }
+}
+
+void sensorBegin() {
+    portENTER_CRITICAL(&sensorLinksMux);
+    sensorLinkInit(sensorLinks[SENSOR_LINK_HEART_RATE], SENSOR_HR_ENABLED);
+    sensorLinkInit(sensorLinks[SENSOR_LINK_POWER], SENSOR_POWER_ENABLED);
+    portEXIT_CRITICAL(&sensorLinksMux);
+    sensorFusionReset(sensorFusion);
+}
+
+void sensorGetLinks(SensorLink* out) {
+    portENTER_CRITICAL(&sensorLinksMux);
+    memcpy(out, sensorLinks, sizeof(sensorLinks));
+    portEXIT_CRITICAL(&sensorLinksMux);
+}
+
+// --- Sensor Task ---
+static bool subscribeSensor(int index, NimBLEClient* pClient) {
+    uint16_t measurementUuid = index == SENSOR_LINK_HEART_RATE ? HEART_RATE_MEASUREMENT_UUID_SHORT : CYCLING_POWER_MEASUREMENT_UUID_SHORT;
+    NimBLERemoteService* pService = pClient->getService(NimBLEUUID(sensorServices[index]));
+    NimBLERemoteCharacteristic* pMeasurement = pService ? pService->getCharacteristic(NimBLEUUID(measurementUuid)) : nullptr;
+    if (pMeasurement == nullptr || !pMeasurement->canNotify()) {
+        ts_log_error("[Sensor] %s sensor has no notifiable measurement (0x%04X).", sensorNames[index], measurementUuid);
+        return false;
+    }
+    return pMeasurement->subscribe(true, index == SENSOR_LINK_HEART_RATE ? heartRateNotificationCallback
+                                                                          : cyclingPowerNotificationCallback, false);
+}
+
+static void connectSensor(int index) {
+    NimBLEAddress address;
+    portENTER_CRITICAL(&sensorLinksMux);
+    address = sensorAddresses[index];
+    portEXIT_CRITICAL(&sensorLinksMux);
+
+    if (sensorClients[index] == nullptr) {
+        sensorClients[index] = NimBLEDevice::createClient();
+        if (sensorClients[index] == nullptr) {
+            ts_log_error("[Sensor] Failed to create %s client (connection limit?).", sensorNames[index]);
+            portENTER_CRITICAL(&sensorLinksMux);
+            sensorLinkFailed(sensorLinks[index], millis());
+            portEXIT_CRITICAL(&sensorLinksMux);
+            return;
+        }
+        sensorClients[index]->setClientCallbacks(&sensorClientCallbacks, false);
+        sensorClients[index]->setConnectTimeout(SENSOR_CONNECT_TIMEOUT_S);
+        // On the link manager's 15 ms grid (link_manager.h), next to the bike and app links.
+        sensorClients[index]->setConnectionParams(LINK_SENSOR_INTERVAL, LINK_SENSOR_INTERVAL, 0, LINK_SUPERVISION_TIMEOUT);
+    }
+    NimBLEClient* pClient = sensorClients[index];
+
+    ts_log_printf("[Sensor] Connecting to %s sensor %s...", sensorNames[index], address.toString().c_str());
+    bool connected = pClient->connect(address) && subscribeSensor(index, pClient);
+    if (!connected && pClient->isConnected()) pClient->disconnect();
+
+    portENTER_CRITICAL(&sensorLinksMux);
+    if (connected) sensorLinkConnected(sensorLinks[index]);
+    else sensorLinkFailed(sensorLinks[index], millis());
+    SensorLink link = sensorLinks[index];
+    portEXIT_CRITICAL(&sensorLinksMux);
+
+    if (connected) {
+        ts_log_printf("[Sensor] %s sensor connected (connect #%lu).", sensorNames[index], (unsigned long)link.connects);
+    } else {
+        ts_log_printf("[Sensor] %s sensor connect failed (%u in a row); next try in %lu ms%s.", sensorNames[index],
+                      link.failures, (unsigned long)(link.nextAttemptMs - millis()), link.hasDevice ? "" : ", searching again");
+    }
+}
+
+// One discovery scan serves every searching link; sensorOnAdvertisement marks what it finds.
+static void scanForSensors() {
+    NimBLEScan* pScan = NimBLEDevice::getScan();
+    pScan->setAdvertisedDeviceCallbacks(&myAdvertisedDeviceCallbacks_global, false);
+    pScan->setActiveScan(true);
+    pScan->setInterval(100); // Not the bike link's background settings: sensors are not on the white list
+    pScan->setWindow(99);
+    pScan->setFilterPolicy(BLE_HCI_SCAN_FILT_NO_WL);
+    pScan->start(SENSOR_SCAN_SECONDS, false); // Blocks this task only
+    pScan->clearResults();
+
+    portENTER_CRITICAL(&sensorLinksMux);
+    for (int i = 0; i < SENSOR_LINK_COUNT; i++) {
+        if (sensorLinks[i].state == SENSOR_LINK_SEARCHING && !sensorLinks[i].hasDevice) {
+            sensorLinkFailed(sensorLinks[i], millis());
+        }
+    }
+    portEXIT_CRITICAL(&sensorLinksMux);
+}
+
+// Runs each sensor's retry policy. Scans and connects wait while the bike is scanning or connecting,
+// and run here rather than in the NimBLE host task, so a missing sensor never delays bike data.
+void sensorTask_func(void *pvParameters) {
+    ts_log_printf("[Sensor:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+    int linksNeeded = 1 + APP_SESSION_MAX + SENSOR_HR_ENABLED + SENSOR_POWER_ENABLED;
+    if (CONFIG_BT_NIMBLE_MAX_CONNECTIONS < linksNeeded) {
+        ts_log_error("[Sensor] CONFIG_BT_NIMBLE_MAX_CONNECTIONS is %d but bike + apps + sensors need %d; sensors may not connect.",
+                     CONFIG_BT_NIMBLE_MAX_CONNECTIONS, linksNeeded);
+    }
+#endif
+
+    while (1) {
+        for (int i = 0; i < SENSOR_LINK_COUNT; i++) {
+            NimBLEScan* pScan = NimBLEDevice::getScan();
+            bool centralBusy = bikeClientBusy() || bikeAttemptingConnection || pScan->isScanning();
+            portENTER_CRITICAL(&sensorLinksMux);
+            uint8_t action = sensorLinkNext(sensorLinks[i], millis(), centralBusy);
+            portEXIT_CRITICAL(&sensorLinksMux);
+
+            if (action == SENSOR_ACTION_SCAN) scanForSensors();
+            else if (action == SENSOR_ACTION_CONNECT) connectSensor(i);
+        }
+        vTaskDelay(pdMS_TO_TICKS(SENSOR_TASK_PERIOD_MS));
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef SENSOR_LINKS_H
+#define SENSOR_LINKS_H
+
+#include <NimBLEDevice.h>
+#include "config.h"
+#include "logger.h"
+#include "telemetry.h"
+
+// --- Global Variables related to Sensor Links (defined in .ino) ---
+extern TaskHandle_t sensorTaskHandle;
+
+// --- Standard Sensor UUIDs (16-bit) ---
+#define HEART_RATE_SERVICE_UUID_SHORT     0x180D
+#define HEART_RATE_MEASUREMENT_UUID_SHORT 0x2A37
+#define CYCLING_POWER_SERVICE_UUID_SHORT  0x1818
+#define CYCLING_POWER_MEASUREMENT_UUID_SHORT 0x2A63
+
+// --- Sensor Links (Central Role, one NimBLE client each) ---
+#define SENSOR_LINK_HEART_RATE 0
+#define SENSOR_LINK_POWER      1
+#define SENSOR_LINK_COUNT      2
+
+#define SENSOR_LINK_DISABLED   0 // Not enabled in config.h
+#define SENSOR_LINK_SEARCHING  1 // No device yet: discovery scan
+#define SENSOR_LINK_CONNECTING 2
+#define SENSOR_LINK_CONNECTED  3
+#define SENSOR_LINK_BACKOFF    4 // Waiting for nextAttemptMs
+
+#define SENSOR_ACTION_NONE    0
+#define SENSOR_ACTION_SCAN    1
+#define SENSOR_ACTION_CONNECT 2
+
+// Retry policy of one link. Only the sensor task changes it; every link retries on its own clock,
+// so a strap that drops out never holds up the bike or another sensor.
+struct SensorLink {
+    uint8_t  state;         // SENSOR_LINK_*
+    bool     hasDevice;     // Address known (from a discovery scan)
+    uint8_t  failures;      // Consecutive failed scans/connects: the backoff doubles with each
+    uint32_t nextAttemptMs;
+    uint32_t connects;
+    uint32_t drops;
+};
+
+void sensorLinkInit(SensorLink& link, bool enabled);
+// What to do now. centralBusy: the bike is scanning or connecting, so neither may start.
+uint8_t sensorLinkNext(SensorLink& link, uint32_t nowMs, bool centralBusy);
+void sensorLinkFound(SensorLink& link);                    // Discovery saw a matching device
+void sensorLinkConnected(SensorLink& link);
+void sensorLinkFailed(SensorLink& link, uint32_t nowMs);   // Scan found nothing or connect failed
+void sensorLinkDropped(SensorLink& link, uint32_t nowMs);  // Was connected
+uint32_t sensorLinkBackoffMs(uint8_t failures);
+
+// --- Measurement Parsers ---
+// Heart Rate Measurement (0x2A37). False if malformed or the strap reports no skin contact.
+bool sensorParseHeartRate(const uint8_t* data, size_t length, uint16_t& bpm);
+// Cycling Power Measurement (0x2A63): flags, then the instantaneous power (sint16, W).
+bool sensorParseCyclingPower(const uint8_t* data, size_t length, int16_t& powerW);
+
+// --- Fusion ---
+// Latest sample of each sensor with its arrival time. Merged into every published frame: a source is
+// used only while its sample is at most SENSOR_MAX_AGE_MS older than the frame.
+struct SensorFusion {
+    int64_t  heartRateUs;   // 0 = none
+    uint8_t  heartRate;
+    int64_t  meterPowerUs;  // 0 = none
+    uint16_t meterPower;
+};
+
+void sensorFusionReset(SensorFusion& fusion);
+// Sets frame.power / powerSource from frame.bikePower and the meter (priority: SENSOR_PREFER_METER_POWER)
+// and frame.heartRate from the strap.
+void sensorFusionApply(const SensorFusion& fusion, TelemetryFrame& frame, int64_t frameUs);
+
+// --- Bridge Hooks ---
+void sensorBegin();
+// Merges the sensors into the staged bike fields, updates the ride filter and publishes the frame
+// (NimBLE host task, bike notifications).
+void sensorMergeAndPublish(TelemetryFrame& frame);
+void sensorOnAdvertisement(NimBLEAdvertisedDevice* advertisedDevice); // Every scan result (bike or sensor scan)
+void sensorGetLinks(SensorLink* out); // SENSOR_LINK_COUNT entries
+void sensorTask_func(void *pvParameters);
+
+// Notification callbacks (NimBLE host task)
+void heartRateNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+void cyclingPowerNotificationCallback(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+
+#endif // SENSOR_LINKS_H
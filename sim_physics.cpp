@@ -0,0 +1,89 @@
+#define LOG_MODULE LOG_MOD_SIM
+#include "sim_physics.h"
+#include "ftms_control_point.h"
+#include "ble_peripheral_manager.h"
+#include "stepper_motion.h"
+
+// Bike torque model in mNm (same constants as the ERG controller).
+static const int32_t SIM_TORQUE_BASE_MNM = (int32_t)(ERG_TORQUE_BASE_NM * 1000.0f);
+static const int32_t SIM_TORQUE_PER_LEVEL_MNM = (int32_t)(ERG_TORQUE_PER_LEVEL_NM * 1000.0f);
+static const int32_t SIM_LEVEL_MIN_X100 = (int32_t)(ERG_LEVEL_MIN * 100.0f);
+static const int32_t SIM_LEVEL_MAX_X100 = (int32_t)(ERG_LEVEL_MAX * 100.0f);
+static const int64_t SIM_GRAVITY_MM_S2 = 9807;
+
+int32_t simRequiredPowerMilliwatts(const SimParams& params, uint16_t speed) {
+    // Units: speed mm/s, forces mN. 0.01 km/h = 10 m / 3600 s = 1/360 m/s = 25/9 mm/s.
+    int64_t speedMmS = (int64_t)speed * 25 / 9;
+    int64_t airMmS = speedMmS + params.windSpeed;
+
+    // sin(atan(g)) and cos(atan(g)) to second order: g * (1 - g^2/2) and 1 - g^2/2, in 1e-4 units.
+    int64_t grade = params.grade;
+    int64_t cosX1e4 = 10000 - grade * grade / 20000;
+    int64_t sinX1e4 = grade * cosX1e4 / 10000;
+
+    // m[g] * g[mm/s2] = uN; * sin[1e-4] -> mN: / 1e7; * Crr[1e-4] * cos[1e-4] -> mN: / 1e11
+    int64_t weightUn = (int64_t)params.massGrams * SIM_GRAVITY_MM_S2;
+    int64_t gravityMn = weightUn * sinX1e4 / 10000000;
+    int64_t rollingMn = weightUn * params.rollingResistance * cosX1e4 / 100000000000LL;
+    // Cw[0.01 kg/m] * v^2[mm2/s2] -> mN: * 1e-2 * 1e-6 * 1e3
+    int64_t airMn = (int64_t)params.windResistance * airMmS * (airMmS < 0 ? -airMmS : airMmS) / 100000;
+
+    // mN * mm/s = uW
+    return (int32_t)((gravityMn + rollingMn + airMn) * speedMmS / 1000);
+}
+
+int32_t simLevelX100(int32_t powerMw, uint16_t cadence) {
+    // Crank speed in mrad/s: cadence/2 RPM * 2*pi/60 * 1000 = cadence * 52.3599
+    int32_t omegaMradS = (int32_t)((int64_t)cadence * 523599 / 10000);
+    if (omegaMradS <= 0) return -1;
+    int32_t torqueMnm = (int32_t)((int64_t)powerMw * 1000 / omegaMradS);
+    int32_t levelX100 = (torqueMnm - SIM_TORQUE_BASE_MNM) * 100 / SIM_TORQUE_PER_LEVEL_MNM;
+    if (levelX100 < SIM_LEVEL_MIN_X100) return SIM_LEVEL_MIN_X100;
+    if (levelX100 > SIM_LEVEL_MAX_X100) return SIM_LEVEL_MAX_X100;
+    return levelX100;
+}
+
+uint8_t simQuantizeLevel(int32_t levelX100, uint8_t previous) {
+    uint8_t level = (uint8_t)((levelX100 + 50) / 100);
+    if (previous > 0 && level != previous) {
+        int32_t distance = levelX100 - previous * 100;
+        if (distance < 0) distance = -distance;
+        if (distance < 50 + SIM_LEVEL_HYSTERESIS_X100) return previous;
+    }
+    return level;
+}
+
+// --- simulationOnSample Implementation (forwarder task, every fresh bike sample) ---
+void simulationOnSample(const TelemetryFrame& frame) {
+    FtmsControlTargets targets;
+    ftmsGetControlTargets(targets);
+
+    SimParams params;
+    params.massGrams = (SIM_RIDER_MASS_KG + SIM_BIKE_MASS_KG) * 1000;
+    if (targets.controlMode == FTMS_CONTROL_MODE_SIMULATION) {
+        params.windSpeed = targets.windSpeed;
+        params.grade = targets.grade;
+        params.rollingResistance = targets.rollingResistance;
+        params.windResistance = targets.windResistance;
+    } else if (targets.controlMode == FTMS_CONTROL_MODE_INCLINATION) {
+        params.windSpeed = 0;
+        params.grade = targetInclinationPercentX100;
+        params.rollingResistance = SIM_DEFAULT_CRR;
+        params.windResistance = SIM_DEFAULT_CW;
+    } else {
+        return;
+    }
+    params.grade = (int16_t)((int32_t)params.grade * SIM_GRADE_SCALE_PERCENT / 100);
+
+    int32_t powerMw = simRequiredPowerMilliwatts(params, frame.speed);
+    int32_t levelX100 = simLevelX100(powerMw, frame.cadence);
+    if (levelX100 < 0) return; // Not pedalling: keep the current level
+
+    uint8_t level = simQuantizeLevel(levelX100, targetResistanceLevel_App);
+    if (level != targetResistanceLevel_App) {
+        targetResistanceLevel_App = level;
+        motionRequestLevel(level);
+        ts_log_debug("[Sim] Grade %d (x0.01%%), %u (x0.01 km/h): road load %ld mW -> level %ld/100 -> %u",
+                     params.grade, frame.speed, (long)powerMw, (long)levelX100, level);
+    }
+}
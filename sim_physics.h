@@ -0,0 +1,34 @@
+#ifndef SIM_PHYSICS_H
+#define SIM_PHYSICS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+#include "telemetry.h"
+
+// --- Simulation Parameters (FTMS units, as received in Control Point 0x11) ---
+struct SimParams {
+    int16_t  windSpeed;          // 0.001 m/s, positive = headwind
+    int16_t  grade;              // 0.01 %
+    uint8_t  rollingResistance;  // Crr, 0.0001
+    uint8_t  windResistance;     // Cw, 0.01 kg/m (= 0.5 * air density * CdA)
+    uint32_t massGrams;          // Rider + bike
+};
+
+// --- Fixed-Point Model (integer only; cheap enough for every bike sample) ---
+// Power needed to hold 'speed' (0.01 km/h): (gravity + rolling + air) * v, with the slope angle
+// to second order (within 0.1 % up to 20 % grade). Negative (descending) power is returned as is.
+int32_t simRequiredPowerMilliwatts(const SimParams& params, uint16_t speed);
+// Resistance level (x100) whose crank torque delivers powerMw at 'cadence' (0.5 RPM), using the
+// bike torque model shared with ERG (ERG_TORQUE_BASE_NM / ERG_TORQUE_PER_LEVEL_NM). Clamped to the
+// ERG level range; returns -1 when the rider is not pedalling.
+int32_t simLevelX100(int32_t powerMw, uint16_t cadence);
+// Whole level with SIM_LEVEL_HYSTERESIS_X100 of hysteresis around 'previous' (0 = none yet).
+uint8_t simQuantizeLevel(int32_t levelX100, uint8_t previous);
+
+// --- Bridge Hook (defined in sim_physics.cpp) ---
+// Called for every fresh bike sample. In simulation (0x11) or inclination (0x03) mode, sets
+// targetResistanceLevel_App from the simulated road load.
+void simulationOnSample(const TelemetryFrame& frame);
+
+#endif // SIM_PHYSICS_H
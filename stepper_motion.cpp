@@ -0,0 +1,317 @@
+#define LOG_MODULE LOG_MOD_MOTION
+#include "stepper_motion.h"
+#include "resistance_calibration.h"
+#include "bike_driver.h"
+
+static QueueHandle_t motionQueue = NULL;
+static volatile uint32_t motionDropCount = 0;
+static uint32_t motionCommandCount = 0;
+
+// Shared by the motion task and the step timer ISR.
+static portMUX_TYPE stepperMux = portMUX_INITIALIZER_UNLOCKED;
+static StepperPlanner stepperPlanner;
+static hw_timer_t* stepTimer = NULL;
+static volatile bool stepTimerRunning = false;
+static volatile bool stepPinHigh = false;
+static volatile uint32_t stepPulseCount = 0;
+
+// --- Planner ---
+void stepperDefaultConfig(StepperConfig& config) {
+    config.maxSpeedSps = STEPPER_MAX_SPEED_SPS;
+    config.accelSps2 = STEPPER_ACCEL_SPS2;
+    config.homingSpeedSps = STEPPER_HOMING_SPEED_SPS;
+    config.minPosition = 0;
+    config.maxPosition = STEPPER_TRAVEL_STEPS;
+    config.homingMaxSteps = STEPPER_HOMING_MAX_STEPS;
+}
+
+void stepperPlannerInit(StepperPlanner& planner, const StepperConfig& config) {
+    memset(&planner, 0, sizeof(planner));
+    // The first interval carries Austin's 0.676 correction for the real (not discrete) ramp start.
+    planner.firstIntervalQ8 = (uint32_t)(0.676f * sqrtf(2.0f / config.accelSps2) * 1e6f * 256.0f);
+    planner.minIntervalQ8 = (uint32_t)(1e6f / config.maxSpeedSps * 256.0f);
+    planner.homingIntervalQ8 = (uint32_t)(1e6f / config.homingSpeedSps * 256.0f);
+    planner.minPosition = config.minPosition;
+    planner.maxPosition = config.maxPosition;
+    planner.homingMaxSteps = config.homingMaxSteps;
+    planner.direction = 1;
+    planner.state = STEPPER_STATE_IDLE;
+}
+
+static int32_t clampPosition(const StepperPlanner& planner, int32_t position) {
+    if (position < planner.minPosition) return planner.minPosition;
+    if (position > planner.maxPosition) return planner.maxPosition;
+    return position;
+}
+
+static void beginHoming(StepperPlanner& planner) {
+    planner.homePending = false;
+    planner.state = STEPPER_STATE_HOMING;
+    planner.homingStepsLeft = planner.homingMaxSteps;
+    planner.rampSteps = 0;
+}
+
+static void decelerateToRest(StepperPlanner& planner) {
+    int32_t stepsToStop = planner.rampSteps < 0 ? -planner.rampSteps : planner.rampSteps;
+    planner.target = planner.position + planner.direction * stepsToStop;
+}
+
+void stepperPlannerMoveTo(StepperPlanner& planner, int32_t target) {
+    target = clampPosition(planner, target);
+    if (planner.homePending || planner.state == STEPPER_STATE_HOMING) {
+        planner.homeTarget = target; // Applied once homing has set the origin
+        return;
+    }
+    planner.target = target;
+    if (planner.state == STEPPER_STATE_IDLE) planner.state = STEPPER_STATE_RUNNING;
+}
+
+void stepperPlannerStop(StepperPlanner& planner) {
+    planner.homePending = false;
+    if (planner.state == STEPPER_STATE_HOMING) {
+        // Homing runs at a constant, start/stop-safe speed: abort on the spot (still not homed).
+        planner.state = STEPPER_STATE_RUNNING;
+        planner.rampSteps = 0;
+        planner.target = planner.position;
+        return;
+    }
+    decelerateToRest(planner);
+}
+
+void stepperPlannerHome(StepperPlanner& planner) {
+    planner.homeTarget = 0;
+    if (planner.state == STEPPER_STATE_IDLE) {
+        beginHoming(planner);
+    } else if (planner.state == STEPPER_STATE_RUNNING) {
+        planner.homePending = true;
+        decelerateToRest(planner);
+    } else {
+        planner.homingStepsLeft = planner.homingMaxSteps;
+    }
+}
+
+static uint32_t IRAM_ATTR wholeMicroseconds(StepperPlanner& planner, uint32_t intervalQ8) {
+    uint32_t total = intervalQ8 + planner.remainderQ8;
+    planner.remainderQ8 = total & 0xFF;
+    return total >> 8;
+}
+
+uint32_t IRAM_ATTR stepperPlannerNext(StepperPlanner& planner, bool homeSwitch) {
+    if (planner.state == STEPPER_STATE_HOMING) {
+        if (!homeSwitch && planner.homingStepsLeft > 0) {
+            planner.homingStepsLeft--;
+            planner.direction = -1;
+            planner.position--;
+            return wholeMicroseconds(planner, planner.homingIntervalQ8);
+        }
+        // At the switch, or far enough to be against the stop: this is the origin.
+        planner.position = 0;
+        planner.target = planner.homeTarget;
+        planner.rampSteps = 0;
+        planner.homed = true;
+        planner.state = STEPPER_STATE_RUNNING;
+    }
+    if (planner.state == STEPPER_STATE_IDLE) return 0;
+
+    int32_t distance = planner.target - planner.position;
+    int32_t n = planner.rampSteps;
+    if (distance == 0 && n >= -1 && n <= 1) {
+        planner.rampSteps = 0;
+        if (planner.homePending) {
+            beginHoming(planner);
+            return stepperPlannerNext(planner, homeSwitch);
+        }
+        planner.state = STEPPER_STATE_IDLE;
+        return 0;
+    }
+
+    // Distance left in the current direction of travel (<= 0: target is behind us).
+    int32_t ahead = distance * planner.direction;
+    if (n > 0 && ahead <= n) {
+        n = -n;                 // Start braking: stops exactly on target, or at rest before reversing
+    } else if (n < 0 && ahead > -n) {
+        n = -n;                 // Target moved further away while braking: accelerate again
+    }
+
+    uint32_t interval;
+    if (n == 0) {
+        planner.direction = distance > 0 ? 1 : -1;
+        interval = planner.firstIntervalQ8 > planner.minIntervalQ8 ? planner.firstIntervalQ8 : planner.minIntervalQ8;
+        n = 1;
+    } else {
+        int32_t c = (int32_t)planner.intervalQ8;
+        c -= 2 * c / (4 * n + 1);
+        if (n > 0 && c <= (int32_t)planner.minIntervalQ8) {
+            interval = planner.minIntervalQ8; // Cruising: n stays at the ramp length (= steps to stop)
+        } else {
+            interval = (uint32_t)c;
+            n++;
+        }
+    }
+    planner.rampSteps = n;
+    planner.intervalQ8 = interval;
+    planner.position += planner.direction;
+    return wholeMicroseconds(planner, interval);
+}
+
+// --- Step Timer ISR ---
+// Two alarms per step: the rising edge, then STEPPER_PULSE_US later the falling edge, where the
+// planner schedules the next step and DIR is set up for it. With auto-reload, each alarm interval
+// is measured from the previous alarm, so ISR latency does not accumulate.
+static bool IRAM_ATTR homeSwitchActive() {
+    return STEPPER_HOME_PIN >= 0 && digitalRead(STEPPER_HOME_PIN) == LOW;
+}
+
+static void IRAM_ATTR scheduleStep(uint32_t intervalUs) {
+    digitalWrite(STEPPER_DIR_PIN, stepperPlanner.direction > 0 ? HIGH : LOW);
+    if (intervalUs < 2 * STEPPER_PULSE_US) intervalUs = 2 * STEPPER_PULSE_US;
+    timerAlarmWrite(stepTimer, intervalUs - STEPPER_PULSE_US, true);
+}
+
+static void IRAM_ATTR stepTimerIsr() {
+    portENTER_CRITICAL_ISR(&stepperMux);
+    if (!stepPinHigh) {
+        digitalWrite(STEPPER_STEP_PIN, HIGH);
+        stepPinHigh = true;
+        stepPulseCount++;
+        timerAlarmWrite(stepTimer, STEPPER_PULSE_US, true);
+    } else {
+        digitalWrite(STEPPER_STEP_PIN, LOW);
+        stepPinHigh = false;
+        uint32_t intervalUs = stepperPlannerNext(stepperPlanner, homeSwitchActive());
+        if (intervalUs == 0) {
+            timerAlarmDisable(stepTimer);
+            stepTimerRunning = false;
+        } else {
+            scheduleStep(intervalUs);
+        }
+    }
+    portEXIT_CRITICAL_ISR(&stepperMux);
+}
+
+// Starts the step timer if the planner has work and it is not already running. Caller holds stepperMux.
+static void kickStepTimer() {
+    if (stepTimerRunning || stepTimer == NULL) return;
+    uint32_t intervalUs = stepperPlannerNext(stepperPlanner, homeSwitchActive());
+    if (intervalUs == 0) return;
+    stepTimerRunning = true;
+    timerWrite(stepTimer, 0);
+    scheduleStep(intervalUs);
+    timerAlarmEnable(stepTimer);
+}
+
+// --- Requests (any task) ---
+static void postCommand(uint8_t type, int32_t target) {
+    if (motionQueue == NULL) return; // No motor fitted (STEPPER_ENABLED 0)
+    MotionCommand command = {type, target};
+    if (xQueueSend(motionQueue, &command, 0) != pdPASS) {
+        motionDropCount++;
+        ts_log_warn("[Motion] Command queue full: command %u dropped.", type);
+    }
+}
+
+int32_t motionLevelToSteps(float level) {
+    int32_t steps;
+    if (calibrationLevelToSteps(level, steps)) return steps;
+    return STEPPER_STEPS_AT_LEVEL_MIN + (int32_t)lroundf((level - ERG_LEVEL_MIN) * STEPPER_STEPS_PER_LEVEL);
+}
+
+void motionRequestLevel(float level) {
+    if (level < ERG_LEVEL_MIN) return; // 0 = no target from the app: leave the knob where it is
+    if (bikeDriverRequestLevel(level)) return; // The bike takes the level over BLE (bike_driver.h)
+    if (calibrationActive()) return;   // The sweep owns the knob; it returns to the app's target when done
+    postCommand(MOTION_CMD_MOVE_TO, motionLevelToSteps(level));
+}
+
+void motionRequestPosition(int32_t steps) {
+    postCommand(MOTION_CMD_MOVE_TO, steps);
+}
+
+void motionRequestStop() {
+    postCommand(MOTION_CMD_STOP, 0);
+}
+
+void motionRequestHome() {
+    postCommand(MOTION_CMD_HOME, 0);
+}
+
+void motionGetStatus(MotionStatus& out) {
+    portENTER_CRITICAL(&stepperMux);
+    out.position = stepperPlanner.position;
+    out.target = stepperPlanner.target;
+    out.state = stepperPlanner.state;
+    out.homed = stepperPlanner.homed;
+    out.pulses = stepPulseCount;
+    portEXIT_CRITICAL(&stepperMux);
+    out.commands = motionCommandCount;
+    out.dropped = motionDropCount;
+}
+
+bool motionBegin() {
+    if (motionQueue == NULL) {
+        motionQueue = xQueueCreate(STEPPER_QUEUE_DEPTH, sizeof(MotionCommand));
+    }
+    if (motionQueue == NULL) {
+        ts_log_error("[Motion] FAILED to create command queue.");
+        return false;
+    }
+
+    StepperConfig config;
+    stepperDefaultConfig(config);
+    stepperPlannerInit(stepperPlanner, config);
+
+    pinMode(STEPPER_STEP_PIN, OUTPUT);
+    pinMode(STEPPER_DIR_PIN, OUTPUT);
+    digitalWrite(STEPPER_STEP_PIN, LOW);
+    if (STEPPER_ENABLE_PIN >= 0) {
+        pinMode(STEPPER_ENABLE_PIN, OUTPUT);
+        digitalWrite(STEPPER_ENABLE_PIN, LOW); // Enabled; holding torque keeps the knob in place
+    }
+    if (STEPPER_HOME_PIN >= 0) pinMode(STEPPER_HOME_PIN, INPUT_PULLUP);
+
+    if (stepTimer == NULL) {
+        stepTimer = timerBegin(STEPPER_TIMER, 80, true); // 80 MHz APB / 80 = 1 us ticks
+        if (stepTimer == NULL) {
+            ts_log_error("[Motion] FAILED to start step timer %d.", STEPPER_TIMER);
+            return false;
+        }
+        // The interrupt is allocated on the calling core.
+        timerAttachInterrupt(stepTimer, &stepTimerIsr, true);
+    }
+    ts_log_printf("[Motion] Step timer %d on core %d: max %.0f steps/s, accel %.0f steps/s^2, travel %ld steps.",
+                  STEPPER_TIMER, xPortGetCoreID(), config.maxSpeedSps, config.accelSps2, (long)config.maxPosition);
+    return true;
+}
+
+// --- motionTask_func Implementation ---
+// Applies queued commands to the planner and starts the step timer; the ISR does the rest.
+void motionTask_func(void *pvParameters) {
+    ts_log_printf("[Motion:%s] Task started on core %d.", pcTaskGetName(NULL), xPortGetCoreID());
+
+    if (STEPPER_HOME_ON_BOOT) motionRequestHome();
+    int32_t lastTarget = -1;
+    MotionCommand command;
+    while (1) {
+        if (xQueueReceive(motionQueue, &command, portMAX_DELAY) != pdPASS) continue;
+
+        portENTER_CRITICAL(&stepperMux);
+        switch (command.type) {
+            case MOTION_CMD_MOVE_TO:
+                stepperPlannerMoveTo(stepperPlanner, command.target);
+                break;
+            case MOTION_CMD_STOP:
+                stepperPlannerStop(stepperPlanner);
+                break;
+            case MOTION_CMD_HOME:
+                stepperPlannerHome(stepperPlanner);
+                if (lastTarget >= 0) stepperPlannerMoveTo(stepperPlanner, lastTarget); // Return after homing
+                break;
+        }
+        kickStepTimer();
+        portEXIT_CRITICAL(&stepperMux);
+
+        if (command.type == MOTION_CMD_MOVE_TO) lastTarget = command.target;
+        motionCommandCount++;
+        ts_log_debug("[Motion] Command %u (target %ld steps).", command.type, (long)command.target);
+    }
+}
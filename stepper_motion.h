@@ -0,0 +1,96 @@
+#ifndef STEPPER_MOTION_H
+#define STEPPER_MOTION_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Global Variables related to the Knob Motor (defined in .ino) ---
+extern TaskHandle_t motionTaskHandle;
+
+// --- Motion Planner (pure; integer only so it can run in the step timer ISR) ---
+// Trapezoidal profile: each step interval follows c(n) = c(n-1) - 2*c(n-1) / (4n + 1) (D. Austin,
+// "Generate stepper-motor speed profiles in real time"), n > 0 while accelerating or cruising and
+// n < 0 while decelerating. |n| is the number of steps needed to stop, so a new target, a reversal
+// or a cancel always decelerates within the acceleration limit instead of stopping dead.
+#define STEPPER_STATE_IDLE    0
+#define STEPPER_STATE_RUNNING 1
+#define STEPPER_STATE_HOMING  2
+
+struct StepperConfig {
+    float maxSpeedSps;          // Steps/s
+    float accelSps2;            // Steps/s^2
+    float homingSpeedSps;       // Constant speed toward the home stop
+    int32_t minPosition;        // Soft limits for move targets (steps from home)
+    int32_t maxPosition;
+    int32_t homingMaxSteps;     // Travel before homing assumes it is against the stop (no switch)
+};
+
+struct StepperPlanner {
+    int32_t position;           // Steps from home, including the step already scheduled
+    int32_t target;
+    int32_t rampSteps;          // n above
+    uint32_t intervalQ8;        // Current step interval, us * 256
+    uint32_t remainderQ8;       // Fraction of a us carried to the next step, so whole-us timer alarms average out
+    uint32_t firstIntervalQ8;   // c0 = 0.676 * sqrt(2 / accel)
+    uint32_t minIntervalQ8;     // 1 / maxSpeed
+    uint32_t homingIntervalQ8;
+    int32_t minPosition;
+    int32_t maxPosition;
+    int32_t homingMaxSteps;
+    int32_t homingStepsLeft;
+    int32_t homeTarget;         // Target once homing has set the origin
+    int8_t direction;           // Of the scheduled step: +1 / -1
+    uint8_t state;              // STEPPER_STATE_*
+    bool homePending;           // Home once the current move has come to rest
+    bool homed;
+};
+
+void stepperDefaultConfig(StepperConfig& config); // From config.h
+void stepperPlannerInit(StepperPlanner& planner, const StepperConfig& config);
+// New target (clamped to the soft limits). Takes effect at the next step; a move in the opposite
+// direction decelerates to rest first.
+void stepperPlannerMoveTo(StepperPlanner& planner, int32_t target);
+// Cancels the move: decelerates to rest as soon as the acceleration limit allows.
+void stepperPlannerStop(StepperPlanner& planner);
+// Drives toward the home stop at homing speed, then sets position 0 and resumes the target.
+// If a move is running it is stopped first.
+void stepperPlannerHome(StepperPlanner& planner);
+// Schedules the next step: returns the interval in us before it (0 = nothing to do, now idle) and
+// sets planner.direction. Call once at start and after every step. homeSwitch: home stop reached.
+uint32_t stepperPlannerNext(StepperPlanner& planner, bool homeSwitch);
+
+// --- Motion Subsystem (step timer + queue) ---
+// Step pulses come from a hardware timer ISR, so they do not depend on what the NimBLE host task
+// or updateDisplay() is doing. Targets reach the ISR only through the motion queue.
+#define MOTION_CMD_MOVE_TO 0
+#define MOTION_CMD_STOP    1
+#define MOTION_CMD_HOME    2
+
+struct MotionCommand {
+    uint8_t type;               // MOTION_CMD_*
+    int32_t target;             // Steps, for MOTION_CMD_MOVE_TO
+};
+
+struct MotionStatus {
+    int32_t position;
+    int32_t target;
+    uint8_t state;              // STEPPER_STATE_*
+    bool homed;
+    uint32_t pulses;            // STEP pulses since boot
+    uint32_t commands;          // Commands applied
+    uint32_t dropped;           // Commands lost to a full queue
+};
+
+bool motionBegin();             // Queue, pins and step timer. Call from setup(): the ISR runs on that core.
+void motionTask_func(void *pvParameters);
+// Resistance level (ERG_LEVEL_MIN..ERG_LEVEL_MAX) -> knob position. Never blocks; safe from any task.
+void motionRequestLevel(float level);
+void motionRequestPosition(int32_t steps); // Raw knob position (calibration)
+void motionRequestStop();
+void motionRequestHome();
+// From the calibration map when there is one, else STEPPER_STEPS_AT_LEVEL_MIN / STEPPER_STEPS_PER_LEVEL.
+int32_t motionLevelToSteps(float level);
+void motionGetStatus(MotionStatus& out);
+
+#endif // STEPPER_MOTION_H
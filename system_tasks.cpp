@@ -0,0 +1,295 @@
+#define LOG_MODULE LOG_MOD_SYSTEM
+#include "system_tasks.h"
+#include "ble_peripheral_manager.h"
+#include "ble_client_manager.h"
+#include "bike_driver.h"
+#include "bike_link.h"
+#include "ftms_forwarder.h"
+#include "ftms_control_point.h"
+#include "erg_controller.h"
+#include "link_manager.h"
+#include "sensor_links.h"
+#include "stepper_motion.h"
+#include "resistance_calibration.h"
+
+// --- Layout ---
+struct SystemTaskSpec {
+    const char*    name;
+    TaskFunction_t function;
+    uint32_t       stackBytes;  // 0 = left out by config.h
+    StackType_t*   stack;       // Static stack and control block; NULL = from the heap (one-shot tasks)
+    StaticTask_t*  tcb;
+    UBaseType_t    priority;
+    BaseType_t     core;
+    TaskHandle_t*  handle;      // The owning module's global
+};
+
+// Persistent tasks run on static stacks and control blocks, so none of their memory is ever on the
+// heap; one config.h leaves out gets a one-byte stack. One-shot tasks take theirs from the heap and
+// give it back when they end (systemTaskExit).
+#define TASK_STACK(name, bytes) \
+    static const uint32_t name##StackBytes = (bytes); \
+    static StackType_t name##Stack[(bytes) > 0 ? (bytes) : 1]; \
+    static StaticTask_t name##Tcb;
+#define TASK_STATIC(name) name##StackBytes, name##Stack, &name##Tcb
+#define TASK_HEAP(bytes)  (bytes), NULL, NULL
+
+TASK_STACK(LogDrain,     3072)
+TASK_STACK(Forwarder,    4096)
+TASK_STACK(ControlPoint, 3072)
+TASK_STACK(BikeControl,  3072)
+TASK_STACK(BikeConnect,  4096)
+TASK_STACK(BikeLink,     BIKE_LINK_AUTO_RECONNECT ? 4096 : 0)
+TASK_STACK(Erg,          3072)
+TASK_STACK(LinkManager,  LINK_MANAGER_ENABLED ? 3072 : 0)
+TASK_STACK(Sensors,      (SENSOR_HR_ENABLED || SENSOR_POWER_ENABLED) ? 8192 : 0)
+TASK_STACK(Motion,       STEPPER_ENABLED ? 3072 : 0)
+
+// Indexed by SystemTaskId. The forwarder outranks everything else on core 0 but the NimBLE host;
+// the knob motor's steps come from a timer interrupt, so its task only plans moves.
+static const SystemTaskSpec systemTaskLayout[SYSTEM_TASK_COUNT] = {
+    {"LogDrain",        logDrainTask_func,           TASK_STATIC(LogDrain),     1, TASK_CORE_APP,  &logDrainTaskHandle},
+    {"PeripheralSetup", blePeripheralSetupTask_func, TASK_HEAP(20480),          1, TASK_CORE_DATA, &blePeripheralTaskHandle},
+    {"Forwarder",       forwarderTask_func,          TASK_STATIC(Forwarder),    3, TASK_CORE_DATA, &forwarderTaskHandle},
+    {"ControlPoint",    controlPointTask_func,       TASK_STATIC(ControlPoint), 2, TASK_CORE_APP,  &controlPointTaskHandle},
+    {"BikeControl",     bikeControlTask_func,        TASK_STATIC(BikeControl),  2, TASK_CORE_APP,  &bikeControlTaskHandle},
+    {"BikeConnect",     bikeConnectTask_func,        TASK_STATIC(BikeConnect),  2, TASK_CORE_APP,  &bikeConnectTaskHandle},
+    {"BikeLink",        bikeLinkTask_func,           TASK_STATIC(BikeLink),     2, TASK_CORE_APP,  &bikeLinkTaskHandle},
+    {"ERG",             ergTask_func,                TASK_STATIC(Erg),          2, TASK_CORE_APP,  &ergTaskHandle},
+    {"LinkManager",     linkManagerTask_func,        TASK_STATIC(LinkManager),  1, TASK_CORE_APP,  &linkManagerTaskHandle},
+    {"Sensors",         sensorTask_func,             TASK_STATIC(Sensors),      1, TASK_CORE_APP,  &sensorTaskHandle},
+    {"Motion",          motionTask_func,             TASK_STATIC(Motion),       2, TASK_CORE_APP,  &motionTaskHandle},
+    {"Calibration",     calibrationTask_func,        TASK_HEAP(4096),           1, TASK_CORE_APP,  &calibrationTaskHandle},
+};
+
+// Final high-water marks of one-shot tasks that have ended (0 = never ran to systemTaskExit), and the
+// handle they ended with: FreeRTOS lists a deleted task until the idle task has freed it.
+static uint32_t systemTaskExitFreeMin[SYSTEM_TASK_COUNT];
+static TaskHandle_t systemTaskExitHandle[SYSTEM_TASK_COUNT];
+static portMUX_TYPE systemTasksMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool systemTaskCreate(uint8_t id) {
+    if (id >= SYSTEM_TASK_COUNT) return false;
+    const SystemTaskSpec& spec = systemTaskLayout[id];
+    if (spec.stackBytes == 0) {
+        ts_log_error("[Tasks] %s Task is left out by config.h.", spec.name);
+        return false;
+    }
+    BaseType_t status = pdPASS;
+    if (spec.stack != NULL) {
+        if (*spec.handle != NULL) { // A static stack holds one instance
+            ts_log_error("[Tasks] %s Task is already running.", spec.name);
+            return false;
+        }
+        *spec.handle = xTaskCreateStaticPinnedToCore(spec.function, spec.name, spec.stackBytes, NULL, spec.priority,
+                                                     spec.stack, spec.tcb, spec.core);
+        if (*spec.handle == NULL) status = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    } else {
+        status = xTaskCreatePinnedToCore(spec.function, spec.name, spec.stackBytes, NULL, spec.priority, spec.handle,
+                                         spec.core);
+    }
+    if (status != pdPASS) {
+        *spec.handle = NULL;
+        ts_log_error("Failed to create %s Task. Error: %d", spec.name, status);
+        return false;
+    }
+    return true;
+}
+
+void systemTaskExit() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t freeMin = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
+    for (uint8_t id = 0; id < SYSTEM_TASK_COUNT; id++) {
+        if (*systemTaskLayout[id].handle != self) continue;
+        portENTER_CRITICAL(&systemTasksMux);
+        systemTaskExitFreeMin[id] = freeMin;
+        systemTaskExitHandle[id] = self;
+        *systemTaskLayout[id].handle = NULL;
+        portEXIT_CRITICAL(&systemTasksMux);
+        ts_log_printf("[Tasks] %s done: %lu of %lu stack bytes never used, stack freed.", systemTaskLayout[id].name,
+                      (unsigned long)freeMin, (unsigned long)systemTaskLayout[id].stackBytes);
+        break;
+    }
+    vTaskDelete(NULL);
+}
+
+// --- UI Events ---
+static QueueHandle_t uiEventQueue = NULL;
+static volatile uint32_t uiEventsLost = 0;
+
+void systemTasksBegin() {
+    if (uiEventQueue == NULL) {
+        uiEventQueue = xQueueCreate(UI_EVENT_QUEUE_DEPTH, sizeof(UiEvent));
+    }
+    if (uiEventQueue == NULL) {
+        ts_log_error("[Tasks] Failed to create the UI event queue.");
+    }
+}
+
+bool uiPostEvent(uint8_t type, uint16_t value) {
+    UiEvent event;
+    event.type = type;
+    event.value = value;
+    if (uiEventQueue == NULL || xQueueSend(uiEventQueue, &event, 0) != pdPASS) {
+        uiEventsLost++; // loop() also refreshes the display on a timer: nothing stays stale for long
+        return false;
+    }
+    return true;
+}
+
+bool uiWaitEvent(UiEvent& event, TickType_t ticks) {
+    if (uiEventQueue == NULL) {
+        vTaskDelay(ticks);
+        return false;
+    }
+    return xQueueReceive(uiEventQueue, &event, ticks) == pdTRUE;
+}
+
+uint32_t uiEventsDropped() {
+    return uiEventsLost;
+}
+
+// --- Stats ---
+static int8_t layoutIdOf(TaskHandle_t handle) {
+    if (handle == NULL) return -1;
+    for (uint8_t id = 0; id < SYSTEM_TASK_COUNT; id++) {
+        if (*systemTaskLayout[id].handle == handle) return (int8_t)id;
+    }
+    return -1;
+}
+
+// An ended one-shot task that FreeRTOS still lists. Compared by name too: its handle may be reused.
+static bool endedOneShot(TaskHandle_t handle, const char* name) {
+    for (uint8_t id = 0; id < SYSTEM_TASK_COUNT; id++) {
+        if (systemTaskExitHandle[id] == handle && strcmp(systemTaskLayout[id].name, name) == 0) return true;
+    }
+    return false;
+}
+
+static int8_t coreOf(BaseType_t core) {
+    return core == 0 || core == 1 ? (int8_t)core : -1;
+}
+
+static void fillLayoutEntry(SystemTaskStats& entry, uint8_t id) {
+    const SystemTaskSpec& spec = systemTaskLayout[id];
+    snprintf(entry.name, sizeof(entry.name), "%s", spec.name);
+    entry.core = coreOf(spec.core);
+    entry.priority = (uint8_t)spec.priority;
+    entry.stackBytes = spec.stackBytes;
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+// Run-time counters of the previous sample, by handle. The counters are 32-bit microseconds and wrap
+// after ~71 minutes; unsigned deltas stay right as long as samples are closer together than that.
+static TaskStatus_t taskStatus[SYSTEM_TASKS_STATS_MAX];
+static TaskHandle_t previousHandle[SYSTEM_TASKS_STATS_MAX];
+static uint32_t previousRunTime[SYSTEM_TASKS_STATS_MAX];
+static uint8_t previousCount = 0;
+static uint32_t previousTotalRunTime = 0;
+
+static uint32_t previousRunTimeOf(TaskHandle_t handle, uint32_t current) {
+    for (uint8_t i = 0; i < previousCount; i++) {
+        if (previousHandle[i] == handle) return previousRunTime[i];
+    }
+    return current; // New since the last sample: no share yet
+}
+#endif
+
+void systemTasksGetStats(SystemTasksStats& out) {
+    out.count = 0;
+    out.coreLoadPermille[0] = -1;
+    out.coreLoadPermille[1] = -1;
+    out.sampleMs = 0;
+    bool listed[SYSTEM_TASK_COUNT];
+    memset(listed, 0, sizeof(listed));
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    uint32_t totalRunTime = 0;
+    UBaseType_t taskCount = uxTaskGetSystemState(taskStatus, SYSTEM_TASKS_STATS_MAX, &totalRunTime);
+    uint32_t elapsed = totalRunTime - previousTotalRunTime;
+    bool haveShares = previousTotalRunTime != 0 && elapsed > 0;
+    out.sampleMs = haveShares ? elapsed / 1000 : 0;
+    for (UBaseType_t i = 0; i < taskCount && out.count < SYSTEM_TASKS_STATS_MAX; i++) {
+        const TaskStatus_t& status = taskStatus[i];
+        if (status.eCurrentState == eDeleted || endedOneShot(status.xHandle, status.pcTaskName)) continue;
+        SystemTaskStats& entry = out.tasks[out.count++];
+        int8_t id = layoutIdOf(status.xHandle);
+        if (id >= 0) {
+            fillLayoutEntry(entry, (uint8_t)id);
+            listed[id] = true;
+        } else {
+            strncpy(entry.name, status.pcTaskName, sizeof(entry.name) - 1);
+            entry.name[sizeof(entry.name) - 1] = '\0';
+            entry.core = coreOf(xTaskGetAffinity(status.xHandle));
+            entry.stackBytes = 0;
+        }
+        entry.priority = (uint8_t)status.uxCurrentPriority;
+        entry.stackFreeMin = (uint32_t)status.usStackHighWaterMark;
+        entry.running = true;
+        uint32_t ran = status.ulRunTimeCounter - previousRunTimeOf(status.xHandle, status.ulRunTimeCounter);
+        entry.cpuPermille = haveShares ? (int16_t)((uint64_t)ran * 1000 / elapsed) : -1;
+        // Each core's IDLE task runs whenever nothing else does: the rest is that core's load.
+        if (haveShares && strncmp(status.pcTaskName, "IDLE", 4) == 0 && entry.core >= 0) {
+            out.coreLoadPermille[entry.core] = (int16_t)(1000 - (entry.cpuPermille > 1000 ? 1000 : entry.cpuPermille));
+        }
+    }
+    previousCount = 0;
+    for (UBaseType_t i = 0; i < taskCount && i < SYSTEM_TASKS_STATS_MAX; i++) {
+        previousHandle[previousCount] = taskStatus[i].xHandle;
+        previousRunTime[previousCount++] = taskStatus[i].ulRunTimeCounter;
+    }
+    previousTotalRunTime = totalRunTime;
+#else
+    // No run-time counters in this FreeRTOS build: only the stacks of the layout's tasks.
+    for (uint8_t id = 0; id < SYSTEM_TASK_COUNT && out.count < SYSTEM_TASKS_STATS_MAX; id++) {
+        TaskHandle_t handle = *systemTaskLayout[id].handle;
+        if (handle == NULL) continue;
+        SystemTaskStats& entry = out.tasks[out.count++];
+        fillLayoutEntry(entry, id);
+        entry.stackFreeMin = (uint32_t)uxTaskGetStackHighWaterMark(handle);
+        entry.cpuPermille = -1;
+        entry.running = true;
+        listed[id] = true;
+    }
+#endif
+
+    // One-shot tasks that have ended keep their final mark.
+    for (uint8_t id = 0; id < SYSTEM_TASK_COUNT && out.count < SYSTEM_TASKS_STATS_MAX; id++) {
+        portENTER_CRITICAL(&systemTasksMux);
+        uint32_t freeMin = systemTaskExitFreeMin[id];
+        bool ended = freeMin != 0 && *systemTaskLayout[id].handle == NULL;
+        portEXIT_CRITICAL(&systemTasksMux);
+        if (listed[id] || !ended) continue;
+        SystemTaskStats& entry = out.tasks[out.count++];
+        fillLayoutEntry(entry, id);
+        entry.stackFreeMin = freeMin;
+        entry.cpuPermille = 0;
+        entry.running = false;
+    }
+}
+
+void systemTasksLogStats() {
+    static SystemTasksStats stats; // UI task only; kept off its stack
+    systemTasksGetStats(stats);
+    if (stats.coreLoadPermille[0] >= 0) {
+        ts_log_printf("[Tasks] Over %lu ms: core 0 %d.%d%% busy, core 1 %d.%d%% busy. UI events dropped: %lu",
+                      (unsigned long)stats.sampleMs, stats.coreLoadPermille[0] / 10, stats.coreLoadPermille[0] % 10,
+                      stats.coreLoadPermille[1] / 10, stats.coreLoadPermille[1] % 10, (unsigned long)uiEventsDropped());
+    } else {
+        ts_log_printf("[Tasks] CPU shares need FreeRTOS run-time stats (first sample, or not in this build). UI events dropped: %lu",
+                      (unsigned long)uiEventsDropped());
+    }
+    for (uint8_t i = 0; i < stats.count; i++) {
+        const SystemTaskStats& task = stats.tasks[i];
+        char cpu[12];
+        if (task.cpuPermille >= 0) snprintf(cpu, sizeof(cpu), "%d.%d%%", task.cpuPermille / 10, task.cpuPermille % 10);
+        else strcpy(cpu, "-");
+        char stack[24];
+        if (task.stackBytes > 0) snprintf(stack, sizeof(stack), "%lu/%lu", (unsigned long)(task.stackBytes - task.stackFreeMin),
+                                          (unsigned long)task.stackBytes);
+        else snprintf(stack, sizeof(stack), "%lu free", (unsigned long)task.stackFreeMin);
+        ts_log_printf("[Tasks]   %-18s core %c prio %2u cpu %6s stack peak %s%s", task.name,
+                      task.core >= 0 ? (char)('0' + task.core) : '*', task.priority, cpu, stack,
+                      task.running ? "" : " (ended)");
+    }
+}
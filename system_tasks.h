@@ -0,0 +1,75 @@
+#ifndef SYSTEM_TASKS_H
+#define SYSTEM_TASKS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+// --- Task Layout ---
+// Core 0 (TASK_CORE_DATA): the NimBLE host and, next to it, the bike -> app data path (forwarder).
+// Core 1 (TASK_CORE_APP): control (Control Point, ERG, bike control, connection parameters), I/O
+// (bike and sensor links, knob motor, log drain) and the UI task, loop(). Tasks hand work to each other
+// through typed queues: button -> bike connect task (ble_client_manager.h), BLE callbacks -> UI (below),
+// Control Point -> response task (ftms_control_point.cpp), level targets -> motion task (stepper_motion.h).
+enum SystemTaskId : uint8_t {
+    SYSTEM_TASK_LOG_DRAIN,
+    SYSTEM_TASK_PERIPHERAL_SETUP, // One-shot: builds the GATT server and starts advertising
+    SYSTEM_TASK_FORWARDER,
+    SYSTEM_TASK_CONTROL_POINT,
+    SYSTEM_TASK_BIKE_CONTROL,
+    SYSTEM_TASK_BIKE_CONNECT,
+    SYSTEM_TASK_BIKE_LINK,
+    SYSTEM_TASK_ERG,
+    SYSTEM_TASK_LINK_MANAGER,
+    SYSTEM_TASK_SENSORS,
+    SYSTEM_TASK_MOTION,
+    SYSTEM_TASK_CALIBRATION,      // One-shot: knob sweep from the console
+    SYSTEM_TASK_COUNT
+};
+
+// Creates the task with its layout entry (core, priority, stack) and stores its handle in the
+// module's global. Logs and returns false if FreeRTOS refuses.
+bool systemTaskCreate(uint8_t id);
+// Ends the calling one-shot task: keeps its stack high-water mark for the stats, clears its handle
+// and deletes it, so its stack goes back to the heap.
+void systemTaskExit();
+
+// --- UI Events (BLE callbacks -> loop()) ---
+#define UI_EVENT_APP_LINK  0 // value: open app sessions
+#define UI_EVENT_CONTROL   1 // value: connection handle of the app in control (APP_SESSION_NONE = released)
+#define UI_EVENT_BIKE_LINK 2 // value: 1 = bike connected, 0 = bike down
+
+struct UiEvent {
+    uint8_t  type;  // UI_EVENT_*
+    uint16_t value;
+};
+
+bool uiPostEvent(uint8_t type, uint16_t value);  // Never blocks; a full queue drops the event
+bool uiWaitEvent(UiEvent& event, TickType_t ticks);
+uint32_t uiEventsDropped();
+
+// --- Stats ---
+struct SystemTaskStats {
+    char     name[16];
+    int8_t   core;          // -1 = either core
+    uint8_t  priority;
+    uint32_t stackBytes;    // From the layout; 0 for tasks created elsewhere (NimBLE host, loopTask, IDLE)
+    uint32_t stackFreeMin;  // High-water mark: fewest stack bytes ever left free
+    int16_t  cpuPermille;   // Share of one core since the previous sample; -1 without run-time stats
+    bool     running;       // false: a one-shot task that has ended (stackFreeMin is its final mark)
+};
+
+struct SystemTasksStats {
+    uint8_t  count;
+    SystemTaskStats tasks[SYSTEM_TASKS_STATS_MAX];
+    int16_t  coreLoadPermille[2]; // 1000 - the core's IDLE task share; -1 without run-time stats
+    uint32_t sampleMs;            // Time covered by the CPU shares
+};
+
+// CPU shares are deltas since the previous call: sample from one task only (the UI task, or a host tool).
+void systemTasksGetStats(SystemTasksStats& out);
+void systemTasksLogStats();
+
+void systemTasksBegin(); // UI queue. setup(), before the BLE tasks
+
+#endif // SYSTEM_TASKS_H
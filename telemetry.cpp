@@ -0,0 +1,51 @@
+#include "telemetry.h"
+#include <esp_timer.h> // For esp_timer_get_time (monotonic microseconds)
+#include <atomic>
+#include <string.h>
+
+// Seqlock: odd value = publish in progress, even value = frame stable.
+static std::atomic<uint32_t> telemetrySeqLock(0);
+static TelemetryFrame publishedFrame = {};
+static TelemetryFrame stagingFrame = {}; // Owned by the writer task only
+
+TelemetryFrame& telemetryBeginUpdate() {
+    return stagingFrame;
+}
+
+void telemetryPublish() {
+    stagingFrame.sequence++;
+    stagingFrame.timestampUs = esp_timer_get_time();
+
+    uint32_t seq = telemetrySeqLock.load(std::memory_order_relaxed);
+    telemetrySeqLock.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&publishedFrame, &stagingFrame, sizeof(TelemetryFrame));
+    telemetrySeqLock.store(seq + 2, std::memory_order_release);
+}
+
+void telemetryReset() {
+    uint32_t sequence = stagingFrame.sequence;
+    TelemetryTotals totals = stagingFrame.totals;
+    memset(&stagingFrame, 0, sizeof(TelemetryFrame));
+    stagingFrame.sequence = sequence;
+    stagingFrame.totals = totals;
+    telemetryPublish();
+}
+
+void telemetryRead(TelemetryFrame& out) {
+    uint32_t seqBefore, seqAfter;
+    do {
+        seqBefore = telemetrySeqLock.load(std::memory_order_acquire);
+        memcpy(&out, &publishedFrame, sizeof(TelemetryFrame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seqAfter = telemetrySeqLock.load(std::memory_order_relaxed);
+    } while ((seqBefore & 1) || seqBefore != seqAfter);
+}
+
+uint32_t telemetrySequence() {
+    uint32_t seq;
+    do {
+        seq = telemetrySeqLock.load(std::memory_order_acquire);
+    } while (seq & 1);
+    return seq >> 1;
+}
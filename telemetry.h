@@ -0,0 +1,63 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// --- Telemetry Snapshot ---
+// One consistent frame of bike data, merged with the external sensors (sensor_links.h). The NimBLE
+// host task is the only writer (bike and sensor notification callbacks); loop(), the display and the
+// FTMS encoder read it.
+#define TELEMETRY_SOURCE_BIKE  0
+#define TELEMETRY_SOURCE_METER 1 // Power meter (0x1818)
+
+// Filtered speed, cadence and power (ride_filter.h), in the units of the raw fields.
+#define TELEMETRY_METRIC_SPEED   0
+#define TELEMETRY_METRIC_CADENCE 1
+#define TELEMETRY_METRIC_POWER   2
+#define TELEMETRY_METRIC_COUNT   3
+
+#define TELEMETRY_FILTER_SHORT   0    // Average over RIDE_FILTER_SHORT_MS
+#define TELEMETRY_FILTER_LONG    1    // Average over RIDE_FILTER_LONG_MS
+#define TELEMETRY_FILTER_SESSION 2    // Average over the ride session (ride_session.h)
+#define TELEMETRY_FILTER_EMA     3    // Exponential moving average, RIDE_FILTER_EMA_TAU_MS
+#define TELEMETRY_FILTER_COUNT   4
+#define TELEMETRY_FILTER_RAW     0xFF // Consumer setting only: the unfiltered field
+
+// Ride session totals (ride_session.h). Unlike the live fields they survive telemetryReset(), so a
+// bike reconnect does not zero the ride.
+struct TelemetryTotals {
+    uint32_t distanceM;       // Integrated from speed
+    uint32_t workJ;           // Mechanical work, integrated from power
+    uint32_t elapsedS;        // Since the session started, pauses and reconnects included
+    uint32_t movingS;         // Time with speed or cadence
+};
+
+struct TelemetryFrame {
+    uint32_t sequence;        // Incremented on every publish (0 = nothing published yet)
+    int64_t  timestampUs;     // Monotonic esp_timer time of the sample, in microseconds
+    uint16_t speed;           // 0.01 km/h
+    uint16_t cadence;         // 0.5 RPM resolution (raw RPM x2 from the bike)
+    uint16_t power;           // Watts, from powerSource
+    uint16_t bikePower;       // Watts, the bike's own estimate
+    uint16_t caloriesX10;     // Bike-reported calories x10 (restarts with the bike; see totals)
+    uint8_t  resistanceLevel; // Apparent resistance level (1-8, 0 = unknown)
+    uint8_t  heartRate;       // BPM from the heart-rate strap (0 = none)
+    uint8_t  powerSource;     // TELEMETRY_SOURCE_*
+    uint16_t filtered[TELEMETRY_FILTER_COUNT][TELEMETRY_METRIC_COUNT]; // [TELEMETRY_FILTER_*][TELEMETRY_METRIC_*]
+    TelemetryTotals totals;
+};
+
+// --- Writer API (single writer: NimBLE host task) ---
+// The writer edits a private staging copy and publishes it as one frame.
+TelemetryFrame& telemetryBeginUpdate();
+void telemetryPublish();
+void telemetryReset(); // Zeroes the live data fields, keeps the totals, and publishes (e.g. on bike disconnect)
+
+// --- Reader API (any task, lock-free) ---
+// Copies the latest frame into 'out'. Retries internally while a publish is in flight.
+void telemetryRead(TelemetryFrame& out);
+// Current publish count; cheap way to detect a new sample without copying the frame.
+uint32_t telemetrySequence();
+
+#endif // TELEMETRY_H
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""Decodes tokenized log frames (TS_LOG_TOKEN / TS_LOG_TOKEN_HEX, see logger.h) in a serial capture.
+
+The string table is rebuilt from the sources: every TS_LOG_TOKEN* format literal is hashed with
+the same FNV-1a as logTokenHash(). Text lines in the capture are passed through unchanged.
+
+Usage:
+    tools/log_decode.py serial.log            # decode a saved capture
+    cat /dev/ttyACM0 | tools/log_decode.py    # decode a live stream from stdin
+    tools/log_decode.py --table               # list token -> format string
+"""
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+
+SYNC = 0x1E
+LEVEL_TAGS = {1: "ERROR: ", 2: "WARN: ", 4: "DEBUG: "}
+
+CALL_RE = re.compile(r'TS_LOG_TOKEN(_HEX)?\s*\(\s*[A-Z_]+\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+SPEC_RE = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t|L)?([diouxXcsfFeEgGp%])')
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '\\': '\\', '"': '"', "'": "'", '0': '\0'}
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    out = []
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        if c == '\\' and i + 1 < len(literal):
+            nxt = literal[i + 1]
+            if nxt == 'x':
+                m = re.match(r'[0-9A-Fa-f]+', literal[i + 2:])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+                continue
+            out.append(ESCAPES.get(nxt, nxt))
+            i += 2
+            continue
+        out.append(c)
+        i += 1
+    return ''.join(out)
+
+
+def build_table(src_dir):
+    table = {}
+    paths = []
+    for pattern in ('*.cpp', '*.h', '*.ino'):
+        paths += glob.glob(os.path.join(src_dir, pattern))
+    for path in sorted(paths):
+        with open(path, encoding='utf-8', errors='replace') as f:
+            text = f.read()
+        for m in CALL_RE.finditer(text):
+            fmt = ''.join(unescape(lit) for lit in LITERAL_RE.findall(m.group(2)))
+            token = fnv1a(fmt.encode('latin-1', errors='replace'))
+            entry = (fmt, bool(m.group(1)))
+            if token in table and table[token] != entry:
+                sys.stderr.write('warning: token 0x%08X collides: %r / %r\n' % (token, table[token][0], fmt))
+            table[token] = entry
+    return table
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def format_args(fmt, is_hex, args):
+    pos = 0
+    out = []
+    last = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        if pos >= len(args):
+            out.append('<missing>')
+            continue
+        if conv == 's':
+            length, pos = read_varint(args, pos)
+            raw = args[pos:pos + length]
+            pos += length
+            out.append(''.join('%02X ' % b for b in raw) if is_hex else raw.decode('latin-1'))
+        elif conv in 'fFeEgG':
+            value = struct.unpack_from('<f', args, pos)[0]
+            pos += 4
+            out.append(('%' + flags + conv) % value)
+        else:
+            raw, pos = read_varint(args, pos)
+            value = (raw >> 1) ^ -(raw & 1)  # zigzag
+            if conv in 'uxXo' and value < 0:
+                value &= 0xFFFFFFFF
+            if conv == 'p':
+                out.append('0x%x' % value)
+            elif conv == 'c':
+                out.append(chr(value & 0xFF))
+            else:
+                out.append(('%' + flags + ('d' if conv == 'i' else conv)) % value)
+    out.append(fmt[last:])
+    return ''.join(out)
+
+
+def decode_frame(payload, table):
+    module_level = payload[0]
+    timestamp_ms, pos = read_varint(payload, 1)
+    token = struct.unpack_from('<I', payload, pos)[0]
+    args = payload[pos + 4:]
+    level = module_level & 0x07
+    entry = table.get(token)
+    if entry is None:
+        text = '<unknown token 0x%08X, module %d, args %s>' % (token, module_level >> 3, args.hex())
+    else:
+        text = format_args(entry[0], entry[1], args)
+    return '[%08.3fs] %s%s' % (timestamp_ms / 1000.0, LEVEL_TAGS.get(level, ''), text)
+
+
+def decode_stream(data, table, out):
+    pos = 0
+    text = bytearray()
+    while pos < len(data):
+        b = data[pos]
+        if b == SYNC and pos + 1 < len(data):
+            length = data[pos + 1]
+            frame = data[pos + 2:pos + 2 + length]
+            pos += 2 + length
+            if len(frame) < length:
+                break  # Truncated at the end of the capture
+            if text:
+                out.write(text.decode('latin-1'))
+                text = bytearray()
+            try:
+                out.write(decode_frame(frame, table) + '\n')
+            except (IndexError, struct.error):
+                out.write('<malformed frame %s>\n' % frame.hex())
+            continue
+        text.append(b)
+        pos += 1
+    if text:
+        out.write(text.decode('latin-1'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help='serial capture (default: stdin)')
+    parser.add_argument('--src', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'),
+                        help='directory with the sketch sources (default: repository root)')
+    parser.add_argument('--table', action='store_true', help='print the token table and exit')
+    args = parser.parse_args()
+
+    table = build_table(args.src)
+    if args.table:
+        for token, (fmt, is_hex) in sorted(table.items()):
+            print('0x%08X %s %r' % (token, 'hex ' if is_hex else 'text', fmt))
+        return
+    if args.capture:
+        with open(args.capture, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    decode_stream(data, table, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()